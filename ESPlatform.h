@@ -0,0 +1,66 @@
+/*
+ * ESPlatform.h
+ *
+ *    The window system behind ESUtil. Each platform (RPi dispmanx, X11,
+ *    headless) fills in an ESPlatform and the public esCreateWindow(),
+ *    esSwapBuffers() and esExit() call through it, so one binary can run
+ *    on whichever platform is chosen at startup.
+ *
+ *    Platforms are compiled in by the Makefile with ES_HAVE_DISPMANX and
+ *    ES_HAVE_X11, headless is always available.
+ */
+#ifndef ESPLATFORM_H
+#define ESPLATFORM_H
+
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#include "ESUtil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ESPlatform
+{
+   /* Name for esSetPlatform() and the ES_PLATFORM environment variable */
+   const char *name;
+
+   /* Create the window, EGL display, surface and context and make them
+      current. esContext->width/height hold the size asked for (0 for the
+      platform's choice) and are set to the actual size. */
+   EGLBoolean (*create)(ESContext *esContext, const char *title, EGLint attribList[]);
+
+   /* Present the frame */
+   void (*swapBuffers)(ESContext *esContext);
+
+   /* GL_TRUE if the window was closed */
+   GLboolean (*userInterrupt)(ESContext *esContext);
+
+   /* Close the window, after the EGL objects have been released */
+   void (*destroy)(ESContext *esContext);
+
+   /* Present the frame, only the rectangles changed. NULL if the
+      platform has nothing better than swapBuffers */
+   void (*swapBuffersWithDamage)(ESContext *esContext, const EGLint *rects, EGLint nrects);
+} ESPlatform;
+
+#ifdef ES_HAVE_DISPMANX
+extern const ESPlatform esPlatformDispmanx;
+#endif
+#ifdef ES_HAVE_X11
+extern const ESPlatform esPlatformX11;
+#endif
+extern const ESPlatform esPlatformHeadless;
+
+/* Shared by the platforms, in ESUtil.c */
+EGLBoolean CreateEGLContext ( EGLNativeDisplayType nativeDisplay, EGLNativeWindowType hWnd,
+                              ESContext *esContext, EGLint attribList[] );
+void CreateSharedContext ( EGLDisplay display, EGLConfig config, EGLContext context,
+                           EGLContext* uploadContext, EGLSurface* uploadSurface );
+void SwapBuffersWithDamage ( ESContext *esContext, const EGLint *rects, EGLint nrects );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPLATFORM_H
@@ -18,6 +18,7 @@
  *  Includes
  */
 #include "ESUtil.h"
+#include "gltrace.h"
 #include <stdlib.h>
 
 
@@ -22,130 +22,79 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
-#include <sys/time.h>
+#include <time.h>
 #include <GLES2/gl2.h>
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include "ESUtil.h"
+#include "log.h"
+#include "ESPlatform.h"
+#include "glcount.h"
 
-#ifdef RPI_NO_X
-#include  "bcm_host.h"
-#else
-#include  <X11/Xlib.h>
-#include  <X11/Xatom.h>
-#include  <X11/Xutil.h>
+// Platforms compiled in, the first is the default (see esSetPlatform()).
+static const ESPlatform *platforms[] =
+{
+#ifdef ES_HAVE_DISPMANX
+   &esPlatformDispmanx,
 #endif
-
-#ifndef RPI_NO_X
-// X11 related local variables
-static Display *x_display = NULL;
+#ifdef ES_HAVE_X11
+   &esPlatformX11,
 #endif
+   &esPlatformHeadless,
+   NULL
+};
 
 
-
-
-/* ORIGINAL VERSION:
-*/
-
 ///
-// CreateEGLContext()
+// CreateSharedContext()
 //
-//    Creates an EGL rendering context and all associated elements
+//    Creates a second GL context sharing textures/buffers with 'context', and a
+//    tiny pbuffer for it, so another thread can upload assets. Falls back to
+//    no surface (EGL_KHR_surfaceless_context). Not fatal if neither works.
 //
-EGLBoolean CreateEGLContext ( EGLNativeWindowType hWnd, EGLDisplay* eglDisplay,
-                              EGLContext* eglContext, EGLSurface* eglSurface,
-                              EGLint attribList[])
+void CreateSharedContext ( EGLDisplay display, EGLConfig config, EGLContext context,
+                           EGLContext* uploadContext, EGLSurface* uploadSurface )
 {
-   EGLint numConfigs;
-   EGLint majorVersion;
-   EGLint minorVersion;
-   EGLDisplay display;
-   EGLContext context;
-   EGLSurface surface;
-   EGLConfig config;
-   #ifndef RPI_NO_X
-   EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE, EGL_NONE };
-   #else
    EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
-   #endif
-   
-   
-   // Get Display
-   #ifndef RPI_NO_X
-   display = eglGetDisplay((EGLNativeDisplayType)x_display);
-   if ( display == EGL_NO_DISPLAY )
-   {
-      return EGL_FALSE;
-   }
-   #else
-   display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-   if ( display == EGL_NO_DISPLAY )
-   {
-      return EGL_FALSE;
-   }
-   #endif
-
-   // Initialize EGL
-   if ( !eglInitialize(display, &majorVersion, &minorVersion) )
-   {
-      return EGL_FALSE;
-   }
+   EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+   const char *extensions;
 
-   // Get configs
-   if ( !eglGetConfigs(display, NULL, 0, &numConfigs) )
-   {
-      return EGL_FALSE;
-   }
+   *uploadContext = EGL_NO_CONTEXT;
+   *uploadSurface = EGL_NO_SURFACE;
 
-   // Choose config
-   if ( !eglChooseConfig(display, attribList, &config, 1, &numConfigs) )
-   {
-      return EGL_FALSE;
-   }
-
-   // Create a surface
-   surface = eglCreateWindowSurface(display, config, (EGLNativeWindowType)hWnd, NULL);
-   if ( surface == EGL_NO_SURFACE )
+   *uploadSurface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+   if ( *uploadSurface == EGL_NO_SURFACE )
    {
-      return EGL_FALSE;
+      extensions = eglQueryString(display, EGL_EXTENSIONS);
+      if ( extensions == NULL || strstr(extensions, "EGL_KHR_surfaceless_context") == NULL )
+      {
+         return;
+      }
    }
 
-   // Create a GL context
-   context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs );
-   if ( context == EGL_NO_CONTEXT )
+   *uploadContext = eglCreateContext(display, config, context, contextAttribs);
+   if ( *uploadContext == EGL_NO_CONTEXT && *uploadSurface != EGL_NO_SURFACE )
    {
-      return EGL_FALSE;
-   }   
-   
-   // Make the context current
-   if ( !eglMakeCurrent(display, surface, surface, context) )
-   {
-      return EGL_FALSE;
+      eglDestroySurface(display, *uploadSurface);
+      *uploadSurface = EGL_NO_SURFACE;
    }
-   
-   *eglDisplay = display;
-   *eglSurface = surface;
-   *eglContext = context;
-   return EGL_TRUE;
-} 
+}
 
 
 
 
-/* 22/6/16 Micro : Modified to include dispmax_ calls inside. 
-   Just for RPi!
+/* ORIGINAL VERSION:
 */
 
 ///
 // CreateEGLContext()
 //
 //    Creates an EGL rendering context and all associated elements
+//    for a platform's native display and window.
 //
-EGLBoolean CreateEGLContext_M ( ESContext *esContext, EGLDisplay* eglDisplay,
-                              EGLContext* eglContext, EGLSurface* eglSurface,
-                              EGLint attribList[])
+EGLBoolean CreateEGLContext ( EGLNativeDisplayType nativeDisplay, EGLNativeWindowType hWnd,
+                              ESContext *esContext, EGLint attribList[] )
 {
-   int32_t success = 0;
-
    EGLint numConfigs;
    EGLint majorVersion;
    EGLint minorVersion;
@@ -154,20 +103,10 @@ EGLBoolean CreateEGLContext_M ( ESContext *esContext, EGLDisplay* eglDisplay,
    EGLSurface surface;
    EGLConfig config;
    EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
-
-   static EGL_DISPMANX_WINDOW_T nativewindow;
    
-   DISPMANX_ELEMENT_HANDLE_T dispman_element;
-   DISPMANX_DISPLAY_HANDLE_T dispman_display;
-   DISPMANX_UPDATE_HANDLE_T dispman_update;
-   VC_RECT_T dst_rect;
-   VC_RECT_T src_rect;
-   uint32_t display_width;
-   uint32_t display_height;
-
-  
+   
    // Get Display
-   display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+   display = eglGetDisplay(nativeDisplay);
    if ( display == EGL_NO_DISPLAY )
    {
       return EGL_FALSE;
@@ -179,21 +118,21 @@ EGLBoolean CreateEGLContext_M ( ESContext *esContext, EGLDisplay* eglDisplay,
       return EGL_FALSE;
    }
 
-   /* Get configs
+   // Get configs
    if ( !eglGetConfigs(display, NULL, 0, &numConfigs) )
    {
       return EGL_FALSE;
    }
-*/
 
    // Choose config
-   if ( !eglChooseConfig(display, attribList, &config, 1, &numConfigs) )
+   if ( !eglChooseConfig(display, attribList, &config, 1, &numConfigs) || numConfigs < 1 )
    {
       return EGL_FALSE;
    }
 
-   // get an appropriate EGL frame buffer configuration
-   if ( !eglBindAPI(EGL_OPENGL_ES_API) )
+   // Create a surface
+   surface = eglCreateWindowSurface(display, config, (EGLNativeWindowType)hWnd, NULL);
+   if ( surface == EGL_NO_SURFACE )
    {
       return EGL_FALSE;
    }
@@ -204,266 +143,125 @@ EGLBoolean CreateEGLContext_M ( ESContext *esContext, EGLDisplay* eglDisplay,
    {
       return EGL_FALSE;
    }   
-
-// PUT IN HERE THE EGL vc_dispmax_ functions.
-
-   // create an EGL window surface
-   success = graphics_get_display_size(0 /* LCD */, &display_width, &display_height ) ;
-   if ( success < 0 )
-   {
-      return EGL_FALSE;
-   }   
-
-    dst_rect.x = 0;
-    dst_rect.y = 0;
-    dst_rect.width = display_width;
-    dst_rect.height = display_height;
-
-    src_rect.x = 0;
-    src_rect.y = 0;
-    src_rect.width = display_width << 16;
-    src_rect.height = display_height << 16;        
-
-    dispman_display = vc_dispmanx_display_open( 0 /* LCD */);
-    dispman_update = vc_dispmanx_update_start( 0 );
-
-    dispman_element = 
-	vc_dispmanx_element_add(dispman_update, dispman_display,
-				0/*layer*/, &dst_rect, 0/*src*/,
-				&src_rect, DISPMANX_PROTECTION_NONE, 
-				0 /*alpha*/, 0/*clamp*/, 0/*transform*/);
-
-    nativewindow.element = dispman_element;
-    nativewindow.width = display_width;
-    nativewindow.height = display_height;
-    vc_dispmanx_update_submit_sync( dispman_update );
-
-   esContext->hWnd = &nativewindow;
-   esContext->dispman_display = dispman_display;
-   esContext->width = display_width;
-   esContext->height = display_height;
-
-   // Create a surface
-   surface = eglCreateWindowSurface(display, config, &nativewindow, NULL);
-   if ( surface == EGL_NO_SURFACE )
-   {
-      return EGL_FALSE;
-   }
    
    // Make the context current
    if ( !eglMakeCurrent(display, surface, surface, context) )
    {
       return EGL_FALSE;
    }
+
+   // A second context for the asset upload thread.
+   CreateSharedContext(display, config, context,
+                       &esContext->eglUploadContext, &esContext->eglUploadSurface);
    
-   *eglDisplay = display;
-   *eglSurface = surface;
-   *eglContext = context;
+   esContext->eglDisplay = display;
+   esContext->eglSurface = surface;
+   esContext->eglContext = context;
    return EGL_TRUE;
 } 
 
 
-#ifdef RPI_NO_X
-///
-//  WinCreate() - RaspberryPi, direct surface (No X, Xlib)
-//
-//      This function initialized the display and window for EGL
-//
-EGLBoolean WinCreate(ESContext *esContext, const char *title) 
-{
-   int32_t success = 0;
-
-   static EGL_DISPMANX_WINDOW_T nativewindow;
 
-   DISPMANX_ELEMENT_HANDLE_T dispman_element;
-   DISPMANX_DISPLAY_HANDLE_T dispman_display;
-   DISPMANX_UPDATE_HANDLE_T dispman_update;
-   VC_RECT_T dst_rect;
-   VC_RECT_T src_rect;
-   
-
-   uint32_t display_width;
-   uint32_t display_height;
 
-   // create an EGL window surface, passing context width/height
-   success = graphics_get_display_size(0 /* LCD */, &display_width, &display_height);
-   if ( success < 0 )
-   {
-      return EGL_FALSE;
-   }
-   
-   // You can hardcode the resolution here:
-//   display_width = 1920;
-//   display_height = 1080;
-
-   dst_rect.x = 0;
-   dst_rect.y = 0;
-   dst_rect.width = display_width;
-   dst_rect.height = display_height;
-      
-   src_rect.x = 0;
-   src_rect.y = 0;
-   src_rect.width = display_width << 16;
-   src_rect.height = display_height << 16;   
-
-   dispman_display = vc_dispmanx_display_open( 0 /* LCD */);
-   dispman_update = vc_dispmanx_update_start( 0 );
-         
-   dispman_element = vc_dispmanx_element_add ( dispman_update, dispman_display,
-      0/*layer*/, &dst_rect, 0/*src*/,
-      &src_rect, DISPMANX_PROTECTION_NONE, 0 /*alpha*/, 0/*clamp*/, 0/*transform*/);
-      
-   nativewindow.element = dispman_element;
-   nativewindow.width = display_width;
-   nativewindow.height = display_height;
-   vc_dispmanx_update_submit_sync( dispman_update );
-   
-   esContext->hWnd = &nativewindow;
-   esContext->dispman_display = dispman_display;
-   esContext->width = display_width;
-   esContext->height = display_height;
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
 
-	return EGL_TRUE;
-}
 ///
-//  userInterrupt()
+//  esInitContext()
 //
-//      Reads from X11 event loop and interrupt program if there is a keypress, or
-//      window close action.
+//      Initialize ES utility context.  This must be called before calling any other
+//      functions.
 //
-GLboolean userInterrupt(ESContext *esContext)
+void ESUTIL_API esInitContext ( ESContext *esContext )
 {
-	//GLboolean userinterrupt = GL_FALSE;
-    //return userinterrupt;
-    
-    // Ctrl-C for now to stop
-    
-    return GL_FALSE;
+   if ( esContext != NULL )
+   {
+      memset( esContext, 0, sizeof( ESContext) );
+   }
 }
-#else
+
+
 ///
-//  WinCreate()
+//  esSetPlatform()
 //
-//      This function initialized the native X11 display and window for EGL
+//      Choose the window system by name, before esCreateWindow().
+//      NULL picks $ES_PLATFORM if set, else the first platform compiled
+//      in, passing over X11 when there is no $DISPLAY.
 //
-EGLBoolean WinCreate(ESContext *esContext, const char *title)
+GLboolean ESUTIL_API esSetPlatform ( ESContext *esContext, const char *name )
 {
-    Window root;
-    XSetWindowAttributes swa;
-    XSetWindowAttributes  xattr;
-    Atom wm_state;
-    XWMHints hints;
-    XEvent xev;
-    EGLConfig ecfg;
-    EGLint num_config;
-    Window win;
-
-    /*
-     * X11 native display initialization
-     */
-
-    x_display = XOpenDisplay(NULL);
-    if ( x_display == NULL )
-    {
-        return EGL_FALSE;
-    }
+   int i;
+
+   if ( name == NULL )
+   {
+      name = getenv("ES_PLATFORM");
+   }
 
-    root = DefaultRootWindow(x_display);
-
-    swa.event_mask  =  ExposureMask | PointerMotionMask | KeyPressMask;
-    win = XCreateWindow(
-               x_display, root,
-               0, 0, esContext->width, esContext->height, 0,
-               CopyFromParent, InputOutput,
-               CopyFromParent, CWEventMask,
-               &swa );
-
-    xattr.override_redirect = FALSE;
-    XChangeWindowAttributes ( x_display, win, CWOverrideRedirect, &xattr );
-
-    hints.input = TRUE;
-    hints.flags = InputHint;
-    XSetWMHints(x_display, win, &hints);
-
-    // make the window visible on the screen
-    XMapWindow (x_display, win);
-    XStoreName (x_display, win, title);
-
-    // get identifiers for the provided atom name strings
-    wm_state = XInternAtom (x_display, "_NET_WM_STATE", FALSE);
-
-    memset ( &xev, 0, sizeof(xev) );
-    xev.type                 = ClientMessage;
-    xev.xclient.window       = win;
-    xev.xclient.message_type = wm_state;
-    xev.xclient.format       = 32;
-    xev.xclient.data.l[0]    = 1;
-    xev.xclient.data.l[1]    = FALSE;
-    XSendEvent (
-       x_display,
-       DefaultRootWindow ( x_display ),
-       FALSE,
-       SubstructureNotifyMask,
-       &xev );
-
-    esContext->hWnd = (EGLNativeWindowType) win;
-    return EGL_TRUE;
+   for ( i = 0; platforms[i] != NULL; i++ )
+   {
+      if ( name != NULL && name[0] != '\0' )
+      {
+         if ( strcmp(name, platforms[i]->name) == 0 )
+         {
+            break;
+         }
+      }
+#ifdef ES_HAVE_X11
+      else if ( platforms[i] != &esPlatformX11 || getenv("DISPLAY") != NULL )
+      {
+         break;
+      }
+#else
+      else
+      {
+         break;
+      }
+#endif
+   }
+
+   if ( platforms[i] == NULL )
+   {
+      logInfo("Unknown platform '%s', available : %s.\n", name, esPlatformNames());
+      return GL_FALSE;
+   }
+   esContext->platform = platforms[i];
+   return GL_TRUE;
 }
 
 
 ///
-//  userInterrupt()
+//  esPlatformNames()
 //
-//      Reads from X11 event loop and interrupt program if there is a keypress, or
-//      window close action.
+//      The platforms compiled in, e.g. "dispmanx, headless".
 //
-GLboolean userInterrupt(ESContext *esContext)
+const char* ESUTIL_API esPlatformNames ( void )
 {
-    XEvent xev;
-    KeySym key;
-    GLboolean userinterrupt = GL_FALSE;
-    char text;
+   static char names[64];
+   int i;
 
-    // Pump all messages from X server. Keypresses are directed to keyfunc (if defined)
-    while ( XPending ( x_display ) )
-    {
-        XNextEvent( x_display, &xev );
-        if ( xev.type == KeyPress )
-        {
-            if (XLookupString(&xev.xkey,&text,1,&key,0)==1)
-            {
-                if (esContext->keyFunc != NULL)
-                    esContext->keyFunc(esContext, text, 0, 0);
-            }
-        }
-        if ( xev.type == DestroyNotify )
-            userinterrupt = GL_TRUE;
-    }
-    return userinterrupt;
+   if ( names[0] == '\0' )
+   {
+      for ( i = 0; platforms[i] != NULL; i++ )
+      {
+         if ( i > 0 ) strcat(names, ", ");
+         strcat(names, platforms[i]->name);
+      }
+   }
+   return names;
 }
-#endif
 
-//////////////////////////////////////////////////////////////////
-//
-//  Public Functions
-//
-//
 
 ///
-//  esInitContext()
+//  esGetPlatform()
 //
-//      Initialize ES utility context.  This must be called before calling any other
-//      functions.
+//      Name of the platform in use, NULL if none chosen yet.
 //
-void ESUTIL_API esInitContext ( ESContext *esContext )
+const char* ESUTIL_API esGetPlatform ( ESContext *esContext )
 {
-#ifdef RPI_NO_X
-   bcm_host_init();
-#endif
-   if ( esContext != NULL )
-   {
-      memset( esContext, 0, sizeof( ESContext) );
-   }
+   return esContext->platform ? esContext->platform->name : NULL;
 }
 
 
@@ -481,11 +279,15 @@ void ESUTIL_API esInitContext ( ESContext *esContext )
 //          ES_WINDOW_DEPTH       - specifies that a depth buffer should be created
 //          ES_WINDOW_STENCIL     - specifies that a stencil buffer should be created
 //          ES_WINDOW_MULTISAMPLE - specifies that a multi-sample buffer should be created
+//          ES_WINDOW_HEADLESS    - render off screen, the same as esSetPlatform("headless")
+//      Uses the platform from esSetPlatform(), else the default one.
+//      A width/height of 0 means full screen (dispmanx) or a default size.
 //
 GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char* title, GLint width, GLint height, GLuint flags )
 {
    EGLint attribList[] =
    {
+       EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
        EGL_RED_SIZE,       8,
        EGL_GREEN_SIZE,     8,
        EGL_BLUE_SIZE,      8,
@@ -504,22 +306,20 @@ GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char* title, G
    esContext->width = width;
    esContext->height = height;
 
-
-   if ( !WinCreate ( esContext, title) )
+   if ( flags & ES_WINDOW_HEADLESS )
+   {
+      esContext->platform = &esPlatformHeadless;
+   }
+   else if ( esContext->platform == NULL && !esSetPlatform ( esContext, NULL ) )
    {
       return GL_FALSE;
    }
 
-  
-   if ( !CreateEGLContext ( esContext->hWnd,
-                            &esContext->eglDisplay,
-                            &esContext->eglContext,
-                            &esContext->eglSurface,
-                            attribList) )
+   if ( !esContext->platform->create ( esContext, title, attribList ) )
    {
+      logError("Unable to create the %s window.\n", esContext->platform->name);
       return GL_FALSE;
    }
-   
 
    return GL_TRUE;
 }
@@ -528,56 +328,27 @@ GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char* title, G
 
 
 
+#ifdef ES_HAVE_DISPMANX
 // 22/6/16 Micro : Modified because screen badly flickering with original version only 30fps!
 // So trying this version out on RPi with vc_dispmanx inside CreateEGLContext_M().
 // Realised it was doubling up on eglSwapBuffers() in test triangle example and esMainLoop(). Doh!
+// 18/10/26 : The dispmanx platform now does the same, see ESUtil_dispmanx.c.
 
 ///
-//  esCreateWindow()
+//  esCreateWindow_M()
 //
-//      title - name for title bar of window
-//      width - width of window to create
-//      height - height of window to create
-//      flags  - bitwise or of window creation flags 
-//          ES_WINDOW_ALPHA       - specifies that the framebuffer should have alpha
-//          ES_WINDOW_DEPTH       - specifies that a depth buffer should be created
-//          ES_WINDOW_STENCIL     - specifies that a stencil buffer should be created
-//          ES_WINDOW_MULTISAMPLE - specifies that a multi-sample buffer should be created
+//      esCreateWindow() on the RPi dispmanx platform.
 //
 GLboolean ESUTIL_API esCreateWindow_M ( ESContext *esContext, const char* title, GLint width, GLint height, GLuint flags )
 {
-   EGLint attribList[] =
-   {
-       EGL_RED_SIZE,       8,
-       EGL_GREEN_SIZE,     8,
-       EGL_BLUE_SIZE,      8,
-       EGL_ALPHA_SIZE,     (flags & ES_WINDOW_ALPHA) ? 8 : EGL_DONT_CARE,
-       EGL_DEPTH_SIZE,     (flags & ES_WINDOW_DEPTH) ? 8 : EGL_DONT_CARE,
-       EGL_STENCIL_SIZE,   (flags & ES_WINDOW_STENCIL) ? 8 : EGL_DONT_CARE,
-       EGL_SAMPLE_BUFFERS, (flags & ES_WINDOW_MULTISAMPLE) ? 1 : 0,
-       EGL_NONE
-   };
-
    if ( esContext == NULL )
    {
       return GL_FALSE;
    }
-
-   esContext->width = width;
-   esContext->height = height;
-  
-   if ( !CreateEGLContext_M ( esContext,
-                            &esContext->eglDisplay,
-                            &esContext->eglContext,
-                            &esContext->eglSurface,
-                            attribList) )
-   {
-      return GL_FALSE;
-   }
-   
-
-   return GL_TRUE;
+   esContext->platform = &esPlatformDispmanx;
+   return esCreateWindow ( esContext, title, width, height, flags & ~ES_WINDOW_HEADLESS );
 }
+#endif // ES_HAVE_DISPMANX
 
 
 
@@ -586,30 +357,33 @@ GLboolean ESUTIL_API esCreateWindow_M ( ESContext *esContext, const char* title,
 //
 //  23/6/16 Micro : My version requires esContext->dispman_display.
 //  Exit function for RPi in the OpenGL ES application
+//  18/10/26 : The platform closes its own window, after EGL is released.
 //
 
 void ESUTIL_API esExit ( ESContext *esContext )
 {
-    DISPMANX_UPDATE_HANDLE_T dispman_update;
-    DISPMANX_DISPLAY_HANDLE_T dispman_display = esContext->dispman_display;
-    EGL_DISPMANX_WINDOW_T *nativewindow = esContext->hWnd ;
-
-    if ( nativewindow ) {
-        dispman_update = vc_dispmanx_update_start( 0 );
-
-        if ( nativewindow->element != 0 ) {
-            vc_dispmanx_element_remove( dispman_update, nativewindow->element );
-        }
-
-        vc_dispmanx_update_submit_sync( dispman_update );
-
-        vc_dispmanx_display_close( dispman_display );
-    }
+    if ( esContext->platform == NULL || esContext->eglDisplay == EGL_NO_DISPLAY )
+        return ;
 
     // Release OpenGL resources
+    if ( esContext->fbo ) {
+        glDeleteFramebuffers( 1, &esContext->fbo );
+        glDeleteRenderbuffers( 1, &esContext->fboDepth );
+        glDeleteTextures( 1, &esContext->fboColour );
+    }
     eglMakeCurrent( esContext->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+    if ( esContext->eglSurface != EGL_NO_SURFACE )
+        eglDestroySurface( esContext->eglDisplay, esContext->eglSurface );
+    if ( esContext->eglUploadContext != EGL_NO_CONTEXT )
+        eglDestroyContext( esContext->eglDisplay, esContext->eglUploadContext );
+    if ( esContext->eglUploadSurface != EGL_NO_SURFACE )
+        eglDestroySurface( esContext->eglDisplay, esContext->eglUploadSurface );
     eglDestroyContext( esContext->eglDisplay, esContext->eglContext );
     eglTerminate( esContext->eglDisplay );
+    esContext->eglDisplay = EGL_NO_DISPLAY;
+
+    // Close the window.
+    esContext->platform->destroy( esContext );
 
 } // esExit
 
@@ -625,18 +399,17 @@ void ESUTIL_API esExit ( ESContext *esContext )
 
 void ESUTIL_API esMainLoop ( ESContext *esContext )
 {
-    struct timeval t1, t2;
-    struct timezone tz;
+    struct timespec t1, t2;
     float deltatime;
     float totaltime = 0.0f;
     unsigned int frames = 0;
 
-    gettimeofday ( &t1 , &tz );
+    clock_gettime ( CLOCK_MONOTONIC, &t1 );
 
-    while(userInterrupt(esContext) == GL_FALSE)
+    while(esUserInterrupt(esContext) == GL_FALSE)
     {
-        gettimeofday(&t2, &tz);
-        deltatime = (float)(t2.tv_sec - t1.tv_sec + (t2.tv_usec - t1.tv_usec) * 1e-6);
+        clock_gettime ( CLOCK_MONOTONIC, &t2 );
+        deltatime = (float)(t2.tv_sec - t1.tv_sec + (t2.tv_nsec - t1.tv_nsec) * 1e-9);
         t1 = t2;
 
         if (esContext->updateFunc != NULL)
@@ -644,13 +417,13 @@ void ESUTIL_API esMainLoop ( ESContext *esContext )
         if (esContext->drawFunc != NULL)
             esContext->drawFunc(esContext);
 
-        eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);
+        esSwapBuffers(esContext);
 
         totaltime += deltatime;
         frames++;
         if (totaltime >  2.0f)
         {
-            printf("%4d frames rendered in %1.4f seconds -> FPS=%3.4f\n", frames, totaltime, frames/totaltime);
+            logInfo("%4d frames rendered in %1.4f seconds -> FPS=%3.4f\n", frames, totaltime, frames/totaltime);
             totaltime -= 2.0f;
             frames = 0;
         }
@@ -658,6 +431,91 @@ void ESUTIL_API esMainLoop ( ESContext *esContext )
 }
 
 
+///
+//  esSwapBuffers()
+//
+//    Present the frame, as the platform does it.
+//
+void ESUTIL_API esSwapBuffers ( ESContext *esContext )
+{
+   esContext->platform->swapBuffers(esContext);
+}
+
+
+///
+//  SwapBuffersWithDamage()
+//
+//    eglSwapBuffersWithDamageKHR (or EXT) where the display has it, looked
+//    up at the first call, else eglSwapBuffers. For the platforms that
+//    present with eglSwapBuffers.
+//
+void SwapBuffersWithDamage ( ESContext *esContext, const EGLint *rects, EGLint nrects )
+{
+   static PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapWithDamage = NULL;
+   static int looked = 0;
+   const char *extensions;
+
+   if ( !looked )
+   {
+      looked = 1;
+      extensions = eglQueryString(esContext->eglDisplay, EGL_EXTENSIONS);
+      if ( extensions && strstr(extensions, "EGL_KHR_swap_buffers_with_damage") )
+         swapWithDamage = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC) eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+      else if ( extensions && strstr(extensions, "EGL_EXT_swap_buffers_with_damage") )
+         swapWithDamage = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC) eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+      logInfo("EGL swap buffers with damage : %s.\n", swapWithDamage ? "yes" : "no");
+   }
+
+   if ( swapWithDamage && nrects > 0 )
+      swapWithDamage(esContext->eglDisplay, esContext->eglSurface, rects, nrects);
+   else
+      eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);
+}
+
+
+///
+//  esSwapBuffersWithDamage()
+//
+//    Present the frame, only the rectangles changed if the platform can.
+//
+void ESUTIL_API esSwapBuffersWithDamage ( ESContext *esContext, const EGLint *rects, EGLint nrects )
+{
+   if ( esContext->platform->swapBuffersWithDamage )
+      esContext->platform->swapBuffersWithDamage(esContext, rects, nrects);
+   else
+      esContext->platform->swapBuffers(esContext);
+}
+
+
+///
+//  esUserInterrupt()
+//
+//    Handle the window system's events, once a frame. GL_TRUE if the
+//    window was closed.
+//
+GLboolean ESUTIL_API esUserInterrupt ( ESContext *esContext )
+{
+   return esContext->platform->userInterrupt(esContext);
+}
+
+
+///
+//  esSwapInterval()
+//
+//    Vertical syncs each swap waits for, 0 for none. Clamped by EGL to
+//    the config's EGL_MIN/MAX_SWAP_INTERVAL.
+//
+EGLBoolean ESUTIL_API esSwapInterval ( ESContext *esContext, EGLint interval )
+{
+   if ( !eglSwapInterval(esContext->eglDisplay, interval) )
+   {
+      logWarn("eglSwapInterval(%d) failed (0x%x).\n", interval, eglGetError());
+      return EGL_FALSE;
+   }
+   return EGL_TRUE;
+}
+
+
 ///
 //  esRegisterDrawFunc()
 //
@@ -689,18 +547,15 @@ void ESUTIL_API esRegisterKeyFunc ( ESContext *esContext,
 ///
 // esLogMessage()
 //
-//    Log an error message to the debug output for the platform
+//    Log an error message to the debug output for the platform,
+//    through the logger (log.c) so it does not wait on the output.
 //
 void ESUTIL_API esLogMessage ( const char *formatStr, ... )
 {
     va_list params;
-    char buf[BUFSIZ];
 
     va_start ( params, formatStr );
-    vsprintf ( buf, formatStr, params );
-    
-    printf ( "%s", buf );
-    
+    logv ( LOG_INFO, formatStr, params );
     va_end ( params );
 }
 
@@ -43,6 +43,12 @@ extern "C" {
 #define ES_WINDOW_STENCIL       4
 /* esCreateWindow flat - multi-sample buffer */
 #define ES_WINDOW_MULTISAMPLE   8
+/* esCreateWindow flag - no window, render to a pbuffer or framebuffer object */
+#define ES_WINDOW_HEADLESS      16
+
+/* Window size when esCreateWindow is given 0 (except full screen dispmanx) */
+#define ES_WINDOW_DEF_WIDTH     1280
+#define ES_WINDOW_DEF_HEIGHT    720
 
 
 /*
@@ -61,6 +67,8 @@ typedef struct
     GLfloat   m[4][4];
 } ESMatrix;
 
+struct ESPlatform;
+
 typedef struct _escontext
 {
     /* Put your user data here. */
@@ -75,8 +83,16 @@ typedef struct _escontext
     /* Window handle */
     EGLNativeWindowType hWnd;
 
-    /* RPi display handle required for exit function */
-    DISPMANX_DISPLAY_HANDLE_T dispman_display;
+    /* Window system in use, see esSetPlatform() */
+    const struct ESPlatform *platform;
+
+    /* Platform's own window data (e.g. the RPi dispmanx display) */
+    void *platformData;
+
+    /* Headless without a pbuffer: framebuffer object drawn into, 0 if none */
+    GLuint fbo;
+    GLuint fboColour;
+    GLuint fboDepth;
 
     /* EGL display */
     EGLDisplay eglDisplay;
@@ -87,6 +103,13 @@ typedef struct _escontext
     /* EGL surface */
     EGLSurface eglSurface;
 
+    /* EGL context sharing objects with eglContext, for an upload thread.
+       EGL_NO_CONTEXT if the platform could not create one. */
+    EGLContext eglUploadContext;
+
+    /* 1x1 pbuffer for eglUploadContext, or EGL_NO_SURFACE (surfaceless) */
+    EGLSurface eglUploadSurface;
+
     /* Callbacks */
     void (ESCALLBACK *drawFunc)(struct _escontext *);
     void (ESCALLBACK *keyFunc)(struct _escontext *, unsigned char, int, int);
@@ -106,6 +129,26 @@ typedef struct _escontext
 void ESUTIL_API esInitContext (ESContext *esContext);
 
 
+/*!
+ * \brief Choose the window system before esCreateWindow.
+ * \param esContext Application context
+ * \param name "dispmanx", "x11" or "headless", if compiled in. NULL for
+ *        $ES_PLATFORM, else the first one available.
+ * \return GL_FALSE if there is no such platform
+ */
+GLboolean ESUTIL_API esSetPlatform(ESContext *esContext, const char *name);
+
+/*!
+ * \brief Names of the platforms compiled in, comma separated.
+ */
+const char *ESUTIL_API esPlatformNames(void);
+
+/*!
+ * \brief Name of the platform in use, NULL before one is chosen.
+ * \param esContext Application context
+ */
+const char *ESUTIL_API esGetPlatform(ESContext *esContext);
+
 /*!
  * \brief Create a window with the specified parameters.
  * \param esContext Application context
@@ -120,11 +163,44 @@ void ESUTIL_API esInitContext (ESContext *esContext);
  *        ES_WINDOW_STENCIL - specifies that a stencil buffer should be created
  *        ES_WINDOW_MULTISAMPLE - specifies that a multi-sample buffer
  *        should be created
+ *        ES_WINDOW_HEADLESS - no window, render off screen to a pbuffer
+ *        or framebuffer object of width x height (0 for the default)
  * \return GL_TRUE if window creation is succesful, GL_FALSE otherwise
  */
 GLboolean ESUTIL_API esCreateWindow(ESContext *esContext, const char *title, 
                                                                         GLint width, GLint height, GLuint flags);
 
+/*!
+ * \brief Present the rendered frame (eglSwapBuffers, or glFinish headless).
+ * \param esContext Application context
+ */
+void ESUTIL_API esSwapBuffers(ESContext *esContext);
+
+/*!
+ * \brief Present the rendered frame, telling the display only the rectangles
+ *        changed (EGL_KHR_swap_buffers_with_damage). The whole frame must
+ *        still have been drawn. Falls back to esSwapBuffers().
+ * \param esContext Application context
+ * \param rects x, y, width, height of each, from the bottom left
+ * \param nrects no. of rectangles, 0 for the whole window
+ */
+void ESUTIL_API esSwapBuffersWithDamage(ESContext *esContext, const EGLint *rects, EGLint nrects);
+
+/*!
+ * \brief Handle the window system's events, call once a frame.
+ * \param esContext Application context
+ * \return GL_TRUE if the window was closed
+ */
+GLboolean ESUTIL_API esUserInterrupt(ESContext *esContext);
+
+/*!
+ * \brief Set the vertical syncs each swap waits for (eglSwapInterval).
+ * \param esContext Application context
+ * \param interval 0 to swap at once, 1 to wait for the next vertical sync
+ * \return EGL_FALSE if EGL refused it
+ */
+EGLBoolean ESUTIL_API esSwapInterval(ESContext *esContext, EGLint interval);
+
 /*!
  * \brief RPi Exit function the OpenGL ES application.
  * \param esContext Application context
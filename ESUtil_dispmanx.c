@@ -0,0 +1,178 @@
+//
+// Book:      OpenGL(R) ES 2.0 Programming Guide
+// Authors:   Aaftab Munshi, Dan Ginsburg, Dave Shreiner
+// ISBN-10:   0321502795
+// ISBN-13:   9780321502797
+// Publisher: Addison-Wesley Professional
+// URLs:      http://safari.informit.com/9780321563835
+//            http://www.opengles-book.com
+//
+
+// ESUtil_dispmanx.c
+//
+//    RaspberryPi platform for ESUtil: a full screen dispmanx element,
+//    no X server. Moved out of ESUtil.c.
+//
+
+///
+//  Includes
+//
+#ifdef ES_HAVE_DISPMANX
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#include "bcm_host.h"
+#include "ESPlatform.h"
+
+// Native window and the display it is on, kept for destroy.
+typedef struct
+{
+   EGL_DISPMANX_WINDOW_T nativewindow;
+   DISPMANX_DISPLAY_HANDLE_T dispman_display;
+} DispmanxWindow;
+
+static DispmanxWindow dispmanxWindow;
+
+
+///
+//  WinCreate() - RaspberryPi, direct surface (No X, Xlib)
+//
+//      This function initialized the display and window for EGL
+//
+static EGLBoolean WinCreate(ESContext *esContext, const char *title)
+{
+   int32_t success = 0;
+
+   DispmanxWindow *window = &dispmanxWindow;
+
+   DISPMANX_ELEMENT_HANDLE_T dispman_element;
+   DISPMANX_DISPLAY_HANDLE_T dispman_display;
+   DISPMANX_UPDATE_HANDLE_T dispman_update;
+   VC_RECT_T dst_rect;
+   VC_RECT_T src_rect;
+
+
+   uint32_t display_width;
+   uint32_t display_height;
+
+   bcm_host_init();
+
+   // create an EGL window surface, passing context width/height
+   success = graphics_get_display_size(0 /* LCD */, &display_width, &display_height);
+   if ( success < 0 )
+   {
+      return EGL_FALSE;
+   }
+
+   // You can hardcode the resolution here:
+//   display_width = 1920;
+//   display_height = 1080;
+
+   dst_rect.x = 0;
+   dst_rect.y = 0;
+   dst_rect.width = display_width;
+   dst_rect.height = display_height;
+
+   src_rect.x = 0;
+   src_rect.y = 0;
+   src_rect.width = display_width << 16;
+   src_rect.height = display_height << 16;
+
+   dispman_display = vc_dispmanx_display_open( 0 /* LCD */);
+   dispman_update = vc_dispmanx_update_start( 0 );
+
+   dispman_element = vc_dispmanx_element_add ( dispman_update, dispman_display,
+      0/*layer*/, &dst_rect, 0/*src*/,
+      &src_rect, DISPMANX_PROTECTION_NONE, 0 /*alpha*/, 0/*clamp*/, 0/*transform*/);
+
+   window->nativewindow.element = dispman_element;
+   window->nativewindow.width = display_width;
+   window->nativewindow.height = display_height;
+   window->dispman_display = dispman_display;
+   vc_dispmanx_update_submit_sync( dispman_update );
+
+   esContext->hWnd = &window->nativewindow;
+   esContext->platformData = window;
+   esContext->width = display_width;
+   esContext->height = display_height;
+
+	return EGL_TRUE;
+}
+
+
+///
+//  DispmanxCreate()
+//
+//      Full screen window on the LCD, then EGL on the default display.
+//
+static EGLBoolean DispmanxCreate(ESContext *esContext, const char *title, EGLint attribList[])
+{
+   if ( !WinCreate ( esContext, title ) )
+   {
+      return EGL_FALSE;
+   }
+   return CreateEGLContext ( EGL_DEFAULT_DISPLAY, esContext->hWnd, esContext, attribList );
+}
+
+
+static void DispmanxSwapBuffers(ESContext *esContext)
+{
+   eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);
+}
+
+
+///
+//  userInterrupt()
+//
+//      There are no window events without X.
+//
+static GLboolean DispmanxUserInterrupt(ESContext *esContext)
+{
+	//GLboolean userinterrupt = GL_FALSE;
+    //return userinterrupt;
+
+    // Ctrl-C for now to stop
+
+    return GL_FALSE;
+}
+
+
+///
+//  DispmanxDestroy()
+//
+//  23/6/16 Micro : Was esExit(), requires the dispman_display.
+//
+static void DispmanxDestroy(ESContext *esContext)
+{
+    DISPMANX_UPDATE_HANDLE_T dispman_update;
+    DispmanxWindow *window = esContext->platformData;
+
+    if ( window ) {
+        dispman_update = vc_dispmanx_update_start( 0 );
+
+        if ( window->nativewindow.element != 0 ) {
+            vc_dispmanx_element_remove( dispman_update, window->nativewindow.element );
+        }
+
+        vc_dispmanx_update_submit_sync( dispman_update );
+
+        vc_dispmanx_display_close( window->dispman_display );
+        esContext->platformData = NULL;
+    }
+}
+
+
+const ESPlatform esPlatformDispmanx =
+{
+   "dispmanx",
+   DispmanxCreate,
+   DispmanxSwapBuffers,
+   DispmanxUserInterrupt,
+   DispmanxDestroy,
+   SwapBuffersWithDamage
+};
+
+#endif // ES_HAVE_DISPMANX
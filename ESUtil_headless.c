@@ -0,0 +1,236 @@
+//
+// Book:      OpenGL(R) ES 2.0 Programming Guide
+// Authors:   Aaftab Munshi, Dan Ginsburg, Dave Shreiner
+// ISBN-10:   0321502795
+// ISBN-13:   9780321502797
+// Publisher: Addison-Wesley Professional
+// URLs:      http://safari.informit.com/9780321563835
+//            http://www.opengles-book.com
+//
+
+// ESUtil_headless.c
+//
+//    Headless platform for ESUtil: no window, rendering off screen into
+//    a pbuffer or a framebuffer object, e.g. Mesa llvmpipe on a server.
+//
+
+///
+//  Includes
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "ESPlatform.h"
+
+// Mesa's display with no window system at all (EGL_MESA_platform_surfaceless).
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA   0x31DD
+#endif
+
+
+///
+// GetHeadlessDisplay()
+//
+//    The EGL display for rendering off screen. Mesa's surfaceless platform
+//    needs no X server or DRM device (llvmpipe), otherwise the default display.
+//
+static EGLDisplay GetHeadlessDisplay ( void )
+{
+   PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay;
+   const char *extensions;
+   EGLDisplay display;
+
+   extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+   if ( extensions != NULL && strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL )
+   {
+      getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+      if ( getPlatformDisplay != NULL )
+      {
+         display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+         if ( display != EGL_NO_DISPLAY )
+         {
+            return display;
+         }
+      }
+   }
+   return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+
+///
+// ChooseHeadlessConfig()
+//
+//    The caller's attributes plus a surface type.
+//
+static EGLBoolean ChooseHeadlessConfig ( EGLDisplay display, EGLint attribList[],
+                                         EGLint surfaceType, EGLConfig *config )
+{
+   EGLint attribs[32];
+   EGLint numConfigs = 0;
+   int i, n = 0;
+
+   for ( i = 0; attribList[i] != EGL_NONE && n < 28; i += 2 )
+   {
+      attribs[n++] = attribList[i];
+      attribs[n++] = attribList[i+1];
+   }
+   attribs[n++] = EGL_SURFACE_TYPE;
+   attribs[n++] = surfaceType;
+   attribs[n] = EGL_NONE;
+
+   return eglChooseConfig(display, attribs, config, 1, &numConfigs) && numConfigs > 0;
+}
+
+
+///
+// CreateFramebuffer()
+//
+//    Colour texture and depth renderbuffer to draw into when there is
+//    no EGL surface at all. Left bound, so drawing code is unchanged.
+//
+static EGLBoolean CreateFramebuffer ( ESContext *esContext )
+{
+   glGenTextures(1, &esContext->fboColour);
+   glBindTexture(GL_TEXTURE_2D, esContext->fboColour);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, esContext->width, esContext->height,
+                0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glBindTexture(GL_TEXTURE_2D, 0);
+
+   glGenRenderbuffers(1, &esContext->fboDepth);
+   glBindRenderbuffer(GL_RENDERBUFFER, esContext->fboDepth);
+   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, esContext->width, esContext->height);
+
+   glGenFramebuffers(1, &esContext->fbo);
+   glBindFramebuffer(GL_FRAMEBUFFER, esContext->fbo);
+   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, esContext->fboColour, 0);
+   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, esContext->fboDepth);
+
+   return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+
+///
+// HeadlessCreate()
+//
+//    Creates an EGL rendering context with no window: a pbuffer of the
+//    context's width/height, else EGL_KHR_surfaceless_context drawing
+//    into a framebuffer object. Swaps are not tied to any display refresh.
+//
+static EGLBoolean HeadlessCreate ( ESContext *esContext, const char *title, EGLint attribList[] )
+{
+   EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+   EGLint pbufferAttribs[] = { EGL_WIDTH, 0, EGL_HEIGHT, 0, EGL_NONE };
+   EGLint majorVersion;
+   EGLint minorVersion;
+   EGLDisplay display;
+   EGLContext context;
+   EGLSurface surface = EGL_NO_SURFACE;
+   EGLConfig config;
+   const char *extensions;
+
+   if ( esContext->width <= 0 ) esContext->width = ES_WINDOW_DEF_WIDTH;
+   if ( esContext->height <= 0 ) esContext->height = ES_WINDOW_DEF_HEIGHT;
+
+   pbufferAttribs[1] = esContext->width;
+   pbufferAttribs[3] = esContext->height;
+
+   display = GetHeadlessDisplay();
+   if ( display == EGL_NO_DISPLAY )
+   {
+      return EGL_FALSE;
+   }
+
+   if ( !eglInitialize(display, &majorVersion, &minorVersion) || !eglBindAPI(EGL_OPENGL_ES_API) )
+   {
+      return EGL_FALSE;
+   }
+
+   // A pbuffer if the platform has them, else any config for surfaceless.
+   if ( ChooseHeadlessConfig(display, attribList, EGL_PBUFFER_BIT, &config) )
+   {
+      surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+   }
+   else if ( !ChooseHeadlessConfig(display, attribList, EGL_DONT_CARE, &config) )
+   {
+      return EGL_FALSE;
+   }
+
+   context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+   if ( context == EGL_NO_CONTEXT )
+   {
+      return EGL_FALSE;
+   }
+
+   if ( surface == EGL_NO_SURFACE )
+   {
+      extensions = eglQueryString(display, EGL_EXTENSIONS);
+      if ( extensions == NULL || strstr(extensions, "EGL_KHR_surfaceless_context") == NULL )
+      {
+         return EGL_FALSE;
+      }
+      if ( !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) ||
+           !CreateFramebuffer(esContext) )
+      {
+         return EGL_FALSE;
+      }
+   }
+   else if ( !eglMakeCurrent(display, surface, surface, context) )
+   {
+      return EGL_FALSE;
+   }
+
+   // Never wait for a vertical blank.
+   eglSwapInterval(display, 0);
+
+   // A second context for the asset upload thread.
+   CreateSharedContext(display, config, context,
+                       &esContext->eglUploadContext, &esContext->eglUploadSurface);
+
+   esContext->eglDisplay = display;
+   esContext->eglSurface = surface;
+   esContext->eglContext = context;
+   return EGL_TRUE;
+}
+
+
+
+
+///
+//  HeadlessSwapBuffers()
+//
+//    Off screen there is nothing to present and nothing throttles the
+//    loop, so wait for the frame to finish instead, as a swap chain one
+//    frame deep would.
+//
+static void HeadlessSwapBuffers ( ESContext *esContext )
+{
+   glFinish();
+}
+
+
+static GLboolean HeadlessUserInterrupt ( ESContext *esContext )
+{
+   return GL_FALSE;
+}
+
+
+// The pbuffer/FBO go with the EGL objects in esExit().
+static void HeadlessDestroy ( ESContext *esContext )
+{
+}
+
+
+const ESPlatform esPlatformHeadless =
+{
+   "headless",
+   HeadlessCreate,
+   HeadlessSwapBuffers,
+   HeadlessUserInterrupt,
+   HeadlessDestroy,
+   NULL                    // nothing is presented
+};
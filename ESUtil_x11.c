@@ -0,0 +1,184 @@
+//
+// Book:      OpenGL(R) ES 2.0 Programming Guide
+// Authors:   Aaftab Munshi, Dan Ginsburg, Dave Shreiner
+// ISBN-10:   0321502795
+// ISBN-13:   9780321502797
+// Publisher: Addison-Wesley Professional
+// URLs:      http://safari.informit.com/9780321563835
+//            http://www.opengles-book.com
+//
+
+// ESUtil_x11.c
+//
+//    X11 platform for ESUtil: a window on $DISPLAY (a desktop, or Xvfb
+//    with Mesa). Moved out of ESUtil.c.
+//
+
+///
+//  Includes
+//
+#ifdef ES_HAVE_X11
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#include  <X11/Xlib.h>
+#include  <X11/Xatom.h>
+#include  <X11/Xutil.h>
+#include "ESPlatform.h"
+
+// X11 related local variables
+static Display *x_display = NULL;
+
+
+///
+//  WinCreate()
+//
+//      This function initialized the native X11 display and window for EGL
+//
+static EGLBoolean WinCreate(ESContext *esContext, const char *title)
+{
+    Window root;
+    XSetWindowAttributes swa;
+    XSetWindowAttributes  xattr;
+    Atom wm_state;
+    XWMHints hints;
+    XEvent xev;
+    Window win;
+
+    /*
+     * X11 native display initialization
+     */
+
+    x_display = XOpenDisplay(NULL);
+    if ( x_display == NULL )
+    {
+        return EGL_FALSE;
+    }
+
+    if ( esContext->width <= 0 ) esContext->width = ES_WINDOW_DEF_WIDTH;
+    if ( esContext->height <= 0 ) esContext->height = ES_WINDOW_DEF_HEIGHT;
+
+    root = DefaultRootWindow(x_display);
+
+    swa.event_mask  =  ExposureMask | PointerMotionMask | KeyPressMask | StructureNotifyMask;
+    win = XCreateWindow(
+               x_display, root,
+               0, 0, esContext->width, esContext->height, 0,
+               CopyFromParent, InputOutput,
+               CopyFromParent, CWEventMask,
+               &swa );
+
+    xattr.override_redirect = FALSE;
+    XChangeWindowAttributes ( x_display, win, CWOverrideRedirect, &xattr );
+
+    hints.input = TRUE;
+    hints.flags = InputHint;
+    XSetWMHints(x_display, win, &hints);
+
+    // make the window visible on the screen
+    XMapWindow (x_display, win);
+    XStoreName (x_display, win, title);
+
+    // get identifiers for the provided atom name strings
+    wm_state = XInternAtom (x_display, "_NET_WM_STATE", FALSE);
+
+    memset ( &xev, 0, sizeof(xev) );
+    xev.type                 = ClientMessage;
+    xev.xclient.window       = win;
+    xev.xclient.message_type = wm_state;
+    xev.xclient.format       = 32;
+    xev.xclient.data.l[0]    = 1;
+    xev.xclient.data.l[1]    = FALSE;
+    XSendEvent (
+       x_display,
+       DefaultRootWindow ( x_display ),
+       FALSE,
+       SubstructureNotifyMask,
+       &xev );
+
+    esContext->hWnd = (EGLNativeWindowType) win;
+    return EGL_TRUE;
+}
+
+
+///
+//  X11Create()
+//
+//      Window on $DISPLAY, then EGL on the same X display.
+//
+static EGLBoolean X11Create(ESContext *esContext, const char *title, EGLint attribList[])
+{
+   if ( !WinCreate ( esContext, title ) )
+   {
+      return EGL_FALSE;
+   }
+   return CreateEGLContext ( (EGLNativeDisplayType) x_display, esContext->hWnd, esContext, attribList );
+}
+
+
+static void X11SwapBuffers(ESContext *esContext)
+{
+   eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);
+}
+
+
+///
+//  userInterrupt()
+//
+//      Reads from X11 event loop and interrupt program if there is a keypress, or
+//      window close action.
+//
+static GLboolean X11UserInterrupt(ESContext *esContext)
+{
+    XEvent xev;
+    KeySym key;
+    GLboolean userinterrupt = GL_FALSE;
+    char text;
+
+    // Pump all messages from X server. Keypresses are directed to keyfunc (if defined)
+    while ( XPending ( x_display ) )
+    {
+        XNextEvent( x_display, &xev );
+        if ( xev.type == KeyPress )
+        {
+            if (XLookupString(&xev.xkey,&text,1,&key,0)==1)
+            {
+                if (esContext->keyFunc != NULL)
+                    esContext->keyFunc(esContext, text, 0, 0);
+            }
+        }
+        if ( xev.type == DestroyNotify )
+            userinterrupt = GL_TRUE;
+    }
+    return userinterrupt;
+}
+
+
+static void X11Destroy(ESContext *esContext)
+{
+   if ( x_display != NULL )
+   {
+      if ( esContext->hWnd )
+      {
+         XDestroyWindow(x_display, (Window) esContext->hWnd);
+      }
+      XCloseDisplay(x_display);
+      x_display = NULL;
+   }
+}
+
+
+const ESPlatform esPlatformX11 =
+{
+   "x11",
+   X11Create,
+   X11SwapBuffers,
+   X11UserInterrupt,
+   X11Destroy,
+   SwapBuffersWithDamage
+};
+
+#endif // ES_HAVE_X11
@@ -0,0 +1,361 @@
+
+/*
+  This module loads assets without blocking the render thread.
+
+  assetsLoadTexture() only queues the file name and returns a handle.
+  A decode thread reads and decodes the file (esLoadTGA), then the upload
+  thread, which has the shared context from esCreateWindow() current,
+  creates the texture and glFinish()es so it is complete before the
+  handle is marked ready. The render thread just checks assetReady().
+
+  If the platform could not create the shared context, assetsPoll() does
+  the uploads on the render thread instead, one per frame.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assets.h"
+#include "utils.h"
+#include "log.h"
+#include "profile.h"
+#include "glcount.h"
+#include "gltrace.h"
+
+
+
+static void setState(ASSET_T *asset, int state)
+{
+    __atomic_store_n( &asset->state, state, __ATOMIC_RELEASE ) ;
+} // setState
+
+
+
+// Decode thread : take the oldest queued asset and decode it.
+static void *decodeThread(void *arg)
+{
+    ASSETS_T *assets = arg ;
+    ASSET_T *asset ;
+    int i ;
+
+    profThreadName("asset decode") ;
+
+    pthread_mutex_lock( &assets->lock ) ;
+    while ( !assets->quit ) {
+        if ( assets->nqueued == 0 ) {
+            pthread_cond_wait( &assets->decodeWake, &assets->lock ) ;
+            continue ;
+        }
+        for ( i = 0, asset = NULL ; i < assets->nassets ; ++i ) {
+            if ( assets->asset[i].state == ASSET_QUEUED ) {
+                asset = &assets->asset[i] ;
+                break ;
+            }
+        }
+        if ( asset == NULL ) {        // Counted but already taken.
+            assets->nqueued = 0 ;
+            continue ;
+        }
+        asset->state = ASSET_DECODING ;
+        assets->nqueued-- ;
+        pthread_mutex_unlock( &assets->lock ) ;
+
+        PROF_BEGIN("esLoadTGA") ;
+        asset->data = esLoadTGA(asset->fileName, &asset->width, &asset->height) ;
+        PROF_END("esLoadTGA") ;
+
+        pthread_mutex_lock( &assets->lock ) ;
+        if ( asset->data == NULL ) {
+            logError("Assets: Unable to load '%s'.\n",asset->fileName) ;
+            setState(asset,ASSET_FAILED) ;
+            continue ;
+        }
+        asset->state = ASSET_DECODED ;
+        assets->ndecoded++ ;
+        pthread_cond_signal( &assets->uploadWake ) ;
+    }
+    pthread_mutex_unlock( &assets->lock ) ;
+
+    return NULL ;
+} // decodeThread
+
+
+
+// Create the GL object for a decoded asset on the current context.
+static void uploadAsset(ASSET_T *asset)
+{
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 ) ;
+    glGenTextures( 1, &asset->textureId ) ;
+    glBindTexture( GL_TEXTURE_2D, asset->textureId ) ;
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, asset->width, asset->height,
+                  0, GL_RGB, GL_UNSIGNED_BYTE, asset->data ) ;
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST ) ;
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST ) ;
+    glBindTexture( GL_TEXTURE_2D, 0 ) ;
+
+    free( asset->data ) ;
+    asset->data = NULL ;
+} // uploadAsset
+
+
+
+// Take one decoded asset, NULL if none. Call with the lock held.
+static ASSET_T *takeDecoded(ASSETS_T *assets)
+{
+    int i ;
+
+    for ( i = 0 ; i < assets->nassets ; ++i ) {
+        if ( assets->asset[i].state == ASSET_DECODED ) {
+            assets->asset[i].state = ASSET_DECODING ;   // claimed for upload
+            return &assets->asset[i] ;
+        }
+    }
+    return NULL ;
+} // takeDecoded
+
+
+
+// Upload thread : owns the shared context.
+static void *uploadThread(void *arg)
+{
+    ASSETS_T *assets = arg ;
+    ESContext *es = assets->esContext ;
+    ASSET_T *asset ;
+
+    profThreadName("asset upload") ;
+
+    if ( !eglMakeCurrent( es->eglDisplay, es->eglUploadSurface, es->eglUploadSurface,
+                          es->eglUploadContext ) ) {
+        logError("Assets: Unable to make the upload context current.\n") ;
+        return NULL ;
+    }
+
+    pthread_mutex_lock( &assets->lock ) ;
+    while ( !assets->quit ) {
+        if ( assets->ndecoded == 0 || ( asset = takeDecoded(assets) ) == NULL ) {
+            pthread_cond_wait( &assets->uploadWake, &assets->lock ) ;
+            continue ;
+        }
+        pthread_mutex_unlock( &assets->lock ) ;
+
+        PROF_BEGIN("upload asset") ;
+        uploadAsset(asset) ;
+        glFinish() ;          // Complete before another context uses it.
+        PROF_END("upload asset") ;
+
+        pthread_mutex_lock( &assets->lock ) ;
+        assets->ndecoded-- ;
+        asset->loadTime = nowus() - asset->loadTime ;
+        setState(asset,ASSET_READY) ;
+    }
+    pthread_mutex_unlock( &assets->lock ) ;
+
+    eglMakeCurrent( es->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT ) ;
+
+    return NULL ;
+} // uploadThread
+
+
+
+/***********************************************************
+ * Name: assetsInit
+ *
+ * Arguments:
+ *     nworkers - no. of decode threads, 0 for default.
+ *
+ * Description: Starts the decode threads. May be called
+ *              before there is a window so that loading
+ *              overlaps EGL start up; uploads wait for
+ *              assetsAttachContext().
+ *
+ * Returns: asset manager, NULL if it can't be started. The
+ *          other calls take NULL as having no assets.
+ *
+ ***********************************************************/
+ASSETS_T *assetsInit(int nworkers)
+{
+    ASSETS_T *assets = calloc( 1, sizeof( ASSETS_T ) ) ;
+    int i ;
+
+    if ( assets == NULL ) {
+        logError("Assets: Out of memory!\n") ;
+        return NULL ;
+    }
+    if ( nworkers <= 0 ) nworkers = ASSETS_DEF_WORKERS ;
+    if ( nworkers > ASSETS_MAX_WORKERS ) nworkers = ASSETS_MAX_WORKERS ;
+
+    pthread_mutex_init( &assets->lock, NULL ) ;
+    pthread_cond_init( &assets->decodeWake, NULL ) ;
+    pthread_cond_init( &assets->uploadWake, NULL ) ;
+
+    for ( i = 0 ; i < nworkers ; ++i ) {
+        if ( pthread_create( &assets->worker[i], NULL, decodeThread, assets ) != 0 )
+            break ;
+    }
+    assets->nworkers = i ;
+    if ( i == 0 ) {
+        logError("Assets: Unable to start a decode thread.\n") ;
+        pthread_cond_destroy( &assets->uploadWake ) ;
+        pthread_cond_destroy( &assets->decodeWake ) ;
+        pthread_mutex_destroy( &assets->lock ) ;
+        free( assets ) ;
+        return NULL ;
+    }
+
+    return assets ;
+
+} // assetsInit
+
+
+
+/***********************************************************
+ * Name: assetsAttachContext
+ *
+ * Arguments:
+ *     assets    - asset manager.
+ *     esContext - context after esCreateWindow().
+ *
+ * Description: Starts the upload thread on the shared context,
+ *              or leaves uploads to assetsPoll() if there is
+ *              no shared context.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void assetsAttachContext(ASSETS_T *assets, ESContext *esContext)
+{
+    if ( assets == NULL ) return ;
+    assets->esContext = esContext ;
+
+    if ( esContext->eglUploadContext != EGL_NO_CONTEXT &&
+         pthread_create( &assets->uploader, NULL, uploadThread, assets ) == 0 )
+        assets->hasUploader = 1 ;
+    else
+        logInfo("Assets: No shared context, uploading on the render thread.\n") ;
+
+} // assetsAttachContext
+
+
+
+// Queue a TGA texture. The handle is valid until assetsShutdown().
+ASSET_T *assetsLoadTexture(ASSETS_T *assets, const char *fileName)
+{
+    ASSET_T *asset ;
+
+    if ( assets == NULL ) return NULL ;
+    pthread_mutex_lock( &assets->lock ) ;
+    if ( assets->nassets >= ASSETS_MAX_ASSETS ) {
+        pthread_mutex_unlock( &assets->lock ) ;
+        logWarn("Assets: Reached maximum no. of assets %d!\n",ASSETS_MAX_ASSETS) ;
+        return NULL ;
+    }
+    asset = &assets->asset[assets->nassets++] ;
+    memset( asset, 0, sizeof( ASSET_T ) ) ;
+    asset->type = ASSET_TEXTURE ;
+    strncpy( asset->fileName, fileName, sizeof( asset->fileName ) - 1 ) ;
+    asset->loadTime = nowus() ;
+    asset->state = ASSET_QUEUED ;
+    assets->nqueued++ ;
+    pthread_cond_signal( &assets->decodeWake ) ;
+    pthread_mutex_unlock( &assets->lock ) ;
+
+    return asset ;
+
+} // assetsLoadTexture
+
+
+
+int assetReady(const ASSET_T *asset)
+{
+    return asset && __atomic_load_n( &asset->state, __ATOMIC_ACQUIRE ) == ASSET_READY ;
+} // assetReady
+
+
+
+/***********************************************************
+ * Name: assetsPoll
+ *
+ * Arguments:
+ *     assets - asset manager.
+ *
+ * Description: Call once per frame on the render thread.
+ *              Only does work when there is no upload thread,
+ *              then uploads at most one asset.
+ *
+ * Returns: no. of assets not yet ready.
+ *
+ ***********************************************************/
+int assetsPoll(ASSETS_T *assets)
+{
+    ASSET_T *asset = NULL ;
+
+    if ( assets == NULL ) return 0 ;
+    if ( !assets->hasUploader && assets->esContext ) {
+        pthread_mutex_lock( &assets->lock ) ;
+        if ( assets->ndecoded > 0 ) asset = takeDecoded(assets) ;
+        pthread_mutex_unlock( &assets->lock ) ;
+        if ( asset ) {
+            PROF_SCOPE("upload asset") ;
+            uploadAsset(asset) ;
+            pthread_mutex_lock( &assets->lock ) ;
+            assets->ndecoded-- ;
+            asset->loadTime = nowus() - asset->loadTime ;
+            setState(asset,ASSET_READY) ;
+            pthread_mutex_unlock( &assets->lock ) ;
+        }
+    }
+    return assetsPending(assets) ;
+
+} // assetsPoll
+
+
+
+// No. of assets queued, decoding or waiting for upload.
+int assetsPending(ASSETS_T *assets)
+{
+    int i, n = 0 ;
+
+    if ( assets == NULL ) return 0 ;
+    pthread_mutex_lock( &assets->lock ) ;
+    for ( i = 0 ; i < assets->nassets ; ++i )
+        if ( assets->asset[i].state < ASSET_READY ) ++n ;
+    pthread_mutex_unlock( &assets->lock ) ;
+
+    return n ;
+} // assetsPending
+
+
+
+// Stop all threads and delete the textures (render thread, context current).
+void assetsShutdown(ASSETS_T *assets)
+{
+    int i ;
+
+    if ( assets == NULL ) return ;
+
+    pthread_mutex_lock( &assets->lock ) ;
+    assets->quit = 1 ;
+    pthread_cond_broadcast( &assets->decodeWake ) ;
+    pthread_cond_broadcast( &assets->uploadWake ) ;
+    pthread_mutex_unlock( &assets->lock ) ;
+
+    for ( i = 0 ; i < assets->nworkers ; ++i )
+        pthread_join( assets->worker[i], NULL ) ;
+    if ( assets->hasUploader )
+        pthread_join( assets->uploader, NULL ) ;
+
+    for ( i = 0 ; i < assets->nassets ; ++i ) {
+        if ( assets->asset[i].data ) free( assets->asset[i].data ) ;
+        if ( assets->asset[i].textureId ) glDeleteTextures( 1, &assets->asset[i].textureId ) ;
+    }
+
+    pthread_mutex_destroy( &assets->lock ) ;
+    pthread_cond_destroy( &assets->decodeWake ) ;
+    pthread_cond_destroy( &assets->uploadWake ) ;
+    free( assets ) ;
+
+} // assetsShutdown
+
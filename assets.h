@@ -0,0 +1,94 @@
+
+/* ************************************************************************* *
+
+  Module Name : assets.h
+
+  Description : Asynchronous asset loading. A pool of decode threads reads
+    and decodes files, then an upload thread holding the shared EGL
+    context (ESContext eglUploadContext) creates the GL objects. Callers
+    get a handle back at once and poll it, so nothing on the render
+    thread waits for a file.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __ASSETS_H__
+#define __ASSETS_H__
+
+#include <pthread.h>
+#include "ESUtil.h"
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define ASSETS_MAX_WORKERS     4       // Max. decode threads.
+#define ASSETS_DEF_WORKERS     2
+#define ASSETS_MAX_ASSETS     64       // Max. assets per manager.
+
+// Asset types.
+#define ASSET_TEXTURE          1       // 24-bit TGA into a GL_TEXTURE_2D
+
+// Asset states.
+#define ASSET_QUEUED           0       // Waiting for a decode thread.
+#define ASSET_DECODING         1
+#define ASSET_DECODED          2       // Waiting for the upload thread.
+#define ASSET_READY            3       // GL object usable on any context.
+#define ASSET_FAILED           4
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    int           type ;
+    volatile int  state ;
+    char          fileName[256] ;
+    char         *data ;           // decoded pixels, until uploaded
+    int           width, height ;
+    GLuint        textureId ;      // valid once ASSET_READY
+    double        loadTime ;       // request to ready (us)
+} ASSET_T ;
+
+typedef struct {
+    ESContext      *esContext ;
+
+    // Decode pool.
+    pthread_t       worker[ASSETS_MAX_WORKERS] ;
+    int             nworkers ;
+    pthread_mutex_t lock ;
+    pthread_cond_t  decodeWake ;
+    pthread_cond_t  uploadWake ;
+    int             quit ;
+
+    // Upload thread, if the shared context could be created.
+    pthread_t       uploader ;
+    int             hasUploader ;
+
+    ASSET_T         asset[ASSETS_MAX_ASSETS] ;
+    int             nassets ;
+    int             nqueued ;      // waiting for decode
+    int             ndecoded ;     // waiting for upload
+} ASSETS_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+ASSETS_T *assetsInit(int nworkers) ;
+
+void assetsAttachContext(ASSETS_T *assets, ESContext *esContext) ;
+
+ASSET_T *assetsLoadTexture(ASSETS_T *assets, const char *fileName) ;
+
+int assetReady(const ASSET_T *asset) ;
+
+int assetsPoll(ASSETS_T *assets) ;
+
+int assetsPending(ASSETS_T *assets) ;
+
+void assetsShutdown(ASSETS_T *assets) ;
+
+#endif // __ASSETS_H__
+
@@ -0,0 +1,369 @@
+
+/*
+  This module packs many small RGB images into a few large texture pages.
+
+  Each page keeps a skyline (the top edge of everything packed so far) and
+  new images go at the lowest point they fit (bottom-left rule). Every image
+  is surrounded by a border of its own edge pixels so that linear filtering
+  and the smaller mip levels do not bleed neighbouring images into it.
+
+  Mesh texture coordinates (esGenCube/esGenSphere or loaded meshes) are then
+  rewritten into the packed rectangle, so objects that used different
+  textures can be drawn with one bind, and merged into one draw.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+#include "log.h"
+#include "glcount.h"
+#include "gltrace.h"
+
+
+
+#define NCOMPONENTS   3       // RGB bytes per pixel, as esLoadTGA().
+
+
+
+/***********************************************************
+ * Name: atlasInit
+ *
+ * Arguments:
+ *     atlas   - atlas to clear.
+ *     size    - page width/height in pixels, 0 for default.
+ *     padding - border pixels round each image, <0 for default.
+ *
+ * Description: Sets up an empty atlas. Pages are allocated
+ *              as images are added.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void atlasInit(ATLAS_T *atlas, int size, int padding)
+{
+    memset( atlas, 0, sizeof( ATLAS_T ) ) ;
+    atlas->size = ( size > 0 ) ? size : ATLAS_DEF_SIZE ;
+    atlas->padding = ( padding >= 0 ) ? padding : ATLAS_DEF_PADDING ;
+} // atlasInit
+
+
+
+// Can a w x h rectangle sit on the skyline starting at node i?
+// Returns the y position it would rest at, or -1.
+static int skylineFits(const ATLAS_PAGE_T *page, int size, int i, int w, int h)
+{
+    int x = page->node[i].x ;
+    int y = page->node[i].y ;
+    int widthLeft = w ;
+
+    if ( x + w > size ) return -1 ;
+
+    while ( widthLeft > 0 ) {
+        if ( i >= page->nnodes ) return -1 ;
+        if ( page->node[i].y > y ) y = page->node[i].y ;
+        if ( y + h > size ) return -1 ;
+        widthLeft -= page->node[i].width ;
+        ++i ;
+    }
+    return y ;
+} // skylineFits
+
+
+
+// Find the lowest (then narrowest) position for a w x h rectangle.
+// Returns the skyline node index to insert at, or -1 if it does not fit.
+static int skylineFind(const ATLAS_PAGE_T *page, int size, int w, int h,
+                       int *bestx, int *besty)
+{
+    int i, y ;
+    int best = -1, bestTop = size + 1, bestWidth = size + 1 ;
+
+    for ( i = 0 ; i < page->nnodes ; ++i ) {
+        y = skylineFits(page,size,i,w,h) ;
+        if ( y < 0 ) continue ;
+        if ( y + h < bestTop ||
+            ( y + h == bestTop && page->node[i].width < bestWidth ) ) {
+            best = i ;
+            bestTop = y + h ;
+            bestWidth = page->node[i].width ;
+            *bestx = page->node[i].x ;
+            *besty = y ;
+        }
+    }
+    return best ;
+} // skylineFind
+
+
+
+// Raise the skyline over the newly placed rectangle.
+static int skylineAdd(ATLAS_PAGE_T *page, int index, int x, int y, int w, int h)
+{
+    int i ;
+
+    if ( page->nnodes >= ATLAS_MAX_NODES ) return 0 ;
+
+    memmove( &page->node[index + 1], &page->node[index],
+             ( page->nnodes - index ) * sizeof( ATLAS_NODE_T ) ) ;
+    page->node[index].x = x ;
+    page->node[index].y = y + h ;
+    page->node[index].width = w ;
+    page->nnodes++ ;
+
+    // Trim or remove the segments now underneath the new one.
+    for ( i = index + 1 ; i < page->nnodes ; ++i ) {
+        ATLAS_NODE_T *prev = &page->node[i - 1] ;
+        ATLAS_NODE_T *node = &page->node[i] ;
+        int shrink = prev->x + prev->width - node->x ;
+
+        if ( shrink <= 0 ) break ;
+
+        node->x += shrink ;
+        node->width -= shrink ;
+        if ( node->width > 0 ) break ;
+
+        memmove( node, node + 1, ( page->nnodes - i - 1 ) * sizeof( ATLAS_NODE_T ) ) ;
+        page->nnodes-- ;
+        --i ;
+    }
+
+    // Merge neighbouring segments at the same height.
+    for ( i = 0 ; i < page->nnodes - 1 ; ++i ) {
+        if ( page->node[i].y == page->node[i + 1].y ) {
+            page->node[i].width += page->node[i + 1].width ;
+            memmove( &page->node[i + 1], &page->node[i + 2],
+                     ( page->nnodes - i - 2 ) * sizeof( ATLAS_NODE_T ) ) ;
+            page->nnodes-- ;
+            --i ;
+        }
+    }
+    return 1 ;
+} // skylineAdd
+
+
+
+static int newPage(ATLAS_T *atlas)
+{
+    ATLAS_PAGE_T *page ;
+
+    if ( atlas->npages >= ATLAS_MAX_PAGES ) return -1 ;
+
+    page = &atlas->page[atlas->npages] ;
+    page->pixels = calloc( (size_t) atlas->size * atlas->size, NCOMPONENTS ) ;
+    if ( page->pixels == NULL ) return -1 ;
+
+    page->textureId = 0 ;
+    page->nnodes = 1 ;
+    page->node[0].x = 0 ;
+    page->node[0].y = 0 ;
+    page->node[0].width = atlas->size ;
+
+    return atlas->npages++ ;
+} // newPage
+
+
+
+// Copy an image into the page, repeating its edge pixels into the padding.
+static void blitPadded(ATLAS_T *atlas, ATLAS_PAGE_T *page, const char *image,
+                       int width, int height, int x0, int y0)
+{
+    int pad = atlas->padding ;
+    int px, py, sx, sy ;
+
+    for ( py = 0 ; py < height + 2 * pad ; ++py ) {
+        char *dst = page->pixels + ( (size_t) ( y0 + py ) * atlas->size + x0 ) * NCOMPONENTS ;
+
+        sy = py - pad ;
+        if ( sy < 0 ) sy = 0 ;
+        if ( sy > height - 1 ) sy = height - 1 ;
+
+        for ( px = 0 ; px < width + 2 * pad ; ++px, dst += NCOMPONENTS ) {
+            sx = px - pad ;
+            if ( sx < 0 ) sx = 0 ;
+            if ( sx > width - 1 ) sx = width - 1 ;
+            memcpy( dst, image + ( (size_t) sy * width + sx ) * NCOMPONENTS, NCOMPONENTS ) ;
+        }
+    }
+} // blitPadded
+
+
+
+/***********************************************************
+ * Name: atlasAdd
+ *
+ * Arguments:
+ *     atlas  - atlas to add to.
+ *     image  - RGB image (as returned by esLoadTGA()).
+ *     width  - image size
+ *     height
+ *
+ * Description: Packs the image into the first page with room,
+ *              opening a new page if required. Pages that have
+ *              already been uploaded are not added to.
+ *
+ * Returns: rect index for atlasRemapTexCoords(), -1 on failure.
+ *
+ ***********************************************************/
+int atlasAdd(ATLAS_T *atlas, const char *image, int width, int height)
+{
+    int w = width + 2 * atlas->padding ;
+    int h = height + 2 * atlas->padding ;
+    int p, index = -1, x = 0, y = 0 ;
+    ATLAS_PAGE_T *page = NULL ;
+    ATLAS_RECT_T *rect ;
+
+    if ( image == NULL || width <= 0 || height <= 0 ) return -1 ;
+    if ( atlas->nrects >= ATLAS_MAX_RECTS ) {
+        logWarn("Atlas: Reached maximum no. of images %d!\n",atlas->nrects) ;
+        return -1 ;
+    }
+    if ( w > atlas->size || h > atlas->size ) {
+        logWarn("Atlas: Image %d x %d too large for %d pages!\n",width,height,atlas->size) ;
+        return -1 ;
+    }
+
+    for ( p = 0 ; p < atlas->npages ; ++p ) {
+        page = &atlas->page[p] ;
+        if ( page->pixels == NULL ) continue ;    // already uploaded
+        index = skylineFind(page,atlas->size,w,h,&x,&y) ;
+        if ( index >= 0 ) break ;
+    }
+
+    if ( index < 0 ) {
+        p = newPage(atlas) ;
+        if ( p < 0 ) {
+            logWarn("Atlas: Out of pages for %d x %d image!\n",width,height) ;
+            return -1 ;
+        }
+        page = &atlas->page[p] ;
+        index = skylineFind(page,atlas->size,w,h,&x,&y) ;
+    }
+
+    if ( !skylineAdd(page,index,x,y,w,h) ) return -1 ;
+
+    blitPadded(atlas,page,image,width,height,x,y) ;
+
+    rect = &atlas->rect[atlas->nrects] ;
+    rect->page = p ;
+    rect->x = x + atlas->padding ;
+    rect->y = y + atlas->padding ;
+    rect->w = width ;
+    rect->h = height ;
+    rect->u0 = (GLfloat) rect->x / atlas->size ;
+    rect->v0 = (GLfloat) rect->y / atlas->size ;
+    rect->u1 = (GLfloat) ( rect->x + width ) / atlas->size ;
+    rect->v1 = (GLfloat) ( rect->y + height ) / atlas->size ;
+
+    return atlas->nrects++ ;
+
+} // atlasAdd
+
+
+
+/***********************************************************
+ * Name: atlasUpload
+ *
+ * Arguments:
+ *     atlas  - atlas to upload.
+ *     mipmap - non-zero to generate mip levels.
+ *
+ * Description: Creates a texture for every page not yet
+ *              uploaded, then frees the client copy.
+ *
+ * Returns: no. of pages uploaded.
+ *
+ ***********************************************************/
+int atlasUpload(ATLAS_T *atlas, int mipmap)
+{
+    ATLAS_PAGE_T *page ;
+    int p, n = 0 ;
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 ) ;
+
+    for ( p = 0 ; p < atlas->npages ; ++p ) {
+        page = &atlas->page[p] ;
+        if ( page->pixels == NULL ) continue ;
+
+        glGenTextures( 1, &page->textureId ) ;
+        glBindTexture( GL_TEXTURE_2D, page->textureId ) ;
+        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, atlas->size, atlas->size,
+                      0, GL_RGB, GL_UNSIGNED_BYTE, page->pixels ) ;
+
+        if ( mipmap ) {
+            glGenerateMipmap( GL_TEXTURE_2D ) ;
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST ) ;
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR ) ;
+        } else {
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST ) ;
+            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST ) ;
+        }
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE ) ;
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE ) ;
+
+        free( page->pixels ) ;
+        page->pixels = NULL ;
+        ++n ;
+    }
+
+    return n ;
+
+} // atlasUpload
+
+
+
+/***********************************************************
+ * Name: atlasRemapTexCoords
+ *
+ * Arguments:
+ *     atlas     - packed atlas.
+ *     rect      - index returned by atlasAdd().
+ *     texCoords - float2 texture coordinates to rewrite.
+ *     nvertices - no. of texture coordinates.
+ *
+ * Description: Moves [0,1] texture coordinates into the
+ *              image's rectangle on its atlas page.
+ *   Note: Coordinates outside [0,1] (repeating textures) are
+ *         clamped, an atlas cannot wrap.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void atlasRemapTexCoords(const ATLAS_T *atlas, int rect,
+                         GLfloat *texCoords, GLuint nvertices)
+{
+    const ATLAS_RECT_T *r = &atlas->rect[rect] ;
+    GLfloat du = r->u1 - r->u0 ;
+    GLfloat dv = r->v1 - r->v0 ;
+    GLfloat u, v ;
+    GLuint i ;
+
+    for ( i = 0 ; i < nvertices ; ++i, texCoords += 2 ) {
+        u = texCoords[0] ;
+        v = texCoords[1] ;
+        if ( u < 0.0f ) u = 0.0f ;
+        if ( u > 1.0f ) u = 1.0f ;
+        if ( v < 0.0f ) v = 0.0f ;
+        if ( v > 1.0f ) v = 1.0f ;
+        texCoords[0] = r->u0 + u * du ;
+        texCoords[1] = r->v0 + v * dv ;
+    }
+
+} // atlasRemapTexCoords
+
+
+
+void atlasFree(ATLAS_T *atlas)
+{
+    int p ;
+
+    for ( p = 0 ; p < atlas->npages ; ++p ) {
+        if ( atlas->page[p].pixels ) free( atlas->page[p].pixels ) ;
+        if ( atlas->page[p].textureId ) glDeleteTextures( 1, &atlas->page[p].textureId ) ;
+    }
+    atlas->npages = 0 ;
+    atlas->nrects = 0 ;
+} // atlasFree
+
@@ -0,0 +1,81 @@
+
+/* ************************************************************************* *
+
+  Module Name : atlas.h
+
+  Description : Texture atlas builder. Packs many small RGB images into one
+    or a few square texture pages (skyline bottom-left packing) so objects
+    with different images can share one glBindTexture and one draw.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __ATLAS_H__
+#define __ATLAS_H__
+
+#include <GLES2/gl2.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define ATLAS_MAX_PAGES       4       // Max. no. of atlas textures.
+#define ATLAS_MAX_RECTS      64       // Max. no. of images packed.
+#define ATLAS_MAX_NODES     256       // Max. skyline segments per page.
+
+#define ATLAS_DEF_SIZE     1024       // Default page size (power of 2 for mips).
+#define ATLAS_DEF_PADDING     4       // Default border pixels round each image.
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+// One horizontal segment of the skyline (top edge of the packed area).
+typedef struct {
+    int      x ;               // left edge
+    int      y ;               // height of the skyline here
+    int      width ;           // segment width
+} ATLAS_NODE_T ;
+
+typedef struct {
+    char         *pixels ;     // size x size RGB image (client copy)
+    GLuint        textureId ;  // 0 until atlasUpload()
+    int           nnodes ;
+    ATLAS_NODE_T  node[ATLAS_MAX_NODES] ;
+} ATLAS_PAGE_T ;
+
+// Where one packed image ended up.
+typedef struct {
+    int      page ;            // atlas page index
+    int      x, y ;            // image position in the page (excl. padding)
+    int      w, h ;            // image size
+    GLfloat  u0, v0, u1, v1 ;  // texture coordinate rectangle
+} ATLAS_RECT_T ;
+
+typedef struct {
+    int           size ;       // page width = height in pixels
+    int           padding ;    // border pixels round each image
+    int           npages ;
+    ATLAS_PAGE_T  page[ATLAS_MAX_PAGES] ;
+    int           nrects ;
+    ATLAS_RECT_T  rect[ATLAS_MAX_RECTS] ;
+} ATLAS_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+void atlasInit(ATLAS_T *atlas, int size, int padding) ;
+
+int atlasAdd(ATLAS_T *atlas, const char *image, int width, int height) ;
+
+int atlasUpload(ATLAS_T *atlas, int mipmap) ;
+
+void atlasRemapTexCoords(const ATLAS_T *atlas, int rect,
+                         GLfloat *texCoords, GLuint nvertices) ;
+
+void atlasFree(ATLAS_T *atlas) ;
+
+#endif // __ATLAS_H__
+
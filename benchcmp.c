@@ -0,0 +1,238 @@
+/*
+   Compares esBench results with a stored baseline and flags the cases
+   that got slower. 'make bench' runs it when there is a baseline.
+
+   Cases are matched by name. A case is a regression when its mean frame
+   time is more than -t percent above the baseline's, or its p99 more
+   than -9 percent above (p99 is noisier). A change in the host or the
+   GL renderer is reported, the numbers are still compared.
+
+   esBench writes one case per line, so the files are read line by line
+   and the fields found by name, no JSON parser is needed.
+
+   Baseline cases that were not run, as when esBench is given a subset,
+   are listed as warnings.
+
+   Exits with 1 if any case regressed, or with -s (--strict) if a
+   baseline case is missing from the new run, 2 on errors.
+
+  18/10/26 v1.0 Mean and p99 thresholds, missing cases.
+  18/10/26 v1.1 Missing cases only fail with -s.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VERSION  "benchcmp v1.1: "
+
+#define DEF_MEAN_PERCENT    5.0       // Mean frame time regression threshold.
+#define DEF_P99_PERCENT    10.0       // p99 threshold.
+
+#define MAXCASES         1024
+#define MAXLINE          2048
+
+
+typedef struct {
+    char     name[64] ;
+    double   mean ;            // ms
+    double   p99 ;
+    double   fps ;
+    int      seen ;            // matched in the other file
+} RESULT_T ;
+
+typedef struct {
+    char     renderer[128] ;
+    char     host[128] ;
+    char     cpu[128] ;
+    RESULT_T result[MAXCASES] ;
+    int      nresults ;
+} RESULTS_T ;
+
+
+static RESULTS_T baseline, current ;
+
+
+
+//------------------------------------------------------------------------------
+
+
+static void usage(char *prog)
+{
+    printf("Usage : %s [options] <baseline.json> <results.json>\n",prog) ;
+    printf("Options :\n") ;
+    printf("  -t <percent>   Mean frame time regression (default %.0f%%).\n",DEF_MEAN_PERCENT) ;
+    printf("  -9 <percent>   p99 frame time regression (default %.0f%%).\n",DEF_P99_PERCENT) ;
+    printf("  -s, --strict   Baseline cases missing from the results fail too.\n") ;
+} // usage
+
+
+
+// The string value of "key" in a line, or "" if there is none.
+static void get_string(const char *line, const char *key, char *value, int size)
+{
+    char pattern[64] ;
+    const char *p, *q ;
+
+    *value = '\0' ;
+    snprintf(pattern, sizeof( pattern ), "\"%s\": \"", key) ;
+    if ( ( p = strstr(line, pattern) ) == NULL ) return ;
+    p += strlen(pattern) ;
+    for ( q = p ; *q && *q != '"' ; ++q )
+        if ( *q == '\\' && q[1] ) ++q ;
+    snprintf(value, size, "%.*s", (int) ( q - p ), p) ;
+
+} // get_string
+
+
+
+// The number value of "key" in a line, or -1.0 if there is none.
+static double get_number(const char *line, const char *key)
+{
+    char pattern[64] ;
+    const char *p ;
+
+    snprintf(pattern, sizeof( pattern ), "\"%s\": ", key) ;
+    if ( ( p = strstr(line, pattern) ) == NULL ) return -1.0 ;
+    return atof(p + strlen(pattern)) ;
+
+} // get_number
+
+
+
+static int load_results(const char *fileName, RESULTS_T *rs)
+{
+    FILE *f = fopen(fileName, "r") ;
+    char line[MAXLINE] ;
+    RESULT_T *r ;
+
+    if ( f == NULL ) {
+        printf(VERSION "Unable to open '%s'.\n",fileName) ;
+        return 0 ;
+    }
+    while ( fgets(line, sizeof( line ), f) ) {
+        if ( strncmp(line, "\"host\":", 7) == 0 ) {
+            get_string(line, "name", rs->host, sizeof( rs->host )) ;
+            get_string(line, "cpu", rs->cpu, sizeof( rs->cpu )) ;
+        } else if ( strncmp(line, "\"gl\":", 5) == 0 )
+            get_string(line, "renderer", rs->renderer, sizeof( rs->renderer )) ;
+        else if ( strncmp(line, "{\"name\":", 8) == 0 && rs->nresults < MAXCASES ) {
+            r = &rs->result[rs->nresults++] ;
+            get_string(line, "name", r->name, sizeof( r->name )) ;
+            r->mean = get_number(line, "mean_ms") ;
+            r->p99 = get_number(line, "p99_ms") ;
+            r->fps = get_number(line, "fps") ;
+        }
+    }
+    fclose( f ) ;
+
+    if ( rs->nresults == 0 ) {
+        printf(VERSION "No cases in '%s'.\n",fileName) ;
+        return 0 ;
+    }
+    return 1 ;
+
+} // load_results
+
+
+
+static RESULT_T *find_result(RESULTS_T *rs, const char *name)
+{
+    int i ;
+
+    for ( i = 0 ; i < rs->nresults ; ++i )
+        if ( strcmp(rs->result[i].name, name) == 0 ) return &rs->result[i] ;
+    return NULL ;
+
+} // find_result
+
+
+
+static double change(double base, double now)
+{
+    return base > 0.0 ? ( now - base ) * 100.0 / base : 0.0 ;
+} // change
+
+
+
+int main(int argc, char **argv)
+{
+    double meanLimit = DEF_MEAN_PERCENT, p99Limit = DEF_P99_PERCENT ;
+    static const struct option longOpts[] = {
+        { "strict", no_argument, NULL, 's' },
+        { NULL, 0, NULL, 0 }
+    } ;
+    int regressions = 0, improved = 0, missing = 0, strict = 0 ;
+    RESULT_T *b, *r ;
+    int opt, i ;
+
+    while ( ( opt = getopt_long(argc, argv, "t:9:s", longOpts, NULL) ) != -1 ) {
+        switch ( opt ) {
+            case 's' :
+                strict = 1 ;
+                break ;
+            case 't' :
+                meanLimit = atof(optarg) ;
+                break ;
+            case '9' :
+                p99Limit = atof(optarg) ;
+                break ;
+            default :
+                usage(argv[0]) ;
+                return 2 ;
+        }
+    }
+    if ( argc - optind != 2 ) {
+        usage(argv[0]) ;
+        return 2 ;
+    }
+    if ( !load_results(argv[optind], &baseline) || !load_results(argv[optind + 1], &current) )
+        return 2 ;
+
+    if ( strcmp(baseline.renderer, current.renderer) )
+        printf("GL renderer changed : '%s' -> '%s'.\n",baseline.renderer,current.renderer) ;
+    if ( strcmp(baseline.host, current.host) || strcmp(baseline.cpu, current.cpu) )
+        printf("Host changed : '%s' (%s) -> '%s' (%s).\n",baseline.host,baseline.cpu,
+               current.host,current.cpu) ;
+
+    printf("%-28s %10s %10s %8s %10s %10s %8s\n","case","base ms","mean ms","change",
+           "base p99","p99 ms","change") ;
+    for ( i = 0 ; i < current.nresults ; ++i ) {
+        const char *flag = "" ;
+        double dmean, dp99 ;
+
+        r = &current.result[i] ;
+        b = find_result(&baseline, r->name) ;
+        if ( b == NULL ) {
+            printf("%-28s %10s %10.3f %8s   (not in the baseline)\n",r->name,"-",r->mean,"") ;
+            continue ;
+        }
+        b->seen = 1 ;
+        dmean = change(b->mean, r->mean) ;
+        dp99 = change(b->p99, r->p99) ;
+        if ( dmean > meanLimit || dp99 > p99Limit ) {
+            flag = "  REGRESSION" ;
+            ++regressions ;
+        } else if ( dmean < -meanLimit ) {
+            flag = "  faster" ;
+            ++improved ;
+        }
+        printf("%-28s %10.3f %10.3f %+7.1f%% %10.3f %10.3f %+7.1f%%%s\n",r->name,
+               b->mean,r->mean,dmean,b->p99,r->p99,dp99,flag) ;
+    }
+    for ( i = 0 ; i < baseline.nresults ; ++i ) {
+        if ( baseline.result[i].seen ) continue ;
+        printf("%-28s   missing from the results%s.\n",baseline.result[i].name,
+               strict ? "" : " (warning)") ;
+        ++missing ;
+    }
+
+    printf("%d cases : %d regressions (mean > +%.1f%% or p99 > +%.1f%%), %d faster, %d missing.\n",
+           current.nresults,regressions,meanLimit,p99Limit,improved,missing) ;
+
+    return ( regressions || ( strict && missing ) ) ? 1 : 0 ;
+
+} // main
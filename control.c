@@ -0,0 +1,377 @@
+
+/*
+  This module serves the control socket on a thread of its own.
+
+  controlStart() binds a Unix domain stream socket, owner only, and the
+  control thread waits in poll() for connections, command lines and the
+  eventfd written by controlStop(). Clients are not trusted to send a
+  line at once, each has a buffer that collects bytes until a newline.
+
+  A complete line is handed to the render thread one at a time : the
+  control thread copies it into the CONTROL_T, sets pending with a
+  release store and waits on a condition. Once a frame the render thread
+  checks pending with an acquire load, which is all a frame costs with no
+  command waiting, and if set splits the line into words, applies it,
+  appends its answer with controlReply() and calls controlDone(), which
+  clears pending and wakes the control thread to send the answer. A
+  render thread that sleeps between frames gives an eventfd to
+  controlNotify(), written each time a line is pending.
+
+  Answers are sent without blocking, a client that does not read them
+  loses them rather than holding up the others.
+*/
+
+
+#define _GNU_SOURCE      // accept4()
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "control.h"
+#include "log.h"
+#include "profile.h"
+
+
+
+#define STATUS_SPACE      8        // Reply bytes kept for "error\n".
+
+
+
+static void close_client(CONTROL_CLIENT_T *c)
+{
+    close( c->fd ) ;
+    c->fd = -1 ;
+    c->length = 0 ;
+    c->discarding = 0 ;
+} // close_client
+
+
+
+// Hand a line to the render thread, wait for the answer and send it.
+static void run_command(CONTROL_T *ctl, CONTROL_CLIENT_T *c)
+{
+    char reply[CONTROL_MAX_REPLY] ;
+    uint64_t one = 1 ;
+    int n ;
+
+    pthread_mutex_lock( &ctl->lock ) ;
+    if ( ctl->stopping ) {
+        pthread_mutex_unlock( &ctl->lock ) ;
+        return ;
+    }
+    memcpy( ctl->line, c->line, sizeof( ctl->line ) ) ;
+    ctl->replyLength = 0 ;
+    ctl->reply[0] = '\0' ;
+    __atomic_store_n( &ctl->pending, 1, __ATOMIC_RELEASE ) ;
+    if ( ctl->notifyFd >= 0 && write( ctl->notifyFd, &one, sizeof( one ) ) != sizeof( one ) )
+        logWarn("Control: Unable to wake the frame loop, %s.\n",strerror(errno)) ;
+    while ( ctl->pending && !ctl->stopping )
+        pthread_cond_wait( &ctl->done, &ctl->lock ) ;
+    n = ctl->pending ? 0 : ctl->replyLength ;
+    memcpy( reply, ctl->reply, n ) ;
+    pthread_mutex_unlock( &ctl->lock ) ;
+
+    if ( n > 0 && send( c->fd, reply, n, MSG_NOSIGNAL | MSG_DONTWAIT ) != n )
+        logLimited(LOG_WARN, 1, "Control: Answer to a client lost.\n") ;
+
+} // run_command
+
+
+
+// Collect what a client sent, running each complete line.
+static void read_client(CONTROL_T *ctl, CONTROL_CLIENT_T *c)
+{
+    ssize_t bytes ;
+    char *nl ;
+    int len ;
+
+    bytes = recv( c->fd, c->line + c->length, CONTROL_MAX_LINE - 1 - c->length, 0 ) ;
+    if ( bytes < 0 && ( errno == EINTR || errno == EAGAIN ) ) return ;
+    if ( bytes <= 0 ) {
+        close_client(c) ;
+        return ;
+    }
+    c->length += bytes ;
+    c->line[c->length] = '\0' ;
+
+    while ( c->fd >= 0 && ( nl = strchr(c->line, '\n') ) != NULL ) {
+        *nl = '\0' ;
+        len = nl - c->line + 1 ;
+        if ( c->discarding )
+            c->discarding = 0 ;     // the end of a line too long to run
+        else {
+            if ( nl > c->line && nl[-1] == '\r' ) nl[-1] = '\0' ;
+            if ( c->line[strspn(c->line, " \t")] != '\0' ) run_command(ctl, c) ;
+        }
+        memmove( c->line, c->line + len, c->length - len + 1 ) ;
+        c->length -= len ;
+    }
+
+    // Full without a newline, the line is too long. Drop all of it, up to
+    // the newline that ends it, rather than run it in pieces.
+    if ( c->fd >= 0 && c->length == CONTROL_MAX_LINE - 1 ) {
+        if ( !c->discarding )
+            logLimited(LOG_WARN, 1, "Control: Line over %d bytes dropped.\n",CONTROL_MAX_LINE - 1) ;
+        c->discarding = 1 ;
+        c->length = 0 ;
+        c->line[0] = '\0' ;
+    }
+
+} // read_client
+
+
+
+static void accept_client(CONTROL_T *ctl)
+{
+    int fd, i ;
+
+    fd = accept4( ctl->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC ) ;
+    if ( fd < 0 ) return ;
+
+    for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) {
+        if ( ctl->client[i].fd < 0 ) {
+            ctl->client[i].fd = fd ;
+            ctl->client[i].length = 0 ;
+            ctl->client[i].discarding = 0 ;
+            return ;
+        }
+    }
+    logLimited(LOG_WARN, 1, "Control: More than %d clients, one refused.\n",CONTROL_MAX_CLIENTS) ;
+    close( fd ) ;
+
+} // accept_client
+
+
+
+static void *controlThread(void *arg)
+{
+    CONTROL_T *ctl = arg ;
+    struct pollfd pfd[CONTROL_MAX_CLIENTS + 2] ;
+    int index[CONTROL_MAX_CLIENTS + 2] ;
+    int i, n ;
+
+    profThreadName("control") ;
+
+    for ( ;; ) {
+        pfd[0].fd = ctl->wakeFd ;
+        pfd[1].fd = ctl->listenFd ;
+        n = 2 ;
+        for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) {
+            if ( ctl->client[i].fd < 0 ) continue ;
+            pfd[n].fd = ctl->client[i].fd ;
+            index[n++] = i ;
+        }
+        for ( i = 0 ; i < n ; ++i ) pfd[i].events = POLLIN ;
+
+        if ( poll( pfd, n, -1 ) < 0 ) {
+            if ( errno == EINTR ) continue ;
+            logError("Control: poll failed, %s.\n",strerror(errno)) ;
+            break ;
+        }
+        if ( pfd[0].revents ) break ;
+        if ( pfd[1].revents & POLLIN ) accept_client(ctl) ;
+        for ( i = 2 ; i < n ; ++i )
+            if ( pfd[i].revents ) read_client(ctl, &ctl->client[index[i]]) ;
+    }
+    return NULL ;
+
+} // controlThread
+
+
+
+/***********************************************************
+ * Name: controlStart
+ *
+ * Arguments:
+ *     path - socket file name, replaced if it is a socket.
+ *
+ * Description: Makes the socket and starts the control thread
+ *              serving it.
+ *
+ * Returns: control, NULL if the socket can't be made.
+ *
+ ***********************************************************/
+CONTROL_T *controlStart(const char *path)
+{
+    struct sockaddr_un addr ;
+    struct stat st ;
+    CONTROL_T *ctl ;
+    int i ;
+
+    if ( strlen(path) >= sizeof( addr.sun_path ) ) {
+        logWarn("Control: Socket name '%s' is too long.\n",path) ;
+        return NULL ;
+    }
+
+    // A socket left by a killed run is in the way, anything else is not ours.
+    if ( lstat( path, &st ) == 0 && S_ISSOCK(st.st_mode) ) unlink( path ) ;
+
+    ctl = calloc( 1, sizeof( CONTROL_T ) ) ;
+    snprintf(ctl->path, sizeof( ctl->path ), "%s", path) ;
+    for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) ctl->client[i].fd = -1 ;
+    ctl->notifyFd = -1 ;
+
+    memset( &addr, 0, sizeof( addr ) ) ;
+    addr.sun_family = AF_UNIX ;
+    snprintf(addr.sun_path, sizeof( addr.sun_path ), "%s", path) ;
+
+    // Owner only as it is made, a chmod() after the bind leaves a window in
+    // which anyone can connect. The umask is the process's, but the other
+    // threads running by now only read files.
+    ctl->listenFd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 ) ;
+    if ( ctl->listenFd >= 0 ) {
+        mode_t mask = umask( S_IRWXG | S_IRWXO ) ;
+        int ok = bind( ctl->listenFd, (struct sockaddr *) &addr, sizeof( addr ) ) == 0 ;
+
+        umask( mask ) ;
+        if ( ok ) ok = listen( ctl->listenFd, CONTROL_MAX_CLIENTS ) == 0 ;
+        if ( !ok ) {
+            close( ctl->listenFd ) ;
+            ctl->listenFd = -1 ;
+        }
+    }
+    if ( ctl->listenFd < 0 ) {
+        logWarn("Control: Unable to listen on '%s', %s.\n",path,strerror(errno)) ;
+        free( ctl ) ;
+        return NULL ;
+    }
+
+    ctl->wakeFd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK ) ;
+    pthread_mutex_init( &ctl->lock, NULL ) ;
+    pthread_cond_init( &ctl->done, NULL ) ;
+
+    if ( pthread_create( &ctl->thread, NULL, controlThread, ctl ) != 0 ) {
+        logWarn("Control: Unable to start the thread.\n") ;
+        close( ctl->listenFd ) ;
+        close( ctl->wakeFd ) ;
+        unlink( path ) ;
+        free( ctl ) ;
+        return NULL ;
+    }
+
+    logInfo("Control: Listening on '%s'.\n",path) ;
+    return ctl ;
+
+} // controlStart
+
+
+
+/***********************************************************
+ * Name: controlPoll
+ *
+ * Arguments:
+ *     ctl  - control, may be NULL.
+ *     argv - CONTROL_MAX_ARGS words of the command.
+ *
+ * Description: Render thread, between frames. Takes the
+ *              command waiting, if any. It must be answered
+ *              with controlDone() before the next poll.
+ *
+ * Returns: no. of words, 0 if there is no command.
+ *
+ ***********************************************************/
+int controlPoll(CONTROL_T *ctl, char **argv)
+{
+    char *p, *save = NULL ;
+    int argc = 0 ;
+
+    if ( ctl == NULL || !__atomic_load_n( &ctl->pending, __ATOMIC_ACQUIRE ) ) return 0 ;
+
+    logInfo("Control: '%s'.\n",ctl->line) ;
+    ctl->commands++ ;
+    for ( p = strtok_r(ctl->line, " \t", &save) ; p && argc < CONTROL_MAX_ARGS ;
+          p = strtok_r(NULL, " \t", &save) )
+        argv[argc++] = p ;
+
+    return argc ;
+
+} // controlPoll
+
+
+
+// Append to the answer of the command in hand.
+void controlReply(CONTROL_T *ctl, const char *fmt, ...)
+{
+    int room = CONTROL_MAX_REPLY - STATUS_SPACE - ctl->replyLength ;
+    va_list ap ;
+    int n ;
+
+    if ( room <= 1 ) return ;
+
+    va_start(ap, fmt) ;
+    n = vsnprintf(ctl->reply + ctl->replyLength, room, fmt, ap) ;
+    va_end(ap) ;
+    ctl->replyLength += ( n < room ) ? n : room - 1 ;
+
+} // controlReply
+
+
+
+// The command in hand is done, send the answer and its status.
+void controlDone(CONTROL_T *ctl, int ok)
+{
+    if ( ctl == NULL ) return ;
+
+    pthread_mutex_lock( &ctl->lock ) ;
+    ctl->replyLength += snprintf(ctl->reply + ctl->replyLength, STATUS_SPACE, "%s\n",
+                                 ok ? "ok" : "error") ;
+    ctl->pending = 0 ;
+    pthread_cond_signal( &ctl->done ) ;
+    pthread_mutex_unlock( &ctl->lock ) ;
+
+} // controlDone
+
+
+
+// An eventfd to write when a command is pending, -1 for none.
+void controlNotify(CONTROL_T *ctl, int fd)
+{
+    if ( ctl == NULL ) return ;
+
+    pthread_mutex_lock( &ctl->lock ) ;
+    ctl->notifyFd = fd ;
+    pthread_mutex_unlock( &ctl->lock ) ;
+
+} // controlNotify
+
+
+
+// Stop the thread, close the clients and remove the socket.
+void controlStop(CONTROL_T *ctl)
+{
+    uint64_t one = 1 ;
+    int i ;
+
+    if ( ctl == NULL ) return ;
+
+    pthread_mutex_lock( &ctl->lock ) ;
+    ctl->stopping = 1 ;
+    pthread_cond_signal( &ctl->done ) ;
+    pthread_mutex_unlock( &ctl->lock ) ;
+    if ( write( ctl->wakeFd, &one, sizeof( one ) ) != sizeof( one ) )
+        logWarn("Control: Unable to wake the listener, %s.\n",strerror(errno)) ;
+    pthread_join( ctl->thread, NULL ) ;
+
+    logInfo("Control: %lu commands.\n",ctl->commands) ;
+
+    for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i )
+        if ( ctl->client[i].fd >= 0 ) close( ctl->client[i].fd ) ;
+    close( ctl->listenFd ) ;
+    close( ctl->wakeFd ) ;
+    unlink( ctl->path ) ;
+    pthread_mutex_destroy( &ctl->lock ) ;
+    pthread_cond_destroy( &ctl->done ) ;
+    free( ctl ) ;
+
+} // controlStop
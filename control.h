@@ -0,0 +1,78 @@
+
+/* ************************************************************************* *
+
+  Module Name : control.h
+
+  Description : Control socket. A Unix domain stream socket served by a
+    thread of its own takes one command a line from any number of local
+    clients (socat, nc -U, scripts) and hands each to the render thread,
+    which applies it between frames and answers. The answer is any lines
+    of text followed by a line "ok" or "error". The render thread only
+    checks a flag each frame, all socket work is on the control thread.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+#include <pthread.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define CONTROL_MAX_CLIENTS    8
+#define CONTROL_MAX_LINE     256          // Command, longer lines are dropped.
+#define CONTROL_MAX_REPLY   4096          // Answer, longer answers are cut.
+#define CONTROL_MAX_ARGS       8          // Words of a command.
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    int         fd ;            // -1 if unused
+    char        line[CONTROL_MAX_LINE] ;
+    int         length ;        // bytes in line
+    int         discarding ;    // dropping the rest of a line too long
+} CONTROL_CLIENT_T ;
+
+typedef struct {
+    char        path[108] ;     // sun_path
+    int         listenFd ;
+    int         wakeFd ;        // eventfd, stops the thread
+    int         notifyFd ;      // eventfd written when a line is pending, -1 none
+    pthread_t   thread ;
+    CONTROL_CLIENT_T client[CONTROL_MAX_CLIENTS] ;
+
+    // The command in hand. The control thread fills in line and sets
+    // pending, the render thread answers in reply and clears it.
+    pthread_mutex_t lock ;
+    pthread_cond_t done ;
+    int         pending ;
+    int         stopping ;
+    char        line[CONTROL_MAX_LINE] ;
+    char        reply[CONTROL_MAX_REPLY] ;
+    int         replyLength ;
+    unsigned long commands ;
+} CONTROL_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+CONTROL_T *controlStart(const char *path) ;
+
+int controlPoll(CONTROL_T *ctl, char **argv) ;
+
+void controlReply(CONTROL_T *ctl, const char *fmt, ...) __attribute__(( format( printf, 2, 3 ) )) ;
+
+void controlDone(CONTROL_T *ctl, int ok) ;
+
+void controlNotify(CONTROL_T *ctl, int fd) ;
+
+void controlStop(CONTROL_T *ctl) ;
+
+#endif // __CONTROL_H__
@@ -0,0 +1,231 @@
+
+/*
+  This module keeps the damage of the next frame and the render on
+  demand sleep.
+
+  Rectangles are clipped to the window as they are added. One covering
+  the window makes the frame fully damaged, and past DAMAGE_MAX_RECTS
+  they are merged into their bounding box, so the list handed to the
+  swap stays short. damageTake() returns none for a fully damaged frame,
+  the caller then swaps as usual.
+
+  damageWait() sleeps in poll() on the eventfd, which the input, control
+  and shader watcher threads write when they have something for the
+  render thread. Reading it clears the count, so a burst of writes is one
+  wake. The eventfd only wakes the loop, the loop then takes the input or
+  command as it does every frame and decides what is damaged.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "damage.h"
+#include "utils.h"
+#include "log.h"
+#include "profile.h"
+
+
+
+// Damage of a window, the first frame fully damaged. NULL if out of
+// memory or the eventfd can't be made.
+DAMAGE_T *damageCreate(int width, int height)
+{
+    DAMAGE_T *d = calloc( 1, sizeof( DAMAGE_T ) ) ;
+
+    if ( d == NULL ) {
+        logError("Damage: Out of memory!\n") ;
+        return NULL ;
+    }
+    d->wakeFd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK ) ;
+    if ( d->wakeFd < 0 ) {
+        logWarn("Damage: Unable to create the wake eventfd, %s.\n",strerror(errno)) ;
+        free( d ) ;
+        return NULL ;
+    }
+    d->width = width ;
+    d->height = height ;
+    d->full = 1 ;
+
+    return d ;
+
+} // damageCreate
+
+
+
+void damageAll(DAMAGE_T *d)
+{
+    if ( d == NULL ) return ;
+    d->full = 1 ;
+    d->nrects = 0 ;
+} // damageAll
+
+
+
+/***********************************************************
+ * Name: damageRect
+ *
+ * Arguments:
+ *     d      - damage, may be NULL.
+ *     x, y   - bottom left corner, window pixels.
+ *     width  - size.
+ *     height
+ *
+ * Description: Marks a rectangle of the next frame changed.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void damageRect(DAMAGE_T *d, int x, int y, int width, int height)
+{
+    EGLint *r ;
+    int x1, y1, i ;
+
+    if ( d == NULL || d->full ) return ;
+
+    x1 = x + width ;
+    y1 = y + height ;
+    if ( x < 0 ) x = 0 ;
+    if ( y < 0 ) y = 0 ;
+    if ( x1 > d->width ) x1 = d->width ;
+    if ( y1 > d->height ) y1 = d->height ;
+    if ( x1 <= x || y1 <= y ) return ;
+
+    if ( x == 0 && y == 0 && x1 == d->width && y1 == d->height ) {
+        damageAll(d) ;
+        return ;
+    }
+
+    // Full, merge them all into their bounding box.
+    if ( d->nrects == DAMAGE_MAX_RECTS ) {
+        for ( i = 0 ; i < d->nrects ; ++i ) {
+            r = &d->rect[i * 4] ;
+            if ( r[0] < x ) x = r[0] ;
+            if ( r[1] < y ) y = r[1] ;
+            if ( r[0] + r[2] > x1 ) x1 = r[0] + r[2] ;
+            if ( r[1] + r[3] > y1 ) y1 = r[1] + r[3] ;
+        }
+        d->nrects = 0 ;
+    }
+
+    r = &d->rect[d->nrects++ * 4] ;
+    r[0] = x ;
+    r[1] = y ;
+    r[2] = x1 - x ;
+    r[3] = y1 - y ;
+
+} // damageRect
+
+
+
+// Does the next frame need drawing? Always, without damage tracking.
+int damagePending(const DAMAGE_T *d)
+{
+    return d == NULL || d->animating || d->full || d->nrects > 0 ;
+} // damagePending
+
+
+
+/***********************************************************
+ * Name: damageWait
+ *
+ * Arguments:
+ *     d         - damage.
+ *     timeoutUs - longest sleep, the next timer due.
+ *
+ * Description: Render thread, nothing pending. Sleeps until
+ *              another thread writes the eventfd or the time
+ *              is up.
+ *
+ * Returns: 1 if woken by a write, 0 if the time was up.
+ *
+ ***********************************************************/
+int damageWait(DAMAGE_T *d, double timeoutUs)
+{
+    struct pollfd pfd ;
+    uint64_t count ;
+    double start = nowus() ;
+    int n ;
+
+    pfd.fd = d->wakeFd ;
+    pfd.events = POLLIN ;
+
+    PROF_BEGIN("damageWait") ;
+    do {
+        n = poll( &pfd, 1, timeoutUs > 0.0 ? (int) ceil( timeoutUs / 1000.0 ) : 0 ) ;
+    } while ( n < 0 && errno == EINTR ) ;
+    if ( n > 0 && read( d->wakeFd, &count, sizeof( count ) ) != sizeof( count ) ) n = 0 ;
+    PROF_END("damageWait") ;
+
+    d->waits++ ;
+    d->idleUs += nowus() - start ;
+    if ( n > 0 ) d->wakes++ ;
+
+    return n > 0 ;
+
+} // damageWait
+
+
+
+/***********************************************************
+ * Name: damageTake
+ *
+ * Arguments:
+ *     d     - damage, may be NULL.
+ *     rects - DAMAGE_MAX_RECTS * 4 EGLints, for
+ *             esSwapBuffersWithDamage().
+ *
+ * Description: Just before the swap. Takes the frame's damage,
+ *              the next frame starts with none.
+ *
+ * Returns: no. of rectangles, 0 if the whole window.
+ *
+ ***********************************************************/
+int damageTake(DAMAGE_T *d, EGLint *rects)
+{
+    double pixels = 0.0 ;
+    int i, n ;
+
+    if ( d == NULL ) return 0 ;
+
+    n = ( d->full || d->nrects == 0 ) ? 0 : d->nrects ;
+    for ( i = 0 ; i < n * 4 ; ++i ) rects[i] = d->rect[i] ;
+    for ( i = 0 ; i < n ; ++i ) pixels += (double) d->rect[i * 4 + 2] * d->rect[i * 4 + 3] ;
+
+    d->frames++ ;
+    if ( n > 0 ) {
+        d->partial++ ;
+        d->area += pixels / ( (double) d->width * d->height ) ;
+    }
+    else
+        d->area += 1.0 ;
+
+    d->full = 0 ;
+    d->nrects = 0 ;
+    return n ;
+
+} // damageTake
+
+
+
+void damageDestroy(DAMAGE_T *d)
+{
+    if ( d == NULL ) return ;
+
+    logInfo("Damage: %lu frames drawn, %lu with rectangles, %.1f%% of the window on average.\n",
+            d->frames,d->partial,d->frames ? 100.0 * d->area / d->frames : 0.0) ;
+    logInfo("Damage: Idle %.3fs in %lu waits, %lu woken by input, commands or edits.\n",
+            d->idleUs / 1000000.0,d->waits,d->wakes) ;
+
+    close( d->wakeFd ) ;
+    free( d ) ;
+
+} // damageDestroy
@@ -0,0 +1,71 @@
+
+/* ************************************************************************* *
+
+  Module Name : damage.h
+
+  Description : Render on demand. A frame is only drawn when something
+    in it changed : the scene is animating, the routine marked part of
+    the window damaged, or input, a command or an edited shader woke the
+    loop and marked it all. Otherwise the render thread sleeps on an
+    eventfd that those threads write, or until a timer is due, and the
+    GPU idles. The damaged rectangles of a frame are handed to the swap,
+    where EGL_KHR_swap_buffers_with_damage lets the display update only
+    those.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __DAMAGE_H__
+#define __DAMAGE_H__
+
+#include <EGL/egl.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define DAMAGE_MAX_RECTS      4           // More are merged into one.
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    int         wakeFd ;        // eventfd, written by other threads
+    int         width ;         // window
+    int         height ;
+    int         animating ;     // every frame changes, always pending
+    int         full ;          // the whole window is damaged
+
+    // x, y, width, height from the bottom left, as EGL has them.
+    EGLint      rect[DAMAGE_MAX_RECTS * 4] ;
+    int         nrects ;
+
+    unsigned long frames ;      // drawn
+    unsigned long partial ;     // of which swapped with rectangles
+    unsigned long waits ;       // times the loop slept
+    unsigned long wakes ;       // of which woken by another thread
+    double      idleUs ;        // slept
+    double      area ;          // sum of the frames' damaged fraction
+} DAMAGE_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+DAMAGE_T *damageCreate(int width, int height) ;
+
+void damageAll(DAMAGE_T *d) ;
+
+void damageRect(DAMAGE_T *d, int x, int y, int width, int height) ;
+
+int damagePending(const DAMAGE_T *d) ;
+
+int damageWait(DAMAGE_T *d, double timeoutUs) ;
+
+int damageTake(DAMAGE_T *d, EGLint *rects) ;
+
+void damageDestroy(DAMAGE_T *d) ;
+
+#endif // __DAMAGE_H__
@@ -0,0 +1,343 @@
+
+/*
+  This module streams per-frame geometry through a small ring of VBOs.
+
+  Each frame starts on the next VBO of the ring and allocations are
+  carved from it linearly, so the GPU can still be reading the last
+  frame's VBO while this one is written. How a VBO is refilled is a
+  driver trade off :
+    orphan  - glBufferData(NULL) gives a fresh store, then glBufferSubData.
+    subdata - glBufferSubData only, relying on the ring to avoid stalls.
+    map     - orphan, then map and write in place (one copy).
+  In map mode only the allocation's range is mapped, unsynchronized,
+  with GL_EXT_map_buffer_range. The VBO was orphaned as the frame took
+  it and the range is past anything drawn from it, so there is nothing
+  to wait for. Without it glMapBufferOES maps the whole VBO, which waits
+  for the draws already made from it this frame.
+
+  dynbufBenchmark() times each on the current platform, drawing points
+  from every allocation as a frame does, so a mode that makes the
+  upload wait for the GPU is seen to.
+
+  Client arrays are copied by the driver on every draw anyway, this makes
+  that copy explicit, sized and counted.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+
+#include "dynbuf.h"
+#include "utils.h"
+#include "ESUtil.h"
+#include "log.h"
+#include "glcount.h"
+#include "gltrace.h"
+
+
+
+#define BENCH_FRAMES      16      // Frames timed per mode.
+#define BENCH_CHUNKS      32      // Allocations per frame.
+#define BENCH_POINTS      64      // Drawn from each.
+#define BENCH_DRAWN       ( BENCH_POINTS * 4 )    // Bytes read by the draw, zero.
+
+
+static const char *modeNames[DYNBUF_NMODES] = { "auto", "orphan", "subdata", "map" } ;
+
+static PFNGLMAPBUFFEROESPROC   mapBuffer = NULL ;
+static PFNGLUNMAPBUFFEROESPROC unmapBuffer = NULL ;
+static PFNGLMAPBUFFERRANGEEXTPROC mapBufferRange = NULL ;
+
+
+
+// Is GL_OES_mapbuffer usable? Looks the entry points up once, and
+// glMapBufferRangeEXT, which unmaps with glUnmapBufferOES.
+static int haveMapBuffer(void)
+{
+    static int checked = 0 ;
+    const char *ext ;
+
+    if ( !checked ) {
+        checked = 1 ;
+        ext = (const char *) glGetString(GL_EXTENSIONS) ;
+        if ( ext && strstr(ext, "GL_OES_mapbuffer") ) {
+            mapBuffer = (PFNGLMAPBUFFEROESPROC) eglGetProcAddress("glMapBufferOES") ;
+            unmapBuffer = (PFNGLUNMAPBUFFEROESPROC) eglGetProcAddress("glUnmapBufferOES") ;
+            if ( strstr(ext, "GL_EXT_map_buffer_range") )
+                mapBufferRange = (PFNGLMAPBUFFERRANGEEXTPROC) eglGetProcAddress("glMapBufferRangeEXT") ;
+        }
+    }
+    return mapBuffer != NULL && unmapBuffer != NULL ;
+} // haveMapBuffer
+
+
+
+const char *dynbufModeName(int mode)
+{
+    return ( mode >= 0 && mode < DYNBUF_NMODES ) ? modeNames[mode] : "?" ;
+} // dynbufModeName
+
+
+
+// Mode from its name (or number), -1 if unknown.
+int dynbufModeFromName(const char *name)
+{
+    int mode ;
+
+    for ( mode = 0 ; mode < DYNBUF_NMODES ; ++mode )
+        if ( strcmp(name, modeNames[mode]) == 0 ) return mode ;
+    mode = atoi(name) ;
+    return ( mode >= 0 && mode < DYNBUF_NMODES && name[0] >= '0' && name[0] <= '9' ) ? mode : -1 ;
+} // dynbufModeFromName
+
+
+
+/***********************************************************
+ * Name: dynbufInit
+ *
+ * Arguments:
+ *     db       - buffer ring to set up.
+ *     target   - GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER.
+ *     size     - bytes per VBO, 0 for default.
+ *     nbuffers - VBOs in the ring, 0 for default.
+ *     mode     - DYNBUF_ORPHAN/SUBDATA/MAP or DYNBUF_AUTO.
+ *
+ * Description: Creates the VBOs. A GL context must be current.
+ *              DYNBUF_MAP falls back to DYNBUF_ORPHAN without
+ *              GL_OES_mapbuffer.
+ *
+ * Returns: mode in use.
+ *
+ ***********************************************************/
+int dynbufInit(DYNBUF_T *db, GLenum target, GLsizeiptr size, int nbuffers, int mode)
+{
+    int i ;
+
+    memset( db, 0, sizeof( DYNBUF_T ) ) ;
+    db->target = target ;
+    db->size = ( size > 0 ) ? size : DYNBUF_DEF_SIZE ;
+    db->nbuffers = ( nbuffers > 0 ) ? nbuffers : DYNBUF_DEF_BUFFERS ;
+    if ( db->nbuffers > DYNBUF_MAX_BUFFERS ) db->nbuffers = DYNBUF_MAX_BUFFERS ;
+
+    if ( mode == DYNBUF_AUTO ) mode = dynbufBenchmark(target, db->size) ;
+    if ( mode == DYNBUF_MAP && !haveMapBuffer() ) mode = DYNBUF_ORPHAN ;
+    db->mode = mode ;
+
+    glGenBuffers( db->nbuffers, db->vboIds ) ;
+    for ( i = 0 ; i < db->nbuffers ; ++i ) {
+        glBindBuffer( target, db->vboIds[i] ) ;
+        glBufferData( target, db->size, NULL, GL_STREAM_DRAW ) ;
+    }
+    db->current = 0 ;
+    db->offset = 0 ;
+
+    return db->mode ;
+
+} // dynbufInit
+
+
+
+// Move to the next VBO of the ring, orphaning it if the mode says so.
+static void nextBuffer(DYNBUF_T *db)
+{
+    db->current = ( db->current + 1 ) % db->nbuffers ;
+    db->offset = 0 ;
+
+    glBindBuffer( db->target, db->vboIds[db->current] ) ;
+    if ( db->mode != DYNBUF_SUBDATA )
+        glBufferData( db->target, db->size, NULL, GL_STREAM_DRAW ) ;
+} // nextBuffer
+
+
+
+// Call at the start of every frame.
+void dynbufNextFrame(DYNBUF_T *db)
+{
+    nextBuffer(db) ;
+} // dynbufNextFrame
+
+
+
+/***********************************************************
+ * Name: dynbufAlloc
+ *
+ * Arguments:
+ *     db     - buffer ring.
+ *     data   - bytes to stream.
+ *     bytes  - size of data.
+ *     offset - returns the byte offset of the data in the VBO.
+ *
+ * Description: Copies the data into the current VBO, moving on
+ *              round the ring if it is full. The VBO is left
+ *              bound to db->target, ready for
+ *              glVertexAttribPointer/glDrawElements at 'offset'.
+ *
+ * Returns: VBO id, 0 if the data is larger than a VBO.
+ *
+ ***********************************************************/
+GLuint dynbufAlloc(DYNBUF_T *db, const void *data, GLsizeiptr bytes, GLintptr *offset)
+{
+    GLsizeiptr aligned = ( bytes + DYNBUF_ALIGN - 1 ) & ~( DYNBUF_ALIGN - 1 ) ;
+    char *p = NULL ;
+
+    if ( aligned > db->size ) return 0 ;
+
+    if ( db->offset + aligned > db->size ) {
+        nextBuffer(db) ;
+        db->wraps++ ;
+    } else
+        glBindBuffer( db->target, db->vboIds[db->current] ) ;
+
+    *offset = db->offset ;
+
+    // Only this allocation's range, nothing has drawn from it, see above.
+    if ( db->mode == DYNBUF_MAP ) {
+        if ( mapBufferRange )
+            p = mapBufferRange( db->target, db->offset, bytes, GL_MAP_WRITE_BIT_EXT |
+                                GL_MAP_INVALIDATE_RANGE_BIT_EXT | GL_MAP_UNSYNCHRONIZED_BIT_EXT ) ;
+        else if ( ( p = mapBuffer( db->target, GL_WRITE_ONLY_OES ) ) != NULL )
+            p += db->offset ;
+    }
+    if ( p ) {
+        memcpy( p, data, bytes ) ;
+        unmapBuffer( db->target ) ;
+    } else
+        glBufferSubData( db->target, db->offset, bytes, data ) ;
+
+    db->offset += aligned ;
+    db->bytes += bytes ;
+
+    return db->vboIds[db->current] ;
+
+} // dynbufAlloc
+
+
+
+// Points at the origin, read from the streamed buffer, so each
+// allocation has a draw depending on it. Drawn into the back buffer
+// before the first frame clears it.
+static const char benchVertex[] =
+    "attribute vec4 a_position;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = a_position;\n"
+    "    gl_PointSize = 1.0;\n"
+    "}\n" ;
+
+static const char benchFragment[] =
+    "precision mediump float;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4(0.0);\n"
+    "}\n" ;
+
+// Draw from an allocation : its bytes as vertices, or as indices into
+// the one zeroed client side vertex. The bytes drawn are kept zero, so
+// every index is 0.
+static void benchDraw(GLenum target, GLint loc, GLintptr offset, const GLubyte *zeros)
+{
+    if ( target == GL_ELEMENT_ARRAY_BUFFER ) {
+        glVertexAttribPointer( loc, 4, GL_UNSIGNED_BYTE, GL_FALSE, 0, zeros ) ;
+        glDrawElements( GL_POINTS, BENCH_POINTS, GL_UNSIGNED_SHORT, (const void *) offset ) ;
+    } else {
+        glVertexAttribPointer( loc, 4, GL_UNSIGNED_BYTE, GL_FALSE, 0, (const void *) offset ) ;
+        glDrawArrays( GL_POINTS, 0, BENCH_POINTS ) ;
+    }
+} // benchDraw
+
+
+
+/***********************************************************
+ * Name: dynbufBenchmark
+ *
+ * Arguments:
+ *     target - buffer target to test.
+ *     size   - bytes per VBO.
+ *
+ * Description: Streams the same data through a ring in each
+ *              mode, drawing from every allocation, and times
+ *              it to glFinish(). A GL context must be current,
+ *              its program and buffer bindings are put back.
+ *
+ * Returns: quickest mode.
+ *
+ ***********************************************************/
+int dynbufBenchmark(GLenum target, GLsizeiptr size)
+{
+    GLsizeiptr chunk = ( size > 0 ? size : DYNBUF_DEF_SIZE ) / ( BENCH_CHUNKS / 2 ) ;
+    double t, best = 1e30 ;
+    int mode, bestMode = DYNBUF_ORPHAN ;
+    int frame, i ;
+    char *data ;
+    GLubyte zeros[4] = { 0 } ;
+    GLint oldProgram, oldArray, oldElements, oldEnabled, loc ;
+    GLuint program ;
+    GLintptr offset ;
+    DYNBUF_T db ;
+
+    if ( chunk < BENCH_DRAWN + BENCH_CHUNKS ) chunk = BENCH_DRAWN + BENCH_CHUNKS ;
+    data = calloc( 1, chunk ) ;
+    program = esLoadProgram(benchVertex, benchFragment) ;
+    if ( data == NULL || program == 0 ) {
+        logWarn("Dynbuf: Unable to set up the timing, using %s.\n",modeNames[bestMode]) ;
+        free( data ) ;
+        return bestMode ;
+    }
+    glGetIntegerv( GL_CURRENT_PROGRAM, &oldProgram ) ;
+    glGetIntegerv( GL_ARRAY_BUFFER_BINDING, &oldArray ) ;
+    glGetIntegerv( GL_ELEMENT_ARRAY_BUFFER_BINDING, &oldElements ) ;
+    loc = glGetAttribLocation( program, "a_position" ) ;
+    glGetVertexAttribiv( loc, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &oldEnabled ) ;
+    glUseProgram( program ) ;
+    glEnableVertexAttribArray( loc ) ;
+
+    logInfo("Dynbuf: Timing %d x %ldKB per frame :",BENCH_CHUNKS,(long) chunk >> 10) ;
+    for ( mode = DYNBUF_ORPHAN ; mode < DYNBUF_NMODES ; ++mode ) {
+        if ( mode == DYNBUF_MAP && !haveMapBuffer() ) continue ;
+
+        dynbufInit(&db, target, size, 0, mode) ;
+        if ( target == GL_ELEMENT_ARRAY_BUFFER ) glBindBuffer( GL_ARRAY_BUFFER, 0 ) ;
+        glFinish() ;
+        t = nowus() / 1000.0 ;
+        for ( frame = 0 ; frame < BENCH_FRAMES ; ++frame ) {
+            dynbufNextFrame(&db) ;
+            for ( i = 0 ; i < BENCH_CHUNKS ; ++i ) {
+                data[BENCH_DRAWN + i] = (char) frame ;   // Past what is drawn.
+                if ( dynbufAlloc(&db, data, chunk, &offset) ) benchDraw(target, loc, offset, zeros) ;
+            }
+        }
+        glFinish() ;
+        t = nowus() / 1000.0 - t ;
+        dynbufFree(&db) ;
+
+        logInfo(" %s %.2fms",modeNames[mode],t) ;
+        if ( t < best ) {
+            best = t ;
+            bestMode = mode ;
+        }
+    }
+    logInfo(" -> %s.\n",modeNames[bestMode]) ;
+
+    if ( !oldEnabled ) glDisableVertexAttribArray( loc ) ;
+    glBindBuffer( GL_ARRAY_BUFFER, oldArray ) ;
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, oldElements ) ;
+    glUseProgram( oldProgram ) ;
+    glDeleteProgram( program ) ;
+    free( data ) ;
+    return bestMode ;
+
+} // dynbufBenchmark
+
+
+
+void dynbufFree(DYNBUF_T *db)
+{
+    if ( db->nbuffers > 0 ) glDeleteBuffers( db->nbuffers, db->vboIds ) ;
+    db->nbuffers = 0 ;
+} // dynbufFree
+
@@ -0,0 +1,72 @@
+
+/* ************************************************************************* *
+
+  Module Name : dynbuf.h
+
+  Description : Streaming vertex/index buffers for geometry that changes
+    every frame. A ring of VBOs is filled by a linear allocator using
+    buffer orphaning, glBufferSubData or glMapBufferOES (GL_OES_mapbuffer,
+    as advertised on the Pi), whichever a start up micro-benchmark finds
+    quickest, instead of handing client arrays to the driver.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __DYNBUF_H__
+#define __DYNBUF_H__
+
+#include <GLES2/gl2.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define DYNBUF_MAX_BUFFERS     4          // Max. VBOs in the ring.
+#define DYNBUF_DEF_BUFFERS     3          // Frames in flight.
+#define DYNBUF_DEF_SIZE   (256 << 10)     // Default bytes per VBO.
+#define DYNBUF_ALIGN           4          // Allocation alignment.
+
+// Upload modes.
+#define DYNBUF_AUTO            0          // Pick by dynbufBenchmark().
+#define DYNBUF_ORPHAN          1          // glBufferData(NULL) then glBufferSubData.
+#define DYNBUF_SUBDATA         2          // glBufferSubData round the ring.
+#define DYNBUF_MAP             3          // Map and write after orphaning.
+#define DYNBUF_NMODES          4
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    GLenum      target ;        // GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+    int         mode ;
+    GLsizeiptr  size ;          // bytes per VBO
+    int         nbuffers ;
+    GLuint      vboIds[DYNBUF_MAX_BUFFERS] ;
+    int         current ;       // ring index in use
+    GLsizeiptr  offset ;        // next free byte in the current VBO
+    unsigned long bytes ;       // bytes streamed (for stats)
+    unsigned long wraps ;       // times a VBO filled in one frame
+} DYNBUF_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+int dynbufInit(DYNBUF_T *db, GLenum target, GLsizeiptr size, int nbuffers, int mode) ;
+
+int dynbufBenchmark(GLenum target, GLsizeiptr size) ;
+
+void dynbufNextFrame(DYNBUF_T *db) ;
+
+GLuint dynbufAlloc(DYNBUF_T *db, const void *data, GLsizeiptr bytes, GLintptr *offset) ;
+
+const char *dynbufModeName(int mode) ;
+
+int dynbufModeFromName(const char *name) ;
+
+void dynbufFree(DYNBUF_T *db) ;
+
+#endif // __DYNBUF_H__
+
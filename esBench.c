@@ -0,0 +1,817 @@
+/*
+   Scene benchmark, run with 'make bench'. A matrix of scenes is drawn in
+   one EGL context and the results, with the host and the GL renderer,
+   are written to a JSON file that benchcmp.bin compares with a stored
+   baseline.
+
+   The axes of the matrix are the object count, the sphere slices (0 = a
+   cube), the texture size (0 = vertex colours only), the vertex format
+   (floats, or normalised shorts and bytes) and where the vertices come
+   from (VBOs or client arrays). Every object is the same mesh with its
+   own MVP and one glDrawElements(). Each case runs for a warm-up period
+   and then for a fixed duration, timed with the same frame statistics
+   as esTri.
+
+   The JSON file has one case per line, so benchcmp.bin and diff can
+   read it without a JSON parser.
+
+  18/10/26 v1.0 Scene matrix, JSON results with host/GL metadata.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "ESUtil.h"
+#include "utils.h"
+#include "framestats.h"
+#include "vbopool.h"
+
+#define VERSION  "esBench v1.0: "
+
+#define MICRO         1000000.0       // Microseconds in a second.
+
+#define DEF_WARMUP          1.0       // Default warm-up per case in seconds.
+#define DEF_DURATION        3.0       // Default timed period per case.
+#define DEF_OUTPUT    "bench.json"
+
+// Matrix axes.
+#define AXIS_OBJECTS        0
+#define AXIS_SLICES         1         // 0 = cube
+#define AXIS_TEXTURE        2         // pixels square, 0 = none
+#define AXIS_FORMAT         3
+#define AXIS_ARRAYS         4
+#define NAXES               5
+
+#define MAXVALUES          16         // Values per axis.
+
+// Vertex formats.
+#define FORMAT_FLOAT        0         // 3 + 2 + 3 floats, 32 bytes.
+#define FORMAT_PACKED       1         // 4 shorts, 2 ushorts, 4 ubytes, 16 bytes.
+
+// Vertex sources.
+#define ARRAYS_VBO          0
+#define ARRAYS_CLIENT       1
+
+#define CAMERA_DISTANCE  5.0f
+#define GRID_HALF        2.0f         // Objects fill [-2,2] square at z=0.
+
+#define BUF_OFFSET(i)   ((void *)(i))
+
+
+typedef struct {
+    const char *name ;
+    const char *option ;       // getopt letter
+    const char *defaults ;
+    const char *names[3] ;     // value names, else numbers
+    int      value[MAXVALUES] ;
+    int      n ;
+} AXIS_T ;
+
+typedef struct {
+    GLuint   id ;
+    GLint    positionLoc ;
+    GLint    texCoordLoc ;
+    GLint    colourLoc ;
+    GLint    mvpLoc ;
+    GLint    samplerLoc ;
+} PROGRAM_T ;
+
+typedef struct {
+    int      v[NAXES] ;
+    char     name[64] ;
+
+    GLuint   nv ;              // no. of vertices
+    GLuint   ni ;              // no. of indices
+    unsigned char *vertices ;  // interleaved
+    GLushort *indices ;
+    GLsizei  stride ;
+    VBOPOOL_T vpool ;
+    VBOPOOL_T ipool ;
+    int      pools ;           // vpool and ipool initialised
+    int      vbo ;             // pool handles, -1 = none
+    int      ibo ;
+    GLuint   textureId ;
+    PROGRAM_T *program ;
+    ESMatrix projMat ;
+    ESMatrix *mvp ;            // per object
+} SCENE_T ;
+
+typedef struct {
+    double   warmup ;          // seconds
+    double   duration ;
+    char    *outName ;
+    int      listOnly ;        // -L
+    int      winWidth ;        // Window size, 0 = default.
+    int      winHeight ;
+
+    PROGRAM_T coloured ;
+    PROGRAM_T textured ;
+    FILE    *out ;
+    int      ncases ;
+    int      closed ;          // window closed, stop
+} BENCH_T ;
+
+
+ESContext esContext ;
+BENCH_T   bench ;
+
+static AXIS_T axes[NAXES] = {
+    { "objects", "n", "1,16,64",     { NULL } },
+    { "slices",  "l", "16,64,200",   { NULL } },
+    { "texture", "x", "0,256,1024",  { NULL } },
+    { "format",  "v", "float,packed", { "float", "packed", NULL } },
+    { "arrays",  "a", "vbo,client",  { "vbo", "client", NULL } },
+} ;
+
+
+
+//------------------------------------------------------------------------------
+
+
+static void usage(char *prog)
+{
+    int a ;
+
+    printf("Usage : %s [options]\n",prog) ;
+    printf("Runs every combination of the axes, each a comma separated list :\n") ;
+    for ( a = 0 ; a < NAXES ; ++a )
+        printf("  -%s <list>%*s%s (default %s).\n",axes[a].option,
+               (int) ( 11 - strlen(axes[a].name) ),"",axes[a].name,axes[a].defaults) ;
+    printf("Options :\n") ;
+    printf("  -w <s>         Warm-up per case (default %.1fs).\n",DEF_WARMUP) ;
+    printf("  -d <s>         Timed period per case (default %.1fs).\n",DEF_DURATION) ;
+    printf("  -o <file>      Results file (default %s).\n",DEF_OUTPUT) ;
+    printf("  -L             List the cases, run nothing.\n") ;
+    printf("  -p <platform>  Window system : %s\n",esPlatformNames()) ;
+    printf("                 (default $ES_PLATFORM, else the first).\n") ;
+    printf("  -H             Headless, the same as -p headless.\n") ;
+    printf("  -s <W>x<H>     Window/off screen size (default %dx%d).\n",
+           ES_WINDOW_DEF_WIDTH,ES_WINDOW_DEF_HEIGHT) ;
+    printf("Slices 0 is a cube, texture 0 is vertex colours only.\n") ;
+} // usage
+
+
+
+// Set an axis from a comma separated list of numbers or value names.
+static int parse_axis(AXIS_T *axis, const char *list)
+{
+    char *copy = strdup(list), *s, *save = NULL ;
+    int i ;
+
+    axis->n = 0 ;
+    for ( s = strtok_r(copy, ",", &save) ; s ; s = strtok_r(NULL, ",", &save) ) {
+        if ( axis->n >= MAXVALUES ) break ;
+        if ( axis->names[0] ) {
+            for ( i = 0 ; axis->names[i] ; ++i )
+                if ( strcmp(s, axis->names[i]) == 0 ) break ;
+            if ( axis->names[i] == NULL ) {
+                printf(VERSION "Unknown %s '%s'.\n",axis->name,s) ;
+                free( copy ) ;
+                return 0 ;
+            }
+        } else
+            i = atoi(s) ;
+        axis->value[axis->n++] = i ;
+    }
+    free( copy ) ;
+    return axis->n > 0 ;
+
+} // parse_axis
+
+
+
+static void parse(int argc, char **argv, BENCH_T *bp)
+{
+    char *prog = argv[0] ;
+    int opt, a ;
+
+    bp->warmup = DEF_WARMUP ;
+    bp->duration = DEF_DURATION ;
+    bp->outName = DEF_OUTPUT ;
+    for ( a = 0 ; a < NAXES ; ++a )
+        parse_axis(&axes[a], axes[a].defaults) ;
+
+    while ( ( opt = getopt(argc, argv, "n:l:x:v:a:w:d:o:Lp:Hs:") ) != -1 ) {
+        for ( a = 0 ; a < NAXES ; ++a )
+            if ( opt == axes[a].option[0] ) break ;
+        if ( a < NAXES ) {
+            if ( !parse_axis(&axes[a], optarg) ) exit(1) ;
+            continue ;
+        }
+        switch ( opt ) {
+            case 'w' :
+                bp->warmup = atof(optarg) ;
+                break ;
+            case 'd' :
+                bp->duration = atof(optarg) ;
+                break ;
+            case 'o' :
+                bp->outName = optarg ;
+                break ;
+            case 'L' :
+                bp->listOnly = 1 ;
+                break ;
+            case 'p' :
+                if ( !esSetPlatform(&esContext, optarg) ) exit(1) ;
+                break ;
+            case 'H' :
+                esSetPlatform(&esContext, "headless") ;
+                break ;
+            case 's' :
+                if ( sscanf(optarg, "%dx%d", &bp->winWidth, &bp->winHeight) != 2 ) {
+                    usage(prog) ;
+                    exit(1) ;
+                }
+                break ;
+            default :
+                usage(prog) ;
+                exit(1) ;
+        }
+    }
+    if ( optind < argc ) {
+        usage(prog) ;
+        exit(*argv[optind] == '?' ? 0 : 1) ;
+    }
+    if ( bp->duration <= 0.0 ) bp->duration = DEF_DURATION ;
+
+} // parse
+
+
+
+//------------------------------------------------------------------------------
+
+
+// The vertex colours, times a texture for the textured program.
+static int init_program(PROGRAM_T *pg, int textured)
+{
+    const char vShaderStr[] =
+        "attribute vec4 a_position;                   \n"
+        "attribute vec2 a_texcoord;                   \n"
+        "attribute vec4 a_colour;                     \n"
+        "uniform   mat4 MVP;                          \n"
+        "varying   vec2 v_texcoord;                   \n"
+        "varying   vec4 v_colour;                     \n"
+        "void main()                                  \n"
+        "{                                            \n"
+        "   v_texcoord = a_texcoord;                  \n"
+        "   v_colour = a_colour;                      \n"
+        "   gl_Position = MVP * vec4(a_position.xyz,1.0); \n"
+        "}                                            \n";
+    const char fColouredStr[] =
+        "precision mediump float;                     \n"
+        "varying   vec4 v_colour;                     \n"
+        "void main()                                  \n"
+        "{                                            \n"
+        "   gl_FragColor = v_colour;                  \n"
+        "}                                            \n";
+    const char fTexturedStr[] =
+        "precision mediump float;                     \n"
+        "varying   vec2 v_texcoord;                   \n"
+        "varying   vec4 v_colour;                     \n"
+        "uniform sampler2D s_texture;                 \n"
+        "void main()                                  \n"
+        "{                                            \n"
+        "   gl_FragColor = texture2D( s_texture, v_texcoord ) * v_colour;\n"
+        "}                                            \n";
+
+    pg->id = esLoadProgram((char *) vShaderStr, (char *) ( textured ? fTexturedStr : fColouredStr )) ;
+    if ( pg->id == 0 ) return 0 ;
+
+    pg->positionLoc = glGetAttribLocation( pg->id, "a_position" ) ;
+    pg->texCoordLoc = glGetAttribLocation( pg->id, "a_texcoord" ) ;
+    pg->colourLoc = glGetAttribLocation( pg->id, "a_colour" ) ;
+    pg->mvpLoc = glGetUniformLocation( pg->id, "MVP" ) ;
+    pg->samplerLoc = glGetUniformLocation( pg->id, "s_texture" ) ;
+    return 1 ;
+
+} // init_program
+
+
+
+// A size x size checker board, so every texel differs from its neighbours.
+// A checkered texture, 0 if out of memory.
+static GLuint init_texture(int size)
+{
+    unsigned char *image = malloc( size * size * 3 ), *p = image ;
+    GLuint textureId ;
+    int x, y ;
+
+    if ( image == NULL ) return 0 ;
+
+    for ( y = 0 ; y < size ; ++y )
+        for ( x = 0 ; x < size ; ++x, p += 3 ) {
+            p[0] = ( ( x ^ y ) & 8 ) ? 255 : 64 ;
+            p[1] = (unsigned char) x ;
+            p[2] = (unsigned char) y ;
+        }
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 ) ;
+    glGenTextures( 1, &textureId ) ;
+    glBindTexture( GL_TEXTURE_2D, textureId ) ;
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, size, size, 0, GL_RGB, GL_UNSIGNED_BYTE, image ) ;
+    // No mip-maps, so any size will do.
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR ) ;
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR ) ;
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE ) ;
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE ) ;
+
+    free( image ) ;
+    return textureId ;
+
+} // init_texture
+
+
+
+static float clamp01(float f)
+{
+    return f < 0.0f ? 0.0f : ( f > 1.0f ? 1.0f : f ) ;
+} // clamp01
+
+
+
+// Interleave the generated mesh in the case's vertex format. 0 if out
+// of memory.
+static int pack_vertices(SCENE_T *sc, const GLfloat *v, const GLfloat *t)
+{
+    unsigned char *p ;
+    GLuint i ;
+    int c ;
+
+    sc->stride = ( sc->v[AXIS_FORMAT] == FORMAT_FLOAT ) ? 8 * sizeof( GLfloat ) : 16 ;
+    sc->vertices = malloc( sc->nv * sc->stride ) ;
+    if ( sc->vertices == NULL ) return 0 ;
+
+    for ( i = 0, p = sc->vertices ; i < sc->nv ; ++i, p += sc->stride ) {
+        if ( sc->v[AXIS_FORMAT] == FORMAT_FLOAT ) {
+            GLfloat *f = (GLfloat *) p ;
+            f[0] = v[i * 3 + 0] ; f[1] = v[i * 3 + 1] ; f[2] = v[i * 3 + 2] ;
+            f[3] = clamp01(t[i * 2 + 0]) ; f[4] = clamp01(t[i * 2 + 1]) ;
+            for ( c = 0 ; c < 3 ; ++c )
+                f[5 + c] = urandom(255) / 255.0f ;
+        } else {
+            GLshort *s = (GLshort *) p ;
+            GLushort *u = (GLushort *) ( p + 8 ) ;
+            GLubyte *b = (GLubyte *) ( p + 12 ) ;
+            for ( c = 0 ; c < 3 ; ++c )
+                s[c] = (GLshort) lrintf( v[i * 3 + c] * 32767.0f ) ;
+            s[3] = 0 ;
+            u[0] = (GLushort) lrintf( clamp01(t[i * 2 + 0]) * 65535.0f ) ;
+            u[1] = (GLushort) lrintf( clamp01(t[i * 2 + 1]) * 65535.0f ) ;
+            for ( c = 0 ; c < 3 ; ++c )
+                b[c] = (GLubyte) urandom(255) ;
+            b[3] = 255 ;
+        }
+    }
+    return 1 ;
+
+} // pack_vertices
+
+
+
+// Build the case's mesh, buffers and texture. The same random colours
+// every run, so baselines compare like with like.
+static int init_scene(BENCH_T *bp, SCENE_T *sc)
+{
+    GLfloat *v = NULL, *t = NULL ;
+    int slices = sc->v[AXIS_SLICES] ;
+
+    sc->vbo = sc->ibo = -1 ;
+    srand(1) ;
+    if ( slices > 0 )
+        sc->ni = esGenSphere(slices,1.0f,&v,NULL,&t,&sc->indices,&sc->nv) ;
+    else
+        sc->ni = esGenCube(2.0f,&v,NULL,&t,&sc->indices,&sc->nv) ;
+    if ( sc->nv > 65535 ) {
+        printf(VERSION "%s: %d vertices, over the USHORT index limit.\n",sc->name,sc->nv) ;
+        free( v ) ; free( t ) ;
+        return 0 ;
+    }
+    if ( !pack_vertices(sc,v,t) ) {
+        printf(VERSION "%s: Out of memory for %d vertices.\n",sc->name,sc->nv) ;
+        free( v ) ; free( t ) ;
+        return 0 ;
+    }
+    free( v ) ;
+    free( t ) ;
+
+    if ( sc->v[AXIS_ARRAYS] == ARRAYS_VBO ) {
+        vbopoolInit(&sc->vpool, GL_ARRAY_BUFFER, sc->nv * sc->stride) ;
+        vbopoolInit(&sc->ipool, GL_ELEMENT_ARRAY_BUFFER, sc->ni * sizeof( GLushort )) ;
+        sc->pools = 1 ;
+        sc->vbo = vbopoolAlloc(&sc->vpool, sc->vertices, sc->nv * sc->stride) ;
+        sc->ibo = vbopoolAlloc(&sc->ipool, sc->indices, sc->ni * sizeof( GLushort )) ;
+        if ( sc->vbo < 0 || sc->ibo < 0 ) {
+            printf(VERSION "%s: Unable to allocate the VBOs.\n",sc->name) ;
+            return 0 ;
+        }
+    }
+
+    sc->program = &bp->coloured ;
+    if ( sc->v[AXIS_TEXTURE] > 0 ) {
+        sc->textureId = init_texture(sc->v[AXIS_TEXTURE]) ;
+        sc->program = &bp->textured ;
+        if ( sc->textureId == 0 ) {
+            printf(VERSION "%s: Out of memory for the texture.\n",sc->name) ;
+            return 0 ;
+        }
+    }
+
+    esMatrixLoadIdentity(&sc->projMat) ;
+    esPerspective(&sc->projMat,45.0f,(float) esContext.width / esContext.height,0.1f,100.0f) ;
+    sc->mvp = malloc( sc->v[AXIS_OBJECTS] * sizeof( ESMatrix ) ) ;
+    if ( sc->mvp == NULL ) {
+        printf(VERSION "%s: Out of memory for %d objects.\n",sc->name,sc->v[AXIS_OBJECTS]) ;
+        return 0 ;
+    }
+
+    return 1 ;
+
+} // init_scene
+
+
+
+static void free_scene(SCENE_T *sc)
+{
+    if ( sc->pools ) {
+        vbopoolDestroy(&sc->vpool) ;
+        vbopoolDestroy(&sc->ipool) ;
+        sc->pools = 0 ;
+    }
+    if ( sc->textureId ) glDeleteTextures( 1, &sc->textureId ) ;
+    free( sc->vertices ) ;
+    free( sc->indices ) ;
+    free( sc->mvp ) ;
+
+} // free_scene
+
+
+
+// Attribute pointers for the whole frame, every object is the same mesh.
+static const void *bind_scene(SCENE_T *sc)
+{
+    PROGRAM_T *pg = sc->program ;
+    const unsigned char *base = sc->vertices ;
+    const void *indices = sc->indices ;
+    int packed = ( sc->v[AXIS_FORMAT] == FORMAT_PACKED ) ;
+    GLintptr offset ;
+
+    glUseProgram( pg->id ) ;
+    if ( sc->vbo >= 0 ) {
+        glBindBuffer( GL_ARRAY_BUFFER, vbopoolBuffer(&sc->vpool, sc->vbo, &offset) ) ;
+        base = BUF_OFFSET(offset) ;
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, vbopoolBuffer(&sc->ipool, sc->ibo, &offset) ) ;
+        indices = BUF_OFFSET(offset) ;
+    } else {
+        glBindBuffer( GL_ARRAY_BUFFER, 0 ) ;
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 ) ;
+    }
+
+    glVertexAttribPointer( pg->positionLoc, 3, packed ? GL_SHORT : GL_FLOAT, packed,
+                           sc->stride, base ) ;
+    glEnableVertexAttribArray( pg->positionLoc ) ;
+    if ( pg->texCoordLoc >= 0 ) {
+        glVertexAttribPointer( pg->texCoordLoc, 2, packed ? GL_UNSIGNED_SHORT : GL_FLOAT, packed,
+                               sc->stride, base + ( packed ? 8 : 3 * sizeof( GLfloat ) ) ) ;
+        glEnableVertexAttribArray( pg->texCoordLoc ) ;
+    }
+    glVertexAttribPointer( pg->colourLoc, packed ? 4 : 3, packed ? GL_UNSIGNED_BYTE : GL_FLOAT, packed,
+                           sc->stride, base + ( packed ? 12 : 5 * sizeof( GLfloat ) ) ) ;
+    glEnableVertexAttribArray( pg->colourLoc ) ;
+
+    if ( sc->textureId ) {
+        glActiveTexture( GL_TEXTURE0 ) ;
+        glBindTexture( GL_TEXTURE_2D, sc->textureId ) ;
+        glUniform1i( pg->samplerLoc, 0 ) ;
+    }
+    return indices ;
+
+} // bind_scene
+
+
+
+static void unbind_scene(SCENE_T *sc)
+{
+    PROGRAM_T *pg = sc->program ;
+
+    glDisableVertexAttribArray( pg->positionLoc ) ;
+    if ( pg->texCoordLoc >= 0 ) glDisableVertexAttribArray( pg->texCoordLoc ) ;
+    glDisableVertexAttribArray( pg->colourLoc ) ;
+
+} // unbind_scene
+
+
+
+// The objects on a square grid, each spinning with its own phase.
+static void draw_scene(SCENE_T *sc, int frame, FRAMESTATS_T *fs)
+{
+    int n = sc->v[AXIS_OBJECTS] ;
+    int side = (int) ceil( sqrt( (double) n ) ) ;
+    float spacing = 2.0f * GRID_HALF / side ;
+    float scale = 0.45f * spacing ;
+    ESMatrix model ;
+    const void *indices ;
+    int i ;
+
+    for ( i = 0 ; i < n ; ++i ) {
+        esMatrixLoadIdentity(&model) ;
+        esTranslate(&model, -GRID_HALF + spacing * ( i % side + 0.5f ),
+                            -GRID_HALF + spacing * ( i / side + 0.5f ), -CAMERA_DISTANCE) ;
+        esRotate(&model, frame * 1.0f + i * 7.0f, 1.0f, 1.0f, 0.0f) ;
+        esScale(&model, scale, scale, scale) ;
+        esMatrixMultiply(&sc->mvp[i], &model, &sc->projMat) ;
+    }
+    if ( fs ) framestatsPhase(fs, FSTATS_UPDATE) ;
+
+    glViewport(0, 0, esContext.width, esContext.height) ;
+    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT ) ;
+    indices = bind_scene(sc) ;
+    for ( i = 0 ; i < n ; ++i ) {
+        glUniformMatrix4fv( sc->program->mvpLoc, 1, GL_FALSE, &sc->mvp[i].m[0][0] ) ;
+        glDrawElements( GL_TRIANGLES, sc->ni, GL_UNSIGNED_SHORT, indices ) ;
+    }
+    if ( fs ) framestatsPhase(fs, FSTATS_DRAW) ;
+
+    esSwapBuffers(&esContext) ;
+    if ( fs ) framestatsPhase(fs, FSTATS_SWAP) ;
+
+} // draw_scene
+
+
+
+//------------------------------------------------------------------------------
+
+
+// A JSON string, escaped.
+static void json_string(FILE *f, const char *s)
+{
+    fputc('"', f) ;
+    for ( ; s && *s ; ++s ) {
+        if ( *s == '"' || *s == '\\' )
+            fprintf(f, "\\%c", *s) ;
+        else if ( (unsigned char) *s < ' ' )
+            fputc(' ', f) ;
+        else
+            fputc(*s, f) ;
+    }
+    fputc('"', f) ;
+} // json_string
+
+
+
+// The CPU's name from /proc/cpuinfo, "model name" on x86, "Model" on a Pi.
+static void cpu_model(char *model, int size)
+{
+    FILE *f = fopen("/proc/cpuinfo", "r") ;
+    char line[256], *colon ;
+
+    strcpy(model, "unknown") ;
+    if ( f == NULL ) return ;
+    while ( fgets(line, sizeof( line ), f) ) {
+        if ( strncmp(line, "model name", 10) && strncmp(line, "Model", 5) &&
+             strncmp(line, "Hardware", 8) ) continue ;
+        if ( ( colon = strchr(line, ':') ) == NULL ) continue ;
+        for ( ++colon ; *colon == ' ' || *colon == '\t' ; ++colon ) ;
+        colon[strcspn(colon, "\n")] = '\0' ;
+        snprintf(model, size, "%s", colon) ;
+        if ( strncmp(line, "Hardware", 8) ) break ;   // Keep looking for "Model".
+    }
+    fclose( f ) ;
+
+} // cpu_model
+
+
+
+static void write_header(BENCH_T *bp)
+{
+    FILE *f = bp->out ;
+    struct utsname un ;
+    char date[32], model[128] ;
+    time_t now = time(NULL) ;
+    int a, i ;
+
+    uname(&un) ;
+    cpu_model(model, sizeof( model )) ;
+    strftime(date, sizeof( date ), "%Y-%m-%dT%H:%M:%S", localtime(&now)) ;
+
+    fprintf(f, "{\n\"version\": 1, \"date\": \"%s\",\n", date) ;
+    fprintf(f, "\"host\": {\"name\": ") ; json_string(f, un.nodename) ;
+    fprintf(f, ", \"os\": ") ; json_string(f, un.sysname) ;
+    fprintf(f, ", \"release\": ") ; json_string(f, un.release) ;
+    fprintf(f, ", \"machine\": ") ; json_string(f, un.machine) ;
+    fprintf(f, ", \"cpu\": ") ; json_string(f, model) ;
+    fprintf(f, ", \"cpus\": %ld},\n", sysconf(_SC_NPROCESSORS_ONLN)) ;
+
+    fprintf(f, "\"gl\": {\"vendor\": ") ; json_string(f, (const char *) glGetString(GL_VENDOR)) ;
+    fprintf(f, ", \"renderer\": ") ; json_string(f, (const char *) glGetString(GL_RENDERER)) ;
+    fprintf(f, ", \"version\": ") ; json_string(f, (const char *) glGetString(GL_VERSION)) ;
+    fprintf(f, ", \"platform\": ") ; json_string(f, esGetPlatform(&esContext)) ;
+    fprintf(f, ", \"width\": %d, \"height\": %d},\n", esContext.width, esContext.height) ;
+
+    fprintf(f, "\"settings\": {\"warmup_s\": %.3f, \"duration_s\": %.3f", bp->warmup, bp->duration) ;
+    for ( a = 0 ; a < NAXES ; ++a ) {
+        fprintf(f, ", \"%s\": [", axes[a].name) ;
+        for ( i = 0 ; i < axes[a].n ; ++i ) {
+            if ( axes[a].names[0] )
+                fprintf(f, "%s\"%s\"", i ? ", " : "", axes[a].names[axes[a].value[i]]) ;
+            else
+                fprintf(f, "%s%d", i ? ", " : "", axes[a].value[i]) ;
+        }
+        fprintf(f, "]") ;
+    }
+    fprintf(f, "},\n\"cases\": [\n") ;
+
+} // write_header
+
+
+
+static double ms(uint64_t ns)
+{
+    return ns / 1000000.0 ;
+} // ms
+
+
+
+// One line per case.
+static void write_case(BENCH_T *bp, SCENE_T *sc, FRAMESTATS_T *fs, double seconds)
+{
+    FILE *f = bp->out ;
+    HDRHIST_T *h = &fs->hist[FSTATS_FRAME] ;
+    double fps = fs->frames / seconds ;
+    double draws = fps * sc->v[AXIS_OBJECTS] ;
+    int a ;
+
+    fprintf(f, "%s{\"name\": \"%s\"", bp->ncases ? ",\n" : "", sc->name) ;
+    for ( a = 0 ; a < NAXES ; ++a ) {
+        if ( axes[a].names[0] )
+            fprintf(f, ", \"%s\": \"%s\"", axes[a].name, axes[a].names[sc->v[a]]) ;
+        else
+            fprintf(f, ", \"%s\": %d", axes[a].name, sc->v[a]) ;
+    }
+    fprintf(f, ", \"vertices\": %u, \"triangles\": %u", sc->nv, sc->ni / 3) ;
+    fprintf(f, ", \"frames\": %lu, \"fps\": %.2f, \"mean_ms\": %.4f, \"p50_ms\": %.4f"
+               ", \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f",
+            fs->frames, fps, h->total ? h->sum / h->total / 1000000.0 : 0.0,
+            ms(hdrPercentile(h,50.0)), ms(hdrPercentile(h,95.0)),
+            ms(hdrPercentile(h,99.0)), ms(h->max)) ;
+    fprintf(f, ", \"update_p50_ms\": %.4f, \"draw_p50_ms\": %.4f, \"swap_p50_ms\": %.4f",
+            ms(hdrPercentile(&fs->hist[FSTATS_UPDATE],50.0)),
+            ms(hdrPercentile(&fs->hist[FSTATS_DRAW],50.0)),
+            ms(hdrPercentile(&fs->hist[FSTATS_SWAP],50.0))) ;
+    fprintf(f, ", \"draws_per_s\": %.0f, \"triangles_per_s\": %.0f}", draws, draws * ( sc->ni / 3 )) ;
+    fflush( f ) ;
+
+    bp->ncases++ ;
+
+} // write_case
+
+
+
+// Warm up, then time the case for the duration.
+static void run_case(BENCH_T *bp, SCENE_T *sc)
+{
+    FRAMESTATS_T *fs ;
+    double end, seconds ;
+    int frame = 0 ;
+
+    if ( !init_scene(bp,sc) ) {
+        free_scene(sc) ;
+        return ;
+    }
+
+    resettimer(0) ;
+    end = bp->warmup * MICRO ;
+    while ( uelapsedtime(0) < end && !( bp->closed = esUserInterrupt(&esContext) ) )
+        draw_scene(sc, frame++, NULL) ;
+    glFinish() ;
+    if ( bp->closed ) {
+        unbind_scene(sc) ;
+        free_scene(sc) ;
+        return ;
+    }
+
+    fs = framestatsCreate(0.0, NULL) ;
+    resettimer(0) ;
+    end = bp->duration * MICRO ;
+    while ( uelapsedtime(0) < end && !bp->closed ) {
+        framestatsBegin(fs) ;
+        draw_scene(sc, frame++, fs) ;
+        framestatsEnd(fs) ;
+        bp->closed = esUserInterrupt(&esContext) ;
+    }
+    seconds = uelapsedtime(0) / MICRO ;
+
+    // A case cut short by closing the window is not written.
+    if ( !bp->closed ) {
+        printf("%-28s %6lu frames %8.1fHz  p50 %7.3fms  p99 %7.3fms\n",sc->name,fs->frames,
+               fs->frames / seconds,ms(hdrPercentile(&fs->hist[FSTATS_FRAME],50.0)),
+               ms(hdrPercentile(&fs->hist[FSTATS_FRAME],99.0))) ;
+        write_case(bp,sc,fs,seconds) ;
+    }
+
+    framestatsDestroy(fs) ;
+    unbind_scene(sc) ;
+    free_scene(sc) ;
+
+} // run_case
+
+
+
+// Every combination of the axes, the last axis changing fastest.
+static void run_matrix(BENCH_T *bp)
+{
+    int index[NAXES] = { 0 } ;
+    SCENE_T scene ;
+    int a ;
+
+    for ( ;; ) {
+        memset( &scene, 0, sizeof( scene ) ) ;
+        for ( a = 0 ; a < NAXES ; ++a )
+            scene.v[a] = axes[a].value[index[a]] ;
+        snprintf(scene.name, sizeof( scene.name ), "n%d_l%d_x%d_%s_%s",
+                 scene.v[AXIS_OBJECTS], scene.v[AXIS_SLICES], scene.v[AXIS_TEXTURE],
+                 axes[AXIS_FORMAT].names[scene.v[AXIS_FORMAT]],
+                 axes[AXIS_ARRAYS].names[scene.v[AXIS_ARRAYS]]) ;
+
+        if ( bp->listOnly )
+            printf("%s\n",scene.name) ;
+        else
+            run_case(bp,&scene) ;
+        if ( bp->closed ) {
+            printf("Window closed, stopped.\n") ;
+            break ;
+        }
+
+        for ( a = NAXES - 1 ; a >= 0 ; --a ) {
+            if ( ++index[a] < axes[a].n ) break ;
+            index[a] = 0 ;
+        }
+        if ( a < 0 ) break ;
+    }
+
+} // run_matrix
+
+
+
+int main(int argc, char **argv)
+{
+    BENCH_T *bp = &bench ;
+    int a, ncases = 1 ;
+
+    esInitContext(&esContext) ;
+    parse(argc,argv,bp) ;
+
+    for ( a = 0 ; a < NAXES ; ++a )
+        ncases *= axes[a].n ;
+    if ( bp->listOnly ) {
+        run_matrix(bp) ;
+        printf("%d cases.\n",ncases) ;
+        return 0 ;
+    }
+
+    // One context for every case.
+    if ( !esCreateWindow(&esContext, "esBench", bp->winWidth, bp->winHeight,
+                         ES_WINDOW_RGB | ES_WINDOW_ALPHA | ES_WINDOW_DEPTH) ) {
+        printf(VERSION "Unable to create a window.\n") ;
+        return 1 ;
+    }
+    printf("Screen size : (%d,%d) on %s%s.\n",esContext.width,esContext.height,
+           esGetPlatform(&esContext), esContext.fbo ? " (FBO)" : "") ;
+    printf("GL Renderer  :'%s'.\n",glGetString(GL_RENDERER)) ;
+    printf("%d cases, %.1fs each.\n",ncases,bp->warmup + bp->duration) ;
+
+    if ( !init_program(&bp->coloured, 0) || !init_program(&bp->textured, 1) ) {
+        printf(VERSION "Unable to build the shaders.\n") ;
+        esExit(&esContext) ;
+        return 1 ;
+    }
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f) ;
+    glEnable(GL_CULL_FACE) ;
+    glEnable(GL_DEPTH_TEST) ;
+    glDepthFunc(GL_LEQUAL) ;
+
+    bp->out = fopen(bp->outName, "w") ;
+    if ( bp->out == NULL ) {
+        printf(VERSION "Unable to create '%s'.\n",bp->outName) ;
+        esExit(&esContext) ;
+        return 1 ;
+    }
+    write_header(bp) ;
+
+    run_matrix(bp) ;
+
+    fprintf(bp->out, "\n]\n}\n") ;
+    fclose( bp->out ) ;
+    printf("Wrote %d cases to '%s'.\n",bp->ncases,bp->outName) ;
+
+    glDeleteProgram( bp->coloured.id ) ;
+    glDeleteProgram( bp->textured.id ) ;
+    esExit(&esContext) ;
+    return 0 ;
+
+} // main
@@ -0,0 +1,688 @@
+/*
+   Microbenchmarks for the ES utility library : the ESTransform.c matrix
+   functions, the ESShapes.c generators, esLoadTGA(), esLoadProgram()
+   and urandom(). 'make micro' runs them all.
+
+   Each benchmark is first calibrated, doubling the operations per sample
+   until a sample takes at least the minimum time, which also warms the
+   caches. Then it is sampled -r times and samples further than 3 scaled
+   MADs (median absolute deviations) from the median are rejected as
+   outliers (interrupts, migrations, page faults). The median of what is
+   left is reported as ns and cycles per operation. Cycles come from the
+   perf cpu-cycles counter, else on x86 the TSC (reference cycles at the
+   nominal clock), else are not reported.
+
+   The process is pinned to one CPU (-c) so samples are not split over
+   cores with different clocks and caches.
+
+   Before timing, the output of each function for fixed inputs is reduced
+   to a signature and checked against the golden values in the table
+   below, so a faster version that changes the results is caught. Float
+   outputs are compared to a tolerance scaled by their magnitude, so a
+   change in rounding (e.g. fused multiply-add) passes. urandom()'s
+   golden values are for glibc's rand(). After a deliberate change of
+   results, -G prints the golden values to copy into the table.
+
+   Exits with 1 if a golden check failed.
+
+  18/10/26 v1.0 Calibrated samples, outlier rejection, golden checks.
+*/
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "ESUtil.h"
+#include "utils.h"
+#include "perfctr.h"
+
+#define VERSION  "esMicro v1.0: "
+
+#define DEF_REPS           25         // Default samples per benchmark.
+#define DEF_SAMPLE_US    2000.0       // Default minimum sample time.
+#define DEF_IMAGE      "goldfish.tga"
+#define MAXREPS          1000
+
+#define OUTLIER_MADS      3.0         // Rejected beyond this many MADs.
+#define MAD_SCALE      1.4826         // MAD to standard deviation (normal).
+#define GOLDEN_TOLERANCE  1e-5        // Of the output's magnitude.
+
+#define MICRO_TIMER         0         // utils.c timer slot used.
+
+// Cycle sources.
+#define CYCLES_NONE         0
+#define CYCLES_PERF         1
+#define CYCLES_TSC          2
+
+
+// Output of a function for fixed inputs. The float part is a weighted
+// sum, compared to a tolerance of the weighted sum of magnitudes. The
+// exact part is a hash of sizes, indices and pixels.
+typedef struct {
+    double   value ;
+    double   scale ;           // not stored in the table
+    uint64_t exact ;
+} SIGNATURE_T ;
+
+typedef struct {
+    const char *name ;
+    int      arg ;             // slices for esGenSphere
+    int      needsGL ;
+    void   (*run)(int arg, long n) ;
+    void   (*signature)(int arg, SIGNATURE_T *sig) ;
+    double   golden ;          // SIGNATURE_T value
+    uint64_t goldenExact ;
+} MICRO_T ;
+
+typedef struct {
+    int      reps ;
+    double   sampleUs ;        // minimum sample time
+    int      cpu ;             // -1 = not pinned
+    const char *filter ;       // names containing this, or NULL
+    int      printGolden ;     // -G
+    char    *imagefn ;
+
+    PERFCTR_T *perf ;
+    int      perfPhase ;
+    int      cycleSource ;
+    int      haveGL ;
+    int      failures ;
+} OPTIONS_T ;
+
+
+ESContext esContext ;
+OPTIONS_T options ;
+
+// Results are written here so the calls can not be optimised away.
+ESMatrix  sinkMat ;
+volatile long sink ;
+
+
+
+//------------------------------------------------------------------------------
+// Signature helpers.
+
+
+static uint64_t fnv(uint64_t h, const void *data, size_t bytes)
+{
+    const unsigned char *p = data ;
+
+    if ( h == 0 ) h = 14695981039346656037ULL ;
+    while ( bytes-- ) {
+        h ^= *p++ ;
+        h *= 1099511628211ULL ;
+    }
+    return h ;
+} // fnv
+
+
+
+// Weighted so that moved or swapped elements change the sum.
+static void add_floats(SIGNATURE_T *sig, const GLfloat *f, long n)
+{
+    long i ;
+
+    if ( f == NULL ) return ;
+    for ( i = 0 ; i < n ; ++i ) {
+        sig->value += f[i] * (double) ( i % 13 + 1 ) ;
+        sig->scale += fabs( f[i] ) * (double) ( i % 13 + 1 ) ;
+    }
+} // add_floats
+
+
+
+//------------------------------------------------------------------------------
+// Benchmarks : run() does n operations, signature() one for fixed inputs.
+
+
+static ESMatrix matA, matB ;
+
+static void init_matrices(void)
+{
+    esMatrixLoadIdentity(&matA) ;
+    esRotate(&matA, 30.0f, 1.0f, 1.0f, 0.0f) ;
+    esTranslate(&matA, 0.5f, -1.0f, -5.0f) ;
+    esMatrixLoadIdentity(&matB) ;
+    esPerspective(&matB, 45.0f, 16.0f / 9.0f, 0.1f, 100.0f) ;
+} // init_matrices
+
+
+
+static void run_multiply(int arg, long n)
+{
+    while ( n-- )
+        esMatrixMultiply(&sinkMat, &matA, &matB) ;
+} // run_multiply
+
+static void sig_multiply(int arg, SIGNATURE_T *sig)
+{
+    ESMatrix m ;
+
+    esMatrixMultiply(&m, &matA, &matB) ;
+    add_floats(sig, &m.m[0][0], 16) ;
+} // sig_multiply
+
+
+
+// Rotations about a changing axis so no two calls are the same.
+static void run_rotate(int arg, long n)
+{
+    esMatrixLoadIdentity(&sinkMat) ;
+    while ( n-- )
+        esRotate(&sinkMat, 1.0f, 1.0f, (float) ( n & 7 ), 0.5f) ;
+} // run_rotate
+
+static void sig_rotate(int arg, SIGNATURE_T *sig)
+{
+    ESMatrix m ;
+
+    esMatrixLoadIdentity(&m) ;
+    esRotate(&m, 30.0f, 1.0f, 1.0f, 0.0f) ;
+    esRotate(&m, -75.0f, 0.2f, 0.0f, 1.0f) ;
+    add_floats(sig, &m.m[0][0], 16) ;
+} // sig_rotate
+
+
+
+static void run_perspective(int arg, long n)
+{
+    while ( n-- ) {
+        esMatrixLoadIdentity(&sinkMat) ;
+        esPerspective(&sinkMat, 45.0f, 16.0f / 9.0f, 0.1f, 100.0f) ;
+    }
+} // run_perspective
+
+static void sig_perspective(int arg, SIGNATURE_T *sig)
+{
+    ESMatrix m ;
+
+    esMatrixLoadIdentity(&m) ;
+    esPerspective(&m, 60.0f, 4.0f / 3.0f, 0.5f, 50.0f) ;
+    add_floats(sig, &m.m[0][0], 16) ;
+} // sig_perspective
+
+
+
+static void run_sphere(int arg, long n)
+{
+    GLfloat *v, *nm, *t ;
+    GLushort *ind ;
+    GLuint nv ;
+
+    while ( n-- ) {
+        sink += esGenSphere(arg, 1.0f, &v, &nm, &t, &ind, &nv) ;
+        free( v ) ; free( nm ) ; free( t ) ; free( ind ) ;
+    }
+} // run_sphere
+
+static void sig_sphere(int arg, SIGNATURE_T *sig)
+{
+    GLfloat *v, *nm, *t ;
+    GLushort *ind ;
+    GLuint nv ;
+    int ni ;
+
+    ni = esGenSphere(arg, 1.5f, &v, &nm, &t, &ind, &nv) ;
+    add_floats(sig, v, nv * 3) ;
+    add_floats(sig, nm, nv * 3) ;
+    add_floats(sig, t, nv * 2) ;
+    sig->exact = fnv(0, &nv, sizeof( nv )) ;
+    sig->exact = fnv(sig->exact, &ni, sizeof( ni )) ;
+    sig->exact = fnv(sig->exact, ind, ni * sizeof( GLushort )) ;
+    free( v ) ; free( nm ) ; free( t ) ; free( ind ) ;
+} // sig_sphere
+
+
+
+static void run_cube(int arg, long n)
+{
+    GLfloat *v, *nm, *t ;
+    GLushort *ind ;
+    GLuint nv ;
+
+    while ( n-- ) {
+        sink += esGenCube(1.0f, &v, &nm, &t, &ind, &nv) ;
+        free( v ) ; free( nm ) ; free( t ) ; free( ind ) ;
+    }
+} // run_cube
+
+static void sig_cube(int arg, SIGNATURE_T *sig)
+{
+    GLfloat *v, *nm, *t ;
+    GLushort *ind ;
+    GLuint nv ;
+    int ni ;
+
+    ni = esGenCube(2.0f, &v, &nm, &t, &ind, &nv) ;
+    add_floats(sig, v, nv * 3) ;
+    add_floats(sig, nm, nv * 3) ;
+    add_floats(sig, t, nv * 2) ;
+    sig->exact = fnv(0, &nv, sizeof( nv )) ;
+    sig->exact = fnv(sig->exact, &ni, sizeof( ni )) ;
+    sig->exact = fnv(sig->exact, ind, ni * sizeof( GLushort )) ;
+    free( v ) ; free( nm ) ; free( t ) ; free( ind ) ;
+} // sig_cube
+
+
+
+// From the page cache after the first load, so this times the parsing.
+static void run_tga(int arg, long n)
+{
+    char *image ;
+    int w, h ;
+
+    while ( n-- ) {
+        image = esLoadTGA(options.imagefn, &w, &h) ;
+        sink += w ;
+        free( image ) ;
+    }
+} // run_tga
+
+static void sig_tga(int arg, SIGNATURE_T *sig)
+{
+    char *image ;
+    int w = 0, h = 0 ;
+
+    image = esLoadTGA(options.imagefn, &w, &h) ;
+    sig->exact = fnv(0, &w, sizeof( w )) ;
+    sig->exact = fnv(sig->exact, &h, sizeof( h )) ;
+    if ( image ) sig->exact = fnv(sig->exact, image, w * h * 3) ;
+    free( image ) ;
+} // sig_tga
+
+
+
+// esTri's textured shaders. A counter is appended to the source so a
+// driver shader cache can not turn the compile into a lookup.
+static GLuint load_program(long count)
+{
+    static const char vShaderStr[] =
+        "attribute vec3 a_position;                   \n"
+        "attribute vec2 a_texcoord;                   \n"
+        "uniform   mat4 MVP;                          \n"
+        "varying   vec2 v_texcoord;                   \n"
+        "void main()                                  \n"
+        "{                                            \n"
+        "   v_texcoord  = a_texcoord;                 \n"
+        "   gl_Position = MVP * vec4(a_position,1.0); \n"
+        "}                                            \n";
+    static const char fShaderStr[] =
+        "precision mediump float;                             \n"
+        "varying   vec2 v_texcoord;                           \n"
+        "uniform sampler2D s_texture;                         \n"
+        "void main()                                          \n"
+        "{                                                    \n"
+        "   gl_FragColor = texture2D( s_texture, v_texcoord );\n"
+        "}                                                    \n";
+    char source[sizeof( vShaderStr ) + 32] ;
+
+    snprintf(source, sizeof( source ), "%s// %ld\n", vShaderStr, count) ;
+    return esLoadProgram(source, fShaderStr) ;
+
+} // load_program
+
+static void run_program(int arg, long n)
+{
+    static long count = 0 ;
+
+    while ( n-- )
+        glDeleteProgram( load_program(++count) ) ;
+} // run_program
+
+static void sig_program(int arg, SIGNATURE_T *sig)
+{
+    GLuint program = load_program(0) ;
+    GLint linked = 0, attribs = 0, uniforms = 0 ;
+
+    if ( program ) {
+        glGetProgramiv(program, GL_LINK_STATUS, &linked) ;
+        glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attribs) ;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniforms) ;
+        glDeleteProgram( program ) ;
+    }
+    sig->exact = linked * 100 + attribs * 10 + uniforms ;
+} // sig_program
+
+
+
+static void run_urandom(int arg, long n)
+{
+    long sum = 0 ;
+
+    while ( n-- )
+        sum += urandom(255) ;
+    sink += sum ;
+} // run_urandom
+
+static void sig_urandom(int arg, SIGNATURE_T *sig)
+{
+    int i, r ;
+
+    srand(1) ;
+    for ( i = 0 ; i < 1000 ; ++i ) {
+        r = urandom(255) ;
+        sig->exact = fnv(sig->exact, &r, sizeof( r )) ;
+    }
+} // sig_urandom
+
+
+
+static MICRO_T micros[] = {
+    { "esMatrixMultiply",    0, 0, run_multiply,    sig_multiply,    53.1038084477, 0x0ULL },
+    { "esRotate",            0, 0, run_rotate,      sig_rotate,      10.1252358109, 0x0ULL },
+    { "esPerspective",       0, 0, run_perspective, sig_perspective, -13.5510823727, 0x0ULL },
+    { "esGenSphere/16",     16, 0, run_sphere,      sig_sphere,      114.5937685795, 0x94a8ea9b6033ccbdULL },
+    { "esGenSphere/64",     64, 0, run_sphere,      sig_sphere,      850.3471763128, 0xd6cf560c3d2dc3e4ULL },
+    { "esGenSphere/200",   200, 0, run_sphere,      sig_sphere,      1809.5034941024, 0x16be222d497c812aULL },
+    { "esGenSphere/350",   350, 0, run_sphere,      sig_sphere,      4447.2999663580, 0x9503e6728acde109ULL },
+    { "esGenCube",           0, 0, run_cube,        sig_cube,        119.0, 0xf388a3c0466f49f9ULL },
+    { "esLoadTGA",           0, 0, run_tga,         sig_tga,         0.0, 0xcbe50d4a6cd32addULL },
+    { "esLoadProgram",       0, 1, run_program,     sig_program,     0.0, 0x7aULL },
+    { "urandom",             0, 0, run_urandom,     sig_urandom,     0.0, 0xa178e602d83a0578ULL },
+} ;
+
+#define NMICROS   ( sizeof( micros ) / sizeof( micros[0] ) )
+
+
+
+//------------------------------------------------------------------------------
+
+
+static void usage(char *prog)
+{
+    printf("Usage : %s [options] [name]\n",prog) ;
+    printf("Runs the benchmarks whose names contain [name], default all.\n") ;
+    printf("Options :\n") ;
+    printf("  -r <n>         Samples per benchmark (default %d).\n",DEF_REPS) ;
+    printf("  -t <us>        Minimum time per sample (default %.0fus).\n",DEF_SAMPLE_US) ;
+    printf("  -c <cpu>       Pin to this CPU, -1 = not pinned (default the current one).\n") ;
+    printf("  -i <file.tga>  Image for esLoadTGA (default %s, the golden one).\n",DEF_IMAGE) ;
+    printf("  -G             Print the golden values of the current results.\n") ;
+    printf("  -l             List the benchmarks.\n") ;
+} // usage
+
+
+
+static void parse(int argc, char **argv, OPTIONS_T *op)
+{
+    char *prog = argv[0] ;
+    int opt, i ;
+
+    op->reps = DEF_REPS ;
+    op->sampleUs = DEF_SAMPLE_US ;
+    op->cpu = sched_getcpu() ;
+    op->imagefn = DEF_IMAGE ;
+
+    while ( ( opt = getopt(argc, argv, "r:t:c:i:Gl") ) != -1 ) {
+        switch ( opt ) {
+            case 'r' :
+                op->reps = atoi(optarg) ;
+                if ( op->reps < 1 ) op->reps = 1 ;
+                if ( op->reps > MAXREPS ) op->reps = MAXREPS ;
+                break ;
+            case 't' :
+                op->sampleUs = atof(optarg) ;
+                break ;
+            case 'c' :
+                op->cpu = atoi(optarg) ;
+                break ;
+            case 'i' :
+                op->imagefn = optarg ;
+                break ;
+            case 'G' :
+                op->printGolden = 1 ;
+                break ;
+            case 'l' :
+                for ( i = 0 ; i < NMICROS ; ++i )
+                    printf("%s\n",micros[i].name) ;
+                exit(0) ;
+            default :
+                usage(prog) ;
+                exit(1) ;
+        }
+    }
+    if ( optind < argc ) {
+        if ( *argv[optind] == '?' ) {
+            usage(prog) ;
+            exit(0) ;
+        }
+        op->filter = argv[optind] ;
+    }
+
+} // parse
+
+
+
+static void pin_cpu(OPTIONS_T *op)
+{
+    cpu_set_t set ;
+    char path[80], governor[32] = "" ;
+    FILE *f ;
+
+    if ( op->cpu < 0 ) {
+        printf("CPU : not pinned.\n") ;
+        return ;
+    }
+    CPU_ZERO(&set) ;
+    CPU_SET(op->cpu, &set) ;
+    if ( sched_setaffinity(0, sizeof( set ), &set) ) {
+        printf(VERSION "Unable to pin to CPU %d.\n",op->cpu) ;
+        op->cpu = -1 ;
+        return ;
+    }
+
+    // Anything but 'performance' may change the clock between samples.
+    snprintf(path, sizeof( path ), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", op->cpu) ;
+    if ( ( f = fopen(path, "r") ) ) {
+        if ( fgets(governor, sizeof( governor ), f) ) governor[strcspn(governor, "\n")] = '\0' ;
+        fclose( f ) ;
+    }
+    printf("CPU : pinned to %d%s%s.\n",op->cpu,*governor ? ", governor " : "",governor) ;
+
+} // pin_cpu
+
+
+
+static void open_cycles(OPTIONS_T *op)
+{
+    op->perf = perfctrOpen() ;
+    if ( op->perf && op->perf->fd[PERF_CYCLES] >= 0 ) {
+        op->perfPhase = perfctrAddPhase(op->perf, "sample") ;
+        op->cycleSource = CYCLES_PERF ;
+        printf("Cycles : perf cpu-cycles.\n") ;
+        return ;
+    }
+    perfctrClose(op->perf) ;
+    op->perf = NULL ;
+#if defined(__x86_64__) || defined(__i386__)
+    op->cycleSource = CYCLES_TSC ;
+    printf("Cycles : TSC, reference cycles at the nominal clock.\n") ;
+#else
+    op->cycleSource = CYCLES_NONE ;
+    printf("Cycles : not available.\n") ;
+#endif
+} // open_cycles
+
+
+
+static double read_cycles(OPTIONS_T *op)
+{
+    switch ( op->cycleSource ) {
+        case CYCLES_PERF :
+            perfctrPhase(op->perf, op->perfPhase) ;
+            return op->perf->phase[op->perfPhase].total[PERF_CYCLES] ;
+#if defined(__x86_64__) || defined(__i386__)
+        case CYCLES_TSC :
+            return (double) __rdtsc() ;
+#endif
+        default :
+            return 0.0 ;
+    }
+} // read_cycles
+
+
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b ;
+    return ( x > y ) - ( x < y ) ;
+} // compare_doubles
+
+
+
+static double median(double *v, int n)
+{
+    qsort(v, n, sizeof( double ), compare_doubles) ;
+    return ( n & 1 ) ? v[n / 2] : ( v[n / 2 - 1] + v[n / 2] ) / 2.0 ;
+} // median
+
+
+
+// Check the output against the golden values, or print them with -G.
+static int check_golden(OPTIONS_T *op, MICRO_T *mb)
+{
+    SIGNATURE_T sig = { 0.0, 0.0, 0 } ;
+
+    if ( mb->run == run_tga && strcmp(op->imagefn, DEF_IMAGE) ) return -1 ;
+
+    mb->signature(mb->arg, &sig) ;
+    if ( op->printGolden ) {
+        printf("%-18s %.10f, 0x%llxULL\n",mb->name,sig.value,(unsigned long long) sig.exact) ;
+        return 1 ;
+    }
+    return sig.exact == mb->goldenExact &&
+           fabs( sig.value - mb->golden ) <= GOLDEN_TOLERANCE * ( sig.scale > 1.0 ? sig.scale : 1.0 ) ;
+
+} // check_golden
+
+
+
+/***********************************************************
+ * Name: run_micro
+ *
+ * Arguments:
+ *     OPTIONS_T *op - options and cycle counter.
+ *     MICRO_T *mb - the benchmark.
+ *
+ * Description: Checks the output, calibrates the operations per
+ *              sample, takes the samples, rejects the outliers and
+ *              prints one line of results.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void run_micro(OPTIONS_T *op, MICRO_T *mb)
+{
+    double ns[MAXREPS], cycles[MAXREPS], dev[MAXREPS], kept[MAXREPS], keptCycles[MAXREPS] ;
+    double t0, t1, c0, med, mad, limit, mean = 0.0, var = 0.0, min ;
+    long n = 1 ;
+    int i, nkept = 0, golden ;
+    const char *check ;
+
+    golden = check_golden(op, mb) ;
+    if ( op->printGolden ) return ;
+    check = golden < 0 ? "-" : ( golden ? "ok" : "FAIL" ) ;
+    if ( golden == 0 ) op->failures++ ;
+
+    // Double the operations until a sample is long enough.
+    for ( ;; ) {
+        t0 = uelapsedtime(MICRO_TIMER) ;
+        mb->run(mb->arg, n) ;
+        t1 = uelapsedtime(MICRO_TIMER) ;
+        if ( t1 - t0 >= op->sampleUs || n >= ( 1L << 30 ) ) break ;
+        n *= 2 ;
+    }
+
+    for ( i = 0 ; i < op->reps ; ++i ) {
+        c0 = read_cycles(op) ;
+        t0 = uelapsedtime(MICRO_TIMER) ;
+        mb->run(mb->arg, n) ;
+        t1 = uelapsedtime(MICRO_TIMER) ;
+        cycles[i] = ( read_cycles(op) - c0 ) / n ;
+        ns[i] = ( t1 - t0 ) * 1000.0 / n ;
+    }
+
+    // Median absolute deviation, robust to the outliers it finds.
+    memcpy( kept, ns, op->reps * sizeof( double ) ) ;
+    med = median(kept, op->reps) ;
+    for ( i = 0 ; i < op->reps ; ++i )
+        dev[i] = fabs( ns[i] - med ) ;
+    mad = median(dev, op->reps) ;
+    limit = OUTLIER_MADS * MAD_SCALE * mad ;
+
+    min = ns[0] ;
+    for ( i = 0 ; i < op->reps ; ++i ) {
+        if ( ns[i] < min ) min = ns[i] ;
+        if ( fabs( ns[i] - med ) > limit && mad > 0.0 ) continue ;
+        kept[nkept] = ns[i] ;
+        keptCycles[nkept++] = cycles[i] ;
+        mean += ns[i] ;
+    }
+    mean /= nkept ;
+    for ( i = 0 ; i < nkept ; ++i )
+        var += ( kept[i] - mean ) * ( kept[i] - mean ) ;
+
+    printf("%-18s %10ld %12.1f %12.1f %7.1f%% %5d/%-4d",mb->name,n,median(kept, nkept),min,
+           mean > 0.0 ? sqrt( var / nkept ) * 100.0 / mean : 0.0,nkept,op->reps) ;
+    if ( op->cycleSource != CYCLES_NONE )
+        printf(" %12.1f",median(keptCycles, nkept)) ;
+    else
+        printf(" %12s","-") ;
+    printf("  %s\n",check) ;
+
+} // run_micro
+
+
+
+int main(int argc, char **argv)
+{
+    OPTIONS_T *op = &options ;
+    int i ;
+
+    esInitContext(&esContext) ;
+    parse(argc,argv,op) ;
+
+    if ( !op->printGolden ) {
+        pin_cpu(op) ;
+        open_cycles(op) ;
+    }
+    init_matrices() ;
+    resettimer(MICRO_TIMER) ;
+
+    // A GL context only if a selected benchmark needs one.
+    for ( i = 0 ; i < NMICROS ; ++i ) {
+        if ( op->filter && strstr(micros[i].name, op->filter) == NULL ) continue ;
+        if ( micros[i].needsGL && !op->haveGL ) {
+            op->haveGL = esCreateWindow(&esContext, "esMicro", 64, 64, ES_WINDOW_RGB) ;
+            if ( !op->haveGL ) printf(VERSION "No GL context, skipping %s.\n",micros[i].name) ;
+            else if ( !op->printGolden ) printf("GL Renderer  :'%s'.\n",glGetString(GL_RENDERER)) ;
+        }
+    }
+
+    if ( !op->printGolden )
+        printf("%-18s %10s %12s %12s %8s %10s %12s  %s\n","benchmark","ops/sample",
+               "ns/op","min ns/op","stddev","kept","cycles/op","golden") ;
+    for ( i = 0 ; i < NMICROS ; ++i ) {
+        if ( op->filter && strstr(micros[i].name, op->filter) == NULL ) continue ;
+        if ( micros[i].needsGL && !op->haveGL ) continue ;
+        run_micro(op, &micros[i]) ;
+    }
+
+    if ( op->failures )
+        printf("%d golden check(s) FAILED : the results have changed.\n",op->failures) ;
+
+    perfctrClose(op->perf) ;
+    if ( op->haveGL ) esExit(&esContext) ;
+    return op->failures ? 1 : 0 ;
+
+} // main
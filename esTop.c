@@ -0,0 +1,209 @@
+/*
+   Live monitor of a running esTri. Maps the telemetry segment esTri
+   publishes each frame (see telemetry.h) read only, and shows it like
+   top, or prints a line a sample with -b, or appends samples to a CSV
+   file with -o. The writer is not slowed or signalled, it does not know
+   there is a reader.
+
+   Without -n the newest segment with a live writer is watched. Stops
+   when the writer exits, or after -c samples.
+
+  18/10/26 v1.0 Screen and batch display, CSV export.
+  18/10/26 v1.1 Time to first frame, telemetry version 2.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+#include "log.h"
+
+#define VERSION  "esTop v1.1: "
+
+#define DEF_INTERVAL_MS  1000        // Between samples.
+
+static const char *phaseNames[TELEMETRY_NPHASES] = { "update", "draw", "swap", "frame" } ;
+
+
+
+//------------------------------------------------------------------------------
+
+
+static void usage(char *prog)
+{
+    printf("Usage : %s [options]\n",prog) ;
+    printf("Options :\n") ;
+    printf("  -n <name>      Segment, %s<pid> (default the newest running).\n",TELEMETRY_PREFIX) ;
+    printf("  -i <ms>        Sample interval (default %d).\n",DEF_INTERVAL_MS) ;
+    printf("  -c <count>     Stop after this many samples.\n") ;
+    printf("  -b             Batch, one line a sample, no screen control.\n") ;
+    printf("  -o <file.csv>  Append the samples to a CSV file.\n") ;
+} // usage
+
+
+
+static double mb(uint64_t bytes)
+{
+    return bytes / ( 1024.0 * 1024.0 ) ;
+} // mb
+
+
+
+// Full screen, redrawn each sample.
+static void show_screen(const TELEMETRY_T *t)
+{
+    int p ;
+
+    printf("\033[H\033[2J") ;
+    printf("%s pid %d  %s on %s  %dx%d  routine %d  up %.1fs  first frame %.1fms\n",t->program,
+           t->pid,t->renderer,t->platform,t->width,t->height,t->routine,t->uptime,t->firstFrameMs) ;
+    printf("\nFrames %llu  %.1f fps  last %.2fms  budget %.2fms  over %llu (%.1f%%)\n",
+           (unsigned long long) t->frames,t->fps,t->frameMs,t->budgetMs,
+           (unsigned long long) t->over,t->frames ? 100.0 * t->over / t->frames : 0.0) ;
+    printf("\n%-8s %9s %9s %9s %9s\n","ms","p50","p95","p99","max") ;
+    for ( p = 0 ; p < TELEMETRY_NPHASES ; ++p )
+        printf("%-8s %9.3f %9.3f %9.3f %9.3f\n",phaseNames[p],t->phase[p].p50,
+               t->phase[p].p95,t->phase[p].p99,t->phase[p].max) ;
+    printf("\nGL a frame : %llu draws, %llu primitives, %llu program/%llu buffer/%llu texture binds,\n"
+           "             %llu uniforms, %.1fKB uploaded\n",
+           (unsigned long long) t->draws,(unsigned long long) t->primitives,
+           (unsigned long long) t->programBinds,(unsigned long long) t->bufferBinds,
+           (unsigned long long) t->textureBinds,(unsigned long long) t->uniforms,
+           t->uploadBytes / 1024.0) ;
+    printf("Scene      : %d objects, %llu triangles\n",t->objects,(unsigned long long) t->triangles) ;
+    printf("Memory     : RSS %.1fMB, VBOs %.1f/%.1fMB, tiles %.1f/%.1fMB\n",mb(t->rss),
+           mb(t->vboUsed),mb(t->vboReserved),mb(t->texResident),mb(t->texBudget)) ;
+    printf("Queues     : assets %d decoding, %d to upload, input %llu events, %llu dropped\n",
+           t->assetsQueued,t->assetsDecoded,(unsigned long long) t->inputEvents,
+           (unsigned long long) t->inputDropped) ;
+    fflush(stdout) ;
+
+} // show_screen
+
+
+
+static void show_line(const TELEMETRY_T *t, int header)
+{
+    if ( header )
+        printf("%8s %8s %7s %8s %8s %8s %7s %7s %9s %7s %7s\n","uptime","frames","fps",
+               "p50 ms","p99 ms","max ms","over","draws","triangles","rss MB","assets") ;
+    printf("%8.1f %8llu %7.1f %8.3f %8.3f %8.3f %7llu %7llu %9llu %7.1f %7d\n",t->uptime,
+           (unsigned long long) t->frames,t->fps,t->phase[3].p50,t->phase[3].p99,
+           t->phase[3].max,(unsigned long long) t->over,(unsigned long long) t->draws,
+           (unsigned long long) t->triangles,mb(t->rss),t->assetsQueued + t->assetsDecoded) ;
+    fflush(stdout) ;
+
+} // show_line
+
+
+
+static void write_csv(FILE *csv, const TELEMETRY_T *t)
+{
+    int p ;
+
+    if ( ftell(csv) == 0 ) {
+        fprintf(csv,"pid,uptime,first_frame_ms,frames,fps,frame_ms,over") ;
+        for ( p = 0 ; p < TELEMETRY_NPHASES ; ++p )
+            fprintf(csv,",%s_p50,%s_p95,%s_p99,%s_max",phaseNames[p],phaseNames[p],
+                    phaseNames[p],phaseNames[p]) ;
+        fprintf(csv,",draws,primitives,program_binds,buffer_binds,texture_binds,uniforms,"
+                "upload_bytes,objects,triangles,rss,vbo_reserved,vbo_used,tex_resident,"
+                "tex_budget,assets_queued,assets_decoded,input_events,input_dropped\n") ;
+    }
+    fprintf(csv,"%d,%.3f,%.3f,%llu,%.2f,%.3f,%llu",t->pid,t->uptime,t->firstFrameMs,
+            (unsigned long long) t->frames,t->fps,t->frameMs,(unsigned long long) t->over) ;
+    for ( p = 0 ; p < TELEMETRY_NPHASES ; ++p )
+        fprintf(csv,",%.3f,%.3f,%.3f,%.3f",t->phase[p].p50,t->phase[p].p95,
+                t->phase[p].p99,t->phase[p].max) ;
+    fprintf(csv,",%llu,%llu,%llu,%llu,%llu,%llu,%llu,%d,%llu,%llu,%llu,%llu,%llu,%llu,%d,%d,%llu,%llu\n",
+            (unsigned long long) t->draws,(unsigned long long) t->primitives,
+            (unsigned long long) t->programBinds,(unsigned long long) t->bufferBinds,
+            (unsigned long long) t->textureBinds,(unsigned long long) t->uniforms,
+            (unsigned long long) t->uploadBytes,t->objects,(unsigned long long) t->triangles,
+            (unsigned long long) t->rss,(unsigned long long) t->vboReserved,
+            (unsigned long long) t->vboUsed,(unsigned long long) t->texResident,
+            (unsigned long long) t->texBudget,t->assetsQueued,t->assetsDecoded,
+            (unsigned long long) t->inputEvents,(unsigned long long) t->inputDropped) ;
+    fflush(csv) ;
+
+} // write_csv
+
+
+
+int main(int argc, char **argv)
+{
+    const TELEMETRY_T *shared ;
+    TELEMETRY_T t ;
+    struct timespec pause ;
+    char name[64] = "" ;
+    char *csvName = NULL ;
+    FILE *csv = NULL ;
+    int interval = DEF_INTERVAL_MS, count = 0, batch = 0 ;
+    int opt, n ;
+
+    while ( ( opt = getopt(argc, argv, "n:i:c:bo:") ) != -1 ) {
+        switch ( opt ) {
+            case 'n' :
+                snprintf(name, sizeof( name ), "%s", optarg) ;
+                break ;
+            case 'i' :
+                interval = atoi(optarg) ;
+                if ( interval < 1 ) interval = 1 ;
+                break ;
+            case 'c' :
+                count = atoi(optarg) ;
+                break ;
+            case 'b' :
+                batch = 1 ;
+                break ;
+            case 'o' :
+                csvName = optarg ;
+                break ;
+            default :
+                usage(argv[0]) ;
+                return 2 ;
+        }
+    }
+    if ( !batch && !isatty(STDOUT_FILENO) ) batch = 1 ;
+
+    if ( name[0] == '\0' && !telemetryFindNewest(name, sizeof( name )) ) {
+        fprintf(stderr,VERSION "No running esTri found in %s.\n",TELEMETRY_SHM_DIR) ;
+        return 1 ;
+    }
+    shared = telemetryAttach(name) ;
+    if ( shared == NULL ) return 1 ;
+
+    if ( csvName && ( csv = fopen(csvName, "a") ) == NULL ) {
+        fprintf(stderr,VERSION "Unable to open '%s', %s.\n",csvName,strerror(errno)) ;
+        return 1 ;
+    }
+    if ( batch ) printf(VERSION "Watching '%s'.\n",name) ;
+
+    pause.tv_sec = interval / 1000 ;
+    pause.tv_nsec = ( interval % 1000 ) * 1000000L ;
+    for ( n = 0 ; count == 0 || n < count ; ++n ) {
+        if ( n > 0 ) nanosleep(&pause, NULL) ;
+        if ( !telemetryRead(shared, &t) ) {
+            fprintf(stderr,VERSION "'%s' is always being written.\n",name) ;
+            continue ;
+        }
+        if ( t.exiting || ( kill( t.pid, 0 ) != 0 && errno != EPERM ) ) {
+            printf(VERSION "esTri %d has exited.\n",t.pid) ;
+            break ;
+        }
+        if ( batch ) show_line(&t, n % 20 == 0) ;
+        else show_screen(&t) ;
+        if ( csv ) write_csv(csv, &t) ;
+    }
+
+    if ( csv ) fclose( csv ) ;
+    telemetryDetach(shared) ;
+    return 0 ;
+
+} // main
@@ -24,40 +24,108 @@ gl_FragColor deprecated after version 120. (=GLSL v1.20).
   25/6/16 v1.3 Correctly rotating vertex-coloured cube using VBOs. 
   26/6/16 v1.4 Added routine rotating textured cube not using VBOs.
   27/6/16 v1.5 Added routine rotating vertex-coloured sphere using VBOs.
+  18/10/26 v1.6 Added routine of textured cubes sharing one texture atlas.
+  18/10/26 v1.7 Added routine panning over a tile streamed image, options.
+  18/10/26 v1.8 Textured cube image loads in the background, not before start.
+  18/10/26 v1.9 Option to stream per-frame client arrays through dynamic VBOs.
+  18/10/26 v1.10 Objects sub-allocated from shared VBO/IBO pools.
+  18/10/26 v1.11 Headless option, renders off screen with uncapped swaps.
+  18/10/26 v1.12 Window system (dispmanx/x11/headless) chosen at startup.
+  18/10/26 v1.13 Frame time percentiles per phase, CSV/JSON export.
+  18/10/26 v1.14 Profiling zones, Chrome trace export.
+  18/10/26 v1.15 Hardware performance counters per frame phase.
+  18/10/26 v1.16 GL call/upload counts per frame when built with GLCOUNT=1.
+  18/10/26 v1.17 GL command trace recording (GLTRACE=1), random seed option.
+  18/10/26 v1.18 Capacity stress routine, finds the most objects within budget.
+  18/10/26 v1.19 Input devices read on their own thread, ESC seen next frame.
+  18/10/26 v1.20 Messages written by a logger thread, log level option.
+  18/10/26 v1.21 Live stats published to shared memory for esTop.bin.
+  18/10/26 v1.22 Control socket, routine/slices/streaming changed while running.
+  18/10/26 v1.23 Startup run as a task graph, CPU work overlaps window creation.
+  18/10/26 v1.24 Shader library, one source pair with features, binary cache.
+  18/10/26 v1.25 Uniforms found by reflection, only changed values uploaded.
+  18/10/26 v1.26 Shader sources from files, rebuilt between frames when edited.
+  18/10/26 v1.27 Render on demand option, frames only drawn when damaged.
+  18/10/26 v1.28 Frame pacing to a target rate, swap interval, input latency.
 */
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
 #include <ctype.h>
+#include <time.h>
 #include <sys/time.h>
 #include <limits.h>
+#include <unistd.h>
 
 #include "ESUtil.h"
 #include "utils.h"
-
-#define VERSION  "esTri v1.5: "
+#include "atlas.h"
+#include "texstream.h"
+#include "assets.h"
+#include "dynbuf.h"
+#include "vbopool.h"
+#include "framestats.h"
+#include "stress.h"
+#include "input.h"
+#include "log.h"
+#include "telemetry.h"
+#include "control.h"
+#include "startup.h"
+#include "shaderlib.h"
+#include "damage.h"
+#include "pacer.h"
+#include "profile.h"
+#include "perfctr.h"
+#include "glcount.h"
+#include "gltrace.h"
+
+#define VERSION  "esTri v1.28: "
 
 // Routines available :
 // 1 = Original red triangle.
 // 2 = Rotating vertex-coloured ES cube.
 // 3 = Rotating textured ES cube.
 // 4 = Rotating vertex-coloured ES Sphere
+// 5 = Rotating textured ES cubes sharing one texture atlas.
+// 6 = Panning over a large image streamed as texture tiles.
+// 7 = Capacity stress, objects added until over the frame budget.
 #define DEF_ROUTINE         1         // Which routine to display.
+#define NROUTINES           7
 
 #define DEF_PERIOD          5.0f      // Default display period in seconds.
 
+#define DEF_IMAGE      "goldfish.tga"  // Default texture image.
+#define DEF_STREAM_TILE    64         // Default streamed tile size in pixels.
+#define DEF_SLICES        350         // Sphere slices, <=360 for USHORT indices.
+#define STREAM_UPLOADS      2         // Max. tile uploads per frame.
+#define STREAM_VIEW      0.6f         // Fraction of the image in view.
+#define TELEMETRY_REFRESH_US 1000000.0  // Telemetry percentiles and memory.
+#define SHADER_WARM_US   1000.0       // Cached programs loaded a frame.
+#define SHADER_RELOAD_US 1000.0       // Edited programs started a frame.
+#define SHADER_POLL_US   2000.0       // Idle wait while programs are rebuilt.
+#define DAMAGE_MARGIN       2         // Pixels round an object's damage.
+
 
 #define MICRO         1000000.0       // Microseconds in a second. 
 
 // Maximum number of object types that can be setup.
 #define MAXNOBJECTS        10
 
-#define MAXNVBOIDS         10
+// Pool allocations per object.
+#define VBO_VERTEX          0
+#define VBO_COLOUR          1
+#define VBO_INDEX           2
+#define NVBOS               3
 
 #define BUF_OFFSET(i)   ((void *)(i))
 
+// No. of image variants packed into the atlas for routine 5.
+#define NATLASIMAGES        4
+
 
 typedef struct {
     GLuint   nv ;              // no. of vertices
@@ -68,13 +136,13 @@ typedef struct {
     GLfloat  *c ;              // colour(r,g,b) per vertex
     GLushort *i ;              // indices
     GLuint   program ;         // Vertex/Fragmenter Shader program handle.
-    GLuint   vboIds[MAXNVBOIDS] ;  // five possible VBO ids(V/N/C/TC/I)
-    GLuint   nvboIds ;         // no. of vboIds setup.
+    int      vbo[NVBOS] ;      // VBO pool handles (V/C/I), -1 = none
+    int      nvbos ;           // no. of pool handles setup.
     ESMatrix modelMat ;        // model matrix
     ESMatrix viewMat ;         // view matrix
     ESMatrix projMat ;         // projection matrix
     ESMatrix mvpMat ;          // model*view*projection matrix
-    GLuint   mvpId ;           // MVP matrix id handle
+    GLfloat  radius ;          // largest vertex coordinate, 0 = not found yet
 } OBJECT_T ;
 
 
@@ -92,24 +160,74 @@ typedef struct {
 
     // Handle to a program object  
     GLuint   programObject;         // Vertex/Fragmenter Shader program handle.
+    SHADERLIB_PROGRAM_T *program ;  // Its attributes and uniform values.
 
-    int      keyboard_fd;           // Keyboard file descriptor.          
+    INPUT_T *input;                 // Keyboard/mouse/touch events, or NULL.
     int      count;                 // Loop count
     double   etime;                 // Elapsed time (us)
     int      toexit;                // Set to exit
 
     float    aspect;                // screen aspect ratio
+    int      winWidth;              // Window size, 0 = default.
+    int      winHeight;
 
+    char    *imagefn;               // Image file name
     char    *image;
     int      width;                 // image size
     int      height;
     GLuint   textureId ;            // Texture handle
-
-// Probably should be in OBJECT_T.   
-    GLint    samplerLoc;            // Textured sampler location
-    GLint    positionLoc;           // Attribute locations
-    GLint    colourLoc; 
-    GLint    texCoordLoc;
+    ATLAS_T  atlas ;                // Packed images for routine 5.
+
+    ASSETS_T *assets ;              // Background asset loader.
+    ASSET_T  *texAsset ;            // Routine 3 texture, once ready.
+
+    VBOPOOL_T vpool ;               // Shared vertex buffers for all objects.
+    VBOPOOL_T ipool ;               // Shared index buffers.
+
+    int      dynMode ;              // -1 = client arrays, else DYNBUF_ mode.
+    DYNBUF_T vbuf ;                 // Streamed vertex data.
+    DYNBUF_T ibuf ;                 // Streamed indices.
+
+    FRAMESTATS_T *stats ;           // Frame time histograms.
+    double   budget ;               // Frame budget (us), 0 = 60Hz.
+    char    *statsName ;            // CSV/JSON file name prefix, or NULL.
+    char    *traceName ;            // Chrome trace file, or NULL.
+    PERFCTR_T *perf ;               // Render thread counters, or NULL.
+    char    *glTraceName ;          // GL command trace file, or NULL.
+    unsigned int seed ;             // Random colours seed.
+    int      seeded ;               // -S given.
+    int      perfPhase[FSTATS_NPHASES] ;
+
+    TEXSTREAM_T *stream ;           // Tile streamed image for routine 6.
+    size_t   streamBudget ;         // GPU bytes for tiles, 0 = default.
+    int      streamTile ;           // Tile size in pixels.
+    int      viewx0, viewy0 ;       // Image pixels in view.
+    int      viewx1, viewy1 ;
+
+    STRESS_T *stress ;              // Capacity finder for routine 7.
+    int      stressPath ;           // STRESS_ draw path.
+
+    int      logLevel ;             // LOG_ERROR .. LOG_DEBUG.
+    STARTUP_T *startup ;            // Startup tasks, until the first frame.
+    double   firstFrameMs ;         // Time to first frame.
+    TELEMETRY_T *telemetry ;        // Shared memory stats, or NULL.
+    CONTROL_T *control ;            // Control socket commands, or NULL.
+    int      onDemand ;             // Only draw frames that changed.
+    DAMAGE_T *damage ;              // Their damage, or NULL.
+    EGLint   lastRect[4] ;          // Object's damage last frame, width 0 = none.
+    PACER_T *pacer ;                // Frame pacing.
+    double   targetHz ;             // Frame rate paced to, 0 = none.
+    int      swapInterval ;         // -1 = the platform's.
+    double   inputTime ;            // us, earliest input event not yet shown, or 0.
+    SHADERLIB_T *shaders ;          // Programs of routines 1 to 6.
+    int      basicSource ;          // Their shaders.
+    char    *shaderCache ;          // Program binary directory, NULL = default.
+    char    *shaderDir ;            // Shader source files, or NULL for built-in.
+    char    *controlPath ;          // Control socket name, or NULL.
+    int      slices ;               // Sphere slices for routine 4.
+    double   statsStart ;           // us, frame stats last reset.
+    double   telemetryRefresh ;     // us, next percentile/memory refresh.
+    unsigned long telemetryFrames ; // frames at the last refresh.
 
 } UserData;
 
@@ -124,6 +242,55 @@ UserData  userData;
 //------------------------------------------------------------------------------
 
 
+static void usage(char *prog)
+{
+    printf("Usage : %s [options] <Routine> <Period(s)>\n",prog) ;
+    printf("Routines available :\n") ;
+    printf("  1 = Original red triangle.\n") ;
+    printf("  2 = Coloured rotating cube.\n") ;
+    printf("  3 = Textured rotating cube.\n") ;
+    printf("  4 = Coloured rotating sphere.\n") ;
+    printf("  5 = Atlas textured rotating cubes.\n") ;
+    printf("  6 = Panning over a tile streamed image.\n") ;
+    printf("  7 = Capacity stress, objects added until over budget.\n") ;
+    printf("Options :\n") ;
+    printf("  -i <file.tga>  Texture image (default %s).\n",DEF_IMAGE) ;
+    printf("  -m <KB>        Streamed tile texture budget.\n") ;
+    printf("  -t <pixels>    Streamed tile size (default %d).\n",DEF_STREAM_TILE) ;
+    printf("  -d <mode>      Stream client arrays through VBOs :\n") ;
+    printf("                 auto, orphan, subdata or map (GL_OES_mapbuffer).\n") ;
+    printf("  -p <platform>  Window system : %s\n",esPlatformNames()) ;
+    printf("                 (default $ES_PLATFORM, else the first).\n") ;
+    printf("  -H             Headless, the same as -p headless.\n") ;
+    printf("  -s <W>x<H>     Window/off screen size (default %dx%d,\n",
+           ES_WINDOW_DEF_WIDTH,ES_WINDOW_DEF_HEIGHT) ;
+    printf("                 dispmanx is full screen).\n") ;
+    printf("  -f <ms>        Frame time budget (default %.1fms).\n",FSTATS_DEF_BUDGET / 1000.0) ;
+    printf("  -o <name>      Write frame stats to <name>.csv and <name>.json.\n") ;
+    printf("  -T <file.json> Record profiling zones, write a Chrome trace.\n") ;
+    printf("  -P             Performance counters (IPC, misses) per phase.\n") ;
+    printf("  -R <file>      Record a GL command trace for glreplay.bin\n") ;
+    printf("                 (built with 'make GLTRACE=1').\n") ;
+    printf("  -S <seed>      Random number seed (default the time).\n") ;
+    printf("  -C <path>      Routine 7 draw path : draws, batch, instance\n") ;
+    printf("                 or cull (default draws). Runs until the knee.\n") ;
+    printf("  -v <level>     Log level : error, warn, info (default) or debug.\n") ;
+    printf("  -c <socket>    Take commands on a Unix domain socket, 'help'\n") ;
+    printf("                 lists them (e.g. socat - UNIX-CONNECT:<socket>).\n") ;
+    printf("  -b <dir>       Program binary cache, 'none' to always compile\n") ;
+    printf("                 (default ~/.cache/%s).\n",SHADERLIB_DIR) ;
+    printf("  -x <dir>       Shader sources from <dir>/basic.vert and .frag,\n") ;
+    printf("                 written if missing, rebuilt when edited.\n") ;
+    printf("  -D             Render on demand, draw only when the scene,\n") ;
+    printf("                 input or a command changed something.\n") ;
+    printf("  -r <Hz>        Target frame rate, frames start as late as\n") ;
+    printf("                 they can and still make it (default none).\n") ;
+    printf("  -I <n>         Swap interval, vertical syncs per swap,\n") ;
+    printf("                 0 not to wait (default the platform's).\n") ;
+} // usage
+
+
+
 /***********************************************************
  * Name: parse
  *
@@ -133,6 +300,7 @@ UserData  userData;
  *     ESContext *esContext - holds display/user data.
  *
  * Description: Function to extract input parameters..
+ *              Options may come before or after <Routine> <Period(s)>.
  *
  * Returns: void
  *
@@ -140,30 +308,127 @@ UserData  userData;
 static void parse(int argc, char **argv, ESContext *esContext)
 {
     UserData *user = esContext->userData;
+    char *prog = argv[0] ;
+    int opt ;
 
     // Set up the default values.
     user->routine = DEF_ROUTINE ;
     user->period = DEF_PERIOD ;
+    user->imagefn = DEF_IMAGE ;
+    user->streamTile = DEF_STREAM_TILE ;
+    user->streamBudget = 0 ;
+    user->dynMode = -1 ;
+    user->logLevel = LOG_INFO ;
+    user->slices = DEF_SLICES ;
+    user->swapInterval = -1 ;
+
+    while ( ( opt = getopt(argc, argv, "i:m:t:d:p:Hs:f:o:T:PR:S:C:v:c:b:x:Dr:I:") ) != -1 ) {
+        switch ( opt ) {
+            case 'i' :
+                user->imagefn = optarg ;
+                break ;
+            case 'm' :
+                user->streamBudget = (size_t) atoi(optarg) << 10 ;
+                break ;
+            case 't' :
+                user->streamTile = atoi(optarg) ;
+                break ;
+            case 'd' :
+                user->dynMode = dynbufModeFromName(optarg) ;
+                if ( user->dynMode < 0 ) {
+                    usage(prog) ;
+                    exit(1) ;
+                }
+                break ;
+            case 'p' :
+                if ( !esSetPlatform(esContext, optarg) ) exit(1) ;
+                break ;
+            case 'H' :
+                esSetPlatform(esContext, "headless") ;
+                break ;
+            case 's' :
+                if ( sscanf(optarg, "%dx%d", &user->winWidth, &user->winHeight) != 2 ) {
+                    usage(prog) ;
+                    exit(1) ;
+                }
+                break ;
+            case 'f' :
+                user->budget = atof(optarg) * 1000.0 ;
+                break ;
+            case 'o' :
+                user->statsName = optarg ;
+                break ;
+            case 'T' :
+                user->traceName = optarg ;
+                profStart() ;
+                break ;
+            case 'P' :
+                user->perf = perfctrOpen() ;   // For this, the render thread.
+                if ( user->perf == NULL ) logInfo("Perf: No counters available.\n") ;
+                break ;
+            case 'R' :
+                user->glTraceName = optarg ;
+                break ;
+            case 'S' :
+                user->seed = (unsigned int) strtoul(optarg, NULL, 0) ;
+                user->seeded = 1 ;
+                break ;
+            case 'C' :
+                user->stressPath = stressPathFromName(optarg) ;
+                if ( user->stressPath < 0 ) {
+                    usage(prog) ;
+                    exit(1) ;
+                }
+                break ;
+            case 'v' :
+                user->logLevel = logLevelFromName(optarg) ;
+                if ( user->logLevel < 0 ) {
+                    usage(prog) ;
+                    exit(1) ;
+                }
+                break ;
+            case 'c' :
+                user->controlPath = optarg ;
+                break ;
+            case 'b' :
+                user->shaderCache = optarg ;
+                break ;
+            case 'x' :
+                user->shaderDir = optarg ;
+                break ;
+            case 'D' :
+                user->onDemand = 1 ;
+                break ;
+            case 'r' :
+                user->targetHz = atof(optarg) ;
+                break ;
+            case 'I' :
+                user->swapInterval = atoi(optarg) ;
+                break ;
+            default :
+                usage(prog) ;
+                exit(1) ;
+        }
+    }
+    argc -= optind ;
+    argv += optind ;
 
-    if ( argc > 1 ) {
-        if ( *argv[1] == '?' ) {
-            printf("Usage : %s <Routine> <Period(s)>\n",argv[0]) ;
-            printf("Routines available :\n") ;
-            printf("  1 = Original red triangle.\n") ;
-            printf("  2 = Coloured rotating cube.\n") ;
-            printf("  3 = Textured rotating cube.\n") ;
-            printf("  4 = Coloured rotating sphere.\n") ;
+    // Without a budget given, a frame's is its share of the target rate.
+    if ( user->budget <= 0.0 && user->targetHz > 0.0 ) user->budget = MICRO / user->targetHz ;
+
+    if ( argc > 0 ) {
+        if ( *argv[0] == '?' ) {
+            usage(prog) ;
             exit(0) ;
         }
-        if ( isdigit(*argv[1]) )    // Limited to single digit!
-            user->routine = (uint32_t) atoi(argv[1]) ;   
-        if ( argc > 2 ) {
-            GLfloat fP = (GLfloat) atof(argv[2]) ;
+        if ( isdigit(*argv[0]) )    // Limited to single digit!
+            user->routine = (uint32_t) atoi(argv[0]) ;   
+        if ( argc > 1 ) {
+            GLfloat fP = (GLfloat) atof(argv[1]) ;
             if ( fP > 0.001f ) user->period = fP ;   
         }	
     }
 
-    printf("Routine : %u\nPeriod : %.3fs\n",user->routine,user->period) ;
 //   exit(0) ;   
 
 } // parse()
@@ -173,23 +438,24 @@ static void parse(int argc, char **argv, ESContext *esContext)
 
 
 /***********************************************************
- * Name: exit_func
+ * Name: free_routine
  *
- * Arguments: None.
+ * Arguments:
+ *     user - the routine's objects, program and textures.
+ *
+ * Description: Frees what the routine set up, leaving the
+ *              window, the pools and the stream buffers, so
+ *              the same or another routine can be set up again.
  *
- * Description: Functions to run on exit.
- *              Function to be passed to atexit().
  * Returns: void
  *
  ***********************************************************/
-
-static void exit_func(void)
+static void free_routine(UserData *user)
 {
-    UserData *user = esContextp->userData;
     OBJECT_T *ob = NULL ;
+    GLint nattribs = 0 ;
     int i ;
 
-//    printf("Exiting...\n") ;
 //    printf("Deleting %d objects...\n",user->nobjs) ;
    
     for ( i = 0 ; i < user->nobjs ; ++i ) {
@@ -202,22 +468,114 @@ static void exit_func(void)
             if ( ob->c ) free( ob->c ) ;
             if ( ob->program != user->programObject )
                 glDeleteProgram( ob->program ) ;
-            if ( ob->nvboIds > 0 )
-                glDeleteBuffers(ob->nvboIds, ob->vboIds) ;
+            if ( ob->nvbos > 0 ) {
+                vbopoolFree(&user->vpool, ob->vbo[VBO_VERTEX]) ;
+                vbopoolFree(&user->vpool, ob->vbo[VBO_COLOUR]) ;
+                vbopoolFree(&user->ipool, ob->vbo[VBO_INDEX]) ;
+            }
         }
     }
+    memset( user->object, 0, sizeof( user->object ) ) ;
+    user->nobjs = 0 ;
+    user->obj = 0 ;
 //    printf("Deleted %d objects.\n",user->nobjs) ;
 
-    glDeleteProgram( user->programObject ) ;
-//    printf("Deleted program object.\n") ;
+    // The program is kept by the shader library.
+    user->programObject = 0 ;
+    user->program = NULL ;
+
+    // The atlas texture goes with the atlas, the loaded texture of
+    // routine 3 belongs to the asset.
+    atlasFree( &user->atlas ) ;
+    if ( user->textureId && user->routine != 5 &&
+         !( user->texAsset && user->textureId == user->texAsset->textureId ) )
+        glDeleteTextures( 1, &user->textureId ) ;
+    user->textureId = 0 ;
+
+    if ( user->stream ) {
+        texstreamPrintStats( user->stream ) ;
+        texstreamClose( user->stream ) ;
+        user->stream = NULL ;
+    }
+
+    if ( user->stress ) {
+        stressReport( user->stress ) ;
+        stressDestroy( user->stress ) ;
+        user->stress = NULL ;
+    }
+
+    // No attribute left pointing at freed client arrays.
+    glGetIntegerv( GL_MAX_VERTEX_ATTRIBS, &nattribs ) ;
+    for ( i = 0 ; i < nattribs ; ++i ) glDisableVertexAttribArray( i ) ;
+    glBindBuffer( GL_ARRAY_BUFFER, 0 ) ;
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 ) ;
+    glUseProgram( 0 ) ;
+
+} // free_routine
+
+
+
+
+
+/***********************************************************
+ * Name: exit_func
+ *
+ * Arguments: None.
+ *
+ * Description: Functions to run on exit.
+ *              Function to be passed to atexit().
+ * Returns: void
+ *
+ ***********************************************************/
+
+static void exit_func(void)
+{
+    UserData *user = esContextp->userData;
+
+    // Commands are not taken from here on.
+    controlStop( user->control ) ;
+    startupDestroy( user->startup ) ;
+
+    free_routine(user) ;
+
+    vbopoolDestroy( &user->vpool ) ;
+    vbopoolDestroy( &user->ipool ) ;
+
+    assetsShutdown( user->assets ) ;
+
+    if ( user->traceName ) profWriteTrace( user->traceName ) ;
+
+    if ( user->dynMode >= 0 ) {
+        if ( user->count > 0 )
+            logInfo("Dynbuf: %s streamed %.1fKB/frame, %lu full buffers.\n",
+                    dynbufModeName(user->vbuf.mode),
+                    ( user->vbuf.bytes + user->ibuf.bytes ) / 1024.0 / user->count,
+                    user->vbuf.wraps + user->ibuf.wraps) ;
+        dynbufFree( &user->vbuf ) ;
+        dynbufFree( &user->ibuf ) ;
+    }
+
+    telemetryDestroy( user->telemetry ) ;
+    framestatsDestroy( user->stats ) ;
+    pacerDestroy( user->pacer ) ;
+    perfctrClose( user->perf ) ;
+
+    shaderlibDestroy( user->shaders ) ;
+
+    gltraceStop() ;
 
     // Close RPi display.
     esExit( esContextp ) ;
 //    printf("Closed display.\n") ;
 
-    // Restore terminal settings.
+    // Stop the input thread, restore terminal settings.
+    inputStop( user->input ) ;
+    damageDestroy( user->damage ) ;     // no thread writes its eventfd now
     restore_terminal() ;
 
+    // Write out the messages still queued.
+    logStop() ;
+
 } // exit_func()
 
 
@@ -228,14 +586,14 @@ static void printVertices(OBJECT_T *ob, int obj)
     GLfloat  *vp = ob->v ;
     GLushort *ip = ob->i ;
 
-    printf("Object %d:\n",obj) ;
+    logInfo("Object %d:\n",obj) ;
     for ( i = 0 ; i < ob->nv ; ++i, vp += 3 ) {
-        printf("v%d : (%.3f,%.3f,%.3f)\n",i,vp[0],vp[1],vp[2]) ;
+        logInfo("v%d : (%.3f,%.3f,%.3f)\n",i,vp[0],vp[1],vp[2]) ;
     } // each vertex
     for ( i = 0 ; i < ob->ni ; ++i, ip += 1 ) {
-        printf("%d:%u,",i,ip[0]) ;
+        logInfo("%d:%u,",i,ip[0]) ;
     } // each index
-    printf("\n") ;
+    logInfo("\n") ;
     
 } //  printVertices
 */
@@ -277,63 +635,70 @@ GLuint loadTexture2D(char *image, int width, int height )
 
 
 
-// Set up Vertex Buffer Objects(vertices/normals/textureCoordinates/colours).
-// Working with VBOs which uses vertex data preloaded into GPU memory.
-// Currently sets up V/C/I VBO buffers for draw_coloured_cube().
-static void init_withVBOs(UserData *user, OBJECT_T *ob) 
+// Point the attributes and index buffer at the object's pool allocations.
+// Done before every draw as a pool compaction may move them. An object
+// the pools had no room for is drawn from its client arrays.
+// Returns the indices for glDrawElements().
+static const GLvoid *bind_withVBOs(UserData *user, OBJECT_T *ob)
 {
-    GLsizeiptr nvbytes = ob->nv * sizeof( GLfloat ) * 3 ;
-//    GLsizeiptr ntbytes = ob->nv * sizeof( GLfloat ) * 2 ;
-    GLsizeiptr nibytes = ob->ni * sizeof( GLushort ) ;
-//    GLfloat color[3] = { 1.0f, 1.0f, 1.0f } ;
-
-
-    ob->nvboIds = 5 ; 
-    glGenBuffers(ob->nvboIds, ob->vboIds) ;
+    GLintptr offset ;
+    GLuint vboId ;
+
+    if ( ob->nvbos == 0 ) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0) ;
+        glVertexAttribPointer(user->program->attrib[SHADER_POSITION], 3, GL_FLOAT, GL_FALSE, 0, ob->v);
+        glVertexAttribPointer(user->program->attrib[SHADER_COLOURS], 3, GL_FLOAT, GL_FALSE, 0, ob->c);
+        return ob->i ;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[0]) ;
-    glBufferData(GL_ARRAY_BUFFER, nvbytes, ob->v, GL_STATIC_DRAW) ;
+    // Load the vertex position
+    vboId = vbopoolBuffer(&user->vpool, ob->vbo[VBO_VERTEX], &offset) ;
+    glBindBuffer(GL_ARRAY_BUFFER, vboId) ;
+    glVertexAttribPointer(user->program->attrib[SHADER_POSITION], 3, GL_FLOAT, GL_FALSE, 0, BUF_OFFSET(offset));
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ob->vboIds[4]) ;
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, nibytes, ob->i, GL_STATIC_DRAW) ;
+    // Load the vertex color
+    vboId = vbopoolBuffer(&user->vpool, ob->vbo[VBO_COLOUR], &offset) ;
+    glBindBuffer(GL_ARRAY_BUFFER, vboId) ;
+    glVertexAttribPointer(user->program->attrib[SHADER_COLOURS], 3, GL_FLOAT, GL_FALSE, 0, BUF_OFFSET(offset));
 
-//    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[1]) ;
-//    glBufferData(GL_ARRAY_BUFFER, nvbytes, ob->n, GL_STATIC_DRAW) ;
+    vboId = vbopoolBuffer(&user->ipool, ob->vbo[VBO_INDEX], &offset) ;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboId) ;
+    return BUF_OFFSET(offset) ;
 
-    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[2]) ;
-    glBufferData(GL_ARRAY_BUFFER, nvbytes, ob->c, GL_STATIC_DRAW) ;
+} // bind_withVBOs
 
-//    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[3]) ;
-//    glBufferData(GL_ARRAY_BUFFER, ntbytes, ob->t, GL_STATIC_DRAW) ;
 
-    // Load the vertex position
-    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[0]) ;
-    glEnableVertexAttribArray(user->positionLoc) ;
-    glVertexAttribPointer(user->positionLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
- 
-    // Load the vertex color
-    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[2]) ;
-    glEnableVertexAttribArray(user->colourLoc) ;
-    glVertexAttribPointer(user->colourLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-/* 
-    // Load the texture coordinate
-    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[3]) ;
-    glEnableVertexAttribArray(user->texCoordLoc) ;
-    glVertexAttribPointer(user->texCoordLoc, 2, GL_FLOAT, GL_FALSE, 0, 0 );
-   
-    // Bind the texture
-    glActiveTexture ( GL_TEXTURE0 );
-    glBindTexture ( GL_TEXTURE_2D, user->textureId );
+// Set up Vertex Buffer Objects(vertices/colours/indices).
+// Working with VBOs which uses vertex data preloaded into GPU memory.
+// The data is sub-allocated from the shared pools, so objects drawn
+// together share the same buffer objects. 
+// Currently sets up V/C/I VBO buffers for draw_coloured_cube().
+static void init_withVBOs(UserData *user, OBJECT_T *ob) 
+{
+    GLsizeiptr nvbytes = ob->nv * sizeof( GLfloat ) * 3 ;
+    GLsizeiptr nibytes = ob->ni * sizeof( GLushort ) ;
 
-    // Set the sampler texture unit to 0
-    glUniform1i( user->samplerLoc, 0 );
-*/
+    ob->vbo[VBO_VERTEX] = vbopoolAlloc(&user->vpool, ob->v, nvbytes) ;
+    ob->vbo[VBO_COLOUR] = vbopoolAlloc(&user->vpool, ob->c, nvbytes) ;
+    ob->vbo[VBO_INDEX] = vbopoolAlloc(&user->ipool, ob->i, nibytes) ;
+    ob->nvbos = NVBOS ;
+    if ( ob->vbo[VBO_VERTEX] < 0 || ob->vbo[VBO_COLOUR] < 0 || ob->vbo[VBO_INDEX] < 0 ) {
+        logWarn("VBO pool: No room for %d vertices, drawing them from client arrays.\n",ob->nv) ;
+        vbopoolFree(&user->vpool, ob->vbo[VBO_VERTEX]) ;
+        vbopoolFree(&user->vpool, ob->vbo[VBO_COLOUR]) ;
+        vbopoolFree(&user->ipool, ob->vbo[VBO_INDEX]) ;
+        ob->vbo[VBO_VERTEX] = ob->vbo[VBO_COLOUR] = ob->vbo[VBO_INDEX] = -1 ;
+        ob->nvbos = 0 ;
+    }
 
-//    glVertexAttrib3fv(user->colourLoc, color) ;
-//    glUniform3f(user->colourLoc, 1.0f, 0.0f, 0.0f ) ;
+    glEnableVertexAttribArray(user->program->attrib[SHADER_POSITION]) ;
+    glEnableVertexAttribArray(user->program->attrib[SHADER_COLOURS]) ;
+    bind_withVBOs(user,ob) ;
 
-    ob->mvpId = glGetUniformLocation(ob->program, "MVP") ;
+    vbopoolPrintStats(&user->vpool,"vertex") ;
+    vbopoolPrintStats(&user->ipool,"index") ;
 
 } // init_withVBOs
 
@@ -345,26 +710,25 @@ static void init_withVBOs(UserData *user, OBJECT_T *ob)
 // Currently sets up V/C/I generic buffers for draw_textured_cube().
 static void init_withoutVBOs(UserData *user, OBJECT_T *ob) 
 {
+    SHADERLIB_PROGRAM_T *pg = user->program ;
 
     glBindBuffer(GL_ARRAY_BUFFER, 0) ;
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0) ;
 
     // Load the vertex position
-    glVertexAttribPointer( user->positionLoc, 3, GL_FLOAT, GL_FALSE, 0, ob->v );
+    glVertexAttribPointer( pg->attrib[SHADER_POSITION], 3, GL_FLOAT, GL_FALSE, 0, ob->v );
     // Load the texture coordinate
-    glVertexAttribPointer( user->texCoordLoc, 2, GL_FLOAT, GL_FALSE, 0, ob->t );
+    glVertexAttribPointer( pg->attrib[SHADER_TEXCOORD], 2, GL_FLOAT, GL_FALSE, 0, ob->t );
 
-    glEnableVertexAttribArray( user->positionLoc );
-    glEnableVertexAttribArray( user->texCoordLoc );
+    glEnableVertexAttribArray( pg->attrib[SHADER_POSITION] );
+    glEnableVertexAttribArray( pg->attrib[SHADER_TEXCOORD] );
 
     // Bind the texture
     glActiveTexture( GL_TEXTURE0 );
     glBindTexture( GL_TEXTURE_2D, user->textureId );
 
     // Set the sampler texture unit to 0
-    glUniform1i( user->samplerLoc, 0 );
-
-    ob->mvpId = glGetUniformLocation(ob->program, "MVP") ;
+    shaderlibSeti( pg, pg->known[SHADER_SAMPLER], 0 );
 
 } // init_withoutVBOs
 
@@ -373,21 +737,22 @@ static void init_withoutVBOs(UserData *user, OBJECT_T *ob)
 
 
 
-static int initialise_coloured_cube(ESContext *esContext)
+static int generate_coloured_cube(UserData *user)
 {
-    UserData *user = esContext->userData;
     int obj = user->nobjs ;                 // A new object
     OBJECT_T *ob = NULL ;
-    int i , ret = 0 ;
+    int i ;
     GLfloat *cp = NULL ;
 
     if ( obj >= MAXNOBJECTS ) {
-        printf("Not initialise: Reached maximum no. of objects %d!\n",obj) ; 
+        logWarn("Not initialise: Reached maximum no. of objects %d!\n",obj) ; 
         return 0 ;
     }
     ob = &user->object[obj] ;
 
+    PROF_BEGIN("esGenCube") ;
     ob->ni = esGenCube(2.0,&ob->v,&ob->n,&ob->t,&ob->i,&ob->nv) ;
+    PROF_END("esGenCube") ;
 
 //    printVertices(ob,obj) ;
 
@@ -401,46 +766,38 @@ static int initialise_coloured_cube(ESContext *esContext)
          cp[2] = urandom(255) / 255.0f ;   
     } // each vertex
 
-    ob->program = user->programObject ;  // for now use main shaders
-
-    init_withVBOs(user,ob) ;
-
     user->obj = obj ;   // current object index number
     user->nobjs++ ;
 
-    return ret ;   
+    return 1 ;
 
-} // initialise_coloured_cube
+} // generate_coloured_cube
 
 
 
-static int initialise_textured_cube(ESContext *esContext)
+static int generate_textured_cube(UserData *user)
 {
-    UserData *user = esContext->userData;
     int obj = user->nobjs ;                 // A new object
     OBJECT_T *ob = NULL ;
-    int ret = 0 ;
 
     if ( obj >= MAXNOBJECTS ) {
-        printf("Not initialise: Reached maximum no. of objects %d!\n",obj) ; 
+        logWarn("Not initialise: Reached maximum no. of objects %d!\n",obj) ; 
         return 0 ;
     }
     ob = &user->object[obj] ;
 
+    PROF_BEGIN("esGenCube") ;
     ob->ni = esGenCube(2.0,&ob->v,&ob->n,&ob->t,&ob->i,&ob->nv) ;
+    PROF_END("esGenCube") ;
 
 //    printVertices(ob,obj) ;
 
-    ob->program = user->programObject ;  // for now use main shaders
-
-    init_withoutVBOs(user,ob) ;
-
     user->obj = obj ;   // current object index number
     user->nobjs++ ;
 
-    return ret ;   
+    return 1 ;
 
-} // initialise_textured_cube
+} // generate_textured_cube
 
 
 
@@ -449,27 +806,28 @@ static int initialise_textured_cube(ESContext *esContext)
 
 
 
-static int initialise_coloured_sphere(ESContext *esContext)
+static int generate_coloured_sphere(UserData *user)
 {
-    UserData *user = esContext->userData;
     int obj = user->nobjs ;                 // A new object
     OBJECT_T *ob = NULL ;
-    int i , ret = 0 ;
+    int i ;
     GLfloat *cp = NULL ;
 
     if ( obj >= MAXNOBJECTS ) {
-        printf("Not initialise: Reached maximum no. of objects %d!\n",obj) ; 
+        logWarn("Not initialise: Reached maximum no. of objects %d!\n",obj) ; 
         return 0 ;
     }
     ob = &user->object[obj] ;
 
     // Use <=350 slices = 61776 vertices & 367500 indices!
-    ob->ni = esGenSphere(350,1.0,&ob->v,&ob->n,&ob->t,&ob->i,&ob->nv) ;
+    PROF_BEGIN("esGenSphere") ;
+    ob->ni = esGenSphere(user->slices,1.0,&ob->v,&ob->n,&ob->t,&ob->i,&ob->nv) ;
+    PROF_END("esGenSphere") ;
 
-    printf("Created sphere: %d vertices and %d indices.\n",ob->nv,ob->ni) ;
+    logInfo("Created sphere: %d vertices and %d indices.\n",ob->nv,ob->ni) ;
     if ( ob->nv > USHRT_MAX ) {
-        fprintf(stderr,"Generated too many vertices, GPU limit is %d for the USHORT indices!!\n",USHRT_MAX) ;
-        exit(0) ;
+        logError("Generated too many vertices, GPU limit is %d for the USHORT indices!!\n",USHRT_MAX) ;
+        return 0 ;
     }
 
 //    printVertices(ob,obj) ;
@@ -484,16 +842,89 @@ static int initialise_coloured_sphere(ESContext *esContext)
          cp[2] = urandom(255) / 255.0f ;   
     } // each vertex
 
-    ob->program = user->programObject ;  // for now use main shaders
+    user->obj = obj ;   // current object index number
+    user->nobjs++ ;
+
+    return 1 ;
+
+} // generate_coloured_sphere
+
+
+
+// A row of cubes, each textured with a different atlas image, merged
+// into one object so they are drawn with one bind and one draw call.
+static int generate_atlas_cubes(UserData *user)
+{
+    int obj = user->nobjs ;                 // A new object
+    OBJECT_T *ob = NULL ;
+    int i, j, k, ncubes = 0 ;
+    GLfloat *v = NULL, *t = NULL ;
+    GLushort *ind = NULL ;
+    GLuint nv = 0 , ni = 0 ;
+
+    if ( obj >= MAXNOBJECTS ) {
+        logWarn("Not initialise: Reached maximum no. of objects %d!\n",obj) ; 
+        return 0 ;
+    }
+    ob = &user->object[obj] ;
+
+    // Only images on the first page share the bound texture.
+    for ( i = 0 ; i < user->atlas.nrects ; ++i )
+        if ( user->atlas.rect[i].page == 0 ) ++ncubes ;
+    if ( ncubes <= 0 ) {
+        logError("No atlas images on the first page to make cubes of!\n") ;
+        return 0 ;
+    }
+    if ( 24 * ncubes > USHRT_MAX ) {
+        logError("Too many atlas cubes, %d, GPU limit is %d vertices for the USHORT indices!!\n",
+                 ncubes,USHRT_MAX) ;
+        return 0 ;
+    }
+
+    ob->nv = 24 * ncubes ;
+    ob->ni = 36 * ncubes ;
+    ob->v = malloc( sizeof(GLfloat) * 3 * ob->nv ) ;
+    ob->t = malloc( sizeof(GLfloat) * 2 * ob->nv ) ;
+    ob->i = malloc( sizeof(GLushort) * ob->ni ) ;
+    if ( ob->v == NULL || ob->t == NULL || ob->i == NULL ) {
+        logError("Atlas cubes: out of memory for %d vertices!\n",ob->nv) ;
+        free( ob->v ) ; free( ob->t ) ; free( ob->i ) ;
+        ob->v = ob->t = NULL ; ob->i = NULL ;
+        ob->nv = ob->ni = 0 ;
+        return 0 ;
+    }
+
+    for ( i = 0, k = 0 ; i < user->atlas.nrects ; ++i ) {
+        GLfloat xoff = ( k - ( ncubes - 1 ) * 0.5f ) * 1.2f ;
+
+        if ( user->atlas.rect[i].page != 0 ) continue ;
 
-    init_withVBOs(user,ob) ;
+        PROF_BEGIN("esGenCube") ;
+        ni = esGenCube(0.8,&v,NULL,&t,&ind,&nv) ;
+        PROF_END("esGenCube") ;
+        atlasRemapTexCoords(&user->atlas,i,t,nv) ;
+
+        for ( j = 0 ; j < nv ; ++j ) {
+            ob->v[(k * nv + j) * 3 + 0] = v[j * 3 + 0] + xoff ;
+            ob->v[(k * nv + j) * 3 + 1] = v[j * 3 + 1] ;
+            ob->v[(k * nv + j) * 3 + 2] = v[j * 3 + 2] ;
+        }
+        memcpy( &ob->t[k * nv * 2], t, sizeof(GLfloat) * 2 * nv ) ;
+        for ( j = 0 ; j < ni ; ++j )
+            ob->i[k * ni + j] = ind[j] + k * nv ;
+
+        free( v ) ; free( t ) ; free( ind ) ;
+        ++k ;
+    } // each atlas image
+
+    logInfo("Created %d atlas cubes: %d vertices and %d indices.\n",ncubes,ob->nv,ob->ni) ;
 
     user->obj = obj ;   // current object index number
     user->nobjs++ ;
 
-    return ret ;   
+    return 1 ;
 
-} // initialise_coloured_sphere
+} // generate_atlas_cubes
 
 
 
@@ -502,23 +933,23 @@ static int initialise_coloured_sphere(ESContext *esContext)
 
 
 
-static int initialise_objects(ESContext *esContext)
+// The routine's meshes and colours, no GL so it may run before the window.
+static int generate_objects(UserData *user)
 {
-    UserData *user = esContext->userData;
-    int ret = 0 ;
-
+    int ret = 1 ;
 
     switch ( user->routine ) {
-        case 1 :
-            break ;
         case 2 :  
-            ret = initialise_coloured_cube(esContext) ;
+            ret = generate_coloured_cube(user) ;
             break ;
         case 3 :  
-            ret = initialise_textured_cube(esContext) ;
+            ret = generate_textured_cube(user) ;
             break ;
         case 4 :  
-            ret = initialise_coloured_sphere(esContext) ;
+            ret = generate_coloured_sphere(user) ;
+            break ;
+        case 5 :  
+            ret = generate_atlas_cubes(user) ;
             break ;
         default :
             break ;
@@ -526,22 +957,80 @@ static int initialise_objects(ESContext *esContext)
 
     return ret ;   
 
+} // generate_objects
+
+
+
+// Upload the generated objects, after the shaders are set up.
+static int initialise_objects(ESContext *esContext)
+{
+    UserData *user = esContext->userData;
+    OBJECT_T *ob = NULL ;
+    int i ;
+
+    for ( i = 0 ; i < user->nobjs ; ++i ) {
+        ob = &user->object[i] ;
+        ob->program = user->programObject ;  // for now use main shaders
+
+        if ( user->routine == 2 || user->routine == 4 )
+            init_withVBOs(user,ob) ;
+        else
+            init_withoutVBOs(user,ob) ;
+    }
+
+    return user->nobjs ;   
+
 } // initialise_objects
 
 
 
+// The routine's program was rebuilt after an edit. It has a new id and
+// its attributes may have moved, so point the objects and arrays at it.
+static void rebind_program(UserData *user)
+{
+    OBJECT_T *ob = NULL ;
+    GLint nattribs = 0 ;
+    int i ;
+
+    if ( user->program == NULL || user->programObject == user->program->id ) return ;
+
+    glGetIntegerv( GL_MAX_VERTEX_ATTRIBS, &nattribs ) ;
+    for ( i = 0 ; i < nattribs ; ++i ) glDisableVertexAttribArray( i ) ;
+    user->programObject = user->program->id ;
+
+    for ( i = 0 ; i < user->nobjs ; ++i ) {
+        ob = &user->object[i] ;
+        ob->program = user->programObject ;
+
+        if ( user->routine == 2 || user->routine == 4 ) {
+            glEnableVertexAttribArray(user->program->attrib[SHADER_POSITION]) ;
+            glEnableVertexAttribArray(user->program->attrib[SHADER_COLOURS]) ;
+        }
+        else
+            init_withoutVBOs(user,ob) ;
+    }
+    damageAll(user->damage) ;
+
+} // rebind_program
+
+
+
 
-static void load_image(UserData *uData)
+static int load_image(UserData *uData)
 {
-    static char *imagefn = "goldfish.tga" ;
+    char *imagefn = uData->imagefn ;
 
+    PROF_BEGIN("esLoadTGA") ;
     uData->image = esLoadTGA(imagefn, &uData->width, &uData->height);
+    PROF_END("esLoadTGA") ;
 
     if (uData->image == NULL) {
-	fprintf(stderr, "No such image '%s'.\n",imagefn);
-	exit(1);
+	logError("No such image '%s'.\n",imagefn);
+	return 0 ;
     }
-    printf("Image '%s' is %d x %d\n", imagefn, uData->width, uData->height);
+    logInfo("Image '%s' is %d x %d\n", imagefn, uData->width, uData->height);
+
+    return 1 ;
 
 } // load_image
 
@@ -550,16 +1039,68 @@ static void load_image(UserData *uData)
 /*  IMPORTANT for OpenGL & GLSL : Know your version numbers!
 static void printGLversion(void)
 {   
-    printf("GL Vendor    :'%s'.\n",glGetString(GL_VENDOR)) ;
-    printf("GL Renderer  :'%s'.\n",glGetString(GL_RENDERER)) ;
-    printf("GL Version   :'%s'.\n",glGetString(GL_VERSION)) ;
-    printf("GLSL Version :'%s'.\n",glGetString(GL_SHADING_LANGUAGE_VERSION)) ;
-    printf("GL Extensions:'%s'.\n",glGetString(GL_EXTENSIONS)) ;
+    logInfo("GL Vendor    :'%s'.\n",glGetString(GL_VENDOR)) ;
+    logInfo("GL Renderer  :'%s'.\n",glGetString(GL_RENDERER)) ;
+    logInfo("GL Version   :'%s'.\n",glGetString(GL_VERSION)) ;
+    logInfo("GLSL Version :'%s'.\n",glGetString(GL_SHADING_LANGUAGE_VERSION)) ;
+    logInfo("GL Extensions:'%s'.\n",glGetString(GL_EXTENSIONS)) ;
 } // printGLversion
 */
 
 
 
+// The shaders of routines 1 to 6. Built by the shader library with
+// the SHADER_ features the routine needs #defined in front.
+static const char basicVertex[] =
+    "attribute vec3 a_position;                   \n"
+    "#ifdef COLOUR                                \n"
+    "attribute vec3 a_colour;                     \n"
+    "varying   vec3 v_colour;                     \n"
+    "#endif                                       \n"
+    "#ifdef TEXTURE                               \n"
+    "attribute vec2 a_texcoord;                   \n"
+    "varying   vec2 v_texcoord;                   \n"
+    "#endif                                       \n"
+    "#ifdef TRANSFORM                             \n"
+    "uniform   mat4 MVP;                          \n"
+    "#endif                                       \n"
+    "void main()                                  \n"
+    "{                                            \n"
+    "#ifdef COLOUR                                \n"
+    "   v_colour = a_colour;                      \n"
+    "#endif                                       \n"
+    "#ifdef TEXTURE                               \n"
+    "   v_texcoord  = a_texcoord;                 \n"
+    "#endif                                       \n"
+    "#ifdef TRANSFORM                             \n"
+    "   gl_Position = MVP * vec4(a_position,1.0); \n"
+    "#else                                        \n"
+    "   gl_Position = vec4(a_position,1.0);       \n"
+    "#endif                                       \n"
+    "}                                            \n";
+
+static const char basicFragment[] =
+    "precision mediump float;                             \n"
+    "#ifdef COLOUR                                        \n"
+    "varying   vec3 v_colour;                             \n"
+    "#endif                                               \n"
+    "#ifdef TEXTURE                                       \n"
+    "varying   vec2 v_texcoord;                           \n"
+    "uniform sampler2D s_texture;                         \n"
+    "#endif                                               \n"
+    "void main()                                          \n"
+    "{                                                    \n"
+    "#if defined(TEXTURE)                                 \n"
+    "   gl_FragColor = texture2D( s_texture, v_texcoord );\n"
+    "#elif defined(COLOUR)                                \n"
+    "   gl_FragColor = vec4(v_colour, 1.0);               \n"
+    "#else                                                \n"
+    "   gl_FragColor = vec4(1.0, 0.0, 0.0, 1.0);          \n"   // Red
+    "#endif                                               \n"
+    "}                                                    \n";
+
+
+
 /***********************************************************
  * Name: initialise
  *
@@ -575,16 +1116,24 @@ static void initialise(int argc, char **argv, ESContext *esContext)
 {
     UserData *user = esContext->userData;
 
-    // Set seed of random number generator using time().
-    srand((unsigned int) time(NULL)) ;
-
     // Extract input parameters.
     parse(argc,argv,esContext) ;
 
-    // Initialise the keyboard input.
-    user->keyboard_fd = init_keyboard() ; 
+    // From here messages are written by the logger thread.
+    logStart(user->logLevel, NULL) ;
+    logInfo("Routine : %u\nPeriod : %.3fs\n",user->routine,user->period) ;
+
+    // Set seed of random number generator, using time() unless given.
+    if ( !user->seeded ) user->seed = (unsigned int) time(NULL) ;
+    srand(user->seed) ;
+    logInfo("Seed : %u\n",user->seed) ;
 
-    load_image(user) ;
+    // The shaders' binaries are read by a startup task.
+    user->shaders = shaderlibCreate(user->shaderCache) ;
+    user->basicSource = shaderlibAddSource(user->shaders, "basic", basicVertex, basicFragment) ;
+    if ( user->shaderDir ) shaderlibAddFiles(user->shaders, user->basicSource, user->shaderDir) ;
+
+    // The rest is started as tasks by main().
 
     // Set up the exit function for exit(0) or the main return.
     atexit(exit_func) ;   
@@ -601,21 +1150,10 @@ static void initialise(int argc, char **argv, ESContext *esContext)
 //
 static int init_shaders1(ESContext *esContext) {
     UserData *userData = esContext->userData;
-    GLbyte vShaderStr[] =
-        "attribute vec4 vPosition;                  \n"
-        "void main()                                \n"
-        "{                                          \n"
-        "   gl_Position = vPosition;                \n"
-        "}                                          \n";
-    GLbyte fShaderStr[] =
-        "precision mediump float;                   \n"
-        "void main()                                \n"
-        "{                                          \n"
-        "  gl_FragColor = vec4(1.0, 0.0, 0.0, 1.0); \n"   // Red
-        "}                                          \n";
-
-    // Store the program object
-    userData->programObject = esLoadProgram((char *)vShaderStr,(char *)fShaderStr);
+
+    // Store the program object, its attributes are found when built.
+    userData->program = shaderlibProgram(userData->shaders, userData->basicSource, 0) ;
+    userData->programObject = userData->program ? userData->program->id : 0 ;
 
     return userData->programObject ;   // 0 = FALSE = Failure
 
@@ -630,33 +1168,11 @@ static int init_shaders1(ESContext *esContext) {
 //  Trying to load up a vertex colour. Working.
 static int init_shaders2(ESContext *esContext) {
     UserData *user = esContext->userData;
-    GLbyte vShaderStr[] =
-        "attribute vec3 a_position;                   \n"
-        "attribute vec3 a_colour;                     \n"
-        "uniform   mat4 MVP;                          \n"
-        "varying   vec3 v_colour;                     \n"
-        "void main()                                  \n"
-        "{                                            \n"
-        "   v_colour = a_colour;                      \n"
-        "   gl_Position = MVP * vec4(a_position,1.0); \n"
-        "}                                            \n";
-
-    GLbyte fShaderStr[] =
-        "#version 100                                 \n"
-        "uniform   vec3 u_colour;                     \n"
-        "varying   vec3 v_colour;                     \n"
-        "void main()                                  \n"
-        "{                                            \n"
-        "  gl_FragColor = vec4(v_colour, 1.0);        \n" 
-        "}                                            \n";
 
-    // Store the program object
-    user->programObject = esLoadProgram((char *)vShaderStr,(char *)fShaderStr);
-
-    // Get the attribute locations
-    user->positionLoc = glGetAttribLocation( user->programObject, "a_position" );
-    user->colourLoc = glGetAttribLocation( user->programObject, "a_colour" );
-//    user->colourLoc = glGetUniformLocation( user->programObject, "u_colour" );
+    // Store the program object, its attributes are found when built.
+    user->program = shaderlibProgram(user->shaders, user->basicSource,
+                                     SHADER_COLOUR | SHADER_TRANSFORM) ;
+    user->programObject = user->program ? user->program->id : 0 ;
 
     return user->programObject ;   // 0 = FALSE = Failure
 
@@ -677,41 +1193,117 @@ static int init_shaders2(ESContext *esContext) {
 
 
 
+// Make a variant of the loaded image so the atlas has different images.
+// 0 = as is, 1 = grey, 2 = inverted colours, 3 = half size.
+// NULL if out of memory.
+static char *make_variant(const char *image, int width, int height,
+                          int mode, int *vwidth, int *vheight)
+{
+    int i, x, y, n = width * height * 3 ;
+    char *variant = NULL ;
+    const unsigned char *src = (const unsigned char *) image ;
+    unsigned char *dst ;
+
+    *vwidth = width ;
+    *vheight = height ;
+
+    if ( mode == 3 ) {
+        *vwidth = width / 2 ;
+        *vheight = height / 2 ;
+        variant = malloc( *vwidth * *vheight * 3 ) ;
+        if ( variant == NULL ) return NULL ;
+        dst = (unsigned char *) variant ;
+        for ( y = 0 ; y < *vheight ; ++y )
+            for ( x = 0 ; x < *vwidth ; ++x, dst += 3 )
+                memcpy( dst, &src[((y * 2) * width + x * 2) * 3], 3 ) ;
+        return variant ;
+    }
+
+    variant = malloc( n ) ;
+    if ( variant == NULL ) return NULL ;
+    dst = (unsigned char *) variant ;
+    for ( i = 0 ; i < n ; i += 3 ) {
+        switch ( mode ) {
+            case 1 :
+                dst[i] = dst[i+1] = dst[i+2] = ( src[i] + src[i+1] + src[i+2] ) / 3 ;
+                break ;
+            case 2 :
+                dst[i] = 255 - src[i] ; dst[i+1] = 255 - src[i+1] ; dst[i+2] = 255 - src[i+2] ;
+                break ;
+            default :
+                dst[i] = src[i] ; dst[i+1] = src[i+1] ; dst[i+2] = src[i+2] ;
+                break ;
+        }
+    }
+    return variant ;
+
+} // make_variant
+
+
+
+// Pack variants of the loaded image into the atlas pages, no GL.
+static int pack_atlas(UserData *user)
+{
+    char *variant ;
+    int i, w, h ;
+
+    atlasInit(&user->atlas, 0, -1) ;
+    for ( i = 0 ; i < NATLASIMAGES ; ++i ) {
+        variant = make_variant(user->image,user->width,user->height,i,&w,&h) ;
+        if ( variant == NULL ) {
+            logError("Atlas: Out of memory for image variant %d!\n",i) ;
+            continue ;
+        }
+        atlasAdd(&user->atlas,variant,w,h) ;
+        free( variant ) ;
+    }
+
+    logInfo("Atlas: %d images packed into %d page(s) of %d x %d.\n",
+            user->atlas.nrects,user->atlas.npages,user->atlas.size,user->atlas.size) ;
+
+    return user->atlas.nrects ;
+
+} // pack_atlas
+
+
+
+// Upload the packed atlas as mip-mapped textures, packing it if not yet.
+static GLuint init_atlas(UserData *user)
+{
+    if ( user->atlas.nrects == 0 ) pack_atlas(user) ;
+    atlasUpload(&user->atlas,1) ;
+
+    return user->atlas.page[0].textureId ;
+
+} // init_atlas
+
+
+
 ///
 // Initialize the second shader and program object. 
 //  Trying to load up a vertex image. Works with init_withoutVBOs().
 static int init_shaders3(ESContext *esContext) {
     UserData *user = esContext->userData;
-    GLbyte vShaderStr[] =
-        "attribute vec3 a_position;                   \n"
-        "attribute vec2 a_texcoord;                   \n"
-        "uniform   mat4 MVP;                          \n"
-        "varying   vec2 v_texcoord;                   \n"
-        "void main()                                  \n"
-        "{                                            \n"
-        "   v_texcoord  = a_texcoord;                 \n"
-        "   gl_Position = MVP * vec4(a_position,1.0); \n"
-        "}                                            \n";
-    GLbyte fShaderStr[] =
-        "precision mediump float;                             \n"
-        "varying   vec2 v_texcoord;                           \n"
-        "uniform sampler2D s_texture;                         \n"
-        "void main()                                          \n"
-        "{                                                    \n"
-        "   gl_FragColor = texture2D( s_texture, v_texcoord );\n"
-        "}                                                    \n";
-
-    // Store the program object
-    user->programObject = esLoadProgram((char *)vShaderStr,(char *)fShaderStr);
-
-    // Get the attribute locations
-    user->positionLoc = glGetAttribLocation( user->programObject, "a_position" );
-    user->texCoordLoc = glGetAttribLocation( user->programObject, "a_texcoord" );
-   
-    // Get the sampler location
-    user->samplerLoc = glGetUniformLocation( user->programObject, "s_texture" );
-    // Load the texture
-    user->textureId = loadTexture2D(user->image, user->width, user->height);
+
+    // Store the program object, its attributes and uniforms are found when built.
+    user->program = shaderlibProgram(user->shaders, user->basicSource,
+                                     SHADER_TEXTURE | SHADER_TRANSFORM) ;
+    user->programObject = user->program ? user->program->id : 0 ;
+    if ( user->program == NULL ) return 0 ;
+
+    // Load the texture, the atlas of textures for routine 5,
+    // or open the tile stream for routine 6.
+    if ( user->routine == 5 )
+        user->textureId = init_atlas(user) ;
+    else if ( user->routine == 6 ) {
+        user->stream = texstreamOpen(user->imagefn, user->streamTile, user->streamBudget) ;
+        if ( user->stream == NULL ) {
+            logError("Unable to stream image '%s'.\n",user->imagefn);
+            return 0 ;
+        }
+    }
+    else if ( user->texAsset == NULL )
+        user->textureId = loadTexture2D(user->image, user->width, user->height);
 
     return user->programObject ;   // 0 = FALSE = Failure
 
@@ -719,11 +1311,26 @@ static int init_shaders3(ESContext *esContext) {
 
 
 
+// The stress module has its own program and meshes, only the image is shared.
+static int init_stress(ESContext *esContext)
+{
+    UserData *user = esContext->userData;
+
+    user->textureId = loadTexture2D(user->image, user->width, user->height);
+    user->stress = stressCreate(user->stressPath, user->budget, user->textureId) ;
 
+    return user->stress ? user->stress->program.id : 0 ;   // 0 = FALSE = Failure
 
+} // init_stress
 
 
-static int init_shaders(ESContext *esContext)
+
+
+
+
+
+// The routine's program, and its textures.
+static int init_routine(ESContext *esContext)
 {
     UserData *user = esContext->userData;
     int ret = 0 ;
@@ -741,11 +1348,52 @@ static int init_shaders(ESContext *esContext)
         case 4 : // Coloured Sphere
             ret = init_shaders2(esContext) ;
             break ;
+        case 5 : // Atlas Textured Cubes
+            ret = init_shaders3(esContext) ;
+            break ;
+        case 6 : // Streamed Image
+            ret = init_shaders3(esContext) ;
+            break ;
+        case 7 : // Capacity Stress
+            ret = init_stress(esContext) ;
+            break ;
         default :
             ret = init_shaders1(esContext) ;
             break ;
     }
 
+    return ret ;   // > 0 for success
+
+} // init_routine
+
+
+
+// Per-frame geometry streams through VBO rings instead of client arrays.
+static void init_dyn_mode(UserData *user)
+{
+    if ( user->dynMode < 0 ) return ;
+
+    user->dynMode = dynbufInit(&user->vbuf, GL_ARRAY_BUFFER, 0, 0, user->dynMode) ;
+    dynbufInit(&user->ibuf, GL_ELEMENT_ARRAY_BUFFER, 0, 0, user->dynMode) ;
+    logInfo("Streaming vertex data with '%s' buffers.\n",dynbufModeName(user->dynMode)) ;
+
+} // init_dyn_mode
+
+
+
+static int init_shaders(ESContext *esContext)
+{
+    UserData *user = esContext->userData;
+    int ret = 0 ;
+
+    ret = init_routine(esContext) ;
+
+    init_dyn_mode(user) ;
+
+    // Objects' vertex/index data is sub-allocated from these.
+    vbopoolInit(&user->vpool, GL_ARRAY_BUFFER, 0) ;
+    vbopoolInit(&user->ipool, GL_ELEMENT_ARRAY_BUFFER, 0) ;
+
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);       // Black
 
     // Enable back face culling & depth testing. Working. 
@@ -776,6 +1424,55 @@ static int init_shaders(ESContext *esContext)
 // In the GPU vertex shader every vertex point is multiplied by MVP to 
 // move & project it into the clip/screen coordinates. 
 
+// Render on demand : damage where the object was and where it is now,
+// the window box round its bounds' corners put through the MVP.
+static void damage_object(ESContext *esContext, OBJECT_T *ob)
+{
+    UserData *user = esContext->userData;
+    const GLfloat (*m)[4] = ob->mvpMat.m ;
+    float x, y, z, w, px, py, x0 = 1.0f, y0 = 1.0f, x1 = -1.0f, y1 = -1.0f ;
+    EGLint rect[4] ;
+    GLuint v ;
+    int c ;
+
+    if ( user->damage == NULL ) return ;
+
+    if ( ob->radius == 0.0f )
+        for ( v = 0 ; v < ob->nv * 3 ; ++v )
+            if ( fabsf(ob->v[v]) > ob->radius ) ob->radius = fabsf(ob->v[v]) ;
+
+    for ( c = 0 ; c < 8 ; ++c ) {
+        x = c & 1 ? ob->radius : -ob->radius ;
+        y = c & 2 ? ob->radius : -ob->radius ;
+        z = c & 4 ? ob->radius : -ob->radius ;
+        w = x * m[0][3] + y * m[1][3] + z * m[2][3] + m[3][3] ;
+        if ( w <= 0.0f ) {              // behind the eye, no box
+            damageAll(user->damage) ;
+            user->lastRect[2] = 0 ;
+            return ;
+        }
+        px = ( x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0] ) / w ;
+        py = ( x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1] ) / w ;
+        x0 = fminf(x0, px) ;
+        x1 = fmaxf(x1, px) ;
+        y0 = fminf(y0, py) ;
+        y1 = fmaxf(y1, py) ;
+    }
+
+    rect[0] = (EGLint) floorf( ( x0 + 1.0f ) * 0.5f * esContext->width ) - DAMAGE_MARGIN ;
+    rect[1] = (EGLint) floorf( ( y0 + 1.0f ) * 0.5f * esContext->height ) - DAMAGE_MARGIN ;
+    rect[2] = (EGLint) ceilf( ( x1 + 1.0f ) * 0.5f * esContext->width ) + DAMAGE_MARGIN - rect[0] ;
+    rect[3] = (EGLint) ceilf( ( y1 + 1.0f ) * 0.5f * esContext->height ) + DAMAGE_MARGIN - rect[1] ;
+
+    damageRect(user->damage, rect[0], rect[1], rect[2], rect[3]) ;
+    if ( user->lastRect[2] > 0 )
+        damageRect(user->damage, user->lastRect[0], user->lastRect[1], user->lastRect[2], user->lastRect[3]) ;
+    memcpy( user->lastRect, rect, sizeof( rect ) ) ;
+
+} // damage_object
+
+
+
 static void Update_MVP(ESContext *esContext, float deltatime)
 {
 // Do not have the FAR_CLIP too large because of depth resolution.
@@ -807,22 +1504,56 @@ static void Update_MVP(ESContext *esContext, float deltatime)
     esMatrixMultiply(&ob->mvpMat,&ob->modelMat,&ob->viewMat) ;
     esMatrixMultiply(&ob->mvpMat,&ob->mvpMat,&ob->projMat) ;
 
-    glUniformMatrix4fv(ob->mvpId,1,GL_FALSE,&(ob->mvpMat.m[0][0])) ;
+    // Sent just before the draw, if it changed.
+    shaderlibSetf(user->program,user->program->known[SHADER_MVP],&(ob->mvpMat.m[0][0])) ;
+    damage_object(esContext, ob) ;
 
 } // Update_MVP
 
 
 
 
-static void Update(ESContext *esContext, float deltatime)
+// Pan the view round the streamed image and request the tiles under it.
+static void Update_Stream(ESContext *esContext)
 {
     UserData *user = esContext->userData;
+    TEXSTREAM_T *ts = user->stream ;
+    int vw = (int) ( ts->width * STREAM_VIEW ) ;
+    int vh = (int) ( ts->height * STREAM_VIEW ) ;
+    float cx = 0.5f + 0.5f * sinf( user->count * 0.010f ) ;
+    float cy = 0.5f + 0.5f * cosf( user->count * 0.013f ) ;
 
-    if ( user->nobjs ) {
+    user->viewx0 = (int) ( cx * ( ts->width - vw ) ) ;
+    user->viewy0 = (int) ( cy * ( ts->height - vh ) ) ;
+    user->viewx1 = user->viewx0 + vw ;
+    user->viewy1 = user->viewy0 + vh ;
 
-      switch ( user->routine ) {
-        case 1 : // Triangle
-            break ;
+    texstreamRequestView(ts,user->viewx0,user->viewy0,user->viewx1,user->viewy1) ;
+
+} // Update_Stream
+
+
+
+
+static void Update(ESContext *esContext, float deltatime)
+{
+    UserData *user = esContext->userData;
+    PROF_SCOPE("Update") ;
+
+    if ( user->routine == 6 ) {    // Streamed image has no objects.
+        Update_Stream(esContext) ;
+        return ;
+    }
+    if ( user->routine == 7 ) {    // Stress objects are its own.
+        stressUpdate(user->stress, user->count, user->aspect) ;
+        return ;
+    }
+
+    if ( user->nobjs ) {
+
+      switch ( user->routine ) {
+        case 1 : // Triangle
+            break ;
         case 2 : // Coloured Cube
             Update_MVP(esContext,deltatime) ;
             break ;
@@ -832,6 +1563,9 @@ static void Update(ESContext *esContext, float deltatime)
         case 4 : // Coloured Sphere
             Update_MVP(esContext,deltatime) ;
             break ;
+        case 5 : // Atlas Textured Cubes
+            Update_MVP(esContext,deltatime) ;
+            break ;
         default :
             break ;
       }
@@ -842,6 +1576,43 @@ static void Update(ESContext *esContext, float deltatime)
 
 
 
+// Point an attribute at a client array, or with -d stream it into
+// the dynamic VBO ring first. Data larger than a VBO stays a client array.
+static void set_attrib(UserData *user, GLint loc, GLint size, const GLfloat *data, GLuint count)
+{
+    GLintptr offset ;
+
+    if ( user->dynMode < 0 ) {
+        glVertexAttribPointer(loc, size, GL_FLOAT, GL_FALSE, 0, data);
+        return ;
+    }
+    if ( !dynbufAlloc(&user->vbuf, data, count * size * sizeof(GLfloat), &offset) ) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+        glVertexAttribPointer(loc, size, GL_FLOAT, GL_FALSE, 0, data);
+        return ;
+    }
+    glVertexAttribPointer(loc, size, GL_FLOAT, GL_FALSE, 0, BUF_OFFSET(offset));
+
+} // set_attrib
+
+
+
+// Indices for glDrawElements(), streamed with -d.
+static const void *set_indices(UserData *user, const GLushort *indices, GLuint count)
+{
+    GLintptr offset ;
+
+    if ( user->dynMode < 0 ) return indices ;
+    if ( !dynbufAlloc(&user->ibuf, indices, count * sizeof(GLushort), &offset) ) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0) ;
+        return indices ;
+    }
+    return BUF_OFFSET(offset) ;
+
+} // set_indices
+
+
+
 ///
 // Draw a triangle using the shader pair created in init_shaders1().
 //
@@ -855,9 +1626,9 @@ static void Draw_Triangle(ESContext *esContext) {
     glUseProgram(userData->programObject);
 
     // Load the vertex data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, vVertices);
+    set_attrib(userData, userData->program->attrib[SHADER_POSITION], 3, vVertices, 3);
 
-    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(userData->program->attrib[SHADER_POSITION]);
 
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
@@ -875,17 +1646,14 @@ static void Draw_Coloured_Object(ESContext *esContext) {
 
     // Use the program object
     glUseProgram(ob->program);
-
-//    glUniform3f(user->colourLoc, 1.0f, 1.0f, 0.0f ) ;
+    shaderlibApply(user->program) ;
 
 // Working when using init_withoutVBOs(),
 // but loads up vertex data from client memory each call!
 //    glDrawElements(GL_TRIANGLES, ob->ni, GL_UNSIGNED_SHORT, &(ob->i[0]));
 
 // Working when using init_withVBOs() which uses vertex data preloaded into GPU memory.
-//    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[0]) ;
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ob->vboIds[4]) ;
-    glDrawElements(GL_TRIANGLES, ob->ni, GL_UNSIGNED_SHORT, BUF_OFFSET(0));
+    glDrawElements(GL_TRIANGLES, ob->ni, GL_UNSIGNED_SHORT, bind_withVBOs(user,ob));
 
 } // Draw_Coloured_Object
 
@@ -898,16 +1666,32 @@ static void Draw_Textured_Cube(ESContext *esContext) {
     OBJECT_T *ob = &user->object[0] ;
 //    void *void0 = (void *) 0;
 
+    // Nothing to show until the background loaded texture is ready.
+    if ( user->texAsset ) {
+        if ( !assetReady(user->texAsset) ) return ;
+        if ( user->textureId != user->texAsset->textureId ) {
+            user->textureId = user->texAsset->textureId ;
+            glBindTexture( GL_TEXTURE_2D, user->textureId );
+            logInfo("Texture '%s' %d x %d ready after %.1fms.\n",user->texAsset->fileName,
+                    user->texAsset->width,user->texAsset->height,user->texAsset->loadTime / 1000.0) ;
+        }
+    }
+
     // Use the program object
     glUseProgram(ob->program);
+    shaderlibApply(user->program) ;
 
 // Working when using init_withoutVBOs(),
 // but loads up vertex data from client memory each call!
-    glDrawElements(GL_TRIANGLES, ob->ni, GL_UNSIGNED_SHORT, &(ob->i[0]));
+// With -d the same data is streamed explicitly through the VBO rings.
+    if ( user->dynMode >= 0 ) {
+        set_attrib(user, user->program->attrib[SHADER_POSITION], 3, ob->v, ob->nv) ;
+        set_attrib(user, user->program->attrib[SHADER_TEXCOORD], 2, ob->t, ob->nv) ;
+    }
+    glDrawElements(GL_TRIANGLES, ob->ni, GL_UNSIGNED_SHORT, set_indices(user, ob->i, ob->ni));
 
 // Working when using init_withVBOs() which uses vertex data preloaded into GPU memory.
-//    glBindBuffer(GL_ARRAY_BUFFER, ob->vboIds[0]) ;
-//    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ob->vboIds[4]) ;
+//    bind_withVBOs(user,ob) ;
 //    glDrawElements(GL_TRIANGLES, ob->ni, GL_UNSIGNED_SHORT, BUF_OFFSET(0));
 
 } // Draw_Textured_Cube
@@ -915,9 +1699,76 @@ static void Draw_Textured_Cube(ESContext *esContext) {
 
 
 
+///
+// Draw the resident tiles under the view using the shaders from init_shaders3().
+// Tiles still being streamed in are left black.
+static void Draw_Streamed_Image(ESContext *esContext) {
+    UserData *user = esContext->userData;
+    SHADERLIB_PROGRAM_T *pg = user->program ;
+    TEXSTREAM_T *ts = user->stream ;
+    ESMatrix identity ;
+    GLushort indices[] = { 0, 1, 2, 0, 2, 3 } ;
+    GLfloat  texCoords[] = { 0.0f, 0.0f,  0.0f, 1.0f,  1.0f, 1.0f,  1.0f, 0.0f } ;
+    GLfloat  vVertices[12] ;
+    float sx = 2.0f / ( user->viewx1 - user->viewx0 ) ;
+    float sy = 2.0f / ( user->viewy1 - user->viewy0 ) ;
+    int tx, ty ;
+
+    glUseProgram(user->programObject);
+
+    texstreamUpdate(ts,STREAM_UPLOADS) ;
+
+    // Sent the first frame only, they do not change.
+    esMatrixLoadIdentity(&identity) ;
+    shaderlibSetf(pg, pg->known[SHADER_MVP], &identity.m[0][0]) ;
+    shaderlibSeti(pg, pg->known[SHADER_SAMPLER], 0) ;
+    shaderlibApply(pg) ;
+
+    if ( user->dynMode < 0 ) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0) ;
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0) ;
+        glVertexAttribPointer( pg->attrib[SHADER_POSITION], 3, GL_FLOAT, GL_FALSE, 0, vVertices );
+        glVertexAttribPointer( pg->attrib[SHADER_TEXCOORD], 2, GL_FLOAT, GL_FALSE, 0, texCoords );
+    }
+    glEnableVertexAttribArray( pg->attrib[SHADER_POSITION] );
+    glEnableVertexAttribArray( pg->attrib[SHADER_TEXCOORD] );
+    glActiveTexture( GL_TEXTURE0 );
+
+    for ( ty = user->viewy0 / ts->tileSize ; ty <= ( user->viewy1 - 1 ) / ts->tileSize ; ++ty ) {
+        for ( tx = user->viewx0 / ts->tileSize ; tx <= ( user->viewx1 - 1 ) / ts->tileSize ; ++tx ) {
+            TEX_TILE_T *tile = &ts->tile[ty * ts->ntx + tx] ;
+            GLuint textureId = texstreamTile(ts,tx,ty) ;
+            // Tile corners in normalised device coordinates, image row 0 at the top.
+            float x0 = ( tx * ts->tileSize - user->viewx0 ) * sx - 1.0f ;
+            float x1 = x0 + tile->w * sx ;
+            float y0 = 1.0f - ( ty * ts->tileSize - user->viewy0 ) * sy ;
+            float y1 = y0 - tile->h * sy ;
+
+            if ( textureId == 0 ) continue ;
+
+            vVertices[0] = x0 ; vVertices[1]  = y0 ; vVertices[2]  = 0.0f ;
+            vVertices[3] = x0 ; vVertices[4]  = y1 ; vVertices[5]  = 0.0f ;
+            vVertices[6] = x1 ; vVertices[7]  = y1 ; vVertices[8]  = 0.0f ;
+            vVertices[9] = x1 ; vVertices[10] = y0 ; vVertices[11] = 0.0f ;
+
+            if ( user->dynMode >= 0 ) {
+                set_attrib(user, pg->attrib[SHADER_POSITION], 3, vVertices, 4) ;
+                set_attrib(user, pg->attrib[SHADER_TEXCOORD], 2, texCoords, 4) ;
+            }
+            glBindTexture( GL_TEXTURE_2D, textureId );
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, set_indices(user, indices, 6));
+        } // each tile column
+    } // each tile row
+
+} // Draw_Streamed_Image
+
+
+
+
 static void Draw(ESContext *esContext)
 {
     UserData *user = esContext->userData;
+    PROF_SCOPE("Draw") ;
 
     // Set the viewport
     glViewport(0, 0, esContext->width, esContext->height);
@@ -925,6 +1776,14 @@ static void Draw(ESContext *esContext)
     // Start with a clear screen
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
+    // Only uploads here if there is no upload thread.
+    assetsPoll(user->assets) ;
+
+    if ( user->dynMode >= 0 ) {
+        dynbufNextFrame(&user->vbuf) ;
+        dynbufNextFrame(&user->ibuf) ;
+    }
+
     switch ( user->routine ) {
         case 1 :
             Draw_Triangle(esContext) ;
@@ -938,6 +1797,15 @@ static void Draw(ESContext *esContext)
         case 4 :
             Draw_Coloured_Object(esContext) ;
             break ;
+        case 5 :
+            Draw_Textured_Cube(esContext) ;
+            break ;
+        case 6 :
+            Draw_Streamed_Image(esContext) ;
+            break ;
+        case 7 :
+            stressDraw(user->stress) ;
+            break ;
         default :
             Draw_Triangle(esContext) ;
             break ;
@@ -949,6 +1817,511 @@ static void Draw(ESContext *esContext)
 
 
 
+// Drain the input ring, no system calls. ESC quits, any input redraws.
+// The earliest event's time is kept for its latency to the swap.
+static void handle_input(UserData *user)
+{
+    INPUT_EVENT_T ev ;
+
+    while ( inputPoll(user->input, &ev) ) {
+        if ( ev.type == EV_KEY && ev.code == KEY_ESC && ev.value == 1 )
+            user->toexit = 1 ;
+        if ( user->inputTime == 0.0 || ev.time < user->inputTime ) user->inputTime = ev.time ;
+        damageAll(user->damage) ;
+    }
+
+} // handle_input
+
+
+
+// Render on demand : after a setup or command, redraw it all, and
+// every frame if the routine's scene moves. Only the triangle is still.
+static void damage_scene(UserData *user)
+{
+    if ( user->damage == NULL ) return ;
+
+    damageAll(user->damage) ;
+    user->damage->animating = user->routine != 1 ;
+    user->lastRect[2] = 0 ;
+
+} // damage_scene
+
+
+
+// Objects drawn and their triangles a frame.
+static void scene_size(UserData *user, int *objects, unsigned long long *triangles)
+{
+    int i ;
+
+    if ( user->stress ) {
+        *objects = user->stress->nobjects ;
+        *triangles = user->stress->triangles ;
+        return ;
+    }
+    *objects = user->nobjs ;
+    *triangles = 0 ;
+    for ( i = 0 ; i < user->nobjs ; ++i ) *triangles += user->object[i].ni / 3 ;
+
+} // scene_size
+
+
+
+/***********************************************************
+ * Name: switch_routine
+ *
+ * Arguments:
+ *     ESContext *esContext - holds display/user data.
+ *     routine - 1 to NROUTINES, may be the one running.
+ *
+ * Description: Replaces the running routine between frames,
+ *              keeping the window, the pools, the loaded image
+ *              and the files written. The frame stats restart
+ *              so they are of the new routine only.
+ *
+ * Returns: 1 if set up, 0 if not (then routine 1 is run).
+ *
+ ***********************************************************/
+static int switch_routine(ESContext *esContext, int routine)
+{
+    UserData *user = esContext->userData;
+    int ok ;
+
+    PROF_SCOPE("switch_routine") ;
+
+    // Routine 6 streams its image, routine 3 may have it from the loader.
+    if ( user->image == NULL && routine != 6 && !( routine == 3 && user->texAsset ) ) {
+        user->image = esLoadTGA(user->imagefn, &user->width, &user->height) ;
+        if ( user->image == NULL ) {
+            logWarn("No such image '%s'.\n",user->imagefn) ;
+            return 0 ;
+        }
+    }
+
+    free_routine(user) ;
+    user->routine = routine ;
+    ok = init_routine(esContext) && generate_objects(user) ;
+    if ( !ok ) {
+        logWarn("Routine %d failed to set up, running routine 1.\n",routine) ;
+        free_routine(user) ;
+        user->routine = 1 ;
+        init_routine(esContext) ;
+    }
+    initialise_objects(esContext) ;
+    glUseProgram(user->programObject) ;
+
+    framestatsReset(user->stats) ;
+    user->statsStart = uelapsedtime(0) ;
+    logInfo("Routine : %d\n",user->routine) ;
+
+    return ok ;
+
+} // switch_routine
+
+
+
+// Control commands, each answers with controlReply() and returns 1
+// if done or 0 for an error.
+
+static int cmd_routine(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+    int routine = atoi(argv[1]) ;
+
+    if ( routine < 1 || routine > NROUTINES ) {
+        controlReply(user->control, "Routines are 1 to %d.\n", NROUTINES) ;
+        return 0 ;
+    }
+    if ( !switch_routine(esContext, routine) ) {
+        controlReply(user->control, "Routine %d failed, running %d.\n", routine, user->routine) ;
+        return 0 ;
+    }
+    controlReply(user->control, "routine %d\n", user->routine) ;
+    return 1 ;
+
+} // cmd_routine
+
+
+
+static int cmd_slices(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+    int slices = atoi(argv[1]) ;
+
+    // esGenSphere() makes (slices/2+1)*(slices+1) vertices.
+    if ( slices < 3 || ( slices / 2 + 1 ) * ( slices + 1 ) > USHRT_MAX ) {
+        controlReply(user->control, "Slices are 3 to 360 for USHORT indices.\n") ;
+        return 0 ;
+    }
+    user->slices = slices ;
+    if ( user->routine == 4 && !switch_routine(esContext, 4) ) return 0 ;
+    controlReply(user->control, "slices %d\n", user->slices) ;
+    return 1 ;
+
+} // cmd_slices
+
+
+
+// Client arrays, or streamed through VBOs as -d. The routine is set up
+// again as its attributes point at one or the other.
+static int cmd_vbo(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+    int mode = -1 ;
+
+    if ( strcmp(argv[1], "client") != 0 && ( mode = dynbufModeFromName(argv[1]) ) < 0 ) {
+        controlReply(user->control, "Modes are client, auto, orphan, subdata or map.\n") ;
+        return 0 ;
+    }
+    if ( user->dynMode >= 0 ) {
+        dynbufFree( &user->vbuf ) ;
+        dynbufFree( &user->ibuf ) ;
+    }
+    user->dynMode = mode ;
+    init_dyn_mode(user) ;
+    if ( !switch_routine(esContext, user->routine) ) return 0 ;
+    controlReply(user->control, "vbo %s\n", user->dynMode < 0 ? "client" : dynbufModeName(user->dynMode)) ;
+    return 1 ;
+
+} // cmd_vbo
+
+
+
+static int cmd_objects(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+
+    if ( user->stress == NULL ) {
+        controlReply(user->control, "Only routine 7 has an object count.\n") ;
+        return 0 ;
+    }
+    stressSetObjects(user->stress, atoi(argv[1])) ;
+    framestatsReset(user->stats) ;
+    user->statsStart = uelapsedtime(0) ;
+    controlReply(user->control, "objects %d\n", user->stress->nobjects) ;
+    return 1 ;
+
+} // cmd_objects
+
+
+
+static int cmd_period(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+
+    user->period = atof(argv[1]) ;
+    if ( user->period < 0.0f ) user->period = 0.0f ;
+    controlReply(user->control, "period %.3fs%s\n", user->period, user->period > 0.0f ? "" : " (until quit)") ;
+    return 1 ;
+
+} // cmd_period
+
+
+
+// A profiling zone capture, as -T but for a while only.
+static int cmd_capture(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+    int n ;
+
+    if ( strcmp(argv[1], "start") == 0 ) {
+        profStart() ;
+        controlReply(user->control, "capture started\n") ;
+        return 1 ;
+    }
+    if ( strcmp(argv[1], "stop") != 0 || argc < 3 ) {
+        controlReply(user->control, "capture start | capture stop <file.json>\n") ;
+        return 0 ;
+    }
+    profStop() ;
+    n = profWriteTrace(argv[2]) ;
+    if ( n < 0 ) {
+        controlReply(user->control, "Unable to write '%s'.\n", argv[2]) ;
+        return 0 ;
+    }
+    controlReply(user->control, "capture %d events to '%s'\n", n, argv[2]) ;
+    return 1 ;
+
+} // cmd_capture
+
+
+
+// Frame stats since the routine started or the last reset.
+static int cmd_stats(ESContext *esContext, int argc, char **argv)
+{
+    static const char *phases[FSTATS_NPHASES] = { "update", "draw", "swap", "frame" } ;
+    UserData *user = esContext->userData;
+    FRAMESTATS_T *fs = user->stats ;
+    double secs = ( uelapsedtime(0) - user->statsStart ) / MICRO ;
+    unsigned long long triangles ;
+    int p, objects ;
+
+    if ( argc > 1 && strcmp(argv[1], "reset") == 0 ) {
+        framestatsReset(fs) ;
+        user->statsStart = uelapsedtime(0) ;
+        controlReply(user->control, "stats reset\n") ;
+        return 1 ;
+    }
+
+    scene_size(user, &objects, &triangles) ;
+    controlReply(user->control, "routine %d, vbo %s, %d objects, %llu triangles\n", user->routine,
+                 user->dynMode < 0 ? "client" : dynbufModeName(user->dynMode), objects, triangles) ;
+    controlReply(user->control, "frames %lu in %.2fs, %.1f fps, %lu over %.2fms\n", fs->frames, secs,
+                 secs > 0.0 ? fs->frames / secs : 0.0, fs->over, fs->budget / 1000.0) ;
+    for ( p = 0 ; p < FSTATS_NPHASES ; ++p )
+        controlReply(user->control, "%-6s ms p50 %.3f p95 %.3f p99 %.3f max %.3f\n", phases[p],
+                     hdrPercentile(&fs->hist[p], 50.0) / 1e6, hdrPercentile(&fs->hist[p], 95.0) / 1e6,
+                     hdrPercentile(&fs->hist[p], 99.0) / 1e6, fs->hist[p].max / 1e6) ;
+    if ( fs->latency.total )
+        controlReply(user->control, "input to swap ms p50 %.3f p95 %.3f p99 %.3f max %.3f (%llu frames)\n",
+                     hdrPercentile(&fs->latency, 50.0) / 1e6, hdrPercentile(&fs->latency, 95.0) / 1e6,
+                     hdrPercentile(&fs->latency, 99.0) / 1e6, fs->latency.max / 1e6,
+                     (unsigned long long) fs->latency.total) ;
+    return 1 ;
+
+} // cmd_stats
+
+
+
+static int cmd_rate(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+
+    user->targetHz = atof(argv[1]) ;
+    if ( user->targetHz < 0.0 ) user->targetHz = 0.0 ;
+    pacerSetRate(user->pacer, user->targetHz) ;
+    if ( user->targetHz > 0.0 )
+        controlReply(user->control, "rate %.1fHz\n", user->targetHz) ;
+    else
+        controlReply(user->control, "rate unpaced\n") ;
+    return 1 ;
+
+} // cmd_rate
+
+
+
+static int cmd_quit(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+
+    user->toexit = 1 ;
+    return 1 ;
+
+} // cmd_quit
+
+
+
+static int cmd_help(ESContext *esContext, int argc, char **argv) ;
+
+static const struct {
+    const char *name ;
+    int         args ;          // words needed after the name
+    const char *help ;
+    int       (*run)(ESContext *esContext, int argc, char **argv) ;
+} commands[] = {
+    { "routine", 1, "routine <1-7>           Switch routine.", cmd_routine },
+    { "slices",  1, "slices <n>              Sphere slices of routine 4.", cmd_slices },
+    { "vbo",     1, "vbo <mode>              client, auto, orphan, subdata or map.", cmd_vbo },
+    { "objects", 1, "objects <n>             Routine 7 object count, stops the search.", cmd_objects },
+    { "period",  1, "period <s>              Run time, 0 until quit.", cmd_period },
+    { "rate",    1, "rate <Hz>               Target frame rate, 0 for none.", cmd_rate },
+    { "capture", 1, "capture start|stop <f>  Profiling zones to a Chrome trace.", cmd_capture },
+    { "stats",   0, "stats [reset]           Frame times since the routine started.", cmd_stats },
+    { "quit",    0, "quit                    Exit.", cmd_quit },
+    { "help",    0, "help                    This list.", cmd_help },
+} ;
+#define NCOMMANDS  ( sizeof( commands ) / sizeof( commands[0] ) )
+
+
+
+static int cmd_help(ESContext *esContext, int argc, char **argv)
+{
+    UserData *user = esContext->userData;
+    int c ;
+
+    for ( c = 0 ; c < NCOMMANDS ; ++c ) controlReply(user->control, "%s\n", commands[c].help) ;
+    return 1 ;
+
+} // cmd_help
+
+
+
+// Apply the command waiting on the control socket, between frames.
+static void handle_control(ESContext *esContext)
+{
+    UserData *user = esContext->userData;
+    char *argv[CONTROL_MAX_ARGS] ;
+    int argc, c ;
+
+    if ( ( argc = controlPoll(user->control, argv) ) == 0 ) return ;
+
+    for ( c = 0 ; c < NCOMMANDS ; ++c )
+        if ( strcmp(argv[0], commands[c].name) == 0 ) break ;
+    if ( c == NCOMMANDS ) {
+        controlReply(user->control, "Unknown command '%s', try 'help'.\n", argv[0]) ;
+        controlDone(user->control, 0) ;
+    } else if ( argc - 1 < commands[c].args ) {
+        controlReply(user->control, "%s\n", commands[c].help) ;
+        controlDone(user->control, 0) ;
+    } else
+        controlDone(user->control, commands[c].run(esContext, argc, argv)) ;
+    damage_scene(user) ;
+
+} // handle_control
+
+
+
+
+// Fixed details of the run, once the window and routine are set up.
+static void init_telemetry(ESContext *esContext)
+{
+    UserData *user = esContext->userData;
+    TELEMETRY_T *t ;
+
+    t = user->telemetry = telemetryCreate("esTri") ;
+    if ( t == NULL ) return ;
+
+    telemetryBegin(t) ;
+    snprintf(t->platform, sizeof( t->platform ), "%s", esGetPlatform(esContext)) ;
+    snprintf(t->renderer, sizeof( t->renderer ), "%s", (const char *) glGetString(GL_RENDERER)) ;
+    t->width = esContext->width ;
+    t->height = esContext->height ;
+    t->budgetMs = user->stats->budget / 1000.0 ;
+    telemetryEnd(t) ;
+
+} // init_telemetry
+
+
+
+/***********************************************************
+ * Name: publish_telemetry
+ *
+ * Arguments:
+ *     user - after framestatsEnd() and glcountFrame().
+ *
+ * Description: Copies the frame's stats to the telemetry
+ *              segment. Counts are copied every frame, the
+ *              percentiles, fps and memory, which cost more to
+ *              gather, once a TELEMETRY_REFRESH_US.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void publish_telemetry(UserData *user)
+{
+    TELEMETRY_T *t = user->telemetry ;
+    FRAMESTATS_T *fs = user->stats ;
+    GLCOUNT_T glc ;
+    unsigned long long triangles ;
+    int objects ;
+
+    if ( t == NULL ) return ;
+
+    glcountLast(&glc) ;
+
+    telemetryBegin(t) ;
+    t->uptime = user->etime / MICRO ;
+    t->firstFrameMs = user->firstFrameMs ;
+    t->frames = fs->frames ;
+    t->frameMs = fs->lastFrame / 1000.0 ;
+    t->over = fs->over ;
+
+    t->draws = glc.count[GLC_DRAWS] ;
+    t->primitives = glc.count[GLC_PRIMITIVES] ;
+    t->programBinds = glc.count[GLC_PROGRAMS] ;
+    t->bufferBinds = glc.count[GLC_BUFFERS] ;
+    t->textureBinds = glc.count[GLC_TEXTURES] ;
+    t->uniforms = glc.count[GLC_UNIFORMS] ;
+    t->uploadBytes = glc.count[GLC_CLIENT_BYTES] + glc.count[GLC_BUFFER_BYTES]
+                     + glc.count[GLC_TEXTURE_BYTES] ;
+
+    scene_size(user, &objects, &triangles) ;
+    t->objects = objects ;
+    t->triangles = triangles ;
+    if ( user->stress && t->draws == 0 ) t->draws = user->stress->draws ;
+    t->routine = user->routine ;
+
+    if ( user->assets ) {
+        t->assetsQueued = __atomic_load_n( &user->assets->nqueued, __ATOMIC_RELAXED ) ;
+        t->assetsDecoded = __atomic_load_n( &user->assets->ndecoded, __ATOMIC_RELAXED ) ;
+    }
+    if ( user->input ) {
+        t->inputEvents = __atomic_load_n( &user->input->events, __ATOMIC_RELAXED ) ;
+        t->inputDropped = __atomic_load_n( &user->input->dropped, __ATOMIC_RELAXED ) ;
+    }
+
+    if ( user->etime >= user->telemetryRefresh ) {
+        TEXSTREAM_STATS_T ts ;
+        VBOPOOL_STATS_T vs, is ;
+        double secs = ( user->etime - user->telemetryRefresh + TELEMETRY_REFRESH_US ) / MICRO ;
+        int p ;
+
+        // Since framestats last reported, it resets them.
+        for ( p = 0 ; p < TELEMETRY_NPHASES && fs->last[FSTATS_FRAME].total > 0 ; ++p ) {
+            t->phase[p].p50 = hdrPercentile(&fs->last[p], 50.0) / 1000000.0 ;
+            t->phase[p].p95 = hdrPercentile(&fs->last[p], 95.0) / 1000000.0 ;
+            t->phase[p].p99 = hdrPercentile(&fs->last[p], 99.0) / 1000000.0 ;
+            t->phase[p].max = fs->last[p].max / 1000000.0 ;
+        }
+        if ( user->telemetryFrames > 0 )
+            t->fps = ( fs->frames - user->telemetryFrames ) / secs ;
+
+        t->rss = telemetryRss() ;
+        vbopoolGetStats(&user->vpool, &vs) ;
+        vbopoolGetStats(&user->ipool, &is) ;
+        t->vboReserved = vs.reserved + is.reserved ;
+        t->vboUsed = vs.used + is.used ;
+        if ( user->stress ) {
+            vbopoolGetStats(&user->stress->vpool, &vs) ;
+            vbopoolGetStats(&user->stress->ipool, &is) ;
+            t->vboReserved += vs.reserved + is.reserved ;
+            t->vboUsed += vs.used + is.used ;
+        }
+        if ( user->stream ) {
+            texstreamGetStats(user->stream, &ts) ;
+            t->texResident = ts.resident ;
+            t->texBudget = ts.budget ;
+        }
+
+        user->telemetryFrames = fs->frames ;
+        user->telemetryRefresh = user->etime + TELEMETRY_REFRESH_US ;
+    }
+    telemetryEnd(t) ;
+
+} // publish_telemetry
+
+
+
+
+// Render on demand with nothing to draw. Sleep until another thread
+// wakes the loop or a timer is due : the period's end, the telemetry
+// refresh, or a shader rebuild to look at. Then take what woke it,
+// which may damage the next frame.
+static void idle(ESContext *esContext)
+{
+    UserData *user = esContext->userData;
+    double dPeriod = (double) floor(user->period * MICRO + 0.5) ;
+    double timeout = TELEMETRY_REFRESH_US ;
+
+    if ( user->telemetry && user->telemetryRefresh > user->etime )
+        timeout = user->telemetryRefresh - user->etime ;
+    if ( dPeriod > 0.0 && dPeriod - user->etime < timeout ) timeout = dPeriod - user->etime ;
+    if ( user->shaders && user->shaders->rebuilding && timeout > SHADER_POLL_US ) timeout = SHADER_POLL_US ;
+
+    damageWait(user->damage, timeout) ;
+    user->etime = uelapsedtime(0) ;
+
+    handle_input(user) ;
+    handle_control(esContext) ;
+    if ( shaderlibReload(user->shaders, SHADER_RELOAD_US) ) rebind_program(user) ;
+    publish_telemetry(user) ;
+
+    if ( dPeriod > 0.0 && user->etime > dPeriod && !user->stress ) user->toexit = 1 ;
+
+} // idle
+
+
+
+
 //==============================================================================
 
 static int myMainLoop (ESContext *esContext)
@@ -956,11 +2329,11 @@ static int myMainLoop (ESContext *esContext)
     UserData *user = esContext->userData;
 //    int i ;
     int iLimit = 10000000 ;   // While loop count limit control
-    int iTimeLoop = 0 ;  
-    double dKeyCheck = 0.0 ;       // enable for now
     double dPeriod = 0.0 ;         // While loop elapsed time control
     double deltaTime = 0.0 ;
     double cur_etime = 0.0 ;
+    double dStats = 2.0 * MICRO ;  // Next stats print.
+    EGLint damageRects[DAMAGE_MAX_RECTS * 4] ;
 //    struct timespec pause = { 1 , 0 } ;  // 1.0s
 
 
@@ -972,42 +2345,120 @@ static int myMainLoop (ESContext *esContext)
 
     // Period in whole microseconds.
     dPeriod = (double) floor(user->period * MICRO + 0.5) ;
-    if ( user->keyboard_fd >= 0 ) printf("Press ESC to quit. :\n") ;
+    if ( user->input ) logInfo("Press ESC to quit. :\n") ;
+
+    user->stats = framestatsCreate(user->budget, user->statsName) ;
+    user->perfPhase[FSTATS_UPDATE] = perfctrAddPhase(user->perf, "update") ;
+    user->perfPhase[FSTATS_DRAW] = perfctrAddPhase(user->perf, "draw") ;
+    user->perfPhase[FSTATS_SWAP] = perfctrAddPhase(user->perf, "swap") ;
+
+    // Windows swap on vertical sync unless told otherwise, headless does not.
+    if ( user->swapInterval >= 0 ) esSwapInterval(esContext, user->swapInterval) ;
+    user->pacer = pacerCreate(user->targetHz, user->swapInterval >= 0 ? user->swapInterval :
+                              strcmp(esGetPlatform(esContext), "headless") != 0) ;
+    if ( user->targetHz > 0.0 ) logInfo("Pacing to %.1fHz.\n", user->targetHz) ;
+
+    glcountStart() ;
+    init_telemetry(esContext) ;
+    if ( user->controlPath ) user->control = controlStart(user->controlPath) ;
+
+    // The other threads wake the loop when it sleeps for want of damage.
+    if ( user->onDemand && ( user->damage = damageCreate(esContext->width, esContext->height) ) ) {
+        inputNotify(user->input, user->damage->wakeFd) ;
+        controlNotify(user->control, user->damage->wakeFd) ;
+        shaderlibNotify(user->shaders, user->damage->wakeFd) ;
+        damage_scene(user) ;
+        logInfo("Rendering on demand.\n") ;
+    }
 
     // Loop until count limit or timeout occurs.
     resettimer(0) ;
     user->etime = uelapsedtime(0) ;
     while ( !user->toexit && ++user->count <= iLimit )
     {
+        if ( esUserInterrupt(esContext) ) {
+            --user->count ;
+            break ;
+        }
+        if ( !damagePending(user->damage) ) {
+            --user->count ;
+            idle(esContext) ;
+            continue ;
+        }
+
+        // Sleep now rather than in the swap, so the input and update are
+        // as fresh as they can be when the frame is shown.
+        pacerBegin(user->pacer) ;
+
         cur_etime = uelapsedtime(0) ;
         deltaTime = (float) (cur_etime - user->etime) ;
         user->etime = cur_etime ;
-       
+        framestatsBegin(user->stats) ;
+        perfctrMark(user->perf) ;
+        PROF_BEGIN("frame") ;
+
+        handle_input(user) ;
+        handle_control(esContext) ;
         if (esContext->updateFunc != NULL)
             esContext->updateFunc(esContext, (float) deltaTime);
+        framestatsPhase(user->stats, FSTATS_UPDATE) ;
+        perfctrPhase(user->perf, user->perfPhase[FSTATS_UPDATE]) ;
         if (esContext->drawFunc != NULL)
             esContext->drawFunc(esContext);
-
-        eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);
+        framestatsPhase(user->stats, FSTATS_DRAW) ;
+        perfctrPhase(user->perf, user->perfPhase[FSTATS_DRAW]) ;
+        pacerSubmitted(user->pacer) ;
+
+        PROF_BEGIN("eglSwapBuffers") ;
+        if ( user->damage )
+            esSwapBuffersWithDamage(esContext, damageRects, damageTake(user->damage, damageRects)) ;
+        else
+            esSwapBuffers(esContext);
+        PROF_END("eglSwapBuffers") ;
+        pacerSwapped(user->pacer) ;
+        if ( user->inputTime > 0.0 ) {
+            framestatsLatency(user->stats, user->inputTime) ;
+            user->inputTime = 0.0 ;
+        }
+        if ( user->startup ) {
+            user->firstFrameMs = startupFirstFrame(user->startup) ;
+            startupDestroy(user->startup) ;
+            user->startup = NULL ;
+        }
+        framestatsPhase(user->stats, FSTATS_SWAP) ;
+        perfctrPhase(user->perf, user->perfPhase[FSTATS_SWAP]) ;
+        framestatsEnd(user->stats) ;
+        if ( stressFrame(user->stress) && !user->control ) user->toexit = 1 ;
+        glcountFrame() ;
+        gltraceFrame() ;
+        shaderlibWarm(user->shaders, SHADER_WARM_US) ;
+        if ( shaderlibReload(user->shaders, SHADER_RELOAD_US) ) rebind_program(user) ;
+        publish_telemetry(user) ;
+        PROF_END("frame") ;
   
-        if ( ++iTimeLoop == 30 ) {  // 1 loop ~16ms, 30 ~= 480ms
-            if ( user->etime > dPeriod ) user->toexit = 1 ;
-            iTimeLoop = 0 ;
-//            printf(".") ; fflush(NULL) ;
-            if ( !user->toexit && user->etime > dKeyCheck ) {
-                if ( getkeycode(user->keyboard_fd) == 1 ) user->toexit = 1 ;
-                dKeyCheck = user->etime + MICRO ; // Check again in a second.
-            }
+        // Every frame, so a paced or slow frame rate does not overrun the
+        // period. It may be changed by a command, 0 runs until quit.
+        dPeriod = (double) floor(user->period * MICRO + 0.5) ;
+        if ( dPeriod > 0.0 && user->etime > dPeriod && !user->stress ) user->toexit = 1 ;
+        if ( user->etime > dStats ) {
+            if ( user->stream ) texstreamPrintStats(user->stream) ;
+            framestatsReport(user->stats) ;
+            perfctrReport(user->perf) ;
+            glcountReport() ;
+            dStats = user->etime + 2.0 * MICRO ;
         }
 //        nanosleep(&pause,NULL) ;
     }
     user->etime = uelapsedtime(0) ;
-    --user->count ;
-    printf("\nStopped!\n") ;
+    if ( user->count > iLimit ) --user->count ;   // not drawn
+    logInfo("\nStopped!\n") ;
 
     double et = user->etime / MICRO ;
-    printf("Time taken for %d loops : %.3fs, %.3fms/frame, %.1fHz\n",
-           user->count,et,et*1000.0/user->count,user->count/et) ;
+    logInfo("Time taken for %d loops : %.3fs, %.3fms/frame, %.1fHz\n",
+            user->count,et,et*1000.0/user->count,user->count/et) ;
+    framestatsFinish(user->stats) ;
+    perfctrFinish(user->perf) ;
+    glcountFinish() ;
 
     return 0;   
 
@@ -1020,26 +2471,199 @@ static int myMainLoop (ESContext *esContext)
 
 
 
+// Startup tasks, each given the ESContext and returning 0 if it failed.
+
+// Keyboard/mouse/touch device discovery and the input thread.
+static int task_input(void *arg)
+{
+    UserData *user = ((ESContext *) arg)->userData;
+
+    init_terminal() ;
+    user->input = inputStart(INPUT_ALL) ;
+    return 1 ;
+
+} // task_input
+
+
+
+// The background loader. The textured cube's image is loaded by it,
+// decoded while the window is created and uploaded in a later frame.
+static int task_assets(void *arg)
+{
+    UserData *user = ((ESContext *) arg)->userData;
+
+    user->assets = assetsInit(0) ;
+    if ( user->routine == 3 )
+        user->texAsset = assetsLoadTexture(user->assets, user->imagefn) ;
+    return 1 ;
+
+} // task_assets
+
+
+
+// The image, but not for the loader's or the streamed image.
+static int task_load_image(void *arg)
+{
+    UserData *user = ((ESContext *) arg)->userData;
+
+    if ( user->routine == 3 || user->routine == 6 ) return 1 ;
+    return load_image(user) ;
+
+} // task_load_image
+
+
+
+static int task_shader_cache(void *arg)
+{
+    shaderlibLoadCache(((UserData *) ((ESContext *) arg)->userData)->shaders) ;
+    return 1 ;
+
+} // task_shader_cache
+
+
+
+static int task_pack_atlas(void *arg)
+{
+    UserData *user = ((ESContext *) arg)->userData;
+
+    if ( user->routine != 5 ) return 1 ;
+    return pack_atlas(user) > 0 ;
+
+} // task_pack_atlas
+
+
+
+static int task_meshes(void *arg)
+{
+    return generate_objects(((ESContext *) arg)->userData) ;
+} // task_meshes
+
+
+
+static int task_window(void *arg)
+{
+    ESContext *esContext = arg ;
+    UserData *user = esContext->userData;
+
+    // IMPORTANT : Use  '| ES_WINDOW_ALPHA | ES_WINDOW_DEPTH' flags.
+    GLuint flags = ES_WINDOW_RGB | ES_WINDOW_ALPHA | ES_WINDOW_DEPTH ;
+    perfctrMark(user->perf) ;
+    if ( esCreateWindow(esContext, "Hello World", user->winWidth, user->winHeight, flags) != GL_TRUE ) {
+        logError("Unable to create the window.\n") ;
+        return 0 ;
+    }
+    perfctrPhase(user->perf, perfctrAddPhase(user->perf, "esCreateWindow")) ;
+    logInfo("Screen size : (%d,%d) on %s%s.\n",esContext->width,esContext->height,
+            esGetPlatform(esContext), esContext->fbo ? " (FBO)" : "") ;
+    if ( user->glTraceName && !gltraceStart(user->glTraceName, esContext->width, esContext->height) )
+        logInfo("GL trace: Not recorded, build with 'make GLTRACE=1'.\n") ;
+    user->aspect = (float) esContext->width / esContext->height ;
+    return 1 ;
+
+} // task_window
+
+
+
+// Lets the loader upload into the context.
+static int task_attach(void *arg)
+{
+    ESContext *esContext = arg ;
+
+    assetsAttachContext(((UserData *) esContext->userData)->assets, esContext) ;
+    return 1 ;
+
+} // task_attach
+
+
+
+static int task_shaders(void *arg)
+{
+    UserData *user = ((ESContext *) arg)->userData;
+    int ret ;
+
+    perfctrMark(user->perf) ;
+    ret = init_shaders(arg) ;
+    perfctrPhase(user->perf, perfctrAddPhase(user->perf, "init_shaders")) ;
+    return ret ;
+
+} // task_shaders
+
+
+
+static int task_objects(void *arg)
+{
+    UserData *user = ((ESContext *) arg)->userData;
+
+    perfctrMark(user->perf) ;
+    initialise_objects(arg) ;  // After shaders set up.
+    perfctrPhase(user->perf, perfctrAddPhase(user->perf, "initialise_objects")) ;
+    return 1 ;
+
+} // task_objects
+
+
+
+/***********************************************************
+ * Name: add_startup_tasks
+ *
+ * Arguments:
+ *     ESContext *esContext - holds display/user data.
+ *
+ * Description: The startup graph. Input, the loader, the image,
+ *              the shader binaries, the atlas and the meshes are
+ *              CPU work run while the window is created, the
+ *              shaders and objects follow as soon as the context
+ *              and their data are ready.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void add_startup_tasks(ESContext *esContext)
+{
+    STARTUP_T *su = ((UserData *) esContext->userData)->startup ;
+    int window, assets, image, atlas, meshes, cache, shaders ;
+
+    window = startupAdd(su, "esCreateWindow", STARTUP_GL, task_window, esContext, 0) ;
+    startupAdd(su, "inputStart", STARTUP_CPU, task_input, esContext, 0) ;
+    assets = startupAdd(su, "assetsInit", STARTUP_CPU, task_assets, esContext, 0) ;
+    image = startupAdd(su, "esLoadTGA", STARTUP_CPU, task_load_image, esContext, 0) ;
+    cache = startupAdd(su, "shaderlibLoadCache", STARTUP_CPU, task_shader_cache, esContext, 0) ;
+    atlas = startupAdd(su, "pack_atlas", STARTUP_CPU, task_pack_atlas, esContext,
+                       STARTUP_NEEDS(image)) ;
+    meshes = startupAdd(su, "generate_objects", STARTUP_CPU, task_meshes, esContext,
+                        STARTUP_NEEDS(atlas)) ;
+    startupAdd(su, "assetsAttachContext", STARTUP_GL, task_attach, esContext,
+               STARTUP_NEEDS(window) | STARTUP_NEEDS(assets)) ;
+    // Routine 3 takes its texture from the asset task's texAsset.
+    shaders = startupAdd(su, "init_shaders", STARTUP_GL, task_shaders, esContext,
+                         STARTUP_NEEDS(window) | STARTUP_NEEDS(image) | STARTUP_NEEDS(atlas) |
+                         STARTUP_NEEDS(cache) | STARTUP_NEEDS(assets)) ;
+    startupAdd(su, "initialise_objects", STARTUP_GL, task_objects, esContext,
+               STARTUP_NEEDS(shaders) | STARTUP_NEEDS(meshes)) ;
+
+} // add_startup_tasks
+
+
+
 int main(int argc, char **argv) {
     UserData *user_p = &userData ;
 
     // Clear UserData memory.
     memset( user_p , 0, sizeof( UserData ) );
 
+    // Time to first frame is from here.
+    user_p->startup = startupCreate() ;
+
     esInitContext(esContextp);
     esContext.userData = user_p;
 
-    // General initialise 
-    initialise(argc,argv,esContextp) ;
+    profThreadName("render") ;
 
-    // IMPORTANT : Use  '| ES_WINDOW_ALPHA | ES_WINDOW_DEPTH' flags.
-    assert( esCreateWindow(esContextp, "Hello World", 0, 0, ES_WINDOW_RGB | ES_WINDOW_ALPHA | ES_WINDOW_DEPTH) == GL_TRUE ) ;
-    printf("Screen size : (%d,%d).\n",esContext.width,esContext.height) ;
-    user_p->aspect = esContext.width / esContext.height ;
-
-    if ( !init_shaders(esContextp) ) return 0; // Will run exit_func()
+    // General initialise 
+    initialise(argc,argv,esContextp) ;   // -T starts the profile.
 
-    initialise_objects(esContextp) ;  // After shaders set up.
+    add_startup_tasks(esContextp) ;
+    if ( !startupRun(user_p->startup) ) return 1 ; // Will run exit_func()
 
     myMainLoop(esContextp); 
 
@@ -0,0 +1,416 @@
+
+/*
+  This module keeps frame time statistics in HDR histograms.
+
+  A histogram has 2^(HDR_SUB_BITS-1) linear sub-buckets per power of two
+  (the first power covers 0 to 2^HDR_SUB_BITS), so a value is found by a
+  count-leading-zeros and a shift, recording is one counter increment and
+  the error is relative, ~0.2%, whether the value is 20us or 2s.
+
+  Counters are incremented atomically so another thread may read a
+  histogram while the render thread records into it.
+
+  Every frame is timed by phase with uelapsedtime(). Input latency is
+  timed against the event's own timestamp, CLOCK_MONOTONIC as the input
+  layer stamps it, and is only recorded for frames that had input, so
+  its count is of those frames, not of all. framestatsReport()
+  prints the percentiles since the last report and appends them to the
+  CSV file, framestatsFinish() does the same for the whole run. The JSON
+  file always holds the latest totals, so a killed run still leaves one.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "framestats.h"
+#include "log.h"
+#include "utils.h"
+
+
+
+#define HALF          ( 1 << ( HDR_SUB_BITS - 1 ) )
+#define MAX_VALUE     ( ( (uint64_t) 1 << HDR_MAX_BITS ) - 1 )
+
+
+static const char *phaseNames[FSTATS_NPHASES] = { "update", "draw", "swap", "frame" } ;
+
+static const double percentiles[] = { 50.0, 95.0, 99.0 } ;
+#define NPERCENTILES   ( sizeof( percentiles ) / sizeof( percentiles[0] ) )
+
+
+
+// Counts index of a value in ns.
+static int hdrIndex(uint64_t v)
+{
+    int bucket = 64 - __builtin_clzll( v | ( ( 1 << HDR_SUB_BITS ) - 1 ) ) - HDR_SUB_BITS ;
+
+    return ( ( bucket + 1 ) << ( HDR_SUB_BITS - 1 ) ) + (int) ( v >> bucket ) - HALF ;
+} // hdrIndex
+
+
+
+// Highest value counted at an index.
+static uint64_t hdrValue(int index)
+{
+    int bucket = ( index >> ( HDR_SUB_BITS - 1 ) ) - 1 ;
+    uint64_t sub = ( index & ( HALF - 1 ) ) + HALF ;
+
+    if ( bucket < 0 ) {
+        sub -= HALF ;
+        bucket = 0 ;
+    }
+    return ( ( sub + 1 ) << bucket ) - 1 ;
+} // hdrValue
+
+
+
+void hdrReset(HDRHIST_T *h)
+{
+    memset( h, 0, sizeof( HDRHIST_T ) ) ;
+    h->min = MAX_VALUE ;
+} // hdrReset
+
+
+
+// Add one value (ns). One writer thread.
+void hdrRecord(HDRHIST_T *h, uint64_t ns)
+{
+    if ( ns > MAX_VALUE ) ns = MAX_VALUE ;
+
+    __atomic_fetch_add( &h->counts[hdrIndex(ns)], 1, __ATOMIC_RELAXED ) ;
+    __atomic_fetch_add( &h->total, 1, __ATOMIC_RELEASE ) ;
+    if ( ns > h->max ) h->max = ns ;
+    if ( ns < h->min ) h->min = ns ;
+    h->sum += ns ;
+} // hdrRecord
+
+
+
+/***********************************************************
+ * Name: hdrPercentile
+ *
+ * Arguments:
+ *     h          - histogram.
+ *     percentile - 0 to 100.
+ *
+ * Description: Value that 'percentile' % of the samples
+ *              are at or below, to the histogram resolution.
+ *
+ * Returns: value in ns, 0 if there are no samples.
+ *
+ ***********************************************************/
+uint64_t hdrPercentile(const HDRHIST_T *h, double percentile)
+{
+    uint64_t total = __atomic_load_n( &h->total, __ATOMIC_ACQUIRE ) ;
+    uint64_t target, count = 0 ;
+    uint64_t value ;
+    int i ;
+
+    if ( total == 0 ) return 0 ;
+
+    target = (uint64_t) ceil( percentile / 100.0 * total ) ;
+    if ( target < 1 ) target = 1 ;
+
+    for ( i = 0 ; i < HDR_NCOUNTS ; ++i ) {
+        count += __atomic_load_n( &h->counts[i], __ATOMIC_RELAXED ) ;
+        if ( count >= target ) {
+            value = hdrValue(i) ;
+            return value < h->max ? value : h->max ;
+        }
+    }
+    return h->max ;
+
+} // hdrPercentile
+
+
+
+/***********************************************************
+ * Name: framestatsCreate
+ *
+ * Arguments:
+ *     budget  - frame budget in us, 0 for 60Hz.
+ *     outName - file name prefix for <outName>.csv and
+ *               <outName>.json, NULL for stdout only.
+ *
+ * Description: Allocates the histograms and opens the CSV
+ *              file. Starts the FSTATS_TIMER timer.
+ *
+ * Returns: frame statistics.
+ *
+ ***********************************************************/
+FRAMESTATS_T *framestatsCreate(double budget, const char *outName)
+{
+    FRAMESTATS_T *fs = calloc( 1, sizeof( FRAMESTATS_T ) ) ;
+    char *csvName ;
+    int p, i ;
+
+    for ( p = 0 ; p < FSTATS_NPHASES ; ++p ) {
+        hdrReset( &fs->hist[p] ) ;
+        hdrReset( &fs->last[p] ) ;
+    }
+    hdrReset( &fs->latency ) ;
+    hdrReset( &fs->lastLatency ) ;
+    fs->budget = ( budget > 0.0 ) ? budget : FSTATS_DEF_BUDGET ;
+
+    if ( outName ) {
+        csvName = malloc( strlen(outName) + 6 ) ;
+        fs->jsonName = malloc( strlen(outName) + 6 ) ;
+        sprintf(csvName,"%s.csv",outName) ;
+        sprintf(fs->jsonName,"%s.json",outName) ;
+
+        fs->csv = fopen(csvName,"w") ;
+        if ( fs->csv ) {
+            fprintf(fs->csv,"time_s,scope,frames,over_budget,fps") ;
+            for ( p = 0 ; p < FSTATS_NPHASES ; ++p ) {
+                for ( i = 0 ; i < NPERCENTILES ; ++i )
+                    fprintf(fs->csv,",%s_p%g_ms",phaseNames[p],percentiles[i]) ;
+                fprintf(fs->csv,",%s_max_ms,%s_mean_ms",phaseNames[p],phaseNames[p]) ;
+            }
+            fprintf(fs->csv,",latency_count") ;
+            for ( i = 0 ; i < NPERCENTILES ; ++i )
+                fprintf(fs->csv,",latency_p%g_ms",percentiles[i]) ;
+            fprintf(fs->csv,",latency_max_ms,latency_mean_ms\n") ;
+        } else
+            logWarn("Frame stats: Unable to create '%s'.\n",csvName) ;
+        free( csvName ) ;
+    }
+
+    resettimer(FSTATS_TIMER) ;
+    fs->since = fs->lastReport = uelapsedtime(FSTATS_TIMER) ;
+    return fs ;
+
+} // framestatsCreate
+
+
+
+// Start of a frame.
+void framestatsBegin(FRAMESTATS_T *fs)
+{
+    fs->frameStart = fs->mark = uelapsedtime(FSTATS_TIMER) ;
+} // framestatsBegin
+
+
+
+// End of a phase, timed from the end of the previous one.
+void framestatsPhase(FRAMESTATS_T *fs, int phase)
+{
+    double now = uelapsedtime(FSTATS_TIMER) ;
+    uint64_t ns = (uint64_t) ( ( now - fs->mark ) * 1000.0 ) ;
+
+    hdrRecord( &fs->hist[phase], ns ) ;
+    hdrRecord( &fs->last[phase], ns ) ;
+    fs->mark = now ;
+} // framestatsPhase
+
+
+
+// End of a frame, after the swap.
+void framestatsEnd(FRAMESTATS_T *fs)
+{
+    double us = uelapsedtime(FSTATS_TIMER) - fs->frameStart ;
+    uint64_t ns = (uint64_t) ( us * 1000.0 ) ;
+
+    hdrRecord( &fs->hist[FSTATS_FRAME], ns ) ;
+    hdrRecord( &fs->last[FSTATS_FRAME], ns ) ;
+    fs->lastFrame = us ;
+    fs->frames++ ;
+    if ( us > fs->budget ) {
+        fs->over++ ;
+        fs->lastOver++ ;
+    }
+} // framestatsEnd
+
+
+
+/***********************************************************
+ * Name: framestatsLatency
+ *
+ * Arguments:
+ *     fs      - frame statistics.
+ *     eventUs - timestamp of the earliest input event the
+ *               frame showed, us CLOCK_MONOTONIC.
+ *
+ * Description: Just after the swap returned, records the
+ *              time from the event to now.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void framestatsLatency(FRAMESTATS_T *fs, double eventUs)
+{
+    double us = nowus() - eventUs ;
+
+    if ( us < 0.0 ) us = 0.0 ;
+
+    hdrRecord( &fs->latency, (uint64_t) ( us * 1000.0 ) ) ;
+    hdrRecord( &fs->lastLatency, (uint64_t) ( us * 1000.0 ) ) ;
+} // framestatsLatency
+
+
+
+static double ms(uint64_t ns)
+{
+    return ns / 1000000.0 ;
+} // ms
+
+
+
+// Mean of a histogram in ms.
+static double mean(const HDRHIST_T *h)
+{
+    return h->total ? h->sum / h->total / 1000000.0 : 0.0 ;
+} // mean
+
+
+
+// One line of percentiles for a set of histograms, to stdout and CSV,
+// and one of the input latency if any frame had input.
+static void report(FRAMESTATS_T *fs, HDRHIST_T *hist, HDRHIST_T *latency, const char *scope,
+                   unsigned long over, double since)
+{
+    double now = uelapsedtime(FSTATS_TIMER), t = now / 1000000.0 ;
+    unsigned long frames = (unsigned long) hist[FSTATS_FRAME].total ;
+    double fps = now > since ? frames * 1000000.0 / ( now - since ) : 0.0 ;
+    char line[256] ;
+    int p, i, n = 0 ;
+
+    // One message, so the line is not split by other threads' messages.
+    for ( p = 0 ; p < FSTATS_NPHASES ; ++p )
+        n += snprintf(line + n, sizeof( line ) - n, " %s %.2f/%.2f/%.2f/%.2f",phaseNames[p],
+                      ms(hdrPercentile(&hist[p],50.0)),ms(hdrPercentile(&hist[p],95.0)),
+                      ms(hdrPercentile(&hist[p],99.0)),ms(hist[p].max)) ;
+    logInfo("Frame ms (%s, %lu frames, %.1ffps, %lu over %.1fms) p50/p95/p99/max :%s\n",
+            scope,frames,fps,over,fs->budget / 1000.0,line) ;
+    if ( latency->total )
+        logInfo("Input to swap ms (%s, %llu frames with input) p50/p95/p99/max : %.2f/%.2f/%.2f/%.2f\n",
+                scope,(unsigned long long) latency->total,ms(hdrPercentile(latency,50.0)),
+                ms(hdrPercentile(latency,95.0)),ms(hdrPercentile(latency,99.0)),ms(latency->max)) ;
+
+    if ( fs->csv ) {
+        fprintf(fs->csv,"%.3f,%s,%lu,%lu,%.2f",t,scope,frames,over,fps) ;
+        for ( p = 0 ; p < FSTATS_NPHASES ; ++p ) {
+            for ( i = 0 ; i < NPERCENTILES ; ++i )
+                fprintf(fs->csv,",%.4f",ms(hdrPercentile(&hist[p],percentiles[i]))) ;
+            fprintf(fs->csv,",%.4f,%.4f",ms(hist[p].max),mean(&hist[p])) ;
+        }
+        fprintf(fs->csv,",%llu",(unsigned long long) latency->total) ;
+        for ( i = 0 ; i < NPERCENTILES ; ++i )
+            fprintf(fs->csv,",%.4f",ms(hdrPercentile(latency,percentiles[i]))) ;
+        fprintf(fs->csv,",%.4f,%.4f\n",ms(latency->max),mean(latency)) ;
+        fflush(fs->csv) ;
+    }
+} // report
+
+
+
+// One histogram's JSON object, after its name.
+static void writeHist(FILE *f, const HDRHIST_T *h)
+{
+    int i ;
+
+    fprintf(f,"{ \"count\": %llu",(unsigned long long) h->total) ;
+    for ( i = 0 ; i < NPERCENTILES ; ++i )
+        fprintf(f,", \"p%g_ms\": %.4f",percentiles[i],ms(hdrPercentile(h,percentiles[i]))) ;
+    fprintf(f,", \"max_ms\": %.4f, \"min_ms\": %.4f, \"mean_ms\": %.4f }",
+            ms(h->max),h->total ? ms(h->min) : 0.0,mean(h)) ;
+} // writeHist
+
+
+
+// Totals since the start, replacing the JSON file.
+static void writeJSON(FRAMESTATS_T *fs)
+{
+    char tmpName[PATH_MAX] ;
+    double now ;
+    FILE *f ;
+    int p ;
+
+    if ( fs->jsonName == NULL ) return ;
+
+    snprintf(tmpName,sizeof(tmpName),"%s.tmp",fs->jsonName) ;
+    f = fopen(tmpName,"w") ;
+    if ( f == NULL ) return ;
+
+    now = uelapsedtime(FSTATS_TIMER) ;
+    fprintf(f,"{\n  \"duration_s\": %.3f,\n  \"frames\": %lu,\n  \"fps\": %.2f,\n",
+            now / 1000000.0,fs->frames,now > fs->since ? fs->frames * 1000000.0 / ( now - fs->since ) : 0.0) ;
+    fprintf(f,"  \"budget_ms\": %.3f,\n  \"over_budget\": %lu,\n  \"phases\": {\n",
+            fs->budget / 1000.0,fs->over) ;
+    for ( p = 0 ; p < FSTATS_NPHASES ; ++p ) {
+        fprintf(f,"    \"%s\": ",phaseNames[p]) ;
+        writeHist(f,&fs->hist[p]) ;
+        fprintf(f,"%s\n",p < FSTATS_NPHASES - 1 ? "," : "") ;
+    }
+    fprintf(f,"  },\n  \"input_latency\": ") ;
+    writeHist(f,&fs->latency) ;
+    fprintf(f,"\n}\n") ;
+    fclose(f) ;
+
+    rename(tmpName,fs->jsonName) ;
+} // writeJSON
+
+
+
+// Report and restart the statistics since the last report.
+void framestatsReport(FRAMESTATS_T *fs)
+{
+    int p ;
+
+    if ( fs->last[FSTATS_FRAME].total == 0 ) return ;
+
+    report(fs,fs->last,&fs->lastLatency,"interval",fs->lastOver,fs->lastReport) ;
+    writeJSON(fs) ;
+
+    for ( p = 0 ; p < FSTATS_NPHASES ; ++p )
+        hdrReset( &fs->last[p] ) ;
+    hdrReset( &fs->lastLatency ) ;
+    fs->lastOver = 0 ;
+    fs->lastReport = uelapsedtime(FSTATS_TIMER) ;
+} // framestatsReport
+
+
+
+// Start over, as if no frames had been recorded.
+void framestatsReset(FRAMESTATS_T *fs)
+{
+    int p ;
+
+    for ( p = 0 ; p < FSTATS_NPHASES ; ++p ) {
+        hdrReset( &fs->hist[p] ) ;
+        hdrReset( &fs->last[p] ) ;
+    }
+    hdrReset( &fs->latency ) ;
+    hdrReset( &fs->lastLatency ) ;
+    fs->frames = 0 ;
+    fs->over = 0 ;
+    fs->lastOver = 0 ;
+    fs->since = fs->lastReport = uelapsedtime(FSTATS_TIMER) ;
+} // framestatsReset
+
+
+
+// Report the whole run.
+void framestatsFinish(FRAMESTATS_T *fs)
+{
+    if ( fs->frames == 0 ) return ;
+
+    report(fs,fs->hist,&fs->latency,"total",fs->over,fs->since) ;
+    writeJSON(fs) ;
+} // framestatsFinish
+
+
+
+void framestatsDestroy(FRAMESTATS_T *fs)
+{
+    if ( fs == NULL ) return ;
+
+    if ( fs->csv ) fclose( fs->csv ) ;
+    free( fs->jsonName ) ;
+    free( fs ) ;
+} // framestatsDestroy
+
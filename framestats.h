@@ -0,0 +1,103 @@
+
+/* ************************************************************************* *
+
+  Module Name : framestats.h
+
+  Description : Per-frame timing statistics. The update, draw submit and
+    swap phases of every frame, and the whole frame, are recorded into
+    HDR (high dynamic range, log-linear) histograms, so percentiles stay
+    accurate from microseconds to seconds at a fixed cost per sample.
+    Reports p50/p95/p99/max, frames over budget and the frame rate,
+    periodically and at exit, to stdout and optionally to CSV/JSON files.
+    Frames that showed input also record the latency from the input
+    event's timestamp to the return of the swap that presented it.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __FRAMESTATS_H__
+#define __FRAMESTATS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+// Histogram resolution : 2^HDR_SUB_BITS sub-buckets per power of two, so
+// values are kept to within 1/2^(HDR_SUB_BITS-1) (~0.2%).
+#define HDR_SUB_BITS          10
+#define HDR_MAX_BITS          36          // Highest value 2^36ns (~68s).
+#define HDR_NCOUNTS   ( ( HDR_MAX_BITS - HDR_SUB_BITS + 2 ) << ( HDR_SUB_BITS - 1 ) )
+
+// Frame phases.
+#define FSTATS_UPDATE          0          // CPU update (animation, MVPs).
+#define FSTATS_DRAW            1          // GL command submission.
+#define FSTATS_SWAP            2          // eglSwapBuffers (or glFinish headless).
+#define FSTATS_FRAME           3          // Whole frame, begin to end of swap.
+#define FSTATS_NPHASES         4
+
+#define FSTATS_TIMER           1          // utils.c timer slot used.
+#define FSTATS_DEF_BUDGET  16666.7        // Default frame budget in us (60Hz).
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    uint32_t    counts[HDR_NCOUNTS] ;
+    uint64_t    total ;         // samples
+    uint64_t    max ;           // ns
+    uint64_t    min ;
+    double      sum ;           // ns, for the mean
+} HDRHIST_T ;
+
+typedef struct {
+    HDRHIST_T   hist[FSTATS_NPHASES] ;      // since start
+    HDRHIST_T   last[FSTATS_NPHASES] ;      // since the last report
+    HDRHIST_T   latency ;       // input event to swap return, since start
+    HDRHIST_T   lastLatency ;   // and since the last report
+    double      budget ;        // us per frame
+    unsigned long frames ;
+    unsigned long over ;        // frames over budget since start
+    unsigned long lastOver ;    // and since the last report
+    double      frameStart ;    // us, uelapsedtime(FSTATS_TIMER)
+    double      lastFrame ;     // us, the last whole frame
+    double      mark ;          // end of the last phase
+    double      since ;         // us, start or reset, for the frame rate
+    double      lastReport ;    // us, the last report
+    FILE       *csv ;
+    char       *jsonName ;
+} FRAMESTATS_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+void hdrReset(HDRHIST_T *h) ;
+
+void hdrRecord(HDRHIST_T *h, uint64_t ns) ;
+
+uint64_t hdrPercentile(const HDRHIST_T *h, double percentile) ;
+
+FRAMESTATS_T *framestatsCreate(double budget, const char *outName) ;
+
+void framestatsBegin(FRAMESTATS_T *fs) ;
+
+void framestatsPhase(FRAMESTATS_T *fs, int phase) ;
+
+void framestatsEnd(FRAMESTATS_T *fs) ;
+
+void framestatsLatency(FRAMESTATS_T *fs, double eventUs) ;
+
+void framestatsReport(FRAMESTATS_T *fs) ;
+
+void framestatsReset(FRAMESTATS_T *fs) ;
+
+void framestatsFinish(FRAMESTATS_T *fs) ;
+
+void framestatsDestroy(FRAMESTATS_T *fs) ;
+
+#endif // __FRAMESTATS_H__
@@ -0,0 +1,235 @@
+
+/*
+  This module keeps the GL call counts for glcount.h's wrappers.
+
+  The wrappers add into glcFrame; glcountFrame() moves a frame's counts
+  into the totals since the last report and since the start.
+
+  Client arrays are only read by the driver at the draw, so the wrappers
+  remember, per thread (a context is current on one thread), which
+  vertex attributes are enabled and sourced from client memory and the
+  size of an element. A draw then counts elements x vertices. For
+  glDrawElements with client indices the vertices are found from the
+  highest index; with an index buffer they can not be read back in
+  ES 2.0, so the index count is used.
+*/
+
+
+#ifdef GLCOUNT
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <string.h>
+
+#include "glcount.h"
+#include "log.h"
+
+
+
+GLCOUNT_T glcFrame ;
+
+static GLCOUNT_T last ;        // the last frame
+static GLCOUNT_T interval ;
+static GLCOUNT_T total ;
+static unsigned long intervalFrames = 0 ;
+static unsigned long totalFrames = 0 ;
+
+static __thread GLuint arrayBuffer = 0 ;
+static __thread GLuint elementBuffer = 0 ;
+static __thread unsigned char attribEnabled[GLC_MAX_ATTRIBS] ;
+static __thread GLsizei attribClientSize[GLC_MAX_ATTRIBS] ;  // bytes per vertex, 0 = in a VBO
+
+
+
+static GLsizei typeSize(GLenum type)
+{
+    switch ( type ) {
+        case GL_BYTE :
+        case GL_UNSIGNED_BYTE :  return 1 ;
+        case GL_SHORT :
+        case GL_UNSIGNED_SHORT : return 2 ;
+        default :                return 4 ;   // GL_FLOAT, GL_FIXED
+    }
+} // typeSize
+
+
+
+static unsigned long primitives(GLenum mode, GLsizei count)
+{
+    switch ( mode ) {
+        case GL_POINTS :         return count ;
+        case GL_LINES :          return count / 2 ;
+        case GL_LINE_LOOP :      return count ;
+        case GL_LINE_STRIP :     return count > 1 ? count - 1 : 0 ;
+        case GL_TRIANGLES :      return count / 3 ;
+        default :                return count > 2 ? count - 2 : 0 ;   // strips, fans
+    }
+} // primitives
+
+
+
+// Highest index + 1 in client indices.
+static GLsizei indexedVertices(GLsizei count, GLenum type, const GLvoid *indices)
+{
+    GLuint max = 0 ;
+    GLsizei i ;
+
+    if ( type == GL_UNSIGNED_BYTE ) {
+        for ( i = 0 ; i < count ; ++i )
+            if ( ( (const GLubyte *) indices )[i] > max ) max = ( (const GLubyte *) indices )[i] ;
+    } else {
+        for ( i = 0 ; i < count ; ++i )
+            if ( ( (const GLushort *) indices )[i] > max ) max = ( (const GLushort *) indices )[i] ;
+    }
+    return count ? (GLsizei) max + 1 : 0 ;
+} // indexedVertices
+
+
+
+// A draw call : type 0 for glDrawArrays.
+void glcountDraw(GLenum mode, GLint first, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    GLsizei vertices = count, bytes = 0 ;
+    int a ;
+
+    GLC_ADD(GLC_DRAWS, 1) ;
+    GLC_ADD(GLC_PRIMITIVES, primitives(mode,count)) ;
+
+    if ( type && elementBuffer == 0 ) {
+        bytes += count * typeSize(type) ;
+        vertices = indexedVertices(count,type,indices) ;
+    }
+    for ( a = 0 ; a < GLC_MAX_ATTRIBS ; ++a )
+        if ( attribEnabled[a] ) bytes += attribClientSize[a] * vertices ;
+
+    if ( bytes ) GLC_ADD(GLC_CLIENT_BYTES, bytes) ;
+} // glcountDraw
+
+
+
+void glcountBindBuffer(GLenum target, GLuint buffer)
+{
+    GLC_ADD(GLC_BUFFERS, 1) ;
+    if ( target == GL_ARRAY_BUFFER )
+        arrayBuffer = buffer ;
+    else if ( target == GL_ELEMENT_ARRAY_BUFFER )
+        elementBuffer = buffer ;
+} // glcountBindBuffer
+
+
+
+// An attribute's source, as glVertexAttribPointer is called.
+void glcountAttribPointer(GLuint index, GLint size, GLenum type)
+{
+    if ( index < GLC_MAX_ATTRIBS )
+        attribClientSize[index] = arrayBuffer ? 0 : size * typeSize(type) ;
+} // glcountAttribPointer
+
+
+
+void glcountAttribArray(GLuint index, int enabled)
+{
+    if ( index < GLC_MAX_ATTRIBS ) attribEnabled[index] = enabled ;
+} // glcountAttribArray
+
+
+
+// Bytes in an image passed to glTex(Sub)Image2D (GL_UNPACK_ALIGNMENT 1).
+GLsizeiptr glcountImageBytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    GLsizeiptr pixel ;
+
+    if ( type != GL_UNSIGNED_BYTE )
+        pixel = 2 ;           // GL_UNSIGNED_SHORT_5_6_5, _4_4_4_4, _5_5_5_1
+    else if ( format == GL_RGBA )
+        pixel = 4 ;
+    else if ( format == GL_RGB )
+        pixel = 3 ;
+    else if ( format == GL_LUMINANCE_ALPHA )
+        pixel = 2 ;
+    else
+        pixel = 1 ;
+    return (GLsizeiptr) width * height * pixel ;
+} // glcountImageBytes
+
+
+
+// End of a frame.
+void glcountFrame(void)
+{
+    unsigned long long n ;
+    int c ;
+
+    for ( c = 0 ; c < GLC_NCOUNTERS ; ++c ) {
+        n = __atomic_exchange_n( &glcFrame.count[c], 0, __ATOMIC_RELAXED ) ;
+        last.count[c] = n ;
+        interval.count[c] += n ;
+        total.count[c] += n ;
+    }
+    intervalFrames++ ;
+    totalFrames++ ;
+} // glcountFrame
+
+
+
+// Counts of the last frame ended.
+void glcountLast(GLCOUNT_T *g)
+{
+    *g = last ;
+} // glcountLast
+
+
+
+// Per frame averages, or counts if frames is 0.
+static void report(const GLCOUNT_T *g, unsigned long frames, const char *scope)
+{
+    const unsigned long long *c = g->count ;
+    double n = frames ? (double) frames : 1.0 ;
+    char title[80] ;
+
+    if ( frames )
+        snprintf(title, sizeof( title ), "GL per frame (%s, %lu frames)",scope,frames) ;
+    else
+        snprintf(title, sizeof( title ), "GL at %s",scope) ;
+    logInfo("%s : %.1f draws, %.0f primitives, binds %.1f program"
+            " %.1f buffer %.1f texture, %.1f uniforms, KB %.1f client %.1f buffer %.1f texture\n",
+            title,c[GLC_DRAWS] / n,c[GLC_PRIMITIVES] / n,c[GLC_PROGRAMS] / n,
+            c[GLC_BUFFERS] / n,c[GLC_TEXTURES] / n,c[GLC_UNIFORMS] / n,
+            c[GLC_CLIENT_BYTES] / n / 1024.0,c[GLC_BUFFER_BYTES] / n / 1024.0,
+            c[GLC_TEXTURE_BYTES] / n / 1024.0) ;
+} // report
+
+
+
+// Report and clear the counts before the first frame.
+void glcountStart(void)
+{
+    GLCOUNT_T startup ;
+    int c ;
+
+    for ( c = 0 ; c < GLC_NCOUNTERS ; ++c )
+        startup.count[c] = __atomic_exchange_n( &glcFrame.count[c], 0, __ATOMIC_RELAXED ) ;
+    report(&startup,0,"startup") ;
+} // glcountStart
+
+
+
+// Report and restart the counts since the last report.
+void glcountReport(void)
+{
+    if ( intervalFrames == 0 ) return ;
+
+    report(&interval,intervalFrames,"interval") ;
+    memset( &interval, 0, sizeof( interval ) ) ;
+    intervalFrames = 0 ;
+} // glcountReport
+
+
+
+// Report the whole run.
+void glcountFinish(void)
+{
+    if ( totalFrames ) report(&total,totalFrames,"total") ;
+} // glcountFinish
+
+#endif // GLCOUNT
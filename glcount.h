@@ -0,0 +1,215 @@
+
+/* ************************************************************************* *
+
+  Module Name : glcount.h
+
+  Description : GL call counting. Built with -DGLCOUNT ('make GLCOUNT=1'),
+    including this header after the GL headers redirects the GL entry
+    points that send work or data to the driver through wrappers that
+    count, per frame : draw calls and primitives, program, buffer and
+    texture binds, uniform uploads, and the bytes passed in client vertex
+    arrays and indices, glBuffer(Sub)Data and glTex(Sub)Image2D.
+
+    Without GLCOUNT the header defines no wrappers and the glcount calls
+    are empty macros, so a normal build calls GL directly.
+
+    Not counted : data written through glMapBufferOES (dynbuf.c prints
+    its own totals) and calls made by the GL libraries themselves.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __GLCOUNT_H__
+#define __GLCOUNT_H__
+
+#include <GLES2/gl2.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define GLC_MAX_ATTRIBS       16          // Vertex attributes tracked.
+
+// Counters.
+#define GLC_DRAWS              0
+#define GLC_PRIMITIVES         1
+#define GLC_PROGRAMS           2          // glUseProgram
+#define GLC_BUFFERS            3          // glBindBuffer
+#define GLC_TEXTURES           4          // glBindTexture
+#define GLC_UNIFORMS           5          // glUniform*
+#define GLC_CLIENT_BYTES       6          // client vertex arrays and indices
+#define GLC_BUFFER_BYTES       7          // glBufferData/glBufferSubData
+#define GLC_TEXTURE_BYTES      8          // glTexImage2D/glTexSubImage2D
+#define GLC_NCOUNTERS          9
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    unsigned long long  count[GLC_NCOUNTERS] ;
+} GLCOUNT_T ;
+
+#ifdef GLCOUNT
+
+/* ************************************************************************* *
+ * GLOBALS
+ * ************************************************************************* */
+
+// Counts since glcountFrame(). Textures may be uploaded from the asset
+// thread, so counters are added to atomically.
+extern GLCOUNT_T glcFrame ;
+
+#define GLC_ADD(c,n)   __atomic_fetch_add( &glcFrame.count[c], (unsigned long long) (n), __ATOMIC_RELAXED )
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+void glcountStart(void) ;
+
+void glcountFrame(void) ;
+
+void glcountReport(void) ;
+
+void glcountLast(GLCOUNT_T *g) ;
+
+void glcountFinish(void) ;
+
+void glcountDraw(GLenum mode, GLint first, GLsizei count, GLenum type, const GLvoid *indices) ;
+
+void glcountBindBuffer(GLenum target, GLuint buffer) ;
+
+void glcountAttribPointer(GLuint index, GLint size, GLenum type) ;
+
+void glcountAttribArray(GLuint index, int enabled) ;
+
+GLsizeiptr glcountImageBytes(GLsizei width, GLsizei height, GLenum format, GLenum type) ;
+
+/* ************************************************************************* *
+ * WRAPPERS
+ * ************************************************************************* */
+
+static inline void glcDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    glcountDraw(mode, first, count, 0, NULL) ;
+    glDrawArrays(mode, first, count) ;
+}
+
+static inline void glcDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    glcountDraw(mode, 0, count, type, indices) ;
+    glDrawElements(mode, count, type, indices) ;
+}
+
+static inline void glcUseProgram(GLuint program)
+{
+    GLC_ADD(GLC_PROGRAMS, 1) ;
+    glUseProgram(program) ;
+}
+
+static inline void glcBindBuffer(GLenum target, GLuint buffer)
+{
+    glcountBindBuffer(target, buffer) ;
+    glBindBuffer(target, buffer) ;
+}
+
+static inline void glcBindTexture(GLenum target, GLuint texture)
+{
+    GLC_ADD(GLC_TEXTURES, 1) ;
+    glBindTexture(target, texture) ;
+}
+
+static inline void glcVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                          GLboolean normalized, GLsizei stride, const GLvoid *ptr)
+{
+    glcountAttribPointer(index, size, type) ;
+    glVertexAttribPointer(index, size, type, normalized, stride, ptr) ;
+}
+
+static inline void glcEnableVertexAttribArray(GLuint index)
+{
+    glcountAttribArray(index, 1) ;
+    glEnableVertexAttribArray(index) ;
+}
+
+static inline void glcDisableVertexAttribArray(GLuint index)
+{
+    glcountAttribArray(index, 0) ;
+    glDisableVertexAttribArray(index) ;
+}
+
+static inline void glcBufferData(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage)
+{
+    if ( data ) GLC_ADD(GLC_BUFFER_BYTES, size) ;
+    glBufferData(target, size, data, usage) ;
+}
+
+static inline void glcBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data)
+{
+    GLC_ADD(GLC_BUFFER_BYTES, size) ;
+    glBufferSubData(target, offset, size, data) ;
+}
+
+static inline void glcTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width,
+                                 GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels)
+{
+    if ( pixels ) GLC_ADD(GLC_TEXTURE_BYTES, glcountImageBytes(width, height, format, type)) ;
+    glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels) ;
+}
+
+static inline void glcTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                                    GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)
+{
+    GLC_ADD(GLC_TEXTURE_BYTES, glcountImageBytes(width, height, format, type)) ;
+    glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels) ;
+}
+
+// Every glUniform* is one upload, whatever its arguments.
+#define GLC_UNIFORM(call)   ( GLC_ADD(GLC_UNIFORMS, 1), call )
+
+#define glDrawArrays            glcDrawArrays
+#define glDrawElements          glcDrawElements
+#define glUseProgram            glcUseProgram
+#define glBindBuffer            glcBindBuffer
+#define glBindTexture           glcBindTexture
+#define glVertexAttribPointer   glcVertexAttribPointer
+#define glEnableVertexAttribArray   glcEnableVertexAttribArray
+#define glDisableVertexAttribArray  glcDisableVertexAttribArray
+#define glBufferData            glcBufferData
+#define glBufferSubData         glcBufferSubData
+#define glTexImage2D            glcTexImage2D
+#define glTexSubImage2D         glcTexSubImage2D
+
+#define glUniform1f(...)        GLC_UNIFORM(glUniform1f(__VA_ARGS__))
+#define glUniform2f(...)        GLC_UNIFORM(glUniform2f(__VA_ARGS__))
+#define glUniform3f(...)        GLC_UNIFORM(glUniform3f(__VA_ARGS__))
+#define glUniform4f(...)        GLC_UNIFORM(glUniform4f(__VA_ARGS__))
+#define glUniform1i(...)        GLC_UNIFORM(glUniform1i(__VA_ARGS__))
+#define glUniform2i(...)        GLC_UNIFORM(glUniform2i(__VA_ARGS__))
+#define glUniform3i(...)        GLC_UNIFORM(glUniform3i(__VA_ARGS__))
+#define glUniform4i(...)        GLC_UNIFORM(glUniform4i(__VA_ARGS__))
+#define glUniform1fv(...)       GLC_UNIFORM(glUniform1fv(__VA_ARGS__))
+#define glUniform2fv(...)       GLC_UNIFORM(glUniform2fv(__VA_ARGS__))
+#define glUniform3fv(...)       GLC_UNIFORM(glUniform3fv(__VA_ARGS__))
+#define glUniform4fv(...)       GLC_UNIFORM(glUniform4fv(__VA_ARGS__))
+#define glUniform1iv(...)       GLC_UNIFORM(glUniform1iv(__VA_ARGS__))
+#define glUniform2iv(...)       GLC_UNIFORM(glUniform2iv(__VA_ARGS__))
+#define glUniform3iv(...)       GLC_UNIFORM(glUniform3iv(__VA_ARGS__))
+#define glUniform4iv(...)       GLC_UNIFORM(glUniform4iv(__VA_ARGS__))
+#define glUniformMatrix2fv(...) GLC_UNIFORM(glUniformMatrix2fv(__VA_ARGS__))
+#define glUniformMatrix3fv(...) GLC_UNIFORM(glUniformMatrix3fv(__VA_ARGS__))
+#define glUniformMatrix4fv(...) GLC_UNIFORM(glUniformMatrix4fv(__VA_ARGS__))
+
+#else
+
+#define glcountStart()
+#define glcountFrame()
+#define glcountReport()
+#define glcountFinish()
+#define glcountLast(g)   ( *(g) = (GLCOUNT_T) { { 0 } } )
+
+#endif // GLCOUNT
+
+#endif // __GLCOUNT_H__
@@ -0,0 +1,738 @@
+/*
+   Replays a GL command trace recorded by esTri -R (built with GLTRACE=1,
+   see gltrace.h), on any ESUtil window system.
+
+   The whole trace is read into memory first, so the replay measures GL
+   and the driver, not the disk. Object names (glGen, glCreate) and
+   attribute/uniform locations are mapped from the recorded ones to this
+   run's. Frames run back to back, or with -r at the times they were
+   recorded, and are timed with the same frame statistics as esTri.
+
+   Each record is checked against the arguments and blob its op needs
+   before it is issued, so a truncated or corrupt trace skips records
+   rather than read past them. String blobs are copied and terminated.
+
+  18/10/26 v1.0 Replay as fast as possible or at the recorded pacing.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Only the trace format from gltrace.h, GL is called directly.
+#undef GLTRACE
+
+#include "ESUtil.h"
+#include "utils.h"
+#include "framestats.h"
+#include "gltrace.h"
+
+#define VERSION  "glreplay v1.0: "
+
+#define MICRO         1000000.0       // Microseconds in a second.
+
+// Recorded name spaces.
+#define NAMES_BUFFER        0
+#define NAMES_TEXTURE       1
+#define NAMES_FRAMEBUFFER   2
+#define NAMES_RENDERBUFFER  3
+#define NAMES_SHADER        4
+#define NAMES_PROGRAM       5
+#define NNAMES              6
+
+#define MAXLOCATIONS      256
+
+// What a record's blob must be.
+#define BLOB_ANY            0          // Not read, or only if there.
+#define BLOB_NEEDED         1
+#define BLOB_STRING         2          // Needed, copied and terminated.
+
+
+typedef struct {
+    GLuint  *name ;            // recorded name -> replay name
+    uint32_t size ;
+} NAMEMAP_T ;
+
+typedef struct {
+    int      uniform ;         // else attribute
+    GLuint   program ;         // recorded program
+    GLint    recorded ;
+    GLint    location ;
+} LOCATION_T ;
+
+typedef struct {
+    char    *fileName ;
+    int      paced ;           // -r : at the recorded times.
+    double   budget ;          // Frame budget (us), 0 = 60Hz.
+    char    *statsName ;       // CSV/JSON file name prefix, or NULL.
+
+    uint32_t *trace ;          // Whole file.
+    size_t   words ;
+
+    NAMEMAP_T names[NNAMES] ;
+    LOCATION_T location[MAXLOCATIONS] ;
+    int      nlocations ;
+    GLuint   program ;         // Recorded program in use.
+    int      context ;
+    unsigned long frames ;
+    unsigned long unknown ;    // Records skipped.
+    unsigned long bad ;        // Records too short for their op, skipped.
+} REPLAY_T ;
+
+// Least arguments, and blob, of each op as gltrace.h records it.
+static const struct {
+    unsigned char nargs ;
+    unsigned char blob ;
+} recordNeeds[GLT_NOPS] = {
+    [GLT_FRAME] = { 2, BLOB_ANY },
+    [GLT_CONTEXT] = { 1, BLOB_ANY },
+    [GLT_ACTIVE_TEXTURE] = { 1, BLOB_ANY },
+    [GLT_ATTACH_SHADER] = { 2, BLOB_ANY },
+    [GLT_BIND_BUFFER] = { 2, BLOB_ANY },
+    [GLT_BIND_FRAMEBUFFER] = { 2, BLOB_ANY },
+    [GLT_BIND_RENDERBUFFER] = { 2, BLOB_ANY },
+    [GLT_BIND_TEXTURE] = { 2, BLOB_ANY },
+    [GLT_BUFFER_DATA] = { 3, BLOB_ANY },
+    [GLT_BUFFER_SUB_DATA] = { 2, BLOB_NEEDED },
+    [GLT_CLEAR] = { 1, BLOB_ANY },
+    [GLT_CLEAR_COLOR] = { 4, BLOB_ANY },
+    [GLT_COMPILE_SHADER] = { 1, BLOB_ANY },
+    [GLT_CREATE_PROGRAM] = { 1, BLOB_ANY },
+    [GLT_CREATE_SHADER] = { 2, BLOB_ANY },
+    [GLT_DELETE_PROGRAM] = { 1, BLOB_ANY },
+    [GLT_DELETE_SHADER] = { 1, BLOB_ANY },
+    [GLT_DEPTH_FUNC] = { 1, BLOB_ANY },
+    [GLT_ENABLE] = { 1, BLOB_ANY },
+    [GLT_DISABLE] = { 1, BLOB_ANY },
+    [GLT_ENABLE_ATTRIB] = { 1, BLOB_ANY },
+    [GLT_DISABLE_ATTRIB] = { 1, BLOB_ANY },
+    [GLT_DRAW_ARRAYS] = { 3, BLOB_ANY },
+    [GLT_DRAW_ELEMENTS] = { 4, BLOB_ANY },
+    [GLT_ATTRIB_POINTER] = { 6, BLOB_ANY },
+    [GLT_CLIENT_ARRAY] = { 5, BLOB_NEEDED },
+    [GLT_FRAMEBUFFER_RENDERBUFFER] = { 4, BLOB_ANY },
+    [GLT_FRAMEBUFFER_TEXTURE_2D] = { 5, BLOB_ANY },
+    [GLT_GENERATE_MIPMAP] = { 1, BLOB_ANY },
+    [GLT_GET_ATTRIB_LOCATION] = { 2, BLOB_STRING },
+    [GLT_GET_UNIFORM_LOCATION] = { 2, BLOB_STRING },
+    [GLT_LINK_PROGRAM] = { 1, BLOB_ANY },
+    [GLT_PIXEL_STOREI] = { 2, BLOB_ANY },
+    [GLT_RENDERBUFFER_STORAGE] = { 4, BLOB_ANY },
+    [GLT_SHADER_SOURCE] = { 1, BLOB_STRING },
+    [GLT_TEX_IMAGE_2D] = { 8, BLOB_ANY },
+    [GLT_TEX_SUB_IMAGE_2D] = { 8, BLOB_ANY },
+    [GLT_TEX_PARAMETERI] = { 3, BLOB_ANY },
+    [GLT_UNIFORM_F] = { 2, BLOB_ANY },
+    [GLT_UNIFORM_I] = { 2, BLOB_ANY },
+    [GLT_UNIFORM_FV] = { 4, BLOB_NEEDED },
+    [GLT_USE_PROGRAM] = { 1, BLOB_ANY },
+    [GLT_VIEWPORT] = { 4, BLOB_ANY },
+    [GLT_UNIFORM_IV] = { 3, BLOB_NEEDED },
+} ;
+
+
+ESContext esContext ;
+REPLAY_T  replay ;
+
+
+
+//------------------------------------------------------------------------------
+
+
+static void usage(char *prog)
+{
+    printf("Usage : %s [options] <trace>\n",prog) ;
+    printf("Options :\n") ;
+    printf("  -r             Replay at the recorded pacing (default as fast as possible).\n") ;
+    printf("  -p <platform>  Window system : %s\n",esPlatformNames()) ;
+    printf("                 (default $ES_PLATFORM, else the first).\n") ;
+    printf("  -H             Headless, the same as -p headless.\n") ;
+    printf("  -f <ms>        Frame time budget (default %.1fms).\n",FSTATS_DEF_BUDGET / 1000.0) ;
+    printf("  -o <name>      Write frame stats to <name>.csv and <name>.json.\n") ;
+} // usage
+
+
+
+static void parse(int argc, char **argv, REPLAY_T *rp)
+{
+    char *prog = argv[0] ;
+    int opt ;
+
+    while ( ( opt = getopt(argc, argv, "rp:Hf:o:") ) != -1 ) {
+        switch ( opt ) {
+            case 'r' :
+                rp->paced = 1 ;
+                break ;
+            case 'p' :
+                if ( !esSetPlatform(&esContext, optarg) ) exit(1) ;
+                break ;
+            case 'H' :
+                esSetPlatform(&esContext, "headless") ;
+                break ;
+            case 'f' :
+                rp->budget = atof(optarg) * 1000.0 ;
+                break ;
+            case 'o' :
+                rp->statsName = optarg ;
+                break ;
+            default :
+                usage(prog) ;
+                exit(1) ;
+        }
+    }
+    if ( optind >= argc ) {
+        usage(prog) ;
+        exit(1) ;
+    }
+    rp->fileName = argv[optind] ;
+} // parse
+
+
+
+/***********************************************************
+ * Name: load_trace
+ *
+ * Arguments:
+ *     rp - replay, fileName set.
+ *
+ * Description: Reads the whole trace into memory and checks
+ *              its header.
+ *
+ * Returns: header, NULL on failure.
+ *
+ ***********************************************************/
+static GLTRACE_HEADER_T *load_trace(REPLAY_T *rp)
+{
+    GLTRACE_HEADER_T *header ;
+    FILE *f = fopen(rp->fileName,"rb") ;
+    long bytes ;
+
+    if ( f == NULL ) {
+        printf(VERSION "Unable to open '%s'.\n",rp->fileName) ;
+        return NULL ;
+    }
+    fseek(f, 0, SEEK_END) ;
+    bytes = ftell(f) ;
+    fseek(f, 0, SEEK_SET) ;
+
+    rp->words = bytes / 4 ;
+    rp->trace = malloc( rp->words * 4 + 4 ) ;
+    if ( rp->trace == NULL || bytes < (long) sizeof( GLTRACE_HEADER_T ) ||
+         fread(rp->trace, 4, rp->words, f) != rp->words ) {
+        printf(VERSION "Unable to read '%s'.\n",rp->fileName) ;
+        fclose(f) ;
+        return NULL ;
+    }
+    fclose(f) ;
+
+    header = (GLTRACE_HEADER_T *) rp->trace ;
+    if ( header->magic != GLTRACE_MAGIC || header->version != GLTRACE_VERSION ) {
+        printf(VERSION "'%s' is not a version %d GL trace.\n",rp->fileName,GLTRACE_VERSION) ;
+        return NULL ;
+    }
+    printf("Trace : '%s', %.1fKB, recorded at %ux%u.\n",rp->fileName,bytes / 1024.0,
+           header->width,header->height) ;
+    return header ;
+
+} // load_trace
+
+
+
+// Replay name of a recorded name, 0 stays 0.
+static GLuint name_of(REPLAY_T *rp, int space, GLuint recorded)
+{
+    NAMEMAP_T *m = &rp->names[space] ;
+
+    return ( recorded < m->size && m->name[recorded] ) ? m->name[recorded] : recorded ;
+} // name_of
+
+
+
+static void set_name(REPLAY_T *rp, int space, GLuint recorded, GLuint name)
+{
+    NAMEMAP_T *m = &rp->names[space] ;
+    uint32_t size ;
+
+    if ( recorded >= m->size ) {
+        size = m->size ? m->size : 64 ;
+        while ( size <= recorded ) size *= 2 ;
+        m->name = realloc( m->name, size * sizeof( GLuint ) ) ;
+        memset( m->name + m->size, 0, ( size - m->size ) * sizeof( GLuint ) ) ;
+        m->size = size ;
+    }
+    m->name[recorded] = name ;
+} // set_name
+
+
+
+// glGen* of as many names as were recorded, mapped in order.
+static void gen_names(REPLAY_T *rp, int space, const uint32_t *recorded, GLsizei n)
+{
+    GLuint *names = malloc( n * sizeof( GLuint ) ) ;
+    GLsizei i ;
+
+    switch ( space ) {
+        case NAMES_BUFFER :       glGenBuffers( n, names ) ; break ;
+        case NAMES_TEXTURE :      glGenTextures( n, names ) ; break ;
+        case NAMES_FRAMEBUFFER :  glGenFramebuffers( n, names ) ; break ;
+        case NAMES_RENDERBUFFER : glGenRenderbuffers( n, names ) ; break ;
+    }
+    for ( i = 0 ; i < n ; ++i )
+        set_name(rp, space, recorded[i], names[i]) ;
+    free( names ) ;
+} // gen_names
+
+
+
+static void delete_names(REPLAY_T *rp, int space, const uint32_t *recorded, GLsizei n)
+{
+    GLuint *names = malloc( n * sizeof( GLuint ) ) ;
+    GLsizei i ;
+
+    for ( i = 0 ; i < n ; ++i ) {
+        names[i] = name_of(rp, space, recorded[i]) ;
+        set_name(rp, space, recorded[i], 0) ;
+    }
+    switch ( space ) {
+        case NAMES_BUFFER :       glDeleteBuffers( n, names ) ; break ;
+        case NAMES_TEXTURE :      glDeleteTextures( n, names ) ; break ;
+        case NAMES_FRAMEBUFFER :  glDeleteFramebuffers( n, names ) ; break ;
+        case NAMES_RENDERBUFFER : glDeleteRenderbuffers( n, names ) ; break ;
+    }
+    free( names ) ;
+} // delete_names
+
+
+
+static void add_location(REPLAY_T *rp, int uniform, GLuint program, GLint recorded, GLint location)
+{
+    LOCATION_T *l ;
+
+    if ( rp->nlocations == MAXLOCATIONS ) return ;
+    l = &rp->location[rp->nlocations++] ;
+    l->uniform = uniform ;
+    l->program = program ;
+    l->recorded = recorded ;
+    l->location = location ;
+} // add_location
+
+
+
+// Location in the program in use; an attribute of any program will do.
+static GLint location_of(REPLAY_T *rp, int uniform, GLint recorded)
+{
+    LOCATION_T *l ;
+    GLint found = recorded ;
+    int i ;
+
+    if ( recorded < 0 ) return recorded ;
+    for ( i = rp->nlocations - 1 ; i >= 0 ; --i ) {
+        l = &rp->location[i] ;
+        if ( l->uniform != uniform || l->recorded != recorded ) continue ;
+        if ( l->program == rp->program ) return l->location ;
+        if ( !uniform && found == recorded ) found = l->location ;
+    }
+    return found ;
+} // location_of
+
+
+
+// Recorded context : 0 is the window's, others the shared upload context.
+static void set_context(REPLAY_T *rp, int context)
+{
+    ESContext *es = &esContext ;
+
+    if ( context > 0 && es->eglUploadContext == EGL_NO_CONTEXT ) {
+        if ( rp->context == 0 ) printf(VERSION "No shared context, replaying on one.\n") ;
+        rp->context = -1 ;
+        return ;
+    }
+    if ( context == 0 )
+        eglMakeCurrent( es->eglDisplay, es->eglSurface, es->eglSurface, es->eglContext ) ;
+    else
+        eglMakeCurrent( es->eglDisplay, es->eglUploadSurface, es->eglUploadSurface, es->eglUploadContext ) ;
+    rp->context = context ;
+} // set_context
+
+
+
+static float F(uint32_t u)
+{
+    union { uint32_t u ; float f ; } v ;
+
+    v.u = u ;
+    return v.f ;
+} // F
+
+
+
+// Has the record the arguments and blob its op reads? Unknown ops are
+// left to replay_record() to count.
+static int record_ok(int op, const uint32_t *a, int nargs, const uint32_t *blob, uint32_t bytes)
+{
+    if ( op <= 0 || op >= GLT_NOPS ) return 1 ;
+    if ( nargs < recordNeeds[op].nargs ) return 0 ;
+    if ( recordNeeds[op].blob != BLOB_ANY && blob == NULL ) return 0 ;
+
+    // Where the args say how much of the blob is read.
+    switch ( op ) {
+        case GLT_BUFFER_DATA :
+            return blob == NULL || a[1] <= bytes ;
+        case GLT_DRAW_ELEMENTS :
+            return blob == NULL || (uint64_t) a[1] * ( a[2] == GL_UNSIGNED_BYTE ? 1 : 2 ) <= bytes ;
+        case GLT_UNIFORM_FV :
+        case GLT_UNIFORM_IV :
+            return (uint64_t) a[1] * a[2] * 4 <= bytes ;
+    }
+    return 1 ;
+} // record_ok
+
+
+
+// A string blob, copied with a terminating 0 whatever was recorded.
+static char *blob_string(const uint32_t *blob, uint32_t bytes)
+{
+    char *s = malloc( bytes + 1 ) ;
+
+    if ( s ) {
+        memcpy( s, blob, bytes ) ;
+        s[bytes] = '\0' ;
+    }
+    return s ;
+} // blob_string
+
+
+
+/***********************************************************
+ * Name: replay_record
+ *
+ * Arguments:
+ *     rp    - replay.
+ *     op    - record op.
+ *     a     - arguments.
+ *     nargs - no. of arguments.
+ *     blob  - blob data or NULL.
+ *     bytes - blob size.
+ *
+ * Description: Issues one recorded GL call, checked by
+ *              record_ok().
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void replay_record(REPLAY_T *rp, int op, const uint32_t *a, int nargs, const uint32_t *blob, uint32_t bytes)
+{
+    GLuint name ;
+    char *string ;
+
+    switch ( op ) {
+        case GLT_CONTEXT :
+            set_context(rp, a[0]) ;
+            break ;
+        case GLT_ACTIVE_TEXTURE :
+            glActiveTexture( a[0] ) ;
+            break ;
+        case GLT_ATTACH_SHADER :
+            glAttachShader( name_of(rp,NAMES_PROGRAM,a[0]), name_of(rp,NAMES_SHADER,a[1]) ) ;
+            break ;
+        case GLT_BIND_BUFFER :
+            glBindBuffer( a[0], name_of(rp,NAMES_BUFFER,a[1]) ) ;
+            break ;
+        case GLT_BIND_FRAMEBUFFER :
+            glBindFramebuffer( a[0], name_of(rp,NAMES_FRAMEBUFFER,a[1]) ) ;
+            break ;
+        case GLT_BIND_RENDERBUFFER :
+            glBindRenderbuffer( a[0], name_of(rp,NAMES_RENDERBUFFER,a[1]) ) ;
+            break ;
+        case GLT_BIND_TEXTURE :
+            glBindTexture( a[0], name_of(rp,NAMES_TEXTURE,a[1]) ) ;
+            break ;
+        case GLT_BUFFER_DATA :
+            glBufferData( a[0], a[1], blob, a[2] ) ;
+            break ;
+        case GLT_BUFFER_SUB_DATA :
+            glBufferSubData( a[0], a[1], bytes, blob ) ;
+            break ;
+        case GLT_CLEAR :
+            glClear( a[0] ) ;
+            break ;
+        case GLT_CLEAR_COLOR :
+            glClearColor( F(a[0]), F(a[1]), F(a[2]), F(a[3]) ) ;
+            break ;
+        case GLT_COMPILE_SHADER :
+            glCompileShader( name_of(rp,NAMES_SHADER,a[0]) ) ;
+            break ;
+        case GLT_CREATE_PROGRAM :
+            set_name(rp, NAMES_PROGRAM, a[0], glCreateProgram()) ;
+            break ;
+        case GLT_CREATE_SHADER :
+            set_name(rp, NAMES_SHADER, a[1], glCreateShader(a[0])) ;
+            break ;
+        case GLT_DELETE_PROGRAM :
+            glDeleteProgram( name_of(rp,NAMES_PROGRAM,a[0]) ) ;
+            break ;
+        case GLT_DELETE_SHADER :
+            glDeleteShader( name_of(rp,NAMES_SHADER,a[0]) ) ;
+            break ;
+        case GLT_DEPTH_FUNC :
+            glDepthFunc( a[0] ) ;
+            break ;
+        case GLT_ENABLE :
+            glEnable( a[0] ) ;
+            break ;
+        case GLT_DISABLE :
+            glDisable( a[0] ) ;
+            break ;
+        case GLT_ENABLE_ATTRIB :
+            glEnableVertexAttribArray( location_of(rp,0,a[0]) ) ;
+            break ;
+        case GLT_DISABLE_ATTRIB :
+            glDisableVertexAttribArray( location_of(rp,0,a[0]) ) ;
+            break ;
+        case GLT_DRAW_ARRAYS :
+            glDrawArrays( a[0], a[1], a[2] ) ;
+            break ;
+        case GLT_DRAW_ELEMENTS :
+            glDrawElements( a[0], a[1], a[2], blob ? (const GLvoid *) blob : (const GLvoid *) (uintptr_t) a[3] ) ;
+            break ;
+        case GLT_ATTRIB_POINTER :
+            glVertexAttribPointer( location_of(rp,0,a[0]), a[1], a[2], a[3], a[4], (const GLvoid *) (uintptr_t) a[5] ) ;
+            break ;
+        case GLT_CLIENT_ARRAY :
+            glVertexAttribPointer( location_of(rp,0,a[0]), a[1], a[2], a[3], a[4], blob ) ;
+            break ;
+        case GLT_FINISH :
+            glFinish() ;
+            break ;
+        case GLT_FLUSH :
+            glFlush() ;
+            break ;
+        case GLT_FRAMEBUFFER_RENDERBUFFER :
+            glFramebufferRenderbuffer( a[0], a[1], a[2], name_of(rp,NAMES_RENDERBUFFER,a[3]) ) ;
+            break ;
+        case GLT_FRAMEBUFFER_TEXTURE_2D :
+            glFramebufferTexture2D( a[0], a[1], a[2], name_of(rp,NAMES_TEXTURE,a[3]), a[4] ) ;
+            break ;
+        case GLT_GENERATE_MIPMAP :
+            glGenerateMipmap( a[0] ) ;
+            break ;
+        case GLT_GEN_BUFFERS :
+        case GLT_GEN_TEXTURES :
+        case GLT_GEN_FRAMEBUFFERS :
+        case GLT_GEN_RENDERBUFFERS :
+            gen_names(rp, op - GLT_GEN_BUFFERS, blob, bytes / 4) ;
+            break ;
+        case GLT_DELETE_BUFFERS :
+        case GLT_DELETE_TEXTURES :
+        case GLT_DELETE_FRAMEBUFFERS :
+        case GLT_DELETE_RENDERBUFFERS :
+            delete_names(rp, op - GLT_DELETE_BUFFERS, blob, bytes / 4) ;
+            break ;
+        case GLT_GET_ATTRIB_LOCATION :
+        case GLT_GET_UNIFORM_LOCATION :
+            if ( ( string = blob_string(blob, bytes) ) == NULL ) break ;
+            name = name_of(rp,NAMES_PROGRAM,a[0]) ;
+            add_location(rp, op == GLT_GET_UNIFORM_LOCATION, a[0], a[1],
+                         op == GLT_GET_UNIFORM_LOCATION ? glGetUniformLocation(name, string)
+                                                        : glGetAttribLocation(name, string)) ;
+            free( string ) ;
+            break ;
+        case GLT_LINK_PROGRAM :
+            glLinkProgram( name_of(rp,NAMES_PROGRAM,a[0]) ) ;
+            break ;
+        case GLT_PIXEL_STOREI :
+            glPixelStorei( a[0], a[1] ) ;
+            break ;
+        case GLT_RENDERBUFFER_STORAGE :
+            glRenderbufferStorage( a[0], a[1], a[2], a[3] ) ;
+            break ;
+        case GLT_SHADER_SOURCE : {
+            const GLchar *source ;
+
+            if ( ( string = blob_string(blob, bytes) ) == NULL ) break ;
+            source = string ;
+            glShaderSource( name_of(rp,NAMES_SHADER,a[0]), 1, &source, NULL ) ;
+            free( string ) ;
+            break ;
+        }
+        case GLT_TEX_IMAGE_2D :
+            glTexImage2D( a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], blob ) ;
+            break ;
+        case GLT_TEX_SUB_IMAGE_2D :
+            glTexSubImage2D( a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], blob ) ;
+            break ;
+        case GLT_TEX_PARAMETERI :
+            glTexParameteri( a[0], a[1], a[2] ) ;
+            break ;
+        case GLT_UNIFORM_F :
+            switch ( nargs ) {
+                case 2 : glUniform1f( location_of(rp,1,a[0]), F(a[1]) ) ; break ;
+                case 3 : glUniform2f( location_of(rp,1,a[0]), F(a[1]), F(a[2]) ) ; break ;
+                case 4 : glUniform3f( location_of(rp,1,a[0]), F(a[1]), F(a[2]), F(a[3]) ) ; break ;
+                case 5 : glUniform4f( location_of(rp,1,a[0]), F(a[1]), F(a[2]), F(a[3]), F(a[4]) ) ; break ;
+            }
+            break ;
+        case GLT_UNIFORM_I :
+            glUniform1i( location_of(rp,1,a[0]), a[1] ) ;
+            break ;
+        case GLT_UNIFORM_FV :
+            switch ( a[1] ) {
+                case 4 :
+                    if ( a[3] )
+                        glUniformMatrix2fv( location_of(rp,1,a[0]), a[2], GL_FALSE, (const GLfloat *) blob ) ;
+                    else
+                        glUniform4fv( location_of(rp,1,a[0]), a[2], (const GLfloat *) blob ) ;
+                    break ;
+                case 9 :  glUniformMatrix3fv( location_of(rp,1,a[0]), a[2], GL_FALSE, (const GLfloat *) blob ) ; break ;
+                case 16 : glUniformMatrix4fv( location_of(rp,1,a[0]), a[2], GL_FALSE, (const GLfloat *) blob ) ; break ;
+            }
+            break ;
+        case GLT_USE_PROGRAM :
+            rp->program = a[0] ;
+            glUseProgram( name_of(rp,NAMES_PROGRAM,a[0]) ) ;
+            break ;
+        case GLT_VIEWPORT :
+            glViewport( a[0], a[1], a[2], a[3] ) ;
+            break ;
+        case GLT_UNIFORM_IV :
+            switch ( a[1] ) {
+                case 2 : glUniform2iv( location_of(rp,1,a[0]), a[2], (const GLint *) blob ) ; break ;
+                case 3 : glUniform3iv( location_of(rp,1,a[0]), a[2], (const GLint *) blob ) ; break ;
+                case 4 : glUniform4iv( location_of(rp,1,a[0]), a[2], (const GLint *) blob ) ; break ;
+            }
+            break ;
+        default :
+            rp->unknown++ ;
+    }
+} // replay_record
+
+
+
+// Sleep until 'ns' after 'start'.
+static void sleep_until(const struct timespec *start, uint64_t ns)
+{
+    struct timespec t ;
+
+    t.tv_sec = start->tv_sec + ns / 1000000000ull ;
+    t.tv_nsec = start->tv_nsec + ns % 1000000000ull ;
+    if ( t.tv_nsec >= 1000000000L ) {
+        t.tv_sec++ ;
+        t.tv_nsec -= 1000000000L ;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) ;
+} // sleep_until
+
+
+
+/***********************************************************
+ * Name: replay_trace
+ *
+ * Arguments:
+ *     rp - replay, trace loaded.
+ *
+ * Description: Issues every record in order, swapping and
+ *              timing a frame at each GLT_FRAME.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void replay_trace(REPLAY_T *rp)
+{
+    FRAMESTATS_T *stats = framestatsCreate(rp->budget, rp->statsName) ;
+    const uint32_t *w = rp->trace + sizeof( GLTRACE_HEADER_T ) / 4 ;
+    const uint32_t *end = rp->trace + rp->words ;
+    const uint32_t *args, *blob ;
+    struct timespec start ;
+    uint32_t word, bytes ;
+    int op, nargs ;
+    double secs ;
+
+    clock_gettime(CLOCK_MONOTONIC, &start) ;
+    resettimer(0) ;
+    framestatsBegin(stats) ;
+
+    while ( w < end ) {
+        word = *w++ ;
+        op = GLT_OP(word) ;
+        nargs = GLT_NARGS(word) ;
+        args = w ;
+        w += nargs ;
+        blob = NULL ;
+        bytes = 0 ;
+        if ( ( word & GLT_BLOB ) && w < end ) {
+            bytes = *w++ ;
+            blob = w ;
+            w += ( bytes + 3 ) / 4 ;
+        }
+        if ( w > end ) {
+            printf(VERSION "Trace is truncated.\n") ;
+            break ;
+        }
+
+        if ( !record_ok(op, args, nargs, blob, bytes) ) {
+            rp->bad++ ;
+            continue ;
+        }
+        if ( op != GLT_FRAME ) {
+            replay_record(rp, op, args, nargs, blob, bytes) ;
+            continue ;
+        }
+
+        // End of a frame, args the ns since the start (low, high).
+        if ( rp->context != 0 ) set_context(rp, 0) ;
+        framestatsPhase(stats, FSTATS_DRAW) ;
+        esSwapBuffers(&esContext) ;
+        framestatsPhase(stats, FSTATS_SWAP) ;
+        framestatsEnd(stats) ;
+        rp->frames++ ;
+        if ( esUserInterrupt(&esContext) ) break ;
+        if ( rp->paced ) sleep_until(&start, args[0] | (uint64_t) args[1] << 32) ;
+        framestatsBegin(stats) ;
+        framestatsPhase(stats, FSTATS_UPDATE) ;
+    }
+
+    secs = uelapsedtime(0) / MICRO ;
+    printf("Replayed %lu frames in %.3fs, %.3fms/frame, %.1fHz%s.\n",rp->frames,secs,
+           rp->frames ? secs * 1000.0 / rp->frames : 0.0,rp->frames ? rp->frames / secs : 0.0,
+           rp->paced ? " (paced)" : "") ;
+    if ( rp->unknown ) printf(VERSION "Skipped %lu unknown records.\n",rp->unknown) ;
+    if ( rp->bad ) printf(VERSION "Skipped %lu records too short for their op.\n",rp->bad) ;
+    framestatsFinish(stats) ;
+    framestatsDestroy(stats) ;
+
+} // replay_trace
+
+
+
+int main(int argc, char **argv)
+{
+    GLTRACE_HEADER_T *header ;
+    int i ;
+
+    esInitContext(&esContext) ;
+    parse(argc,argv,&replay) ;
+
+    header = load_trace(&replay) ;
+    if ( header == NULL ) return 1 ;
+
+    if ( !esCreateWindow(&esContext, "GL replay", header->width, header->height,
+                         ES_WINDOW_RGB | ES_WINDOW_ALPHA | ES_WINDOW_DEPTH) ) {
+        printf(VERSION "Unable to create a window.\n") ;
+        return 1 ;
+    }
+    printf("Screen size : (%d,%d) on %s%s.\n",esContext.width,esContext.height,
+           esGetPlatform(&esContext), esContext.fbo ? " (FBO)" : "") ;
+    printf("GL Renderer  :'%s'.\n",glGetString(GL_RENDERER)) ;
+
+    replay_trace(&replay) ;
+
+    esExit(&esContext) ;
+    for ( i = 0 ; i < NNAMES ; ++i )
+        free( replay.names[i].name ) ;
+    free( replay.trace ) ;
+    return 0 ;
+
+} // main
@@ -0,0 +1,406 @@
+
+/*
+  This module writes the GL command trace for gltrace.h's wrappers.
+
+  Records are written with stdio through a large buffer, under a lock as
+  the asset upload thread records too. Each thread is given a context
+  index the first time it records, and a GLT_CONTEXT record is written
+  when the recording thread changes.
+
+  Client arrays are only read at the draw, so glVertexAttribPointer with
+  no buffer bound just remembers the pointer. A draw then writes each
+  enabled client array up to the last vertex used : first + count for
+  glDrawArrays, the highest index + 1 for glDrawElements with client
+  indices. An index buffer can not be read back in ES 2.0, so with one
+  bound the index count is used.
+
+  Buffer and attribute state is kept per thread (a context is current on
+  one thread) and only while recording, which starts before esTri makes
+  any GL calls of its own.
+*/
+
+
+#ifdef GLTRACE
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "gltrace.h"
+#include "utils.h"
+#include "log.h"
+
+
+
+#define TRACE_BUFFER    ( 1 << 20 )   // stdio buffer.
+
+typedef struct {
+    int          enabled ;
+    int          client ;       // pointer is client memory
+    GLint        size ;
+    GLenum       type ;
+    GLboolean    normalized ;
+    GLsizei      stride ;
+    const GLvoid *ptr ;
+} ATTRIB_T ;
+
+
+int gltRecording = 0 ;
+
+static FILE *traceFile = NULL ;
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER ;
+static uint64_t startNs = 0 ;
+static unsigned long frames = 0 ;
+static int lastContext = 0 ;
+static int ncontexts = 0 ;
+
+static __thread int myContext = -1 ;
+static __thread GLuint arrayBuffer = 0 ;
+static __thread GLuint elementBuffer = 0 ;
+static __thread GLint unpackAlignment = 4 ;
+static __thread ATTRIB_T attrib[GLT_MAX_ATTRIBS] ;
+
+static PFNGLMAPBUFFEROESPROC realMapBuffer = NULL ;
+static PFNGLPROGRAMBINARYOESPROC realProgramBinary = NULL ;
+
+
+
+/***********************************************************
+ * Name: gltraceStart
+ *
+ * Arguments:
+ *     fileName - trace file to write.
+ *     width    - window size, for the replay window.
+ *     height
+ *
+ * Description: Opens the trace and starts recording. The
+ *              calling thread is context 0.
+ *
+ * Returns: 1 if recording, else 0.
+ *
+ ***********************************************************/
+int gltraceStart(const char *fileName, int width, int height)
+{
+    GLTRACE_HEADER_T header = { GLTRACE_MAGIC, GLTRACE_VERSION, width, height } ;
+
+    traceFile = fopen(fileName,"wb") ;
+    if ( traceFile == NULL ) {
+        logWarn("GL trace: Unable to create '%s'.\n",fileName) ;
+        return 0 ;
+    }
+    setvbuf(traceFile, NULL, _IOFBF, TRACE_BUFFER) ;
+    fwrite(&header, sizeof( header ), 1, traceFile) ;
+
+    myContext = 0 ;
+    ncontexts = 1 ;
+    startNs = nowns() ;
+    gltRecording = 1 ;
+    return 1 ;
+
+} // gltraceStart
+
+
+
+// Stop recording, close the trace.
+void gltraceStop(void)
+{
+    long bytes ;
+
+    if ( traceFile == NULL ) return ;
+
+    pthread_mutex_lock( &traceLock ) ;
+    gltRecording = 0 ;
+    bytes = ftell(traceFile) ;
+    fclose(traceFile) ;
+    traceFile = NULL ;
+    pthread_mutex_unlock( &traceLock ) ;
+
+    logInfo("GL trace: %lu frames, %.1fKB from %d context(s).\n",frames,bytes / 1024.0,ncontexts) ;
+} // gltraceStop
+
+
+
+// Write a record, with the lock held.
+static void writeRecord(int op, const uint32_t *args, int nargs, const void *blob, uint32_t bytes, int hasBlob)
+{
+    static const uint32_t zero = 0 ;
+    uint32_t word ;
+
+    if ( traceFile == NULL ) return ;
+
+    if ( myContext < 0 ) myContext = ( ncontexts < GLT_MAX_CONTEXTS ) ? ncontexts++ : GLT_MAX_CONTEXTS - 1 ;
+    if ( myContext != lastContext ) {
+        word = GLT_CONTEXT | 1 << 8 ;
+        fwrite(&word, 4, 1, traceFile) ;
+        word = myContext ;
+        fwrite(&word, 4, 1, traceFile) ;
+        lastContext = myContext ;
+    }
+
+    word = op | nargs << 8 | ( hasBlob ? GLT_BLOB : 0 ) ;
+    fwrite(&word, 4, 1, traceFile) ;
+    if ( nargs ) fwrite(args, 4, nargs, traceFile) ;
+    if ( hasBlob ) {
+        fwrite(&bytes, 4, 1, traceFile) ;
+        if ( bytes ) fwrite(blob, 1, bytes, traceFile) ;
+        if ( bytes & 3 ) fwrite(&zero, 1, 4 - ( bytes & 3 ), traceFile) ;
+    }
+} // writeRecord
+
+
+
+// A call, with a blob if it is not NULL.
+void gltraceCall(int op, const uint32_t *args, int nargs, const void *blob, uint32_t bytes)
+{
+    pthread_mutex_lock( &traceLock ) ;
+    writeRecord(op, args, nargs, blob, bytes, blob != NULL) ;
+    pthread_mutex_unlock( &traceLock ) ;
+} // gltraceCall
+
+
+
+// End of a frame (after the swap), with the time since gltraceStart().
+void gltraceFrame(void)
+{
+    uint64_t ns = nowns() - startNs ;
+    uint32_t args[2] = { (uint32_t) ns, (uint32_t) ( ns >> 32 ) } ;
+
+    if ( !gltRecording ) return ;
+
+    gltraceCall(GLT_FRAME, args, 2, NULL, 0) ;
+    frames++ ;
+} // gltraceFrame
+
+
+
+void gltraceBindBuffer(GLenum target, GLuint buffer)
+{
+    uint32_t args[2] = { target, buffer } ;
+
+    if ( target == GL_ARRAY_BUFFER )
+        arrayBuffer = buffer ;
+    else if ( target == GL_ELEMENT_ARRAY_BUFFER )
+        elementBuffer = buffer ;
+    gltraceCall(GLT_BIND_BUFFER, args, 2, NULL, 0) ;
+} // gltraceBindBuffer
+
+
+
+static GLsizei typeSize(GLenum type)
+{
+    switch ( type ) {
+        case GL_BYTE :
+        case GL_UNSIGNED_BYTE :  return 1 ;
+        case GL_SHORT :
+        case GL_UNSIGNED_SHORT : return 2 ;
+        default :                return 4 ;   // GL_FLOAT, GL_FIXED
+    }
+} // typeSize
+
+
+
+// Recorded now if it is in a buffer, else at each draw.
+void gltraceAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                          GLsizei stride, const GLvoid *ptr)
+{
+    uint32_t args[6] = { index, size, type, normalized, stride, (uint32_t) (uintptr_t) ptr } ;
+    ATTRIB_T *a ;
+
+    if ( index >= GLT_MAX_ATTRIBS ) return ;
+
+    a = &attrib[index] ;
+    a->client = ( arrayBuffer == 0 ) ;
+    a->size = size ;
+    a->type = type ;
+    a->normalized = normalized ;
+    a->stride = stride ;
+    a->ptr = ptr ;
+    if ( !a->client ) gltraceCall(GLT_ATTRIB_POINTER, args, 6, NULL, 0) ;
+} // gltraceAttribPointer
+
+
+
+void gltraceAttribArray(GLuint index, int enabled)
+{
+    if ( index < GLT_MAX_ATTRIBS ) attrib[index].enabled = enabled ;
+    gltraceCall(enabled ? GLT_ENABLE_ATTRIB : GLT_DISABLE_ATTRIB, &index, 1, NULL, 0) ;
+} // gltraceAttribArray
+
+
+
+// Highest index + 1 in client indices.
+static GLsizei indexedVertices(GLsizei count, GLenum type, const GLvoid *indices)
+{
+    GLuint max = 0 ;
+    GLsizei i ;
+
+    if ( type == GL_UNSIGNED_BYTE ) {
+        for ( i = 0 ; i < count ; ++i )
+            if ( ( (const GLubyte *) indices )[i] > max ) max = ( (const GLubyte *) indices )[i] ;
+    } else {
+        for ( i = 0 ; i < count ; ++i )
+            if ( ( (const GLushort *) indices )[i] > max ) max = ( (const GLushort *) indices )[i] ;
+    }
+    return count ? (GLsizei) max + 1 : 0 ;
+} // indexedVertices
+
+
+
+/***********************************************************
+ * Name: gltraceDraw
+ *
+ * Arguments:
+ *     mode, first, count - as glDrawArrays.
+ *     type, indices      - as glDrawElements, type 0 for
+ *                          glDrawArrays.
+ *
+ * Description: Records the enabled client arrays the draw
+ *              reads, then the draw itself.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void gltraceDraw(GLenum mode, GLint first, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    GLsizei vertices = first + count ;
+    uint32_t args[5] ;
+    ATTRIB_T *a ;
+    GLsizei elem, stride ;
+    int i, clientIndices = ( type && elementBuffer == 0 ) ;
+
+    if ( type ) vertices = clientIndices ? indexedVertices(count,type,indices) : count ;
+
+    pthread_mutex_lock( &traceLock ) ;
+
+    for ( i = 0 ; i < GLT_MAX_ATTRIBS ; ++i ) {
+        a = &attrib[i] ;
+        if ( !a->enabled || !a->client || vertices == 0 ) continue ;
+
+        elem = a->size * typeSize(a->type) ;
+        stride = a->stride ? a->stride : elem ;
+        args[0] = i ;
+        args[1] = a->size ;
+        args[2] = a->type ;
+        args[3] = a->normalized ;
+        args[4] = a->stride ;
+        writeRecord(GLT_CLIENT_ARRAY, args, 5, a->ptr, ( vertices - 1 ) * stride + elem, 1) ;
+    }
+
+    args[0] = mode ;
+    if ( type == 0 ) {
+        args[1] = first ;
+        args[2] = count ;
+        writeRecord(GLT_DRAW_ARRAYS, args, 3, NULL, 0, 0) ;
+    } else {
+        args[1] = count ;
+        args[2] = type ;
+        args[3] = clientIndices ? 0 : (uint32_t) (uintptr_t) indices ;
+        writeRecord(GLT_DRAW_ELEMENTS, args, 4, indices, count * typeSize(type), clientIndices) ;
+    }
+
+    pthread_mutex_unlock( &traceLock ) ;
+
+} // gltraceDraw
+
+
+
+void gltracePixelStore(GLenum pname, GLint param)
+{
+    uint32_t args[2] = { pname, param } ;
+
+    if ( pname == GL_UNPACK_ALIGNMENT ) unpackAlignment = param ;
+    gltraceCall(GLT_PIXEL_STOREI, args, 2, NULL, 0) ;
+} // gltracePixelStore
+
+
+
+// glTex(Sub)Image2D, with the pixels read at GL_UNPACK_ALIGNMENT.
+void gltraceTexImage(int op, const uint32_t *args, int nargs, GLsizei width, GLsizei height,
+                     GLenum format, GLenum type, const GLvoid *pixels)
+{
+    uint32_t pixel, row, bytes = 0 ;
+
+    if ( type != GL_UNSIGNED_BYTE )
+        pixel = 2 ;           // GL_UNSIGNED_SHORT_5_6_5, _4_4_4_4, _5_5_5_1
+    else if ( format == GL_RGBA )
+        pixel = 4 ;
+    else if ( format == GL_RGB )
+        pixel = 3 ;
+    else if ( format == GL_LUMINANCE_ALPHA )
+        pixel = 2 ;
+    else
+        pixel = 1 ;
+
+    if ( width > 0 && height > 0 ) {
+        row = width * pixel ;
+        bytes = ( ( row + unpackAlignment - 1 ) & ~( unpackAlignment - 1 ) ) * ( height - 1 ) + row ;
+    }
+    gltraceCall(op, args, nargs, pixels, pixels ? bytes : 0) ;
+} // gltraceTexImage
+
+
+
+// The source strings joined, with a terminating 0.
+void gltraceShaderSource(GLuint shader, GLsizei count, const GLchar * const *string, const GLint *length)
+{
+    uint32_t bytes = 1 ;
+    char *source, *p ;
+    GLsizei i ;
+    GLint len ;
+
+    for ( i = 0 ; i < count ; ++i )
+        bytes += ( length && length[i] >= 0 ) ? length[i] : strlen(string[i]) ;
+
+    p = source = malloc( bytes ) ;
+    if ( source == NULL ) return ;
+    for ( i = 0 ; i < count ; ++i ) {
+        len = ( length && length[i] >= 0 ) ? length[i] : strlen(string[i]) ;
+        memcpy( p, string[i], len ) ;
+        p += len ;
+    }
+    *p = '\0' ;
+
+    gltraceCall(GLT_SHADER_SOURCE, &shader, 1, source, bytes) ;
+    free( source ) ;
+} // gltraceShaderSource
+
+
+
+static void *GL_APIENTRY mapBuffer(GLenum target, GLenum access)
+{
+    return gltRecording ? NULL : realMapBuffer(target,access) ;
+} // mapBuffer
+
+
+
+// Not loaded while recording, the program is compiled from its sources.
+static void GL_APIENTRY programBinary(GLuint program, GLenum format, const void *binary, GLint length)
+{
+    if ( !gltRecording ) realProgramBinary(program,format,binary,length) ;
+} // programBinary
+
+
+
+// eglGetProcAddress, but glMapBufferOES and glProgramBinaryOES fail
+// while recording.
+void *gltraceGetProcAddress(const char *procname)
+{
+    void *proc = (void *) (eglGetProcAddress)(procname) ;
+
+    if ( proc && strcmp(procname,"glMapBufferOES") == 0 ) {
+        realMapBuffer = (PFNGLMAPBUFFEROESPROC) proc ;
+        return (void *) mapBuffer ;
+    }
+    if ( proc && strcmp(procname,"glProgramBinaryOES") == 0 ) {
+        realProgramBinary = (PFNGLPROGRAMBINARYOESPROC) proc ;
+        return (void *) programBinary ;
+    }
+    return proc ;
+} // gltraceGetProcAddress
+
+#endif // GLTRACE
@@ -0,0 +1,630 @@
+
+/* ************************************************************************* *
+
+  Module Name : gltrace.h
+
+  Description : GL command trace. Built with -DGLTRACE ('make GLTRACE=1'),
+    including this header after the GL headers redirects the GL calls
+    that change state or draw through wrappers which, once gltraceStart()
+    is called, also write each call, with the data it passes (buffers,
+    textures, shader sources, client arrays and indices), to a trace file.
+    gltraceFrame() marks the end of each frame with its time.
+
+    glreplay.bin re-issues a trace on any ESUtil platform, as fast as
+    possible or at the recorded pacing, so driver or GPU changes can be
+    compared on the same GL command stream.
+
+    Trace file : a GLTRACE_HEADER_T, then records, all in 32-bit words
+    (host byte order) :
+      header word   op | nargs << 8 | GLT_BLOB if a blob follows
+      nargs words   arguments, floats as their bits
+      blob          byte length, then the bytes padded to a word
+
+    Queries (glGet*) are not recorded. Generated names and locations are
+    recorded with the call and mapped on replay. Calls are recorded from
+    every thread, with a GLT_CONTEXT record when the thread changes; each
+    thread is taken to have its own context, sharing objects with the
+    first's (assets.c's upload thread).
+
+ * ************************************************************************* */
+
+
+
+#ifndef __GLTRACE_H__
+#define __GLTRACE_H__
+
+#include <stdint.h>
+#include <GLES2/gl2.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define GLTRACE_MAGIC     0x52544c47      // "GLTR"
+#define GLTRACE_VERSION        1
+
+#define GLT_BLOB          ( 1 << 16 )     // Header word flag.
+#define GLT_OP(w)         ( (w) & 0xff )
+#define GLT_NARGS(w)      ( ( (w) >> 8 ) & 0xff )
+#define GLT_MAX_ATTRIBS       16
+#define GLT_MAX_CONTEXTS       8
+
+// Record ops.
+enum {
+    GLT_FRAME = 1,              // ns since start (low, high), end of a frame
+    GLT_CONTEXT,                // context index (one per recording thread)
+    GLT_ACTIVE_TEXTURE,
+    GLT_ATTACH_SHADER,
+    GLT_BIND_BUFFER,
+    GLT_BIND_FRAMEBUFFER,
+    GLT_BIND_RENDERBUFFER,
+    GLT_BIND_TEXTURE,
+    GLT_BUFFER_DATA,            // blob if data is not NULL
+    GLT_BUFFER_SUB_DATA,
+    GLT_CLEAR,
+    GLT_CLEAR_COLOR,
+    GLT_COMPILE_SHADER,
+    GLT_CREATE_PROGRAM,         // returned name
+    GLT_CREATE_SHADER,          // type, returned name
+    GLT_DELETE_PROGRAM,
+    GLT_DELETE_SHADER,
+    GLT_DEPTH_FUNC,
+    GLT_ENABLE,
+    GLT_DISABLE,
+    GLT_ENABLE_ATTRIB,
+    GLT_DISABLE_ATTRIB,
+    GLT_DRAW_ARRAYS,
+    GLT_DRAW_ELEMENTS,          // indices in a buffer, or a blob of indices
+    GLT_ATTRIB_POINTER,         // in a buffer : index, size, type, normalised, stride, offset
+    GLT_CLIENT_ARRAY,           // index, size, type, normalised, stride, blob, before a draw
+    GLT_FINISH,
+    GLT_FLUSH,
+    GLT_FRAMEBUFFER_RENDERBUFFER,
+    GLT_FRAMEBUFFER_TEXTURE_2D,
+    GLT_GENERATE_MIPMAP,
+    GLT_GEN_BUFFERS,            // blob of the returned names
+    GLT_GEN_TEXTURES,
+    GLT_GEN_FRAMEBUFFERS,
+    GLT_GEN_RENDERBUFFERS,
+    GLT_DELETE_BUFFERS,         // blob of names
+    GLT_DELETE_TEXTURES,
+    GLT_DELETE_FRAMEBUFFERS,
+    GLT_DELETE_RENDERBUFFERS,
+    GLT_GET_ATTRIB_LOCATION,    // program, returned location, blob of the name
+    GLT_GET_UNIFORM_LOCATION,
+    GLT_LINK_PROGRAM,
+    GLT_PIXEL_STOREI,
+    GLT_RENDERBUFFER_STORAGE,
+    GLT_SHADER_SOURCE,          // blob of the whole source
+    GLT_TEX_IMAGE_2D,           // blob if pixels is not NULL
+    GLT_TEX_SUB_IMAGE_2D,
+    GLT_TEX_PARAMETERI,
+    GLT_UNIFORM_F,              // location, 1 to 4 floats
+    GLT_UNIFORM_I,              // location, 1 to 4 ints
+    GLT_UNIFORM_FV,             // location, components (4/9/16 matrices), count, matrix, blob
+    GLT_USE_PROGRAM,
+    GLT_VIEWPORT,
+    GLT_UNIFORM_IV,             // location, components (2 to 4), count, blob
+    GLT_NOPS
+} ;
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    uint32_t    magic ;
+    uint32_t    version ;
+    uint32_t    width ;         // window size when recorded
+    uint32_t    height ;
+} GLTRACE_HEADER_T ;
+
+#ifdef GLTRACE
+
+#include <string.h>
+
+#ifdef GLCOUNT
+#error "Build with GLCOUNT=1 or GLTRACE=1, not both."
+#endif
+
+/* ************************************************************************* *
+ * GLOBALS
+ * ************************************************************************* */
+
+extern int gltRecording ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+int gltraceStart(const char *fileName, int width, int height) ;
+
+void gltraceFrame(void) ;
+
+void gltraceStop(void) ;
+
+void gltraceCall(int op, const uint32_t *args, int nargs, const void *blob, uint32_t bytes) ;
+
+void gltraceBindBuffer(GLenum target, GLuint buffer) ;
+
+void gltraceAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                          GLsizei stride, const GLvoid *ptr) ;
+
+void gltraceAttribArray(GLuint index, int enabled) ;
+
+void gltraceDraw(GLenum mode, GLint first, GLsizei count, GLenum type, const GLvoid *indices) ;
+
+void gltracePixelStore(GLenum pname, GLint param) ;
+
+void gltraceTexImage(int op, const uint32_t *args, int nargs, GLsizei width, GLsizei height,
+                     GLenum format, GLenum type, const GLvoid *pixels) ;
+
+void gltraceShaderSource(GLuint shader, GLsizei count, const GLchar * const *string, const GLint *length) ;
+
+void *gltraceGetProcAddress(const char *procname) ;
+
+/* ************************************************************************* *
+ * WRAPPERS
+ * ************************************************************************* */
+
+// Record a call's arguments (and a blob) while recording.
+#define GLT_REC(op, blob, bytes, ...) \
+    do { if ( gltRecording ) { const uint32_t a_[] = { __VA_ARGS__ } ; \
+         gltraceCall(op, a_, sizeof( a_ ) / sizeof( a_[0] ), blob, bytes) ; } } while ( 0 )
+
+static inline uint32_t gltF(GLfloat f)
+{
+    union { GLfloat f ; uint32_t u ; } v ;
+
+    v.f = f ;
+    return v.u ;
+}
+
+static inline void gltActiveTexture(GLenum texture)
+{
+    glActiveTexture(texture) ;
+    GLT_REC(GLT_ACTIVE_TEXTURE, NULL, 0, texture) ;
+}
+
+static inline void gltAttachShader(GLuint program, GLuint shader)
+{
+    glAttachShader(program, shader) ;
+    GLT_REC(GLT_ATTACH_SHADER, NULL, 0, program, shader) ;
+}
+
+static inline void gltBindBuffer(GLenum target, GLuint buffer)
+{
+    glBindBuffer(target, buffer) ;
+    if ( gltRecording ) gltraceBindBuffer(target, buffer) ;
+}
+
+static inline void gltBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    glBindFramebuffer(target, framebuffer) ;
+    GLT_REC(GLT_BIND_FRAMEBUFFER, NULL, 0, target, framebuffer) ;
+}
+
+static inline void gltBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+    glBindRenderbuffer(target, renderbuffer) ;
+    GLT_REC(GLT_BIND_RENDERBUFFER, NULL, 0, target, renderbuffer) ;
+}
+
+static inline void gltBindTexture(GLenum target, GLuint texture)
+{
+    glBindTexture(target, texture) ;
+    GLT_REC(GLT_BIND_TEXTURE, NULL, 0, target, texture) ;
+}
+
+static inline void gltBufferData(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage)
+{
+    glBufferData(target, size, data, usage) ;
+    GLT_REC(GLT_BUFFER_DATA, data, data ? size : 0, target, size, usage) ;
+}
+
+static inline void gltBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data)
+{
+    glBufferSubData(target, offset, size, data) ;
+    GLT_REC(GLT_BUFFER_SUB_DATA, data, size, target, offset) ;
+}
+
+static inline void gltClear(GLbitfield mask)
+{
+    glClear(mask) ;
+    GLT_REC(GLT_CLEAR, NULL, 0, mask) ;
+}
+
+static inline void gltClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)
+{
+    glClearColor(red, green, blue, alpha) ;
+    GLT_REC(GLT_CLEAR_COLOR, NULL, 0, gltF(red), gltF(green), gltF(blue), gltF(alpha)) ;
+}
+
+static inline void gltCompileShader(GLuint shader)
+{
+    glCompileShader(shader) ;
+    GLT_REC(GLT_COMPILE_SHADER, NULL, 0, shader) ;
+}
+
+static inline GLuint gltCreateProgram(void)
+{
+    GLuint program = glCreateProgram() ;
+
+    GLT_REC(GLT_CREATE_PROGRAM, NULL, 0, program) ;
+    return program ;
+}
+
+static inline GLuint gltCreateShader(GLenum type)
+{
+    GLuint shader = glCreateShader(type) ;
+
+    GLT_REC(GLT_CREATE_SHADER, NULL, 0, type, shader) ;
+    return shader ;
+}
+
+static inline void gltDeleteProgram(GLuint program)
+{
+    glDeleteProgram(program) ;
+    GLT_REC(GLT_DELETE_PROGRAM, NULL, 0, program) ;
+}
+
+static inline void gltDeleteShader(GLuint shader)
+{
+    glDeleteShader(shader) ;
+    GLT_REC(GLT_DELETE_SHADER, NULL, 0, shader) ;
+}
+
+static inline void gltDepthFunc(GLenum func)
+{
+    glDepthFunc(func) ;
+    GLT_REC(GLT_DEPTH_FUNC, NULL, 0, func) ;
+}
+
+static inline void gltEnable(GLenum cap)
+{
+    glEnable(cap) ;
+    GLT_REC(GLT_ENABLE, NULL, 0, cap) ;
+}
+
+static inline void gltDisable(GLenum cap)
+{
+    glDisable(cap) ;
+    GLT_REC(GLT_DISABLE, NULL, 0, cap) ;
+}
+
+static inline void gltEnableVertexAttribArray(GLuint index)
+{
+    glEnableVertexAttribArray(index) ;
+    if ( gltRecording ) gltraceAttribArray(index, 1) ;
+}
+
+static inline void gltDisableVertexAttribArray(GLuint index)
+{
+    glDisableVertexAttribArray(index) ;
+    if ( gltRecording ) gltraceAttribArray(index, 0) ;
+}
+
+// Client arrays are recorded before the draw, as it reads them.
+static inline void gltDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    if ( gltRecording ) gltraceDraw(mode, first, count, 0, NULL) ;
+    glDrawArrays(mode, first, count) ;
+}
+
+static inline void gltDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    if ( gltRecording ) gltraceDraw(mode, 0, count, type, indices) ;
+    glDrawElements(mode, count, type, indices) ;
+}
+
+static inline void gltVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                          GLboolean normalized, GLsizei stride, const GLvoid *ptr)
+{
+    glVertexAttribPointer(index, size, type, normalized, stride, ptr) ;
+    if ( gltRecording ) gltraceAttribPointer(index, size, type, normalized, stride, ptr) ;
+}
+
+static inline void gltFinish(void)
+{
+    glFinish() ;
+    if ( gltRecording ) gltraceCall(GLT_FINISH, NULL, 0, NULL, 0) ;
+}
+
+static inline void gltFlush(void)
+{
+    glFlush() ;
+    if ( gltRecording ) gltraceCall(GLT_FLUSH, NULL, 0, NULL, 0) ;
+}
+
+static inline void gltFramebufferRenderbuffer(GLenum target, GLenum attachment,
+                                              GLenum renderbuffertarget, GLuint renderbuffer)
+{
+    glFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer) ;
+    GLT_REC(GLT_FRAMEBUFFER_RENDERBUFFER, NULL, 0, target, attachment, renderbuffertarget, renderbuffer) ;
+}
+
+static inline void gltFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget,
+                                           GLuint texture, GLint level)
+{
+    glFramebufferTexture2D(target, attachment, textarget, texture, level) ;
+    GLT_REC(GLT_FRAMEBUFFER_TEXTURE_2D, NULL, 0, target, attachment, textarget, texture, level) ;
+}
+
+static inline void gltGenerateMipmap(GLenum target)
+{
+    glGenerateMipmap(target) ;
+    GLT_REC(GLT_GENERATE_MIPMAP, NULL, 0, target) ;
+}
+
+static inline void gltGenBuffers(GLsizei n, GLuint *buffers)
+{
+    glGenBuffers(n, buffers) ;
+    if ( gltRecording ) gltraceCall(GLT_GEN_BUFFERS, NULL, 0, buffers, n * sizeof( GLuint )) ;
+}
+
+static inline void gltGenTextures(GLsizei n, GLuint *textures)
+{
+    glGenTextures(n, textures) ;
+    if ( gltRecording ) gltraceCall(GLT_GEN_TEXTURES, NULL, 0, textures, n * sizeof( GLuint )) ;
+}
+
+static inline void gltGenFramebuffers(GLsizei n, GLuint *framebuffers)
+{
+    glGenFramebuffers(n, framebuffers) ;
+    if ( gltRecording ) gltraceCall(GLT_GEN_FRAMEBUFFERS, NULL, 0, framebuffers, n * sizeof( GLuint )) ;
+}
+
+static inline void gltGenRenderbuffers(GLsizei n, GLuint *renderbuffers)
+{
+    glGenRenderbuffers(n, renderbuffers) ;
+    if ( gltRecording ) gltraceCall(GLT_GEN_RENDERBUFFERS, NULL, 0, renderbuffers, n * sizeof( GLuint )) ;
+}
+
+static inline void gltDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+    if ( gltRecording ) gltraceCall(GLT_DELETE_BUFFERS, NULL, 0, buffers, n * sizeof( GLuint )) ;
+    glDeleteBuffers(n, buffers) ;
+}
+
+static inline void gltDeleteTextures(GLsizei n, const GLuint *textures)
+{
+    if ( gltRecording ) gltraceCall(GLT_DELETE_TEXTURES, NULL, 0, textures, n * sizeof( GLuint )) ;
+    glDeleteTextures(n, textures) ;
+}
+
+static inline void gltDeleteFramebuffers(GLsizei n, const GLuint *framebuffers)
+{
+    if ( gltRecording ) gltraceCall(GLT_DELETE_FRAMEBUFFERS, NULL, 0, framebuffers, n * sizeof( GLuint )) ;
+    glDeleteFramebuffers(n, framebuffers) ;
+}
+
+static inline void gltDeleteRenderbuffers(GLsizei n, const GLuint *renderbuffers)
+{
+    if ( gltRecording ) gltraceCall(GLT_DELETE_RENDERBUFFERS, NULL, 0, renderbuffers, n * sizeof( GLuint )) ;
+    glDeleteRenderbuffers(n, renderbuffers) ;
+}
+
+static inline int gltGetAttribLocation(GLuint program, const GLchar *name)
+{
+    int loc = glGetAttribLocation(program, name) ;
+
+    GLT_REC(GLT_GET_ATTRIB_LOCATION, name, strlen(name) + 1, program, loc) ;
+    return loc ;
+}
+
+static inline int gltGetUniformLocation(GLuint program, const GLchar *name)
+{
+    int loc = glGetUniformLocation(program, name) ;
+
+    GLT_REC(GLT_GET_UNIFORM_LOCATION, name, strlen(name) + 1, program, loc) ;
+    return loc ;
+}
+
+static inline void gltLinkProgram(GLuint program)
+{
+    glLinkProgram(program) ;
+    GLT_REC(GLT_LINK_PROGRAM, NULL, 0, program) ;
+}
+
+static inline void gltPixelStorei(GLenum pname, GLint param)
+{
+    glPixelStorei(pname, param) ;
+    if ( gltRecording ) gltracePixelStore(pname, param) ;
+}
+
+static inline void gltRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+{
+    glRenderbufferStorage(target, internalformat, width, height) ;
+    GLT_REC(GLT_RENDERBUFFER_STORAGE, NULL, 0, target, internalformat, width, height) ;
+}
+
+static inline void gltShaderSource(GLuint shader, GLsizei count, const GLchar * const *string, const GLint *length)
+{
+    glShaderSource(shader, count, string, length) ;
+    if ( gltRecording ) gltraceShaderSource(shader, count, string, length) ;
+}
+
+static inline void gltTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width,
+                                 GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels)
+{
+    glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels) ;
+    if ( gltRecording ) {
+        const uint32_t a_[] = { target, level, internalformat, width, height, border, format, type } ;
+        gltraceTexImage(GLT_TEX_IMAGE_2D, a_, 8, width, height, format, type, pixels) ;
+    }
+}
+
+static inline void gltTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                                    GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)
+{
+    glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels) ;
+    if ( gltRecording ) {
+        const uint32_t a_[] = { target, level, xoffset, yoffset, width, height, format, type } ;
+        gltraceTexImage(GLT_TEX_SUB_IMAGE_2D, a_, 8, width, height, format, type, pixels) ;
+    }
+}
+
+static inline void gltTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+    glTexParameteri(target, pname, param) ;
+    GLT_REC(GLT_TEX_PARAMETERI, NULL, 0, target, pname, param) ;
+}
+
+static inline void gltUniform1f(GLint location, GLfloat x)
+{
+    glUniform1f(location, x) ;
+    GLT_REC(GLT_UNIFORM_F, NULL, 0, location, gltF(x)) ;
+}
+
+static inline void gltUniform2f(GLint location, GLfloat x, GLfloat y)
+{
+    glUniform2f(location, x, y) ;
+    GLT_REC(GLT_UNIFORM_F, NULL, 0, location, gltF(x), gltF(y)) ;
+}
+
+static inline void gltUniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+{
+    glUniform3f(location, x, y, z) ;
+    GLT_REC(GLT_UNIFORM_F, NULL, 0, location, gltF(x), gltF(y), gltF(z)) ;
+}
+
+static inline void gltUniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+    glUniform4f(location, x, y, z, w) ;
+    GLT_REC(GLT_UNIFORM_F, NULL, 0, location, gltF(x), gltF(y), gltF(z), gltF(w)) ;
+}
+
+static inline void gltUniform1i(GLint location, GLint x)
+{
+    glUniform1i(location, x) ;
+    GLT_REC(GLT_UNIFORM_I, NULL, 0, location, x) ;
+}
+
+static inline void gltUniform4fv(GLint location, GLsizei count, const GLfloat *v)
+{
+    glUniform4fv(location, count, v) ;
+    GLT_REC(GLT_UNIFORM_FV, v, count * 4 * sizeof( GLfloat ), location, 4, count, 0) ;
+}
+
+static inline void gltUniform2iv(GLint location, GLsizei count, const GLint *v)
+{
+    glUniform2iv(location, count, v) ;
+    GLT_REC(GLT_UNIFORM_IV, v, count * 2 * sizeof( GLint ), location, 2, count) ;
+}
+
+static inline void gltUniform3iv(GLint location, GLsizei count, const GLint *v)
+{
+    glUniform3iv(location, count, v) ;
+    GLT_REC(GLT_UNIFORM_IV, v, count * 3 * sizeof( GLint ), location, 3, count) ;
+}
+
+static inline void gltUniform4iv(GLint location, GLsizei count, const GLint *v)
+{
+    glUniform4iv(location, count, v) ;
+    GLT_REC(GLT_UNIFORM_IV, v, count * 4 * sizeof( GLint ), location, 4, count) ;
+}
+
+static inline void gltUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+    glUniformMatrix2fv(location, count, transpose, value) ;
+    GLT_REC(GLT_UNIFORM_FV, value, count * 4 * sizeof( GLfloat ), location, 4, count, 1) ;
+}
+
+static inline void gltUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+    glUniformMatrix3fv(location, count, transpose, value) ;
+    GLT_REC(GLT_UNIFORM_FV, value, count * 9 * sizeof( GLfloat ), location, 9, count, 1) ;
+}
+
+static inline void gltUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+    glUniformMatrix4fv(location, count, transpose, value) ;
+    GLT_REC(GLT_UNIFORM_FV, value, count * 16 * sizeof( GLfloat ), location, 16, count, 1) ;
+}
+
+static inline void gltUseProgram(GLuint program)
+{
+    glUseProgram(program) ;
+    GLT_REC(GLT_USE_PROGRAM, NULL, 0, program) ;
+}
+
+static inline void gltViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    glViewport(x, y, width, height) ;
+    GLT_REC(GLT_VIEWPORT, NULL, 0, x, y, width, height) ;
+}
+
+#define glActiveTexture             gltActiveTexture
+#define glAttachShader              gltAttachShader
+#define glBindBuffer                gltBindBuffer
+#define glBindFramebuffer           gltBindFramebuffer
+#define glBindRenderbuffer          gltBindRenderbuffer
+#define glBindTexture               gltBindTexture
+#define glBufferData                gltBufferData
+#define glBufferSubData             gltBufferSubData
+#define glClear                     gltClear
+#define glClearColor                gltClearColor
+#define glCompileShader             gltCompileShader
+#define glCreateProgram             gltCreateProgram
+#define glCreateShader              gltCreateShader
+#define glDeleteProgram             gltDeleteProgram
+#define glDeleteShader              gltDeleteShader
+#define glDepthFunc                 gltDepthFunc
+#define glEnable                    gltEnable
+#define glDisable                   gltDisable
+#define glEnableVertexAttribArray   gltEnableVertexAttribArray
+#define glDisableVertexAttribArray  gltDisableVertexAttribArray
+#define glDrawArrays                gltDrawArrays
+#define glDrawElements              gltDrawElements
+#define glVertexAttribPointer       gltVertexAttribPointer
+#define glFinish                    gltFinish
+#define glFlush                     gltFlush
+#define glFramebufferRenderbuffer   gltFramebufferRenderbuffer
+#define glFramebufferTexture2D      gltFramebufferTexture2D
+#define glGenerateMipmap            gltGenerateMipmap
+#define glGenBuffers                gltGenBuffers
+#define glGenTextures               gltGenTextures
+#define glGenFramebuffers           gltGenFramebuffers
+#define glGenRenderbuffers          gltGenRenderbuffers
+#define glDeleteBuffers             gltDeleteBuffers
+#define glDeleteTextures            gltDeleteTextures
+#define glDeleteFramebuffers        gltDeleteFramebuffers
+#define glDeleteRenderbuffers       gltDeleteRenderbuffers
+#define glGetAttribLocation         gltGetAttribLocation
+#define glGetUniformLocation        gltGetUniformLocation
+#define glLinkProgram               gltLinkProgram
+#define glPixelStorei               gltPixelStorei
+#define glRenderbufferStorage       gltRenderbufferStorage
+#define glShaderSource              gltShaderSource
+#define glTexImage2D                gltTexImage2D
+#define glTexSubImage2D             gltTexSubImage2D
+#define glTexParameteri             gltTexParameteri
+#define glUniform1f                 gltUniform1f
+#define glUniform2f                 gltUniform2f
+#define glUniform3f                 gltUniform3f
+#define glUniform4f                 gltUniform4f
+#define glUniform1i                 gltUniform1i
+#define glUniform4fv                gltUniform4fv
+#define glUniform2iv                gltUniform2iv
+#define glUniform3iv                gltUniform3iv
+#define glUniform4iv                gltUniform4iv
+#define glUniformMatrix2fv          gltUniformMatrix2fv
+#define glUniformMatrix3fv          gltUniformMatrix3fv
+#define glUniformMatrix4fv          gltUniformMatrix4fv
+#define glUseProgram                gltUseProgram
+#define glViewport                  gltViewport
+
+// glMapBufferOES writes can not be seen, so it fails while recording and
+// dynbuf.c falls back to glBufferSubData. glProgramBinaryOES does nothing
+// while recording, so shaderlib.c compiles the sources and they are seen.
+#define eglGetProcAddress(name)     gltraceGetProcAddress(name)
+
+#else
+
+#define gltraceStart(fileName, width, height)   0
+#define gltraceFrame()
+#define gltraceStop()
+
+#endif // GLTRACE
+
+#endif // __GLTRACE_H__
@@ -0,0 +1,363 @@
+
+/*
+  This module reads the input devices on a thread of its own.
+
+  inputScanDevices() parses /proc/bus/input/devices, one blank line
+  separated block per device, for the device name (N:), its event
+  handler (H: ... eventN) and the event types it sends (B: EV=, hex) :
+    keyboard - EV_KEY and EV_REP, so power buttons and the like are not.
+    mouse    - EV_REL.
+    touch    - EV_ABS and EV_KEY (BTN_TOUCH).
+
+  inputStart() opens the devices of the classes wanted, non blocking, and
+  has the kernel stamp their events with CLOCK_MONOTONIC so the times
+  compare with the frame timers (on older kernels, stamped when read).
+  The input thread sleeps in epoll_wait() until a device is readable, or
+  the eventfd is written by inputStop(), and pushes the events, less
+  EV_SYN/EV_MSC, onto the ring. A device that goes away is dropped, hot
+  plugging is not looked for. Once the devices readable are read, the
+  eventfd given to inputNotify(), if any, is written so a render thread
+  sleeping until something happens wakes.
+
+  The ring has one producer and one consumer so needs no lock : the
+  producer writes the event then publishes head with a release store,
+  the consumer reads head with an acquire load, so sees the event, then
+  releases tail to free the slot. When the ring is full events are
+  counted as dropped rather than waiting on the render thread.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#include "input.h"
+#include "utils.h"
+#include "log.h"
+#include "profile.h"
+
+
+
+#define MAXLINE         512
+#define READ_EVENTS      32        // input_events per read()
+#define WAKE_ID          -1        // epoll data of the eventfd
+
+
+
+static int classify(unsigned long ev)
+{
+    int classes = 0 ;
+
+    if ( ( ev & ( 1UL << EV_KEY ) ) && ( ev & ( 1UL << EV_REP ) ) ) classes |= INPUT_KEYBOARD ;
+    if ( ev & ( 1UL << EV_REL ) ) classes |= INPUT_MOUSE ;
+    if ( ( ev & ( 1UL << EV_ABS ) ) && ( ev & ( 1UL << EV_KEY ) ) ) classes |= INPUT_TOUCH ;
+    return classes ;
+
+} // classify
+
+
+
+/***********************************************************
+ * Name: inputScanDevices
+ *
+ * Arguments:
+ *     fileName - NULL for INPUT_DEVICES_FILE.
+ *     device   - filled in with fd -1, not opened.
+ *     max      - size of device[].
+ *
+ * Description: Lists the input devices that have an event
+ *              handler, with their classes (0 if none).
+ *
+ * Returns: no. of devices, -1 if the file can't be read.
+ *
+ ***********************************************************/
+int inputScanDevices(const char *fileName, INPUT_DEVICE_T *device, int max)
+{
+    FILE *f = fopen(fileName ? fileName : INPUT_DEVICES_FILE, "r") ;
+    char line[MAXLINE], name[sizeof( device->name )] = "" ;
+    unsigned long ev = 0 ;
+    int event = -1, n = 0 ;
+    char *p ;
+
+    if ( f == NULL ) return -1 ;
+
+    while ( n < max ) {
+        p = fgets(line, sizeof( line ), f) ;
+
+        // A blank line, or the end, closes a block.
+        if ( p == NULL || line[0] == '\n' ) {
+            if ( event >= 0 ) {
+                snprintf(device[n].name, sizeof( device[n].name ), "%s", name) ;
+                snprintf(device[n].path, sizeof( device[n].path ), "/dev/input/event%d", event) ;
+                device[n].classes = classify(ev) ;
+                device[n].fd = -1 ;
+                ++n ;
+            }
+            if ( p == NULL ) break ;
+            name[0] = '\0' ;
+            ev = 0 ;
+            event = -1 ;
+        } else if ( strncmp(line, "N: Name=\"", 9) == 0 ) {
+            snprintf(name, sizeof( name ), "%s", line + 9) ;
+            if ( ( p = strrchr(name, '"') ) != NULL ) *p = '\0' ;
+        } else if ( strncmp(line, "H: Handlers=", 12) == 0 ) {
+            if ( ( p = strstr(line, "event") ) != NULL ) event = atoi(p + 5) ;
+        } else if ( strncmp(line, "B: EV=", 6) == 0 )
+            ev = strtoul(line + 6, NULL, 16) ;
+    }
+    fclose( f ) ;
+
+    return n ;
+
+} // inputScanDevices
+
+
+
+// Producer side, input thread only.
+static void push(INPUT_T *in, const INPUT_EVENT_T *ev)
+{
+    unsigned int head = in->head ;
+
+    if ( head - __atomic_load_n( &in->tail, __ATOMIC_ACQUIRE ) >= INPUT_QUEUE_SIZE ) {
+        __atomic_fetch_add( &in->dropped, 1, __ATOMIC_RELAXED ) ;
+        return ;
+    }
+    in->event[head & ( INPUT_QUEUE_SIZE - 1 )] = *ev ;
+    __atomic_store_n( &in->head, head + 1, __ATOMIC_RELEASE ) ;
+    __atomic_fetch_add( &in->events, 1, __ATOMIC_RELAXED ) ;
+
+} // push
+
+
+
+static void close_device(INPUT_T *in, INPUT_DEVICE_T *dev)
+{
+    epoll_ctl( in->epollFd, EPOLL_CTL_DEL, dev->fd, NULL ) ;
+    close( dev->fd ) ;
+    dev->fd = -1 ;
+    logInfo("Input: Lost '%s'.\n",dev->name) ;
+} // close_device
+
+
+
+// Read all that is waiting on a device.
+static void read_device(INPUT_T *in, int d)
+{
+    INPUT_DEVICE_T *dev = &in->device[d] ;
+    struct input_event buf[READ_EVENTS] ;
+    INPUT_EVENT_T ev ;
+    ssize_t bytes ;
+    double now ;
+    int i, n ;
+
+    for ( ;; ) {
+        bytes = read( dev->fd, buf, sizeof( buf ) ) ;
+        if ( bytes < 0 ) {
+            if ( errno == EINTR ) continue ;
+            if ( errno != EAGAIN ) close_device(in, dev) ;
+            return ;
+        }
+        if ( bytes == 0 ) {
+            close_device(in, dev) ;
+            return ;
+        }
+        n = bytes / sizeof( struct input_event ) ;
+        now = dev->monotonic ? 0.0 : nowus() ;
+        for ( i = 0 ; i < n ; ++i ) {
+            if ( buf[i].type == EV_SYN || buf[i].type == EV_MSC ) continue ;
+            ev.time = dev->monotonic ? buf[i].time.tv_sec * 1000000.0 + buf[i].time.tv_usec : now ;
+            ev.type = buf[i].type ;
+            ev.code = buf[i].code ;
+            ev.value = buf[i].value ;
+            ev.device = d ;
+            push(in, &ev) ;
+        }
+        if ( n < READ_EVENTS ) return ;
+    }
+
+} // read_device
+
+
+
+static void *inputThread(void *arg)
+{
+    INPUT_T *in = arg ;
+    struct epoll_event events[INPUT_MAX_DEVICES + 1] ;
+    unsigned long before ;
+    uint64_t one = 1 ;
+    int i, n, fd ;
+
+    profThreadName("input") ;
+
+    for ( ;; ) {
+        n = epoll_wait( in->epollFd, events, INPUT_MAX_DEVICES + 1, -1 ) ;
+        if ( n < 0 ) {
+            if ( errno == EINTR ) continue ;
+            logError("Input: epoll_wait failed, %s.\n",strerror(errno)) ;
+            break ;
+        }
+        before = in->events ;
+        for ( i = 0 ; i < n ; ++i ) {
+            if ( events[i].data.u32 == (uint32_t) WAKE_ID ) return NULL ;
+            read_device(in, events[i].data.u32) ;
+        }
+        fd = __atomic_load_n( &in->notifyFd, __ATOMIC_RELAXED ) ;
+        if ( in->events != before && fd >= 0 && write( fd, &one, sizeof( one ) ) != sizeof( one ) )
+            logWarn("Input: Unable to wake the frame loop, %s.\n",strerror(errno)) ;
+    }
+    return NULL ;
+
+} // inputThread
+
+
+
+/***********************************************************
+ * Name: inputStart
+ *
+ * Arguments:
+ *     classes - INPUT_KEYBOARD | INPUT_MOUSE | INPUT_TOUCH.
+ *
+ * Description: Opens the devices of those classes and starts
+ *              the input thread on them.
+ *
+ * Returns: input, NULL if no device could be opened.
+ *
+ ***********************************************************/
+INPUT_T *inputStart(int classes)
+{
+    INPUT_DEVICE_T found[INPUT_MAX_DEVICES] ;
+    struct epoll_event ee ;
+    INPUT_DEVICE_T *dev ;
+    INPUT_T *in ;
+    int clk = CLOCK_MONOTONIC ;
+    int i, n ;
+
+    n = inputScanDevices(NULL, found, INPUT_MAX_DEVICES) ;
+    if ( n < 0 ) {
+        logWarn("Input: Unable to read '%s'.\n",INPUT_DEVICES_FILE) ;
+        return NULL ;
+    }
+
+    in = calloc( 1, sizeof( INPUT_T ) ) ;
+    if ( in == NULL ) {
+        logError("Input: Out of memory!\n") ;
+        return NULL ;
+    }
+    in->epollFd = epoll_create1( EPOLL_CLOEXEC ) ;
+    in->wakeFd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK ) ;
+    in->notifyFd = -1 ;
+    ee.events = EPOLLIN ;
+    ee.data.u32 = (uint32_t) WAKE_ID ;
+    if ( in->epollFd < 0 || in->wakeFd < 0 ||
+         epoll_ctl( in->epollFd, EPOLL_CTL_ADD, in->wakeFd, &ee ) != 0 ) {
+        logWarn("Input: Unable to set up epoll, %s.\n",strerror(errno)) ;
+        if ( in->epollFd >= 0 ) close( in->epollFd ) ;
+        if ( in->wakeFd >= 0 ) close( in->wakeFd ) ;
+        free( in ) ;
+        return NULL ;
+    }
+
+    for ( i = 0 ; i < n ; ++i ) {
+        if ( ( found[i].classes & classes ) == 0 ) continue ;
+        dev = &in->device[in->ndevices] ;
+        *dev = found[i] ;
+        dev->fd = open( dev->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC ) ;
+        if ( dev->fd < 0 ) {
+            logWarn("Input: Unable to open '%s' (%s), %s.\n",dev->path,dev->name,strerror(errno)) ;
+            continue ;
+        }
+        dev->monotonic = ( ioctl( dev->fd, EVIOCSCLOCKID, &clk ) == 0 ) ;
+        ee.data.u32 = in->ndevices ;
+        if ( epoll_ctl( in->epollFd, EPOLL_CTL_ADD, dev->fd, &ee ) != 0 ) {
+            logWarn("Input: Unable to watch '%s', %s.\n",dev->path,strerror(errno)) ;
+            close( dev->fd ) ;
+            continue ;
+        }
+        logInfo("Input: '%s' on %s%s%s%s.\n",dev->name,dev->path,
+                dev->classes & INPUT_KEYBOARD ? " keyboard" : "",
+                dev->classes & INPUT_MOUSE ? " mouse" : "",
+                dev->classes & INPUT_TOUCH ? " touch" : "") ;
+        ++in->ndevices ;
+    }
+
+    if ( in->ndevices == 0 || pthread_create( &in->thread, NULL, inputThread, in ) != 0 ) {
+        if ( in->ndevices == 0 ) logInfo("Input: No devices.\n") ;
+        for ( i = 0 ; i < in->ndevices ; ++i ) close( in->device[i].fd ) ;
+        close( in->epollFd ) ;
+        close( in->wakeFd ) ;
+        free( in ) ;
+        return NULL ;
+    }
+
+    return in ;
+
+} // inputStart
+
+
+
+/***********************************************************
+ * Name: inputPoll
+ *
+ * Arguments:
+ *     in - input, may be NULL.
+ *     ev - the oldest event.
+ *
+ * Description: Takes the oldest event off the ring. Render
+ *              thread only, no system calls.
+ *
+ * Returns: 1 if there was an event, else 0.
+ *
+ ***********************************************************/
+int inputPoll(INPUT_T *in, INPUT_EVENT_T *ev)
+{
+    unsigned int tail ;
+
+    if ( in == NULL ) return 0 ;
+
+    tail = in->tail ;
+    if ( tail == __atomic_load_n( &in->head, __ATOMIC_ACQUIRE ) ) return 0 ;
+    *ev = in->event[tail & ( INPUT_QUEUE_SIZE - 1 )] ;
+    __atomic_store_n( &in->tail, tail + 1, __ATOMIC_RELEASE ) ;
+    return 1 ;
+
+} // inputPoll
+
+
+
+// An eventfd to write when events are queued, -1 for none.
+void inputNotify(INPUT_T *in, int fd)
+{
+    if ( in == NULL ) return ;
+    __atomic_store_n( &in->notifyFd, fd, __ATOMIC_RELAXED ) ;
+} // inputNotify
+
+
+
+// Stop the thread and close the devices.
+void inputStop(INPUT_T *in)
+{
+    uint64_t one = 1 ;
+    int i ;
+
+    if ( in == NULL ) return ;
+
+    if ( write( in->wakeFd, &one, sizeof( one ) ) != sizeof( one ) )
+        logWarn("Input: Unable to wake the reader, %s.\n",strerror(errno)) ;
+    pthread_join( in->thread, NULL ) ;
+
+    logInfo("Input: %lu events, %lu dropped.\n",in->events,in->dropped) ;
+
+    for ( i = 0 ; i < in->ndevices ; ++i )
+        if ( in->device[i].fd >= 0 ) close( in->device[i].fd ) ;
+    close( in->epollFd ) ;
+    close( in->wakeFd ) ;
+    free( in ) ;
+
+} // inputStop
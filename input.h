@@ -0,0 +1,90 @@
+
+/* ************************************************************************* *
+
+  Module Name : input.h
+
+  Description : Event driven input. The keyboards, mice and touch screens
+    listed in /proc/bus/input/devices are opened and watched with epoll by
+    an input thread, which passes their events to the render thread
+    through a single producer single consumer ring. Draining the ring
+    each frame costs no system calls.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <linux/input.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define INPUT_DEVICES_FILE  "/proc/bus/input/devices"
+#define INPUT_MAX_DEVICES     16
+#define INPUT_QUEUE_SIZE     256        // Events, a power of 2.
+#define INPUT_CACHE_LINE      64
+
+// Device classes, may be or-ed.
+#define INPUT_KEYBOARD      0x01
+#define INPUT_MOUSE         0x02
+#define INPUT_TOUCH         0x04
+#define INPUT_ALL           0x07
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    double      time ;          // us, CLOCK_MONOTONIC
+    uint16_t    type ;          // EV_KEY, EV_REL, EV_ABS
+    uint16_t    code ;          // KEY_ESC, REL_X, ...
+    int32_t     value ;         // 1 pressed, 0 released, 2 repeat
+    int         device ;        // index into INPUT_T device[]
+} INPUT_EVENT_T ;
+
+typedef struct {
+    char        name[80] ;
+    char        path[32] ;      // /dev/input/eventN
+    int         classes ;       // INPUT_KEYBOARD | ...
+    int         fd ;            // -1 if closed
+    int         monotonic ;     // kernel stamps CLOCK_MONOTONIC, else read time
+} INPUT_DEVICE_T ;
+
+typedef struct {
+    INPUT_DEVICE_T device[INPUT_MAX_DEVICES] ;
+    int         ndevices ;
+
+    pthread_t   thread ;
+    int         epollFd ;
+    int         wakeFd ;        // eventfd, stops the thread
+    int         notifyFd ;      // eventfd written when events are queued, -1 none
+
+    // SPSC ring. head is only written by the input thread, tail by the
+    // render thread, each on its own cache line.
+    INPUT_EVENT_T event[INPUT_QUEUE_SIZE] ;
+    unsigned int head __attribute__(( aligned( INPUT_CACHE_LINE ) )) ;
+    unsigned long dropped ;     // ring full
+    unsigned long events ;
+    unsigned int tail __attribute__(( aligned( INPUT_CACHE_LINE ) )) ;
+} INPUT_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+int inputScanDevices(const char *fileName, INPUT_DEVICE_T *device, int max) ;
+
+INPUT_T *inputStart(int classes) ;
+
+int inputPoll(INPUT_T *in, INPUT_EVENT_T *ev) ;
+
+void inputNotify(INPUT_T *in, int fd) ;
+
+void inputStop(INPUT_T *in) ;
+
+#endif // __INPUT_H__
@@ -0,0 +1,604 @@
+
+/*
+  This module logs without the caller waiting for the output.
+
+  A message is recorded in the calling thread's ring as a header (size,
+  level, no. of arguments, the format pointer, the time) followed by the
+  arguments as 8 byte values and the text of any %s arguments. The format
+  string is only read again by the writer, so must be a literal or live
+  until logStop(), which every call site here is. Rings are allocated by
+  a thread's first message, up to LOG_MAX_THREADS at a time, other
+  threads log directly. A thread's exit marks its ring, the writer frees
+  it once what is left is written and the slot is taken again.
+
+  Each ring has one producer, its thread, and one consumer, the writer,
+  so needs no lock. Records are contiguous : if one does not fit before
+  the end of the ring a padding record fills the end and it starts at
+  the beginning. The producer publishes head with a release store after
+  copying the record in, the writer releases tail after formatting it.
+  A record that does not fit in the free space is dropped and counted.
+
+  The writer wakes every LOG_FLUSH_US, takes records from all the rings
+  oldest first, so messages from different threads stay in order, and
+  formats them with snprintf() one conversion at a time.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "utils.h"
+
+
+
+#define ALIGN8(n)       ( ( (n) + 7 ) & ~7 )
+#define LOG_PAD         0xffff     // level of a padding record
+#define MAXLINE         4096       // formatted record
+
+// Argument classes of a conversion.
+#define ARG_NONE        0          // %% or not a conversion
+#define ARG_INT         1          // also char and short
+#define ARG_LONG        2
+#define ARG_LLONG       3          // also intmax_t
+#define ARG_SIZE        4          // size_t, ptrdiff_t
+#define ARG_DOUBLE      5
+#define ARG_LDOUBLE     6          // recorded as a double
+#define ARG_STRING      7
+#define ARG_POINTER     8
+#define ARG_COUNT       9          // %n, not recorded
+
+
+typedef struct {
+    uint32_t    size ;          // bytes, with header and padding
+    uint16_t    level ;         // LOG_PAD = skip
+    uint16_t    nargs ;
+    const char *fmt ;
+    double      time ;          // us
+} LOG_RECORD_T ;
+
+typedef union {
+    int64_t     i ;             // integers, pointers, string offsets
+    double      d ;
+} LOG_ARG_T ;
+
+typedef struct {
+    char        data[LOG_RING_SIZE] ;
+    uint64_t    head __attribute__(( aligned( 64 ) )) ;   // producer
+    unsigned long dropped ;
+    int         exited ;        // the producer is gone
+    uint64_t    tail __attribute__(( aligned( 64 ) )) ;   // writer
+    unsigned long reported ;    // dropped, last told
+} LOG_RING_T ;
+
+typedef struct {
+    int         level ;
+    int         running ;
+    FILE       *out ;
+    pthread_t   writer ;
+    pthread_key_t key ;         // releases a thread's ring
+    LOG_RING_T *ring[LOG_MAX_THREADS] ;     // NULL = free slot
+    unsigned long records ;
+    unsigned long dropped ;
+    unsigned long limited ;
+} LOGGER_T ;
+
+// A conversion in a format.
+typedef struct {
+    int         len ;           // chars, from the '%'
+    int         stars ;         // '*' width/precision arguments
+    int         arg ;           // ARG_ class
+} SPEC_T ;
+
+
+static LOGGER_T logger = { LOG_INFO } ;
+static __thread LOG_RING_T *myRing ;
+static __thread int noRing ;   // no slot left
+
+static const char *levelNames[LOG_NLEVELS] = { "error", "warn", "info", "debug" } ;
+
+
+
+// The conversion at p (a '%'), as printf() would read it.
+static void parse_spec(const char *p, SPEC_T *sp)
+{
+    const char *q = p + 1 ;
+    int length = 0 ;            // 'h', 'l', 'L' (ll), 'z', 'D' (long double)
+
+    sp->stars = 0 ;
+    while ( *q && strchr("-+ #0'", *q) ) ++q ;
+    if ( *q == '*' ) {
+        sp->stars++ ;
+        ++q ;
+    } else
+        while ( isdigit( (unsigned char) *q ) ) ++q ;
+    if ( *q == '.' ) {
+        ++q ;
+        if ( *q == '*' ) {
+            sp->stars++ ;
+            ++q ;
+        } else
+            while ( isdigit( (unsigned char) *q ) ) ++q ;
+    }
+    switch ( *q ) {
+        case 'h' : length = 'h' ; while ( *q == 'h' ) ++q ; break ;
+        case 'l' : length = ( q[1] == 'l' ) ? 'L' : 'l' ; q += ( q[1] == 'l' ) ? 2 : 1 ; break ;
+        case 'j' : length = 'L' ; ++q ; break ;
+        case 'z' :
+        case 't' : length = 'z' ; ++q ; break ;
+        case 'L' : length = 'D' ; ++q ; break ;
+    }
+
+    switch ( *q ) {
+        case 'd' : case 'i' : case 'o' : case 'u' : case 'x' : case 'X' :
+            sp->arg = length == 'l' ? ARG_LONG : length == 'L' ? ARG_LLONG :
+                      length == 'z' ? ARG_SIZE : ARG_INT ;
+            break ;
+        case 'c' :
+            sp->arg = ARG_INT ;
+            break ;
+        case 'e' : case 'E' : case 'f' : case 'F' : case 'g' : case 'G' : case 'a' : case 'A' :
+            sp->arg = length == 'D' ? ARG_LDOUBLE : ARG_DOUBLE ;
+            break ;
+        case 's' :
+            sp->arg = ARG_STRING ;
+            break ;
+        case 'p' :
+            sp->arg = ARG_POINTER ;
+            break ;
+        case 'n' :
+            sp->arg = ARG_COUNT ;
+            break ;
+        default :               // %% or a bad conversion
+            sp->arg = ARG_NONE ;
+            sp->stars = 0 ;
+            break ;
+    }
+    sp->len = q - p + ( *q ? 1 : 0 ) ;
+
+} // parse_spec
+
+
+
+// Record the arguments of fmt into rec, return its size.
+static int capture(char *rec, int level, const char *fmt, va_list ap)
+{
+    LOG_RECORD_T *r = (LOG_RECORD_T *) rec ;
+    LOG_ARG_T arg[LOG_MAX_ARGS] ;
+    char text[LOG_MAX_RECORD] ;
+    int nargs = 0, ntext = 0, room, i, n ;
+    const char *p, *s ;
+    SPEC_T sp ;
+
+    room = LOG_MAX_RECORD - sizeof( LOG_RECORD_T ) - sizeof( arg ) ;
+    for ( p = fmt ; *p ; ) {
+        if ( *p++ != '%' ) continue ;
+        parse_spec(p - 1, &sp) ;
+        p += sp.len - 1 ;
+        if ( sp.arg == ARG_NONE ) continue ;
+        if ( nargs + sp.stars + 1 > LOG_MAX_ARGS ) break ;    // the rest print as is
+
+        for ( i = 0 ; i < sp.stars ; ++i )
+            arg[nargs++].i = va_arg(ap, int) ;
+        switch ( sp.arg ) {
+            case ARG_INT :     arg[nargs++].i = va_arg(ap, int) ; break ;
+            case ARG_LONG :    arg[nargs++].i = va_arg(ap, long) ; break ;
+            case ARG_LLONG :   arg[nargs++].i = va_arg(ap, long long) ; break ;
+            case ARG_SIZE :    arg[nargs++].i = va_arg(ap, size_t) ; break ;
+            case ARG_DOUBLE :  arg[nargs++].d = va_arg(ap, double) ; break ;
+            case ARG_LDOUBLE : arg[nargs++].d = va_arg(ap, long double) ; break ;
+            case ARG_POINTER : arg[nargs++].i = (intptr_t) va_arg(ap, void *) ; break ;
+            case ARG_COUNT :   (void) va_arg(ap, void *) ; break ;
+            case ARG_STRING :
+                s = va_arg(ap, const char *) ;
+                if ( s == NULL ) s = "(null)" ;
+                if ( ntext >= room ) {          // full, an empty string
+                    arg[nargs++].i = ntext - 1 ;
+                    break ;
+                }
+                n = strlen(s) ;
+                if ( n > room - ntext - 1 ) n = room - ntext - 1 ;
+                if ( n < 0 ) n = 0 ;
+                arg[nargs++].i = ntext ;
+                memcpy( text + ntext, s, n ) ;
+                ntext += n ;
+                text[ntext++] = '\0' ;
+                break ;
+        }
+    }
+
+    r->level = level ;
+    r->nargs = nargs ;
+    r->fmt = fmt ;
+    r->time = nowus() ;
+    memcpy( rec + sizeof( LOG_RECORD_T ), arg, nargs * sizeof( LOG_ARG_T ) ) ;
+    memcpy( rec + sizeof( LOG_RECORD_T ) + nargs * sizeof( LOG_ARG_T ), text, ntext ) ;
+    r->size = ALIGN8(sizeof( LOG_RECORD_T ) + nargs * sizeof( LOG_ARG_T ) + ntext) ;
+    return r->size ;
+
+} // capture
+
+
+
+#define EMIT(value)                                                         \
+    ( sp.stars == 0 ? snprintf(o, room, spec, value) :                      \
+      sp.stars == 1 ? snprintf(o, room, spec, star[0], value) :             \
+                      snprintf(o, room, spec, star[0], star[1], value) )
+
+// Format a record into out, return its length.
+static int format_record(const LOG_RECORD_T *r, char *out, int size)
+{
+    const LOG_ARG_T *arg = (const LOG_ARG_T *) ( r + 1 ) ;
+    const char *text = (const char *) ( arg + r->nargs ) ;
+    const char *p = r->fmt ;
+    char spec[32], *o ;
+    int n = 0, a = 0, room, w, i ;
+    int star[2] ;
+    LOG_ARG_T v ;
+    SPEC_T sp ;
+
+    while ( *p && n < size - 1 ) {
+        if ( *p != '%' ) {
+            out[n++] = *p++ ;
+            continue ;
+        }
+        parse_spec(p, &sp) ;
+        if ( sp.arg == ARG_NONE || sp.arg == ARG_COUNT ||
+             a + sp.stars + 1 > r->nargs || sp.len >= (int) sizeof( spec ) ) {
+            if ( p[1] == '%' ) out[n++] = '%' ;
+            else if ( sp.arg != ARG_COUNT )   // not recorded, as is
+                for ( i = 0 ; i < sp.len && n < size - 1 ; ++i ) out[n++] = p[i] ;
+            p += sp.len ;
+            continue ;
+        }
+
+        memcpy( spec, p, sp.len ) ;
+        spec[sp.len] = '\0' ;
+        p += sp.len ;
+        if ( sp.arg == ARG_LDOUBLE ) {      // recorded as a double
+            char *L = strchr(spec, 'L') ;
+            memmove( L, L + 1, strlen(L) ) ;
+        }
+        for ( i = 0 ; i < sp.stars ; ++i ) star[i] = (int) arg[a++].i ;
+        v = arg[a++] ;
+
+        o = out + n ;
+        room = size - n ;
+        switch ( sp.arg ) {
+            case ARG_INT :    w = EMIT((int) v.i) ; break ;
+            case ARG_LONG :   w = EMIT((long) v.i) ; break ;
+            case ARG_LLONG :  w = EMIT((long long) v.i) ; break ;
+            case ARG_SIZE :   w = EMIT((size_t) v.i) ; break ;
+            case ARG_STRING : w = EMIT(text + v.i) ; break ;
+            case ARG_POINTER : w = EMIT((void *) (intptr_t) v.i) ; break ;
+            default :         w = EMIT(v.d) ; break ;
+        }
+        if ( w > 0 ) n += ( w < room ) ? w : room - 1 ;
+    }
+    out[n] = '\0' ;
+    return n ;
+
+} // format_record
+
+
+
+// This thread's ring, made by its first message in a free slot.
+static LOG_RING_T *get_ring(void)
+{
+    LOG_RING_T *ring, *none ;
+    int slot ;
+
+    if ( myRing || noRing ) return myRing ;
+
+    ring = calloc( 1, sizeof( LOG_RING_T ) ) ;
+    for ( slot = 0 ; ring && slot < LOG_MAX_THREADS ; ++slot ) {
+        none = NULL ;
+        if ( __atomic_compare_exchange_n( &logger.ring[slot], &none, ring, 0,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED ) ) {
+            pthread_setspecific( logger.key, ring ) ;
+            myRing = ring ;
+            return myRing ;
+        }
+    }
+    free( ring ) ;
+    noRing = 1 ;
+    return NULL ;
+
+} // get_ring
+
+
+
+// Destructor of logger.key, the thread exits. The writer frees the ring
+// once it is empty, messages from later destructors are written at once.
+static void release_ring(void *ring)
+{
+    __atomic_store_n( &( (LOG_RING_T *) ring )->exited, 1, __ATOMIC_RELEASE ) ;
+    myRing = NULL ;
+    noRing = 1 ;
+
+} // release_ring
+
+
+
+// Producer side, copy a record into the ring.
+static void push(LOG_RING_T *ring, const char *rec, uint32_t size)
+{
+    uint64_t head = ring->head ;
+    uint64_t tail = __atomic_load_n( &ring->tail, __ATOMIC_ACQUIRE ) ;
+    uint32_t pos = head & ( LOG_RING_SIZE - 1 ) ;
+    uint32_t toEnd = LOG_RING_SIZE - pos ;
+    LOG_RECORD_T *pad ;
+
+    if ( size > toEnd ) {
+        if ( head + toEnd + size - tail > LOG_RING_SIZE ) goto full ;
+        pad = (LOG_RECORD_T *) ( ring->data + pos ) ;
+        pad->size = toEnd ;
+        pad->level = LOG_PAD ;
+        head += toEnd ;
+        pos = 0 ;
+    } else if ( head + size - tail > LOG_RING_SIZE )
+        goto full ;
+
+    memcpy( ring->data + pos, rec, size ) ;
+    __atomic_store_n( &ring->head, head + size, __ATOMIC_RELEASE ) ;
+    return ;
+
+full :
+    __atomic_fetch_add( &ring->dropped, 1, __ATOMIC_RELAXED ) ;
+
+} // push
+
+
+
+static void write_line(int level, const char *line, int n)
+{
+    FILE *f = ( level == LOG_ERROR && logger.out == stdout ) ? stderr : logger.out ;
+
+    fwrite( line, 1, n, f ) ;
+} // write_line
+
+
+
+// The oldest record in a ring, skipping padding, or NULL.
+static LOG_RECORD_T *peek(LOG_RING_T *ring)
+{
+    uint64_t head = __atomic_load_n( &ring->head, __ATOMIC_ACQUIRE ) ;
+    LOG_RECORD_T *r ;
+
+    while ( ring->tail != head ) {
+        r = (LOG_RECORD_T *) ( ring->data + ( ring->tail & ( LOG_RING_SIZE - 1 ) ) ) ;
+        if ( r->level != LOG_PAD ) return r ;
+        __atomic_store_n( &ring->tail, ring->tail + r->size, __ATOMIC_RELEASE ) ;
+    }
+    return NULL ;
+
+} // peek
+
+
+
+// Write out everything in the rings, oldest first.
+static int drain(void)
+{
+    char line[MAXLINE] ;
+    LOG_RECORD_T *r, *oldest ;
+    LOG_RING_T *ring, *from ;
+    unsigned long dropped ;
+    int i, n, exited, written = 0 ;
+
+    for ( ;; ) {
+        oldest = NULL ;
+        from = NULL ;
+        for ( i = 0 ; i < LOG_MAX_THREADS ; ++i ) {
+            ring = __atomic_load_n( &logger.ring[i], __ATOMIC_ACQUIRE ) ;
+            if ( ring == NULL || ( r = peek(ring) ) == NULL ) continue ;
+            if ( oldest == NULL || r->time < oldest->time ) {
+                oldest = r ;
+                from = ring ;
+            }
+        }
+        if ( oldest == NULL ) break ;
+
+        n = format_record(oldest, line, sizeof( line )) ;
+        write_line(oldest->level, line, n) ;
+        __atomic_store_n( &from->tail, from->tail + oldest->size, __ATOMIC_RELEASE ) ;
+        logger.records++ ;
+        ++written ;
+    }
+
+    for ( i = 0 ; i < LOG_MAX_THREADS ; ++i ) {
+        ring = __atomic_load_n( &logger.ring[i], __ATOMIC_ACQUIRE ) ;
+        if ( ring == NULL ) continue ;
+        exited = __atomic_load_n( &ring->exited, __ATOMIC_ACQUIRE ) ;
+        dropped = __atomic_load_n( &ring->dropped, __ATOMIC_RELAXED ) ;
+        if ( dropped != ring->reported ) {
+            n = snprintf(line, sizeof( line ), "Log: %lu messages dropped, ring %d full.\n",
+                         dropped - ring->reported, i) ;
+            write_line(LOG_WARN, line, n) ;
+            logger.dropped += dropped - ring->reported ;
+            ring->reported = dropped ;
+            ++written ;
+        }
+        // Its thread is gone and all it pushed is written, free the slot.
+        if ( exited && peek(ring) == NULL ) {
+            __atomic_store_n( &logger.ring[i], NULL, __ATOMIC_RELEASE ) ;
+            free( ring ) ;
+        }
+    }
+
+    if ( written ) fflush( logger.out ) ;
+    return written ;
+
+} // drain
+
+
+
+static void *writerThread(void *arg)
+{
+    struct timespec pause = { 0, LOG_FLUSH_US * 1000 } ;
+
+    while ( __atomic_load_n( &logger.running, __ATOMIC_ACQUIRE ) ) {
+        drain() ;
+        nanosleep(&pause, NULL) ;
+    }
+    return NULL ;
+
+} // writerThread
+
+
+
+/***********************************************************
+ * Name: logStart
+ *
+ * Arguments:
+ *     level    - LOG_ERROR .. LOG_DEBUG.
+ *     fileName - output file, NULL for stdout.
+ *
+ * Description: Starts the writer thread. Messages are kept in
+ *              the threads' rings until it writes them.
+ *
+ * Returns: 1 if started, 0 if logging stays synchronous.
+ *
+ ***********************************************************/
+int logStart(int level, const char *fileName)
+{
+    logger.level = level ;
+    logger.out = stdout ;
+    if ( fileName && ( logger.out = fopen(fileName, "w") ) == NULL ) {
+        printf("Log: Unable to write '%s', using stdout.\n",fileName) ;
+        logger.out = stdout ;
+    }
+
+    if ( pthread_key_create( &logger.key, release_ring ) != 0 ) return 0 ;
+    __atomic_store_n( &logger.running, 1, __ATOMIC_RELEASE ) ;
+    if ( pthread_create( &logger.writer, NULL, writerThread, NULL ) != 0 ) {
+        __atomic_store_n( &logger.running, 0, __ATOMIC_RELEASE ) ;
+        pthread_key_delete( logger.key ) ;
+        return 0 ;
+    }
+    return 1 ;
+
+} // logStart
+
+
+
+void logv(int level, const char *fmt, va_list ap)
+{
+    char rec[LOG_MAX_RECORD] __attribute__(( aligned( 8 ) )) ;
+    LOG_RING_T *ring ;
+    FILE *f ;
+
+    if ( level > logger.level ) return ;
+
+    if ( !__atomic_load_n( &logger.running, __ATOMIC_ACQUIRE ) || ( ring = get_ring() ) == NULL ) {
+        f = ( level == LOG_ERROR && ( logger.out == NULL || logger.out == stdout ) ) ? stderr :
+            logger.out ? logger.out : stdout ;
+        vfprintf(f, fmt, ap) ;
+        return ;
+    }
+
+    push(ring, rec, capture(rec, level, fmt, ap)) ;
+
+} // logv
+
+
+
+// Log a message if its level is kept.
+void logWrite(int level, const char *fmt, ...)
+{
+    va_list ap ;
+
+    va_start(ap, fmt) ;
+    logv(level, fmt, ap) ;
+    va_end(ap) ;
+
+} // logWrite
+
+
+
+// As logWrite(), within the call site's rate.
+void logRated(LOG_LIMIT_T *limit, int level, const char *fmt, ...)
+{
+    double now = nowus() ;
+    va_list ap ;
+
+    if ( level > logger.level ) return ;
+
+    limit->tokens += ( now - limit->last ) * limit->perSec / 1000000.0 ;
+    if ( limit->tokens > limit->perSec || limit->last == 0.0 ) limit->tokens = limit->perSec ;
+    limit->last = now ;
+    if ( limit->tokens < 1.0 ) {
+        limit->suppressed++ ;
+        __atomic_fetch_add( &logger.limited, 1, __ATOMIC_RELAXED ) ;
+        return ;
+    }
+    limit->tokens -= 1.0 ;
+
+    if ( limit->suppressed ) {
+        logWrite(level, "Log: %lu messages like the next suppressed.\n", limit->suppressed) ;
+        limit->suppressed = 0 ;
+    }
+    va_start(ap, fmt) ;
+    logv(level, fmt, ap) ;
+    va_end(ap) ;
+
+} // logRated
+
+
+
+// Level from its name, -1 if unknown.
+int logLevelFromName(const char *name)
+{
+    int i ;
+
+    for ( i = 0 ; i < LOG_NLEVELS ; ++i )
+        if ( strcmp(name, levelNames[i]) == 0 ) return i ;
+    return -1 ;
+
+} // logLevelFromName
+
+
+
+/***********************************************************
+ * Name: logStop
+ *
+ * Arguments: None.
+ *
+ * Description: Writes out what is left, stops the writer and
+ *              frees the rings. Messages after this are written
+ *              at once. No other thread may still be logging.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void logStop(void)
+{
+    int i ;
+
+    if ( !__atomic_load_n( &logger.running, __ATOMIC_ACQUIRE ) ) return ;
+
+    __atomic_store_n( &logger.running, 0, __ATOMIC_RELEASE ) ;
+    pthread_join( logger.writer, NULL ) ;
+    drain() ;
+
+    if ( logger.dropped || logger.limited )
+        fprintf(logger.out, "Log: %lu messages, %lu dropped, %lu rate limited.\n",
+                logger.records,logger.dropped,logger.limited) ;
+    if ( logger.out != stdout ) fclose( logger.out ) ;
+    logger.out = stdout ;
+    fflush( stdout ) ;
+
+    // Threads exiting later must not mark the freed rings.
+    pthread_key_delete( logger.key ) ;
+    for ( i = 0 ; i < LOG_MAX_THREADS ; ++i ) {
+        free( logger.ring[i] ) ;
+        logger.ring[i] = NULL ;
+    }
+    myRing = NULL ;     // the other threads' are gone
+    noRing = 0 ;
+
+} // logStop
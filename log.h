@@ -0,0 +1,82 @@
+
+/* ************************************************************************* *
+
+  Module Name : log.h
+
+  Description : Asynchronous logging. A message is stored as a binary
+    record, its format string and arguments, in a lock-free ring of the
+    calling thread, and is formatted and written by a writer thread, so
+    logging never waits on stdout. Messages below the log level are not
+    recorded, call sites may be rate limited and full rings drop records
+    and count them. Until logStart(), and after logStop(), messages are
+    written at once as printf() would.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <stdint.h>
+#include <stdarg.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+// Levels, a message is kept if its level <= the log level.
+#define LOG_ERROR              0          // to stderr when logging to stdout
+#define LOG_WARN               1
+#define LOG_INFO               2          // default
+#define LOG_DEBUG              3
+#define LOG_NLEVELS            4
+
+#define LOG_MAX_THREADS       16          // Threads with rings.
+#define LOG_RING_SIZE   (64 << 10)        // Bytes per thread ring, a power of 2.
+#define LOG_MAX_RECORD      2048          // Bytes per record, longer strings cut.
+#define LOG_MAX_ARGS          16          // Arguments per message.
+#define LOG_FLUSH_US       10000          // Writer wakes this often.
+
+#define logError(...)  logWrite(LOG_ERROR, __VA_ARGS__)
+#define logWarn(...)   logWrite(LOG_WARN, __VA_ARGS__)
+#define logInfo(...)   logWrite(LOG_INFO, __VA_ARGS__)
+#define logDebug(...)  logWrite(LOG_DEBUG, __VA_ARGS__)
+
+// At most perSec messages a second from this call site in each thread,
+// the rest are counted and the count logged with the next one let through.
+#define logLimited(level, perSec, ...)                                  \
+    do {                                                                \
+        static __thread LOG_LIMIT_T limit_ = { perSec } ;               \
+        logRated(&limit_, level, __VA_ARGS__) ;                         \
+    } while ( 0 )
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+// Token bucket of a call site, one per thread.
+typedef struct {
+    double      perSec ;
+    double      tokens ;
+    double      last ;          // us
+    unsigned long suppressed ;
+} LOG_LIMIT_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+int logStart(int level, const char *fileName) ;
+
+void logWrite(int level, const char *fmt, ...) __attribute__(( format( printf, 2, 3 ) )) ;
+
+void logv(int level, const char *fmt, va_list ap) ;
+
+void logRated(LOG_LIMIT_T *limit, int level, const char *fmt, ...) __attribute__(( format( printf, 3, 4 ) )) ;
+
+int logLevelFromName(const char *name) ;
+
+void logStop(void) ;
+
+#endif // __LOG_H__
@@ -0,0 +1,193 @@
+
+/*
+  This module paces the frames to a target rate.
+
+  A frame is the update and draw, on the CPU, then the swap. The
+  prediction of the next frame is the longest update and draw of the
+  last PACER_HISTORY frames, plus the shortest swap, plus the margin.
+  The shortest swap is taken as the swap's own cost, as with vsync a
+  swap also waits for the display and a frame started later waits less,
+  so its longer swaps are not work that needs time kept for it.
+
+  pacerBegin() sleeps with clock_nanosleep() to the absolute time of
+  the deadline less the prediction, and returns at once if that has
+  passed. pacerSwapped() moves the deadline on a period. With vsync the
+  swap returns as the display takes the frame, so the next deadline is
+  a period from that return, which keeps the deadlines in step with the
+  display. Without vsync the deadlines keep their own cadence, and when
+  behind they skip ahead whole periods rather than run frames back to
+  back to catch up.
+
+  A frame starting after its deadline follows an idle render on demand
+  loop or a stall outside the frames, and the deadlines start over from
+  it. A swap returning over half a period after its deadline is counted as
+  missed and doubles the margin, up to half a period. Each frame on time
+  takes 1% off it, down to PACER_MIN_MARGIN.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "pacer.h"
+#include "utils.h"
+#include "log.h"
+#include "profile.h"
+
+
+
+#define MARGIN_DECAY    0.99        // Margin kept after a frame on time.
+
+
+
+// Sleep until an absolute time, us CLOCK_MONOTONIC.
+static void sleep_until(double us)
+{
+    struct timespec ts ;
+
+    ts.tv_sec = (time_t) ( us / 1000000.0 ) ;
+    ts.tv_nsec = (long) ( ( us - ts.tv_sec * 1000000.0 ) * 1000.0 ) ;
+    if ( ts.tv_nsec >= 1000000000L ) {
+        ts.tv_sec++ ;
+        ts.tv_nsec -= 1000000000L ;
+    }
+    while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL ) == EINTR ) ;
+
+} // sleep_until
+
+
+
+/***********************************************************
+ * Name: pacerCreate
+ *
+ * Arguments:
+ *     targetHz     - frames a second, 0 for no target.
+ *     swapInterval - eglSwapInterval() set, 0 for none, so
+ *                    the swap does not wait for the display.
+ *
+ * Description: A pacer, its first frame starts at once.
+ *
+ * Returns: pacer, NULL if out of memory.
+ *
+ ***********************************************************/
+PACER_T *pacerCreate(double targetHz, int swapInterval)
+{
+    PACER_T *pc = calloc( 1, sizeof( PACER_T ) ) ;
+
+    if ( pc == NULL ) {
+        logError("Pacer: Out of memory!\n") ;
+        return NULL ;
+    }
+    pc->vsync = swapInterval > 0 ;
+    pc->margin = PACER_MIN_MARGIN ;
+    pacerSetRate(pc, targetHz) ;
+
+    return pc ;
+
+} // pacerCreate
+
+
+
+// A new target, 0 for none. The next frame starts at once.
+void pacerSetRate(PACER_T *pc, double targetHz)
+{
+    if ( pc == NULL ) return ;
+
+    pc->period = targetHz > 0.0 ? 1000000.0 / targetHz : 0.0 ;
+    pc->deadline = 0.0 ;
+    pc->margin = PACER_MIN_MARGIN ;
+
+} // pacerSetRate
+
+
+
+// Before the frame reads its input. Sleeps until the predicted start.
+void pacerBegin(PACER_T *pc)
+{
+    double cpu = 0.0, swap = 0.0, wake ;
+    int i ;
+
+    if ( pc == NULL ) return ;
+
+    pc->start = nowus() ;
+
+    // Past its deadline before it started, the loop idled or stalled
+    // between frames. Start over from this one rather than count it late.
+    if ( pc->start > pc->deadline ) pc->deadline = 0.0 ;
+    if ( pc->period <= 0.0 || pc->deadline <= 0.0 ) return ;
+
+    for ( i = 0 ; i < pc->nhistory ; ++i ) {
+        if ( pc->cpu[i] > cpu ) cpu = pc->cpu[i] ;
+        if ( i == 0 || pc->swap[i] < swap ) swap = pc->swap[i] ;
+    }
+    wake = pc->deadline - cpu - swap - pc->margin ;
+    if ( wake <= pc->start ) return ;
+
+    PROF_BEGIN("pacerSleep") ;
+    sleep_until(wake) ;
+    PROF_END("pacerSleep") ;
+    wake = nowus() ;
+    pc->sleeps++ ;
+    pc->sleptUs += wake - pc->start ;
+    pc->start = wake ;
+
+} // pacerBegin
+
+
+
+// The frame's draw calls are made, the swap is next.
+void pacerSubmitted(PACER_T *pc)
+{
+    if ( pc == NULL ) return ;
+    pc->submitted = nowus() ;
+} // pacerSubmitted
+
+
+
+// The swap has returned. Records the frame and sets the next deadline.
+void pacerSwapped(PACER_T *pc)
+{
+    double end ;
+
+    if ( pc == NULL ) return ;
+
+    end = nowus() ;
+    pc->cpu[pc->next] = pc->submitted - pc->start ;
+    pc->swap[pc->next] = end - pc->submitted ;
+    pc->next = ( pc->next + 1 ) % PACER_HISTORY ;
+    if ( pc->nhistory < PACER_HISTORY ) pc->nhistory++ ;
+    pc->frames++ ;
+
+    if ( pc->period <= 0.0 ) return ;
+
+    if ( pc->deadline > 0.0 && end > pc->deadline + pc->period * 0.5 ) {
+        pc->missed++ ;
+        pc->margin *= 2.0 ;
+        if ( pc->margin > pc->period * 0.5 ) pc->margin = pc->period * 0.5 ;
+    }
+    else if ( pc->margin * MARGIN_DECAY > PACER_MIN_MARGIN )
+        pc->margin *= MARGIN_DECAY ;
+
+    if ( pc->vsync || pc->deadline <= 0.0 )
+        pc->deadline = end + pc->period ;
+    else
+        do pc->deadline += pc->period ; while ( pc->deadline <= end ) ;
+
+} // pacerSwapped
+
+
+
+void pacerDestroy(PACER_T *pc)
+{
+    if ( pc == NULL ) return ;
+
+    if ( pc->period > 0.0 && pc->frames > 0 )
+        logInfo("Pacer: %.1fHz target, %lu frames, %lu missed, slept %lu times for %.3fs, "
+                "margin %.2fms.\n",1000000.0 / pc->period,pc->frames,pc->missed,pc->sleeps,
+                pc->sleptUs / 1000000.0,pc->margin / 1000.0) ;
+    free( pc ) ;
+
+} // pacerDestroy
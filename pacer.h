@@ -0,0 +1,71 @@
+
+/* ************************************************************************* *
+
+  Module Name : pacer.h
+
+  Description : Frame pacing. With a target rate each frame has a
+    deadline, one period after the last, by which its swap should have
+    returned. Rather than start the frame as soon as the last one is
+    swapped and wait in the swap, the pacer predicts how long the frame
+    will take from the recent ones and sleeps first, so the input is
+    read and the scene updated as late as possible and what is shown is
+    fresher. A missed deadline widens the safety margin, frames on time
+    narrow it again.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __PACER_H__
+#define __PACER_H__
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define PACER_HISTORY        32           // Frames the prediction looks at.
+#define PACER_MIN_MARGIN  250.0           // us, least time kept spare.
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    double      period ;        // us, 0 = no target, frames run back to back
+    int         vsync ;         // swap waits for the display, its return sets the phase
+    double      margin ;        // us, spare time in the prediction
+
+    // The last frames' update and draw time, and swap time, us.
+    double      cpu[PACER_HISTORY] ;
+    double      swap[PACER_HISTORY] ;
+    int         nhistory ;
+    int         next ;
+
+    // us, CLOCK_MONOTONIC.
+    double      deadline ;      // the next frame's swap should return by
+    double      start ;         // this frame's, after the sleep
+    double      submitted ;     // draw calls made
+
+    unsigned long frames ;
+    unsigned long missed ;      // swapped over half a period late
+    unsigned long sleeps ;
+    double      sleptUs ;
+} PACER_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+PACER_T *pacerCreate(double targetHz, int swapInterval) ;
+
+void pacerSetRate(PACER_T *pc, double targetHz) ;
+
+void pacerBegin(PACER_T *pc) ;
+
+void pacerSubmitted(PACER_T *pc) ;
+
+void pacerSwapped(PACER_T *pc) ;
+
+void pacerDestroy(PACER_T *pc) ;
+
+#endif // __PACER_H__
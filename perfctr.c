@@ -0,0 +1,252 @@
+
+/*
+  This module reads performance counters for the calling thread.
+
+  Each counter is its own perf event (pid 0, any cpu), not a group : a
+  group is only counted when all of it fits the PMU at once, and a Pi's
+  ARM11 has two registers besides the cycle counter. Alone, the kernel
+  multiplexes them, and every read carries the time the event was enabled
+  and running so a delta is scaled up by enabled/running.
+
+  The kernel is counted too when perf_event_paranoid allows it (GL driver
+  ioctls and context switches happen there), else only user space.
+
+  A sample is one read(2) per counter, about a microsecond each, so a few
+  per frame cost little next to a 16ms frame.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perfctr.h"
+#include "log.h"
+
+
+
+static const struct {
+    const char *name ;
+    uint32_t    type ;
+    uint64_t    config ;
+} counters[PERF_NCOUNTERS] = {
+    { "cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "cache-misses",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "branch-misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+} ;
+
+
+
+static int openCounter(int c, int excludeKernel)
+{
+    struct perf_event_attr attr ;
+
+    memset( &attr, 0, sizeof( attr ) ) ;
+    attr.size = sizeof( attr ) ;
+    attr.type = counters[c].type ;
+    attr.config = counters[c].config ;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING ;
+    attr.exclude_kernel = excludeKernel ;
+    attr.exclude_hv = 1 ;
+
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0) ;
+} // openCounter
+
+
+
+/***********************************************************
+ * Name: perfctrOpen
+ *
+ * Arguments: None.
+ *
+ * Description: Opens the counters for the calling thread,
+ *              which must be the one that samples them.
+ *              Prints the counters that are not available.
+ *
+ * Returns: counters, NULL if none could be opened.
+ *
+ ***********************************************************/
+PERFCTR_T *perfctrOpen(void)
+{
+    PERFCTR_T *pc = calloc( 1, sizeof( PERFCTR_T ) ) ;
+    int c, n = 0 ;
+
+    if ( pc == NULL ) return NULL ;
+
+    for ( c = 0 ; c < PERF_NCOUNTERS ; ++c ) {
+        pc->fd[c] = openCounter(c,pc->userOnly) ;
+        if ( pc->fd[c] < 0 && ( errno == EACCES || errno == EPERM ) && !pc->userOnly ) {
+            // Not allowed to count the kernel, so nor is any later counter.
+            pc->userOnly = 1 ;
+            pc->fd[c] = openCounter(c,1) ;
+        }
+        if ( pc->fd[c] < 0 )
+            logInfo("Perf: No %s counter (%s).\n",counters[c].name,strerror(errno)) ;
+        else
+            ++n ;
+    }
+
+    if ( n == 0 ) {
+        free( pc ) ;
+        return NULL ;
+    }
+    if ( pc->userOnly ) logInfo("Perf: Counting user space only.\n") ;
+
+    perfctrMark(pc) ;
+    return pc ;
+
+} // perfctrOpen
+
+
+
+// Phase index for perfctrPhase(), -1 if there are too many.
+int perfctrAddPhase(PERFCTR_T *pc, const char *name)
+{
+    if ( pc == NULL || pc->nphases == PERF_MAX_PHASES ) return -1 ;
+
+    pc->phase[pc->nphases].name = name ;
+    return pc->nphases++ ;
+} // perfctrAddPhase
+
+
+
+static void readCounters(PERFCTR_T *pc, PERFREAD_T *r)
+{
+    int c ;
+
+    for ( c = 0 ; c < PERF_NCOUNTERS ; ++c ) {
+        if ( pc->fd[c] < 0 || read(pc->fd[c], &r[c], sizeof( PERFREAD_T )) != sizeof( PERFREAD_T ) )
+            memset( &r[c], 0, sizeof( PERFREAD_T ) ) ;
+    }
+} // readCounters
+
+
+
+// Start of a phase, when the previous one was not sampled.
+void perfctrMark(PERFCTR_T *pc)
+{
+    if ( pc ) readCounters(pc,pc->mark) ;
+} // perfctrMark
+
+
+
+// End of a phase, counted from the end of the previous one.
+void perfctrPhase(PERFCTR_T *pc, int phase)
+{
+    PERFREAD_T now[PERF_NCOUNTERS] ;
+    PERFPHASE_T *p ;
+    uint64_t running ;
+    double delta ;
+    int c ;
+
+    if ( pc == NULL || phase < 0 ) return ;
+
+    readCounters(pc,now) ;
+    p = &pc->phase[phase] ;
+    for ( c = 0 ; c < PERF_NCOUNTERS ; ++c ) {
+        delta = (double) ( now[c].value - pc->mark[c].value ) ;
+        running = now[c].running - pc->mark[c].running ;
+        if ( running > 0 )
+            delta *= (double) ( now[c].enabled - pc->mark[c].enabled ) / running ;
+        p->total[c] += delta ;
+        p->last[c] += delta ;
+    }
+    p->samples++ ;
+    p->lastSamples++ ;
+    memcpy( pc->mark, now, sizeof( now ) ) ;
+} // perfctrPhase
+
+
+
+// Counter per sample, or a '-' if it is not available, added to line.
+static int printPer(PERFCTR_T *pc, int c, double v, int width, int prec, char *line, int size)
+{
+    if ( pc->fd[c] < 0 )
+        return snprintf(line, size, " %*s",width,"-") ;
+    else
+        return snprintf(line, size, " %*.*f",width,prec,v) ;
+} // printPer
+
+
+
+// One line per phase sampled : per sample kilo cycles, kilo instructions,
+// IPC, cache and branch misses per 1000 instructions, context switches.
+// Each line is built then logged as one message.
+static void report(PERFCTR_T *pc, int total)
+{
+    PERFPHASE_T *p ;
+    const double *v ;
+    unsigned long n ;
+    char line[160] ;
+    int i, k, size = sizeof( line ), haveInstr = ( pc->fd[PERF_INSTRUCTIONS] >= 0 ) ;
+
+    logInfo("Perf %-15s %6s %8s %8s %6s %6s %6s %8s\n",total ? "(total)" : "(interval)",
+            "n","Kcycles","Kinstr","IPC","c-MPKI","b-MPKI","switches") ;
+    for ( i = 0 ; i < pc->nphases ; ++i ) {
+        p = &pc->phase[i] ;
+        v = total ? p->total : p->last ;
+        n = total ? p->samples : p->lastSamples ;
+        if ( n == 0 ) continue ;
+
+        k = snprintf(line, size, "  %-18s %6lu",p->name,n) ;
+        k += printPer(pc,PERF_CYCLES,v[PERF_CYCLES] / n / 1000.0,8,1,line + k,size - k) ;
+        k += printPer(pc,PERF_INSTRUCTIONS,v[PERF_INSTRUCTIONS] / n / 1000.0,8,1,line + k,size - k) ;
+        if ( haveInstr && pc->fd[PERF_CYCLES] >= 0 && v[PERF_CYCLES] > 0.0 )
+            k += snprintf(line + k, size - k, " %6.2f",v[PERF_INSTRUCTIONS] / v[PERF_CYCLES]) ;
+        else
+            k += snprintf(line + k, size - k, " %6s","-") ;
+        if ( haveInstr && v[PERF_INSTRUCTIONS] > 0.0 ) {
+            k += printPer(pc,PERF_CACHE_MISSES,v[PERF_CACHE_MISSES] * 1000.0 / v[PERF_INSTRUCTIONS],6,2,
+                          line + k,size - k) ;
+            k += printPer(pc,PERF_BRANCH_MISSES,v[PERF_BRANCH_MISSES] * 1000.0 / v[PERF_INSTRUCTIONS],6,2,
+                          line + k,size - k) ;
+        } else
+            k += snprintf(line + k, size - k, " %6s %6s","-","-") ;
+        printPer(pc,PERF_CTX_SWITCHES,v[PERF_CTX_SWITCHES] / n,8,3,line + k,size - k) ;
+        logInfo("%s\n",line) ;
+    }
+} // report
+
+
+
+// Report and restart the counts since the last report.
+void perfctrReport(PERFCTR_T *pc)
+{
+    int i ;
+
+    if ( pc == NULL ) return ;
+
+    report(pc,0) ;
+    for ( i = 0 ; i < pc->nphases ; ++i ) {
+        memset( pc->phase[i].last, 0, sizeof( pc->phase[i].last ) ) ;
+        pc->phase[i].lastSamples = 0 ;
+    }
+} // perfctrReport
+
+
+
+// Report the whole run.
+void perfctrFinish(PERFCTR_T *pc)
+{
+    if ( pc ) report(pc,1) ;
+} // perfctrFinish
+
+
+
+void perfctrClose(PERFCTR_T *pc)
+{
+    int c ;
+
+    if ( pc == NULL ) return ;
+
+    for ( c = 0 ; c < PERF_NCOUNTERS ; ++c )
+        if ( pc->fd[c] >= 0 ) close( pc->fd[c] ) ;
+    free( pc ) ;
+} // perfctrClose
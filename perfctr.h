@@ -0,0 +1,86 @@
+
+/* ************************************************************************* *
+
+  Module Name : perfctr.h
+
+  Description : Hardware performance counters (cycles, instructions, cache
+    misses, branch misses) and context switches for the calling thread,
+    read with perf_event_open(2) at phase boundaries. Deltas are summed
+    per named phase, so each frame phase and startup stage gets its IPC,
+    miss rates and switches per sample, reported periodically and at exit
+    next to the frame time statistics.
+
+    Counters the kernel or CPU will not give (perf_event_paranoid, no PMU
+    in a VM) are left out; with none at all perfctrOpen() returns NULL,
+    and every function accepts NULL and does nothing.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __PERFCTR_H__
+#define __PERFCTR_H__
+
+#include <stdint.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+// Counters.
+#define PERF_CYCLES            0
+#define PERF_INSTRUCTIONS      1
+#define PERF_CACHE_MISSES      2
+#define PERF_BRANCH_MISSES     3
+#define PERF_CTX_SWITCHES      4
+#define PERF_NCOUNTERS         5
+
+#define PERF_MAX_PHASES       16
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+// One counter read : value, and times enabled/running to scale for
+// multiplexing when there are more events than PMU registers.
+typedef struct {
+    uint64_t    value ;
+    uint64_t    enabled ;       // ns
+    uint64_t    running ;
+} PERFREAD_T ;
+
+typedef struct {
+    const char *name ;
+    double      total[PERF_NCOUNTERS] ;     // since start
+    double      last[PERF_NCOUNTERS] ;      // since the last report
+    unsigned long samples ;
+    unsigned long lastSamples ;
+} PERFPHASE_T ;
+
+typedef struct {
+    int         fd[PERF_NCOUNTERS] ;        // -1 = not available
+    int         userOnly ;      // counting excludes the kernel
+    PERFREAD_T  mark[PERF_NCOUNTERS] ;      // end of the last phase
+    PERFPHASE_T phase[PERF_MAX_PHASES] ;
+    int         nphases ;
+} PERFCTR_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+PERFCTR_T *perfctrOpen(void) ;
+
+int perfctrAddPhase(PERFCTR_T *pc, const char *name) ;
+
+void perfctrMark(PERFCTR_T *pc) ;
+
+void perfctrPhase(PERFCTR_T *pc, int phase) ;
+
+void perfctrReport(PERFCTR_T *pc) ;
+
+void perfctrFinish(PERFCTR_T *pc) ;
+
+void perfctrClose(PERFCTR_T *pc) ;
+
+#endif // __PERFCTR_H__
@@ -0,0 +1,210 @@
+
+/*
+  This module records profiling zones for a Chrome trace.
+
+  Each thread gets its own ring of PROF_RING_SIZE events the first time
+  it records one, found again through a thread local pointer, so there
+  is no lock or shared cache line on the recording path : a clock read,
+  three stores and a release store of the head. Only creating a ring
+  takes the registry lock. A full ring overwrites its oldest events.
+
+  profWriteTrace() reads every ring. It is meant for the end of a run;
+  events being written at the same time may be missing or torn.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "profile.h"
+#include "utils.h"
+#include "log.h"
+
+
+
+int profEnabled = 0 ;
+
+static PROF_RING_T *rings[PROF_MAX_THREADS] ;
+static int nrings = 0 ;
+static pthread_mutex_t ringsLock = PTHREAD_MUTEX_INITIALIZER ;
+static uint64_t startNs = 0 ;
+
+static __thread PROF_RING_T *myRing = NULL ;
+static __thread const char *myName = NULL ;
+static __thread int noRing = 0 ;      // Ran out of rings.
+
+
+
+// Start recording zones. A trace is of the zones since the last start.
+void profStart(void)
+{
+    if ( !profEnabled ) startNs = nowns() ;
+    profEnabled = 1 ;
+} // profStart
+
+
+
+void profStop(void)
+{
+    profEnabled = 0 ;
+} // profStop
+
+
+
+// Name the calling thread in the trace.
+void profThreadName(const char *name)
+{
+    myName = name ;
+    if ( myRing ) myRing->threadName = name ;
+} // profThreadName
+
+
+
+static PROF_RING_T *newRing(void)
+{
+    PROF_RING_T *ring = NULL ;
+
+    pthread_mutex_lock( &ringsLock ) ;
+    if ( nrings < PROF_MAX_THREADS ) {
+        ring = calloc( 1, sizeof( PROF_RING_T ) ) ;
+        if ( ring ) {
+            ring->tid = (int) syscall(SYS_gettid) ;
+            ring->threadName = myName ;
+            rings[nrings++] = ring ;
+        }
+    }
+    pthread_mutex_unlock( &ringsLock ) ;
+
+    if ( ring == NULL ) noRing = 1 ;
+    return ring ;
+} // newRing
+
+
+
+static void record(const char *name, char type)
+{
+    PROF_RING_T *ring = myRing ;
+    PROF_EVENT_T *e ;
+
+    if ( ring == NULL ) {
+        if ( noRing || ( ring = myRing = newRing() ) == NULL ) return ;
+    }
+
+    e = &ring->event[ring->head & ( PROF_RING_SIZE - 1 )] ;
+    e->ns = nowns() ;
+    e->name = name ;
+    e->type = type ;
+    __atomic_store_n( &ring->head, ring->head + 1, __ATOMIC_RELEASE ) ;
+} // record
+
+
+
+void profBegin(const char *name)
+{
+    record(name,'B') ;
+} // profBegin
+
+
+
+void profEnd(const char *name)
+{
+    record(name,'E') ;
+} // profEnd
+
+
+
+// PROF_SCOPE : the name is kept in a cleanup variable, NULL if not recording.
+const char *profScopeBegin(const char *name)
+{
+    if ( !profEnabled ) return NULL ;
+    record(name,'B') ;
+    return name ;
+} // profScopeBegin
+
+
+
+void profScopeEnd(const char **name)
+{
+    if ( *name ) record(*name,'E') ;
+} // profScopeEnd
+
+
+
+// Characters that must be escaped in a JSON string are not expected in
+// zone names, but quotes/backslashes are replaced to keep the file valid.
+static void writeName(FILE *f, const char *name)
+{
+    for ( ; *name ; ++name )
+        fputc( ( *name == '"' || *name == '\\' ) ? '\'' : *name, f ) ;
+} // writeName
+
+
+
+/***********************************************************
+ * Name: profWriteTrace
+ *
+ * Arguments:
+ *     fileName - JSON file to write.
+ *
+ * Description: Writes every thread's events as Chrome
+ *              trace_event 'B'/'E' events, with microsecond
+ *              timestamps from profStart(), and the thread
+ *              names as metadata events.
+ *
+ * Returns: no. of events written, -1 on failure.
+ *
+ ***********************************************************/
+int profWriteTrace(const char *fileName)
+{
+    FILE *f = fopen(fileName,"w") ;
+    PROF_RING_T *ring ;
+    PROF_EVENT_T *e ;
+    uint32_t head, i ;
+    int r, n = 0 ;
+    int pid = (int) getpid() ;
+
+    if ( f == NULL ) {
+        logWarn("Profile: Unable to create '%s'.\n",fileName) ;
+        return -1 ;
+    }
+
+    fprintf(f,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n") ;
+
+    pthread_mutex_lock( &ringsLock ) ;
+    for ( r = 0 ; r < nrings ; ++r ) {
+        ring = rings[r] ;
+        if ( ring->threadName ) {
+            fprintf(f,"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                    "\"args\":{\"name\":\"",n ? ",\n" : "",pid,ring->tid) ;
+            writeName(f,ring->threadName) ;
+            fprintf(f,"\"}}") ;
+            ++n ;
+        }
+
+        head = __atomic_load_n( &ring->head, __ATOMIC_ACQUIRE ) ;
+        i = ( head > PROF_RING_SIZE ) ? head - PROF_RING_SIZE : 0 ;
+        for ( ; i != head ; ++i ) {
+            e = &ring->event[i & ( PROF_RING_SIZE - 1 )] ;
+            if ( e->ns < startNs ) continue ;
+            fprintf(f,"%s{\"name\":\"",n ? ",\n" : "") ;
+            writeName(f,e->name) ;
+            fprintf(f,"\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    e->type,( e->ns - startNs ) / 1000.0,pid,ring->tid) ;
+            ++n ;
+        }
+    }
+    pthread_mutex_unlock( &ringsLock ) ;
+
+    fprintf(f,"\n]}\n") ;
+    fclose(f) ;
+
+    logInfo("Profile: Wrote %d events from %d threads to '%s'.\n",n,nrings,fileName) ;
+    return n ;
+
+} // profWriteTrace
+
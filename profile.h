@@ -0,0 +1,90 @@
+
+/* ************************************************************************* *
+
+  Module Name : profile.h
+
+  Description : Profiling zones. PROF_BEGIN/PROF_END, or PROF_SCOPE for
+    the rest of a block, record timestamped begin/end events into a ring
+    buffer owned by the calling thread, so recording takes no lock. The
+    rings are written out as Chrome trace_event JSON for chrome://tracing
+    or Perfetto (ui.perfetto.dev).
+
+    Zones cost one flag test until profStart() is called, and nothing if
+    compiled with -DNO_PROFILE.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define PROF_RING_SIZE   ( 1 << 16 )      // Events kept per thread (power of 2).
+#define PROF_MAX_THREADS     32
+
+#define PROF_CAT2(a,b)   a##b
+#define PROF_CAT(a,b)    PROF_CAT2(a,b)
+
+#ifdef NO_PROFILE
+#define PROF_BEGIN(name)
+#define PROF_END(name)
+#define PROF_SCOPE(name)
+#else
+// 'name' must be a string literal (or otherwise never freed).
+#define PROF_BEGIN(name) do { if ( profEnabled ) profBegin(name) ; } while ( 0 )
+#define PROF_END(name)   do { if ( profEnabled ) profEnd(name) ; } while ( 0 )
+// Zone to the end of the enclosing block.
+#define PROF_SCOPE(name) const char *PROF_CAT(profScope_,__LINE__) \
+                             __attribute__((cleanup(profScopeEnd))) = profScopeBegin(name)
+#endif
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    uint64_t    ns ;            // CLOCK_MONOTONIC
+    const char *name ;
+    char        type ;          // 'B' begin, 'E' end
+} PROF_EVENT_T ;
+
+typedef struct {
+    uint32_t      head ;        // events written, only the owner writes
+    int           tid ;
+    const char   *threadName ;
+    PROF_EVENT_T  event[PROF_RING_SIZE] ;
+} PROF_RING_T ;
+
+/* ************************************************************************* *
+ * GLOBALS
+ * ************************************************************************* */
+
+extern int profEnabled ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+void profStart(void) ;
+
+void profStop(void) ;
+
+void profThreadName(const char *name) ;
+
+void profBegin(const char *name) ;
+
+void profEnd(const char *name) ;
+
+const char *profScopeBegin(const char *name) ;
+
+void profScopeEnd(const char **name) ;
+
+int profWriteTrace(const char *fileName) ;
+
+#endif // __PROFILE_H__
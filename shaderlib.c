@@ -0,0 +1,1154 @@
+
+/*
+  This module builds and keeps the shader programs.
+
+  A program is a source pair and a set of features. Its full text is
+  "#version 100", a "#define <FEATURE> 1" line for each feature and the
+  source, and a 64-bit FNV-1a hash of the vertex and fragment text names
+  it, in memory and on disk, so a changed source or feature set is a
+  different program and a stale binary is never loaded for it.
+
+  Binary files are <dir>/<driver>-<hash>.bin, the driver a hash of
+  GL_RENDERER and GL_VERSION, so drivers sharing the directory, say a
+  headless llvmpipe run and one on the GPU, each keep their own.
+  shaderlibLoadCache() reads them all with no GL, before any program is
+  asked for, so it can be a startup task on a worker. A file is only
+  loaded into a program if it was saved by the same driver, and if the
+  driver still turns it down the program is compiled from source. Only
+  the driver's own stale binaries are removed, never another's. Binaries of programs
+  compiled this run are kept in memory and written when the library is
+  destroyed, out of the way of the frames.
+
+  While recording a GL trace, gltrace.c turns glProgramBinaryOES away so
+  every program is compiled from source and recorded.
+
+  A built program's active uniforms are listed with glGetActiveUniform()
+  and each keeps a copy of its value, which starts as GL's, all zeros.
+  The setters compare the new value with the copy and only mark it if it
+  differs, and shaderlibApply() sends the marked ones with the call of
+  their type. Values are set through the library only, a glUniform*()
+  of its own would leave the copy out of date.
+
+  shaderlibAddFiles() reads a source from files, written first from the
+  built-in text if missing, and watches their directory, as editors
+  often save by renaming a new file over the old. The watcher thread
+  sleeps in poll() on the inotify descriptor and an eventfd that stops
+  it, and only sets the source's changed flag, then writes the eventfd
+  given to shaderlibNotify() if any. shaderlibReload() takes
+  the flags between frames, reads the files again on the render thread
+  and marks the source's programs stale if the text differs. A stale
+  program is rebuilt into a new GL program while the old one is still
+  drawn with. With GL_KHR_parallel_shader_compile the link goes on in
+  the driver's threads and is polled for each frame, without it the
+  build is done at once, the budget then limiting how many a frame. A
+  program that links takes the old one's place in the same slot, so
+  pointers to it stay good, its uniforms are reflected again and their
+  values carried over by name and sent again. A failed build logs the
+  compiler's messages and leaves the old program in use.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <EGL/egl.h>
+
+#include "shaderlib.h"
+#include "utils.h"
+#include "ESUtil.h"
+#include "log.h"
+#include "profile.h"
+#include "glcount.h"
+#include "gltrace.h"
+
+
+
+#define FNV_OFFSET   0xcbf29ce484222325ULL
+#define FNV_PRIME    0x100000001b3ULL
+
+#define MAX_TEXT     8192          // Defines and source of one shader.
+#define MAX_DEFINES   256          // "#version" and the features' lines.
+
+static const char *featureNames[SHADER_NFEATURES] = { "COLOUR", "TEXTURE", "TRANSFORM" } ;
+static const char *attribNames[SHADER_NATTRIBS] = { "a_position", "a_colour", "a_texcoord" } ;
+static const char *uniformNames[SHADER_NUNIFORMS] = { "MVP", "s_texture" } ;
+
+
+
+static uint64_t fnv1a(uint64_t h, const char *s)
+{
+    while ( *s ) {
+        h ^= (unsigned char) *s++ ;
+        h *= FNV_PRIME ;
+    }
+    return h ;
+} // fnv1a
+
+
+
+/***********************************************************
+ * Name: shaderlibCreate
+ *
+ * Arguments:
+ *     cacheDir - binary cache directory, NULL for the default
+ *                ($XDG_CACHE_HOME or ~/.cache, then esTri),
+ *                "" or "none" for no binaries.
+ *
+ * Description: An empty library, no GL needed.
+ *
+ * Returns: library.
+ *
+ ***********************************************************/
+SHADERLIB_T *shaderlibCreate(const char *cacheDir)
+{
+    SHADERLIB_T *lib = calloc( 1, sizeof( SHADERLIB_T ) ) ;
+    const char *base ;
+
+    lib->haveBinary = -1 ;
+    lib->inotifyFd = lib->wakeFd = lib->notifyFd = -1 ;
+
+    if ( cacheDir == NULL ) {
+        if ( ( base = getenv("XDG_CACHE_HOME") ) && base[0] )
+            snprintf(lib->dir, sizeof( lib->dir ), "%s/" SHADERLIB_DIR, base) ;
+        else if ( ( base = getenv("HOME") ) && base[0] )
+            snprintf(lib->dir, sizeof( lib->dir ), "%s/.cache/" SHADERLIB_DIR, base) ;
+    }
+    else if ( strcmp(cacheDir, "none") != 0 )
+        snprintf(lib->dir, sizeof( lib->dir ), "%s", cacheDir) ;
+
+    return lib ;
+
+} // shaderlibCreate
+
+
+
+// A source pair, its strings must last as long as the library.
+// Returns its number for shaderlibProgram(), -1 if full.
+int shaderlibAddSource(SHADERLIB_T *lib, const char *name, const char *vertex, const char *fragment)
+{
+    SHADERLIB_SOURCE_T *src ;
+
+    if ( lib->nsources == SHADERLIB_MAX_SOURCES ) {
+        logError("Shaders: More than %d sources, '%s' not added.\n",SHADERLIB_MAX_SOURCES,name) ;
+        return -1 ;
+    }
+    src = &lib->source[lib->nsources] ;
+    snprintf(src->name, sizeof( src->name ), "%s", name) ;
+    src->vertex = vertex ;
+    src->fragment = fragment ;
+
+    return lib->nsources++ ;
+
+} // shaderlibAddSource
+
+
+
+// A whole text file, NULL if it can't be read or is too long.
+static char *read_text(const char *path)
+{
+    FILE *f ;
+    char *text ;
+    long len ;
+    size_t n ;
+
+    if ( ( f = fopen(path, "rb") ) == NULL ) return NULL ;
+
+    if ( fseek( f, 0, SEEK_END ) != 0 || ( len = ftell( f ) ) < 0 || len > MAX_TEXT - MAX_DEFINES ) {
+        logWarn("Shaders: '%s' is over %d bytes.\n",path,MAX_TEXT - MAX_DEFINES) ;
+        fclose( f ) ;
+        return NULL ;
+    }
+    rewind( f ) ;
+    text = malloc( len + 1 ) ;
+    n = fread(text, 1, len, f) ;
+    text[n] = '\0' ;
+    fclose( f ) ;
+
+    return text ;
+
+} // read_text
+
+
+
+// Is the event about one of the source's files?
+static int watched(const SHADERLIB_SOURCE_T *src, const struct inotify_event *ev)
+{
+    const char *base ;
+    int i ;
+
+    if ( ev->len == 0 || ev->wd != __atomic_load_n( &src->wd, __ATOMIC_RELAXED ) ) return 0 ;
+
+    for ( i = 0 ; i < 2 ; ++i ) {
+        base = strrchr(src->path[i], '/') ;
+        if ( strcmp(base ? base + 1 : src->path[i], ev->name) == 0 ) return 1 ;
+    }
+    return 0 ;
+
+} // watched
+
+
+
+static void *watchThread(void *arg)
+{
+    SHADERLIB_T *lib = arg ;
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event)))) ;
+    const struct inotify_event *ev ;
+    struct pollfd pfd[2] ;
+    uint64_t one = 1 ;
+    ssize_t len ;
+    char *p ;
+    int s, fd, changed ;
+
+    profThreadName("shaderwatch") ;
+
+    pfd[0].fd = lib->wakeFd ;
+    pfd[1].fd = lib->inotifyFd ;
+    pfd[0].events = pfd[1].events = POLLIN ;
+
+    for ( ;; ) {
+        if ( poll( pfd, 2, -1 ) < 0 ) {
+            if ( errno == EINTR ) continue ;
+            logError("Shaders: poll failed, %s.\n",strerror(errno)) ;
+            break ;
+        }
+        if ( pfd[0].revents ) break ;
+
+        len = read( lib->inotifyFd, buf, sizeof( buf ) ) ;
+        changed = 0 ;
+        for ( p = buf ; len > 0 && p < buf + len ; p += sizeof( struct inotify_event ) + ev->len ) {
+            ev = (const struct inotify_event *) p ;
+            for ( s = 0 ; s < lib->nsources ; ++s ) {
+                if ( !watched(&lib->source[s], ev) ) continue ;
+                __atomic_store_n( &lib->source[s].changed, 1, __ATOMIC_RELEASE ) ;
+                changed = 1 ;
+            }
+        }
+        fd = __atomic_load_n( &lib->notifyFd, __ATOMIC_RELAXED ) ;
+        if ( changed && fd >= 0 && write( fd, &one, sizeof( one ) ) != sizeof( one ) )
+            logWarn("Shaders: Unable to wake the frame loop, %s.\n",strerror(errno)) ;
+    }
+    return NULL ;
+
+} // watchThread
+
+
+
+static int start_watcher(SHADERLIB_T *lib)
+{
+    lib->inotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC ) ;
+    lib->wakeFd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK ) ;
+
+    if ( lib->inotifyFd < 0 || lib->wakeFd < 0 ||
+         pthread_create( &lib->watcher, NULL, watchThread, lib ) != 0 ) {
+        if ( lib->inotifyFd >= 0 ) close( lib->inotifyFd ) ;
+        if ( lib->wakeFd >= 0 ) close( lib->wakeFd ) ;
+        lib->inotifyFd = lib->wakeFd = -1 ;
+        return 0 ;
+    }
+    return 1 ;
+
+} // start_watcher
+
+
+
+/***********************************************************
+ * Name: shaderlibAddFiles
+ *
+ * Arguments:
+ *     lib    - library, before the source's programs are
+ *              asked for.
+ *     source - from shaderlibAddSource().
+ *     dir    - directory of <name>.vert and <name>.frag.
+ *
+ * Description: The source's text is read from its files, each
+ *              written from the built-in text first if it is
+ *              missing, and the files are watched so edits are
+ *              rebuilt by shaderlibReload(). No GL.
+ *
+ * Returns: 1 if read, 0 if the built-in text is still used.
+ *
+ ***********************************************************/
+int shaderlibAddFiles(SHADERLIB_T *lib, int source, const char *dir)
+{
+    static const char *ext[2] = { "vert", "frag" } ;
+    SHADERLIB_SOURCE_T *src ;
+    const char *builtIn[2] ;
+    char path[SHADERLIB_MAX_PATH] ;
+    FILE *f ;
+    int i, wd ;
+
+    if ( source < 0 || source >= lib->nsources ) return 0 ;
+    src = &lib->source[source] ;
+    builtIn[0] = src->vertex ;
+    builtIn[1] = src->fragment ;
+
+    for ( i = 0 ; i < 2 ; ++i ) {
+        snprintf(path, sizeof( path ), "%s/%s.%s", dir, src->name, ext[i]) ;
+        memcpy( src->path[i], path, sizeof( path ) ) ;
+        if ( access( src->path[i], F_OK ) != 0 && ( f = fopen(src->path[i], "w") ) != NULL ) {
+            fputs(builtIn[i], f) ;
+            if ( fclose( f ) == 0 ) logInfo("Shaders: '%s' written from the built-in text.\n",src->path[i]) ;
+        }
+        if ( ( src->text[i] = read_text(src->path[i]) ) == NULL ) {
+            logError("Shaders: Unable to read '%s', the built-in '%s' is used.\n",src->path[i],src->name) ;
+            free( src->text[0] ) ;
+            src->text[0] = NULL ;
+            src->path[0][0] = '\0' ;
+            return 0 ;
+        }
+    }
+    src->vertex = src->text[0] ;
+    src->fragment = src->text[1] ;
+
+    if ( lib->inotifyFd < 0 && !start_watcher(lib) ) {
+        logWarn("Shaders: Unable to watch '%s', edits are not reloaded.\n",dir) ;
+        return 1 ;
+    }
+    if ( ( wd = inotify_add_watch( lib->inotifyFd, dir, IN_CLOSE_WRITE | IN_MOVED_TO ) ) < 0 ) {
+        logWarn("Shaders: Unable to watch '%s', %s.\n",dir,strerror(errno)) ;
+        return 1 ;
+    }
+    __atomic_store_n( &src->wd, wd, __ATOMIC_RELAXED ) ;
+    logInfo("Shaders: '%s' read from '%s', reloaded when edited.\n",src->name,dir) ;
+
+    return 1 ;
+
+} // shaderlibAddFiles
+
+
+
+/***********************************************************
+ * Name: shaderlibLoadCache
+ *
+ * Arguments:
+ *     lib - library, before any program is asked for.
+ *
+ * Description: Reads the binary files of the cache directory
+ *              into memory. No GL, it may run on any thread.
+ *
+ * Returns: no. of binaries read.
+ *
+ ***********************************************************/
+int shaderlibLoadCache(SHADERLIB_T *lib)
+{
+    SHADERLIB_BINARY_T *bin ;
+    struct dirent *de ;
+    char path[512] ;
+    DIR *dir ;
+    FILE *f ;
+    size_t len ;
+
+    if ( lib->dir[0] == '\0' || ( dir = opendir(lib->dir) ) == NULL ) return 0 ;
+
+    while ( ( de = readdir(dir) ) != NULL && lib->nbinaries < SHADERLIB_MAX_BINARIES ) {
+        len = strlen(de->d_name) ;
+        if ( len < 5 || strcmp(de->d_name + len - 4, ".bin") != 0 ) continue ;
+
+        snprintf(path, sizeof( path ), "%s/%s", lib->dir, de->d_name) ;
+        if ( ( f = fopen(path, "rb") ) == NULL ) continue ;
+
+        bin = &lib->binary[lib->nbinaries] ;
+        memset( bin, 0, sizeof( SHADERLIB_BINARY_T ) ) ;
+        if ( fread(&bin->head, sizeof( bin->head ), 1, f) == 1 && bin->head.magic == SHADERLIB_MAGIC &&
+             bin->head.version == SHADERLIB_VERSION && bin->head.length > 0 ) {
+            bin->data = malloc( bin->head.length ) ;
+            if ( fread(bin->data, bin->head.length, 1, f) == 1 ) {
+                bin->head.source[SHADERLIB_MAX_NAME - 1] = '\0' ;
+                bin->saved = 1 ;
+                lib->nbinaries++ ;
+            }
+            else {
+                free( bin->data ) ;
+                bin->data = NULL ;
+            }
+        }
+        fclose( f ) ;
+    }
+    closedir( dir ) ;
+
+    logInfo("Shaders: %d program binaries read from '%s'.\n",lib->nbinaries,lib->dir) ;
+    return lib->nbinaries ;
+
+} // shaderlibLoadCache
+
+
+
+// A binary's file, named by its driver and program.
+static void binary_path(const SHADERLIB_T *lib, const SHADERLIB_BINARY_T *bin, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%016llx-%016llx.bin", lib->dir, (unsigned long long) bin->head.driver,
+             (unsigned long long) bin->head.hash) ;
+} // binary_path
+
+
+
+// Is GL_OES_get_program_binary usable? Looked up at the first build,
+// with GL_KHR_parallel_shader_compile for rebuilds.
+static int have_binary(SHADERLIB_T *lib)
+{
+    const char *ext ;
+    GLint formats = 0 ;
+
+    if ( lib->haveBinary >= 0 ) return lib->haveBinary ;
+
+    lib->driver = fnv1a(fnv1a(FNV_OFFSET, (const char *) glGetString(GL_RENDERER)),
+                        (const char *) glGetString(GL_VERSION)) ;
+    lib->haveBinary = 0 ;
+    ext = (const char *) glGetString(GL_EXTENSIONS) ;
+    lib->haveParallel = ext && strstr(ext, "GL_KHR_parallel_shader_compile") ;
+    if ( ext && strstr(ext, "GL_OES_get_program_binary") ) {
+        glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats ) ;
+        lib->getProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC) eglGetProcAddress("glGetProgramBinaryOES") ;
+        lib->programBinary = (PFNGLPROGRAMBINARYOESPROC) eglGetProcAddress("glProgramBinaryOES") ;
+        lib->haveBinary = formats > 0 && lib->getProgramBinary && lib->programBinary ;
+    }
+    if ( !lib->haveBinary ) logInfo("Shaders: No program binaries, all are compiled.\n") ;
+
+    return lib->haveBinary ;
+
+} // have_binary
+
+
+
+// The full text of both shaders, returns its hash.
+static uint64_t program_text(const SHADERLIB_T *lib, int source, unsigned int features,
+                             char *vertex, char *fragment)
+{
+    char defines[MAX_DEFINES] = "#version 100\n" ;
+    int f, len = strlen(defines) ;
+
+    for ( f = 0 ; f < SHADER_NFEATURES ; ++f )
+        if ( features & ( 1u << f ) )
+            len += snprintf(defines + len, sizeof( defines ) - len, "#define %s 1\n", featureNames[f]) ;
+
+    snprintf(vertex, MAX_TEXT, "%s%s", defines, lib->source[source].vertex) ;
+    snprintf(fragment, MAX_TEXT, "%s%s", defines, lib->source[source].fragment) ;
+
+    return fnv1a(fnv1a(FNV_OFFSET, vertex), fragment) ;
+
+} // program_text
+
+
+
+// Load a binary into a new program, 0 if it is turned down.
+static GLuint load_binary(SHADERLIB_T *lib, SHADERLIB_BINARY_T *bin)
+{
+    GLint linked = 0 ;
+    GLuint id ;
+
+    bin->used = 1 ;
+
+    id = glCreateProgram() ;
+    lib->programBinary(id, bin->head.format, bin->data, bin->head.length) ;
+    glGetProgramiv( id, GL_LINK_STATUS, &linked ) ;
+    if ( !linked ) {
+        glDeleteProgram( id ) ;
+        return 0 ;
+    }
+    return id ;
+
+} // load_binary
+
+
+
+// Keep a compiled program's binary, written by shaderlibDestroy().
+static void keep_binary(SHADERLIB_T *lib, const SHADERLIB_PROGRAM_T *pg)
+{
+    SHADERLIB_BINARY_T *bin = NULL ;
+    GLint length = 0 ;
+    GLenum format = 0 ;
+    int b ;
+
+    glGetProgramiv( pg->id, GL_PROGRAM_BINARY_LENGTH_OES, &length ) ;
+    if ( length <= 0 ) return ;
+
+    // A stale binary of the same program and driver is replaced.
+    for ( b = 0 ; b < lib->nbinaries ; ++b )
+        if ( lib->binary[b].head.hash == pg->hash && lib->binary[b].head.driver == lib->driver ) break ;
+    if ( b < lib->nbinaries ) {
+        bin = &lib->binary[b] ;
+        free( bin->data ) ;
+    }
+    else if ( lib->nbinaries < SHADERLIB_MAX_BINARIES )
+        bin = &lib->binary[lib->nbinaries++] ;
+    else
+        return ;
+
+    memset( bin, 0, sizeof( SHADERLIB_BINARY_T ) ) ;
+    bin->data = malloc( length ) ;
+    lib->getProgramBinary(pg->id, length, NULL, &format, bin->data) ;
+    bin->head.magic = SHADERLIB_MAGIC ;
+    bin->head.version = SHADERLIB_VERSION ;
+    bin->head.hash = pg->hash ;
+    bin->head.driver = lib->driver ;
+    bin->head.format = format ;
+    bin->head.length = length ;
+    bin->head.features = pg->features ;
+    snprintf(bin->head.source, sizeof( bin->head.source ), "%s", lib->source[pg->source].name) ;
+    bin->used = 1 ;
+
+} // keep_binary
+
+
+
+// List the program's active uniforms and find the named attributes.
+static void reflect(SHADERLIB_PROGRAM_T *pg)
+{
+    SHADERLIB_UNIFORM_T *u ;
+    GLint active = 0 ;
+    char *bracket ;
+    int i, n ;
+
+    for ( n = 0 ; n < SHADER_NATTRIBS ; ++n )
+        pg->attrib[n] = glGetAttribLocation( pg->id, attribNames[n] ) ;
+
+    glGetProgramiv( pg->id, GL_ACTIVE_UNIFORMS, &active ) ;
+    if ( active > SHADERLIB_MAX_UNIFORMS ) {
+        logWarn("Shaders: %d active uniforms, only %d are set.\n",active,SHADERLIB_MAX_UNIFORMS) ;
+        active = SHADERLIB_MAX_UNIFORMS ;
+    }
+    for ( i = 0 ; i < active ; ++i ) {
+        u = &pg->uniform[pg->nuniforms] ;
+        glGetActiveUniform( pg->id, i, sizeof( u->name ), NULL, &u->size, &u->type, u->name ) ;
+        if ( ( bracket = strchr(u->name, '[') ) != NULL ) *bracket = '\0' ;   // "m[0]", arrays
+        u->location = glGetUniformLocation( pg->id, u->name ) ;
+        if ( u->location >= 0 ) pg->nuniforms++ ;     // not built in gl_ ones
+    }
+
+    for ( n = 0 ; n < SHADER_NUNIFORMS ; ++n )
+        pg->known[n] = shaderlibUniform(pg, uniformNames[n]) ;
+
+} // reflect
+
+
+
+// Build a program from its binary, or compile it. NULL if it fails.
+static SHADERLIB_PROGRAM_T *build(SHADERLIB_T *lib, int source, unsigned int features, uint64_t hash,
+                                  const char *vertex, const char *fragment)
+{
+    SHADERLIB_PROGRAM_T *pg ;
+    double start = nowus(), took ;
+    GLuint id = 0 ;
+    int b, fromBinary = 0 ;
+
+    if ( lib->nprograms == SHADERLIB_MAX_PROGRAMS ) {
+        logError("Shaders: More than %d programs.\n",SHADERLIB_MAX_PROGRAMS) ;
+        return NULL ;
+    }
+
+    PROF_BEGIN("shaderlibBuild") ;
+    if ( have_binary(lib) ) {
+        for ( b = 0 ; b < lib->nbinaries && id == 0 ; ++b )
+            if ( lib->binary[b].head.hash == hash && lib->binary[b].head.driver == lib->driver &&
+                 lib->binary[b].data )
+                id = load_binary(lib, &lib->binary[b]) ;
+        fromBinary = id != 0 ;
+    }
+    if ( id == 0 ) id = esLoadProgram(vertex, fragment) ;
+    PROF_END("shaderlibBuild") ;
+    took = ( nowus() - start ) / 1000.0 ;
+
+    if ( id == 0 ) {
+        logError("Shaders: '%s' features 0x%x failed to build.\n",lib->source[source].name,features) ;
+        return NULL ;
+    }
+
+    pg = &lib->program[lib->nprograms++] ;
+    memset( pg, 0, sizeof( SHADERLIB_PROGRAM_T ) ) ;
+    pg->hash = hash ;
+    pg->source = source ;
+    pg->features = features ;
+    pg->id = id ;
+    pg->fromBinary = fromBinary ;
+    reflect(pg) ;
+
+    if ( fromBinary ) {
+        lib->loaded++ ;
+        lib->loadMs += took ;
+    }
+    else {
+        lib->compiled++ ;
+        lib->compileMs += took ;
+        if ( lib->haveBinary ) keep_binary(lib, pg) ;
+    }
+    logInfo("Shaders: '%s' features 0x%x %s in %.2fms, %d uniforms.\n",lib->source[source].name,
+            features,fromBinary ? "loaded from its binary" : "compiled",took,pg->nuniforms) ;
+
+    return pg ;
+
+} // build
+
+
+
+/***********************************************************
+ * Name: shaderlibProgram
+ *
+ * Arguments:
+ *     lib      - library.
+ *     source   - from shaderlibAddSource().
+ *     features - SHADER_ bits.
+ *
+ * Description: GL thread. The program of the source with the
+ *              features, built the first time it is asked for.
+ *              The library owns it, do not delete it.
+ *
+ * Returns: program, NULL if it failed to build.
+ *
+ ***********************************************************/
+SHADERLIB_PROGRAM_T *shaderlibProgram(SHADERLIB_T *lib, int source, unsigned int features)
+{
+    char vertex[MAX_TEXT], fragment[MAX_TEXT] ;
+    uint64_t hash ;
+    int p ;
+
+    if ( source < 0 || source >= lib->nsources ) return NULL ;
+
+    // Found by what it was asked for, its text may be being rebuilt.
+    for ( p = 0 ; p < lib->nprograms ; ++p )
+        if ( lib->program[p].source == source && lib->program[p].features == features )
+            return &lib->program[p] ;
+
+    hash = program_text(lib, source, features, vertex, fragment) ;
+    return build(lib, source, features, hash, vertex, fragment) ;
+
+} // shaderlibProgram
+
+
+
+// A uniform's index for the setters, -1 if it is not active.
+int shaderlibUniform(const SHADERLIB_PROGRAM_T *pg, const char *name)
+{
+    int u ;
+
+    for ( u = 0 ; u < pg->nuniforms ; ++u )
+        if ( strcmp(pg->uniform[u].name, name) == 0 ) return u ;
+    return -1 ;
+
+} // shaderlibUniform
+
+
+
+// Values of a uniform type, 0 if not one set here.
+static int components(GLenum type)
+{
+    switch ( type ) {
+        case GL_FLOAT :      case GL_INT :      case GL_BOOL :
+        case GL_SAMPLER_2D : case GL_SAMPLER_CUBE :
+            return 1 ;
+        case GL_FLOAT_VEC2 : case GL_INT_VEC2 : case GL_BOOL_VEC2 :
+            return 2 ;
+        case GL_FLOAT_VEC3 : case GL_INT_VEC3 : case GL_BOOL_VEC3 :
+            return 3 ;
+        case GL_FLOAT_VEC4 : case GL_INT_VEC4 : case GL_BOOL_VEC4 : case GL_FLOAT_MAT2 :
+            return 4 ;
+        case GL_FLOAT_MAT3 :
+            return 9 ;
+        case GL_FLOAT_MAT4 :
+            return 16 ;
+        default :
+            return 0 ;
+    }
+} // components
+
+
+
+static int is_float(GLenum type)
+{
+    return type == GL_FLOAT || type == GL_FLOAT_VEC2 || type == GL_FLOAT_VEC3 ||
+           type == GL_FLOAT_VEC4 || type == GL_FLOAT_MAT2 || type == GL_FLOAT_MAT3 ||
+           type == GL_FLOAT_MAT4 ;
+} // is_float
+
+
+
+// Mark a uniform if its new value differs from the copy.
+static void set_value(SHADERLIB_PROGRAM_T *pg, SHADERLIB_UNIFORM_T *u, const void *value, size_t bytes)
+{
+    if ( memcmp( &u->value, value, bytes ) == 0 ) {
+        pg->unchanged++ ;
+        return ;
+    }
+    memcpy( &u->value, value, bytes ) ;
+    if ( !u->dirty ) {
+        u->dirty = 1 ;
+        pg->ndirty++ ;
+    }
+
+} // set_value
+
+
+
+/***********************************************************
+ * Name: shaderlibSetf
+ *
+ * Arguments:
+ *     pg      - program, may be NULL.
+ *     uniform - index from known[] or shaderlibUniform(),
+ *               -1 is ignored.
+ *     value   - as many floats as the type has, 16 for a mat4.
+ *
+ * Description: Sets a float, vec or mat uniform's value, sent
+ *              by the next shaderlibApply() if it changed.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void shaderlibSetf(SHADERLIB_PROGRAM_T *pg, int uniform, const GLfloat *value)
+{
+    SHADERLIB_UNIFORM_T *u ;
+
+    if ( pg == NULL || uniform < 0 || uniform >= pg->nuniforms ) return ;
+    u = &pg->uniform[uniform] ;
+    if ( is_float(u->type) ) set_value(pg, u, value, components(u->type) * sizeof( GLfloat )) ;
+
+} // shaderlibSetf
+
+
+
+// As shaderlibSetf(), an int, bool or sampler uniform.
+void shaderlibSeti(SHADERLIB_PROGRAM_T *pg, int uniform, GLint value)
+{
+    SHADERLIB_UNIFORM_T *u ;
+
+    if ( pg == NULL || uniform < 0 || uniform >= pg->nuniforms ) return ;
+    u = &pg->uniform[uniform] ;
+    if ( components(u->type) == 1 && !is_float(u->type) ) set_value(pg, u, &value, sizeof( GLint )) ;
+
+} // shaderlibSeti
+
+
+
+// As shaderlibSetf(), an int or bool vector, or a single one.
+void shaderlibSetiv(SHADERLIB_PROGRAM_T *pg, int uniform, const GLint *value)
+{
+    SHADERLIB_UNIFORM_T *u ;
+
+    if ( pg == NULL || uniform < 0 || uniform >= pg->nuniforms ) return ;
+    u = &pg->uniform[uniform] ;
+    if ( components(u->type) > 0 && !is_float(u->type) )
+        set_value(pg, u, value, components(u->type) * sizeof( GLint )) ;
+
+} // shaderlibSetiv
+
+
+
+/***********************************************************
+ * Name: shaderlibApply
+ *
+ * Arguments:
+ *     pg - program, in use, may be NULL.
+ *
+ * Description: Just before a draw. Uploads the uniforms whose
+ *              values changed since the last apply.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void shaderlibApply(SHADERLIB_PROGRAM_T *pg)
+{
+    SHADERLIB_UNIFORM_T *u ;
+    const GLfloat *v ;
+    int i ;
+
+    if ( pg == NULL || pg->ndirty == 0 ) return ;
+
+    for ( i = 0 ; i < pg->nuniforms ; ++i ) {
+        u = &pg->uniform[i] ;
+        if ( !u->dirty ) continue ;
+        v = u->value.f ;
+        switch ( u->type ) {
+            case GL_FLOAT :      glUniform1f( u->location, v[0] ) ; break ;
+            case GL_FLOAT_VEC2 : glUniform2f( u->location, v[0], v[1] ) ; break ;
+            case GL_FLOAT_VEC3 : glUniform3f( u->location, v[0], v[1], v[2] ) ; break ;
+            case GL_FLOAT_VEC4 : glUniform4fv( u->location, 1, v ) ; break ;
+            case GL_FLOAT_MAT2 : glUniformMatrix2fv( u->location, 1, GL_FALSE, v ) ; break ;
+            case GL_FLOAT_MAT3 : glUniformMatrix3fv( u->location, 1, GL_FALSE, v ) ; break ;
+            case GL_FLOAT_MAT4 : glUniformMatrix4fv( u->location, 1, GL_FALSE, v ) ; break ;
+            case GL_INT_VEC2 :
+            case GL_BOOL_VEC2 :  glUniform2iv( u->location, 1, u->value.i ) ; break ;
+            case GL_INT_VEC3 :
+            case GL_BOOL_VEC3 :  glUniform3iv( u->location, 1, u->value.i ) ; break ;
+            case GL_INT_VEC4 :
+            case GL_BOOL_VEC4 :  glUniform4iv( u->location, 1, u->value.i ) ; break ;
+            case GL_INT :
+            case GL_BOOL :
+            case GL_SAMPLER_2D :
+            case GL_SAMPLER_CUBE : glUniform1i( u->location, u->value.i[0] ) ; break ;
+        }
+        u->dirty = 0 ;
+        pg->uploads++ ;
+    }
+    pg->ndirty = 0 ;
+
+} // shaderlibApply
+
+
+
+/***********************************************************
+ * Name: shaderlibWarm
+ *
+ * Arguments:
+ *     lib      - library, may be NULL.
+ *     budgetUs - time to spend, at least one is built.
+ *
+ * Description: GL thread, between frames. Builds programs of
+ *              the binaries read from the cache that have not
+ *              been asked for yet, so they are ready when they
+ *              are. This driver's binaries of sources since
+ *              changed are removed, other drivers' are left.
+ *
+ * Returns: no. of binaries still to look at.
+ *
+ ***********************************************************/
+int shaderlibWarm(SHADERLIB_T *lib, double budgetUs)
+{
+    char vertex[MAX_TEXT], fragment[MAX_TEXT] ;
+    char path[512] ;
+    SHADERLIB_BINARY_T *bin ;
+    double end ;
+    uint64_t hash ;
+    int s, p ;
+
+    if ( lib == NULL || lib->warmed >= lib->nbinaries || !have_binary(lib) ) return 0 ;
+
+    end = nowus() + budgetUs ;
+    do {
+        bin = &lib->binary[lib->warmed++] ;
+        if ( bin->used || bin->head.driver != lib->driver ) continue ;
+
+        for ( s = 0 ; s < lib->nsources && strcmp(lib->source[s].name, bin->head.source) != 0 ; ++s ) ;
+        hash = s < lib->nsources ? program_text(lib, s, bin->head.features, vertex, fragment) : 0 ;
+        if ( hash != bin->head.hash ) {
+            bin->used = 1 ;
+            binary_path(lib, bin, path, sizeof( path )) ;
+            unlink( path ) ;
+            continue ;
+        }
+        for ( p = 0 ; p < lib->nprograms && lib->program[p].hash != hash ; ++p ) ;
+        if ( p == lib->nprograms ) build(lib, s, bin->head.features, hash, vertex, fragment) ;
+    } while ( lib->warmed < lib->nbinaries && nowus() < end ) ;
+
+    return lib->nbinaries - lib->warmed ;
+
+} // shaderlibWarm
+
+
+
+// Read a watched source's files again, its programs are marked
+// stale if the text changed.
+static void reread(SHADERLIB_T *lib, int source)
+{
+    SHADERLIB_SOURCE_T *src = &lib->source[source] ;
+    char *text[2] ;
+    int i, p ;
+
+    text[0] = read_text(src->path[0]) ;
+    text[1] = read_text(src->path[1]) ;
+    if ( text[0] == NULL || text[1] == NULL ||
+         ( strcmp(text[0], src->text[0]) == 0 && strcmp(text[1], src->text[1]) == 0 ) ) {
+        free( text[0] ) ;
+        free( text[1] ) ;
+        return ;            // gone for now, or saved unchanged
+    }
+
+    for ( i = 0 ; i < 2 ; ++i ) {
+        free( src->text[i] ) ;
+        src->text[i] = text[i] ;
+    }
+    src->vertex = src->text[0] ;
+    src->fragment = src->text[1] ;
+
+    logInfo("Shaders: '%s' changed, its programs are rebuilt.\n",src->name) ;
+    for ( p = 0 ; p < lib->nprograms ; ++p )
+        if ( lib->program[p].source == source ) lib->program[p].stale = 1 ;
+
+} // reread
+
+
+
+// Start building a stale program from its source's new text. Its
+// status is not asked for, so with parallel compiles it goes on in
+// the background.
+static void start_rebuild(SHADERLIB_T *lib, SHADERLIB_PROGRAM_T *pg)
+{
+    char vertex[MAX_TEXT], fragment[MAX_TEXT] ;
+    const char *text ;
+    GLuint vs, fs ;
+
+    pg->stale = 0 ;
+    pg->nextHash = program_text(lib, pg->source, pg->features, vertex, fragment) ;
+    if ( pg->nextHash == pg->hash ) return ;      // edited back
+
+    pg->nextStart = nowus() ;
+    vs = glCreateShader( GL_VERTEX_SHADER ) ;
+    text = vertex ;
+    glShaderSource( vs, 1, &text, NULL ) ;
+    glCompileShader( vs ) ;
+    fs = glCreateShader( GL_FRAGMENT_SHADER ) ;
+    text = fragment ;
+    glShaderSource( fs, 1, &text, NULL ) ;
+    glCompileShader( fs ) ;
+
+    pg->next = glCreateProgram() ;
+    glAttachShader( pg->next, vs ) ;
+    glAttachShader( pg->next, fs ) ;
+    glLinkProgram( pg->next ) ;
+
+    // Go with the program, their messages can still be read.
+    glDeleteShader( vs ) ;
+    glDeleteShader( fs ) ;
+
+} // start_rebuild
+
+
+
+// Log why a rebuild failed, the compiler's or else the linker's messages.
+static void report_failure(const SHADERLIB_T *lib, const SHADERLIB_PROGRAM_T *pg)
+{
+    const SHADERLIB_SOURCE_T *src = &lib->source[pg->source] ;
+    char message[1024] ;
+    GLuint shader[2] ;
+    GLsizei n = 0 ;
+    GLint ok, type ;
+    int s, compiled = 1 ;
+
+    logWarn("Shaders: '%s' features 0x%x failed to rebuild, the old program is kept.\n",
+            src->name,pg->features) ;
+
+    glGetAttachedShaders( pg->next, 2, &n, shader ) ;
+    for ( s = 0 ; s < n ; ++s ) {
+        glGetShaderiv( shader[s], GL_COMPILE_STATUS, &ok ) ;
+        if ( ok ) continue ;
+        compiled = 0 ;
+        glGetShaderiv( shader[s], GL_SHADER_TYPE, &type ) ;
+        message[0] = '\0' ;
+        glGetShaderInfoLog( shader[s], sizeof( message ), NULL, message ) ;
+        logWarn("Shaders: %s :\n%s\n",src->path[type == GL_FRAGMENT_SHADER],message) ;
+    }
+    if ( compiled ) {
+        message[0] = '\0' ;
+        glGetProgramInfoLog( pg->next, sizeof( message ), NULL, message ) ;
+        logWarn("Shaders: Link :\n%s\n",message) ;
+    }
+
+} // report_failure
+
+
+
+// The rebuild has ended. If it linked it takes the old program's place,
+// else it is dropped. Returns 1 if swapped in.
+static int finish_rebuild(SHADERLIB_T *lib, SHADERLIB_PROGRAM_T *pg)
+{
+    SHADERLIB_UNIFORM_T old[SHADERLIB_MAX_UNIFORMS] ;
+    SHADERLIB_UNIFORM_T *u ;
+    GLint linked = 0 ;
+    int i, n, nold ;
+
+    glGetProgramiv( pg->next, GL_LINK_STATUS, &linked ) ;
+    if ( !linked ) {
+        report_failure(lib, pg) ;
+        glDeleteProgram( pg->next ) ;
+        pg->next = 0 ;
+        lib->reloadFailed++ ;
+        return 0 ;
+    }
+
+    glDeleteProgram( pg->id ) ;
+    pg->id = pg->next ;
+    pg->hash = pg->nextHash ;
+    pg->next = 0 ;
+    pg->fromBinary = 0 ;
+
+    // Reflected again, the values carried over by name and all sent.
+    nold = pg->nuniforms ;
+    memcpy( old, pg->uniform, sizeof( old ) ) ;
+    memset( pg->uniform, 0, sizeof( pg->uniform ) ) ;
+    pg->nuniforms = 0 ;
+    reflect(pg) ;
+    for ( i = 0 ; i < pg->nuniforms ; ++i ) {
+        u = &pg->uniform[i] ;
+        for ( n = 0 ; n < nold && strcmp(old[n].name, u->name) != 0 ; ++n ) ;
+        if ( n < nold && old[n].type == u->type ) u->value = old[n].value ;
+        u->dirty = 1 ;
+    }
+    pg->ndirty = pg->nuniforms ;
+
+    if ( lib->haveBinary ) keep_binary(lib, pg) ;
+    lib->reloaded++ ;
+    logInfo("Shaders: '%s' features 0x%x rebuilt in %.2fms, swapped in, %d uniforms.\n",
+            lib->source[pg->source].name,pg->features,( nowus() - pg->nextStart ) / 1000.0,
+            pg->nuniforms) ;
+
+    return 1 ;
+
+} // finish_rebuild
+
+
+
+/***********************************************************
+ * Name: shaderlibReload
+ *
+ * Arguments:
+ *     lib      - library, may be NULL.
+ *     budgetUs - time to spend starting rebuilds.
+ *
+ * Description: GL thread, between frames. Reads the source
+ *              files edited since the last call, swaps in the
+ *              rebuilt programs that have linked and starts
+ *              rebuilding stale ones while in budget. A swapped
+ *              program keeps its SHADERLIB_PROGRAM_T but has a
+ *              new id, and may have new attribute locations.
+ *
+ * Returns: no. of programs swapped in.
+ *
+ ***********************************************************/
+int shaderlibReload(SHADERLIB_T *lib, double budgetUs)
+{
+    SHADERLIB_PROGRAM_T *pg ;
+    GLint done ;
+    double end ;
+    int s, p, swapped = 0 ;
+
+    if ( lib == NULL || lib->inotifyFd < 0 ) return 0 ;
+
+    for ( s = 0 ; s < lib->nsources ; ++s )
+        if ( __atomic_exchange_n( &lib->source[s].changed, 0, __ATOMIC_ACQUIRE ) ) reread(lib, s) ;
+
+    end = nowus() + budgetUs ;
+    for ( p = 0 ; p < lib->nprograms ; ++p ) {
+        pg = &lib->program[p] ;
+        if ( pg->next == 0 ) continue ;
+        done = GL_TRUE ;
+        if ( lib->haveParallel ) glGetProgramiv( pg->next, GL_COMPLETION_STATUS_KHR, &done ) ;
+        if ( done ) swapped += finish_rebuild(lib, pg) ;
+    }
+
+    for ( p = 0 ; p < lib->nprograms && nowus() < end ; ++p ) {
+        pg = &lib->program[p] ;
+        if ( !pg->stale || pg->next ) continue ;
+        PROF_BEGIN("shaderlibRebuild") ;
+        start_rebuild(lib, pg) ;
+        if ( pg->next && !lib->haveParallel ) swapped += finish_rebuild(lib, pg) ;
+        PROF_END("shaderlibRebuild") ;
+    }
+
+    for ( p = 0, lib->rebuilding = 0 ; p < lib->nprograms ; ++p )
+        if ( lib->program[p].stale || lib->program[p].next ) lib->rebuilding++ ;
+
+    return swapped ;
+
+} // shaderlibReload
+
+
+
+// An eventfd to write when a watched source changes, -1 for none.
+void shaderlibNotify(SHADERLIB_T *lib, int fd)
+{
+    if ( lib == NULL ) return ;
+    __atomic_store_n( &lib->notifyFd, fd, __ATOMIC_RELAXED ) ;
+} // shaderlibNotify
+
+
+
+// Write a binary as <driver>-<hash>.bin, through a temporary file.
+static int save_binary(const SHADERLIB_T *lib, const SHADERLIB_BINARY_T *bin)
+{
+    char path[512], tmpPath[520] ;
+    FILE *f ;
+    int ok ;
+
+    binary_path(lib, bin, path, sizeof( path )) ;
+    snprintf(tmpPath, sizeof( tmpPath ), "%s.tmp", path) ;
+    if ( ( f = fopen(tmpPath, "wb") ) == NULL ) return 0 ;
+
+    ok = fwrite(&bin->head, sizeof( bin->head ), 1, f) == 1 &&
+         fwrite(bin->data, bin->head.length, 1, f) == 1 ;
+    ok = ( fclose( f ) == 0 ) && ok ;
+    if ( ok ) ok = rename(tmpPath, path) == 0 ;
+    if ( !ok ) unlink( tmpPath ) ;
+    return ok ;
+
+} // save_binary
+
+
+
+// Make the cache directory and its parent, if they are missing.
+static void make_dir(const char *dir)
+{
+    char parent[256] ;
+    char *slash ;
+
+    if ( mkdir(dir, 0700) == 0 ) return ;
+    snprintf(parent, sizeof( parent ), "%s", dir) ;
+    if ( ( slash = strrchr(parent, '/') ) != NULL && slash != parent ) {
+        *slash = '\0' ;
+        mkdir(parent, 0700) ;
+        mkdir(dir, 0700) ;
+    }
+
+} // make_dir
+
+
+
+// GL thread. Stops the watcher, saves the new binaries and deletes
+// the programs.
+void shaderlibDestroy(SHADERLIB_T *lib)
+{
+    unsigned long uploads = 0, unchanged = 0 ;
+    uint64_t one = 1 ;
+    int b, p, s, saved = 0, failed = 0 ;
+
+    if ( lib == NULL ) return ;
+
+    if ( lib->inotifyFd >= 0 ) {
+        if ( write( lib->wakeFd, &one, sizeof( one ) ) != sizeof( one ) )
+            logWarn("Shaders: Unable to wake the watcher, %s.\n",strerror(errno)) ;
+        pthread_join( lib->watcher, NULL ) ;
+        close( lib->inotifyFd ) ;
+        close( lib->wakeFd ) ;
+        if ( lib->reloaded + lib->reloadFailed > 0 )
+            logInfo("Shaders: %d programs rebuilt after edits, %d failed.\n",
+                    lib->reloaded,lib->reloadFailed) ;
+    }
+
+    for ( b = 0 ; b < lib->nbinaries ; ++b ) {
+        if ( lib->binary[b].saved || lib->dir[0] == '\0' ) continue ;
+        if ( saved + failed == 0 ) make_dir(lib->dir) ;
+        if ( save_binary(lib, &lib->binary[b]) ) ++saved ;
+        else ++failed ;
+    }
+    if ( failed ) logWarn("Shaders: %d program binaries not saved in '%s'.\n",failed,lib->dir) ;
+
+    if ( lib->nprograms > 0 )
+        logInfo("Shaders: %d programs, %d compiled in %.2fms, %d loaded from binaries in %.2fms, "
+                "%d binaries saved.\n",lib->nprograms,lib->compiled,lib->compileMs,lib->loaded,
+                lib->loadMs,saved) ;
+
+    for ( p = 0 ; p < lib->nprograms ; ++p ) {
+        uploads += lib->program[p].uploads ;
+        unchanged += lib->program[p].unchanged ;
+    }
+    if ( uploads + unchanged > 0 )
+        logInfo("Shaders: %lu uniform values uploaded, %lu set unchanged and not sent.\n",
+                uploads,unchanged) ;
+
+    for ( p = 0 ; p < lib->nprograms ; ++p ) {
+        glDeleteProgram( lib->program[p].id ) ;
+        if ( lib->program[p].next ) glDeleteProgram( lib->program[p].next ) ;
+    }
+    for ( b = 0 ; b < lib->nbinaries ; ++b ) free( lib->binary[b].data ) ;
+    for ( s = 0 ; s < lib->nsources ; ++s ) {
+        free( lib->source[s].text[0] ) ;
+        free( lib->source[s].text[1] ) ;
+    }
+    free( lib ) ;
+
+} // shaderlibDestroy
@@ -0,0 +1,208 @@
+
+/* ************************************************************************* *
+
+  Module Name : shaderlib.h
+
+  Description : Shader library. Programs are built from a few shared
+    vertex/fragment source pairs, each feature asked for becoming a
+    #define in front of them, so one pair covers every routine. Built
+    programs are kept by a hash of their full text and asked for again
+    cost a lookup. Where GL_OES_get_program_binary is supported each
+    linked program is saved as a binary file in a cache directory, the
+    files are read by shaderlibLoadCache() off the GL thread while the
+    window is created, and a program found there is loaded rather than
+    compiled. shaderlibWarm() loads the rest, a few a frame, so later
+    routine switches find them built.
+
+    Each program's active attributes and uniforms are read once when it
+    is built. Uniform values are set in a copy kept with the program,
+    only those changed are marked, and shaderlibApply() uploads them
+    just before a draw, so a value that stays the same is sent once.
+
+    A source may instead be read from <name>.vert and <name>.frag files,
+    which a watcher thread follows with inotify. An edit is picked up by
+    shaderlibReload() between frames, which rebuilds the source's programs
+    a few at a time, in the background where GL_KHR_parallel_shader_compile
+    is supported, and swaps each in only once it has linked. A program
+    that fails to build is reported and the old one is kept.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __SHADERLIB_H__
+#define __SHADERLIB_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define SHADERLIB_MAX_SOURCES     8
+#define SHADERLIB_MAX_PROGRAMS   32
+#define SHADERLIB_MAX_BINARIES   64
+#define SHADERLIB_MAX_NAME       32
+#define SHADERLIB_MAX_UNIFORMS   16       // Active in a program.
+#define SHADERLIB_MAGIC  0x42444853       // "SHDB"
+#define SHADERLIB_VERSION         1
+#define SHADERLIB_DIR       "esTri"       // under $XDG_CACHE_HOME or ~/.cache
+#define SHADERLIB_MAX_PATH      256
+
+// Features, each defines its name in front of the sources.
+#define SHADER_COLOUR           0x1       // a_colour per vertex
+#define SHADER_TEXTURE          0x2       // a_texcoord, s_texture
+#define SHADER_TRANSFORM        0x4       // MVP matrix
+#define SHADER_NFEATURES          3
+
+// Attributes of the sources found by name, in SHADERLIB_PROGRAM_T attrib[].
+#define SHADER_POSITION           0       // a_position
+#define SHADER_COLOURS            1       // a_colour
+#define SHADER_TEXCOORD           2       // a_texcoord
+#define SHADER_NATTRIBS           3
+
+// Uniforms of the sources found by name, in SHADERLIB_PROGRAM_T known[].
+#define SHADER_MVP                0       // MVP
+#define SHADER_SAMPLER            1       // s_texture
+#define SHADER_NUNIFORMS          2
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    char        name[SHADERLIB_MAX_NAME] ;
+    const char *vertex ;        // kept, not copied, or text[0]
+    const char *fragment ;
+
+    // Read from files, shaderlibAddFiles(). path[0] "" for none.
+    char        path[2][SHADERLIB_MAX_PATH] ;       // .vert, .frag
+    char       *text[2] ;       // their contents, owned
+    int         wd ;            // inotify watch of their directory
+    int         changed ;       // set by the watcher, atomic
+} SHADERLIB_SOURCE_T ;
+
+typedef struct {
+    char        name[SHADERLIB_MAX_NAME] ;
+    GLint       location ;
+    GLenum      type ;          // GL_FLOAT_MAT4, GL_SAMPLER_2D, ...
+    GLint       size ;          // array length, only [0] is set here
+    int         dirty ;         // value not uploaded yet
+    union {
+        GLfloat f[16] ;         // float, vec and mat types
+        GLint   i[4] ;          // int, bool and sampler types
+    } value ;
+} SHADERLIB_UNIFORM_T ;
+
+typedef struct {
+    uint64_t    hash ;          // of the full vertex and fragment text
+    int         source ;
+    unsigned int features ;
+    GLuint      id ;
+    int         fromBinary ;
+
+    // Found when built, -1 where not active.
+    GLint       attrib[SHADER_NATTRIBS] ;     // locations
+    int         known[SHADER_NUNIFORMS] ;     // uniform[] indexes
+    SHADERLIB_UNIFORM_T uniform[SHADERLIB_MAX_UNIFORMS] ;
+    int         nuniforms ;
+    int         ndirty ;
+    unsigned long uploads ;     // uniform values sent
+    unsigned long unchanged ;   // set to the value they had
+
+    // Rebuilt when its source changes, id is kept until next links.
+    int         stale ;         // source changed, rebuild not started
+    GLuint      next ;          // being built, 0 = none
+    uint64_t    nextHash ;
+    double      nextStart ;     // us
+} SHADERLIB_PROGRAM_T ;
+
+// A binary file, this header then length bytes.
+typedef struct {
+    uint32_t    magic ;
+    uint32_t    version ;
+    uint64_t    hash ;          // the program's, in the file name
+    uint64_t    driver ;        // hash of GL_RENDERER and GL_VERSION, in the file name
+    uint32_t    format ;        // GL_PROGRAM_BINARY_FORMAT
+    uint32_t    length ;
+    uint32_t    features ;
+    uint32_t    pad ;
+    char        source[SHADERLIB_MAX_NAME] ;
+} SHADERLIB_FILE_T ;
+
+typedef struct {
+    SHADERLIB_FILE_T head ;
+    void       *data ;
+    int         used ;          // loaded, or found unusable
+    int         saved ;         // on disk
+} SHADERLIB_BINARY_T ;
+
+typedef struct {
+    char        dir[256] ;      // binary cache, "" for none
+    SHADERLIB_SOURCE_T source[SHADERLIB_MAX_SOURCES] ;
+    int         nsources ;
+    SHADERLIB_PROGRAM_T program[SHADERLIB_MAX_PROGRAMS] ;
+    int         nprograms ;
+    SHADERLIB_BINARY_T binary[SHADERLIB_MAX_BINARIES] ;
+    int         nbinaries ;
+    int         warmed ;        // binaries before this looked at
+
+    // Set by the first build, on the GL thread.
+    int         haveBinary ;    // -1 = not known yet
+    uint64_t    driver ;
+    PFNGLGETPROGRAMBINARYOESPROC getProgramBinary ;
+    PFNGLPROGRAMBINARYOESPROC programBinary ;
+
+    int         haveParallel ;  // GL_KHR_parallel_shader_compile
+
+    // Source file watcher.
+    int         inotifyFd ;      // inotify, -1 = not watching
+    int         wakeFd ;        // eventfd, stops the thread
+    int         notifyFd ;      // eventfd written when a source changes, -1 none
+    pthread_t   watcher ;
+
+    int         compiled ;
+    int         loaded ;        // from binaries
+    double      compileMs ;
+    double      loadMs ;
+    int         rebuilding ;    // programs stale or being built
+    int         reloaded ;      // programs swapped after an edit
+    int         reloadFailed ;
+} SHADERLIB_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+SHADERLIB_T *shaderlibCreate(const char *cacheDir) ;
+
+int shaderlibAddSource(SHADERLIB_T *lib, const char *name, const char *vertex, const char *fragment) ;
+
+int shaderlibAddFiles(SHADERLIB_T *lib, int source, const char *dir) ;
+
+int shaderlibLoadCache(SHADERLIB_T *lib) ;
+
+SHADERLIB_PROGRAM_T *shaderlibProgram(SHADERLIB_T *lib, int source, unsigned int features) ;
+
+int shaderlibUniform(const SHADERLIB_PROGRAM_T *pg, const char *name) ;
+
+void shaderlibSetf(SHADERLIB_PROGRAM_T *pg, int uniform, const GLfloat *value) ;
+
+void shaderlibSeti(SHADERLIB_PROGRAM_T *pg, int uniform, GLint value) ;
+
+void shaderlibSetiv(SHADERLIB_PROGRAM_T *pg, int uniform, const GLint *value) ;
+
+void shaderlibApply(SHADERLIB_PROGRAM_T *pg) ;
+
+int shaderlibWarm(SHADERLIB_T *lib, double budgetUs) ;
+
+int shaderlibReload(SHADERLIB_T *lib, double budgetUs) ;
+
+void shaderlibNotify(SHADERLIB_T *lib, int fd) ;
+
+void shaderlibDestroy(SHADERLIB_T *lib) ;
+
+#endif // __SHADERLIB_H__
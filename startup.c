@@ -0,0 +1,314 @@
+
+/*
+  This module runs the startup tasks as a dependency graph.
+
+  startupAdd() returns a task's number, and later tasks name those they
+  need as a mask of numbers, so a task can only need earlier ones and
+  the graph has no cycles. startupRun() starts one worker for each CPU
+  task, up to the CPUs online and STARTUP_MAX_WORKERS, and then runs the
+  GL tasks itself. Every thread takes the first waiting task of its kind
+  whose needs are done, so tasks start in the order they were added when
+  they can. All share one mutex and condition, which is plenty for a few
+  dozen tasks run once. A task that fails skips all that need it, the
+  others still run, so startupRun() always returns with no task running.
+
+  startupFirstFrame() is called after the first frame is swapped. It
+  finds the critical path by starting from the last task to end and
+  stepping back each time to the need that ended last, the one it waited
+  for, and logs every task's times, the path and the time to first frame.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "startup.h"
+#include "utils.h"
+#include "log.h"
+#include "profile.h"
+
+
+
+#define FIRST_FRAME     -1        // Critical path step after the tasks.
+
+
+
+static double nowms(STARTUP_T *su)
+{
+    return ( nowus() - su->origin ) / 1000.0 ;
+} // nowms
+
+
+
+// Start timing. Create first so the times are from the start of main().
+STARTUP_T *startupCreate(void)
+{
+    STARTUP_T *su = calloc( 1, sizeof( STARTUP_T ) ) ;
+
+    su->origin = nowus() ;
+    pthread_mutex_init( &su->lock, NULL ) ;
+    pthread_cond_init( &su->wake, NULL ) ;
+    return su ;
+
+} // startupCreate
+
+
+
+/***********************************************************
+ * Name: startupAdd
+ *
+ * Arguments:
+ *     su    - startup graph.
+ *     name  - task name, a string constant.
+ *     where - STARTUP_CPU or STARTUP_GL.
+ *     run   - task function, returns 0 if it failed.
+ *     arg   - passed to run.
+ *     needs - STARTUP_NEEDS() of the tasks to end first.
+ *
+ * Description: Adds a task, before startupRun().
+ *
+ * Returns: task number, for STARTUP_NEEDS().
+ *
+ ***********************************************************/
+int startupAdd(STARTUP_T *su, const char *name, int where, int (*run)(void *arg), void *arg,
+               unsigned int needs)
+{
+    STARTUP_TASK_T *task ;
+
+    if ( su->ntasks == STARTUP_MAX_TASKS ) {
+        logError("Startup: More than %d tasks, '%s' not added.\n",STARTUP_MAX_TASKS,name) ;
+        return -1 ;
+    }
+    task = &su->task[su->ntasks] ;
+    task->name = name ;
+    task->where = where ;
+    task->run = run ;
+    task->arg = arg ;
+    task->needs = needs ;
+    task->state = STARTUP_WAITING ;
+    su->remaining++ ;
+
+    return su->ntasks++ ;
+
+} // startupAdd
+
+
+
+// The next task for a thread of this kind, NULL if there is none yet.
+// Waiting tasks whose needs failed are skipped on the way. Locked.
+static STARTUP_TASK_T *next_task(STARTUP_T *su, int where)
+{
+    STARTUP_TASK_T *task ;
+    int t, n, ready, failed ;
+
+    for ( t = 0 ; t < su->ntasks ; ++t ) {
+        task = &su->task[t] ;
+        if ( task->state != STARTUP_WAITING ) continue ;
+
+        ready = 1 ;
+        failed = 0 ;
+        for ( n = 0 ; n < t ; ++n ) {
+            if ( !( task->needs & STARTUP_NEEDS(n) ) ) continue ;
+            if ( su->task[n].state >= STARTUP_FAILED ) failed = 1 ;
+            else if ( su->task[n].state != STARTUP_DONE ) ready = 0 ;
+        }
+        if ( failed ) {
+            task->state = STARTUP_SKIPPED ;
+            task->start = task->end = nowms(su) ;
+            su->remaining-- ;
+            pthread_cond_broadcast( &su->wake ) ;
+            t = -1 ;            // may free earlier tasks
+            continue ;
+        }
+        if ( ready && task->where == where ) return task ;
+    }
+    return NULL ;
+
+} // next_task
+
+
+
+// Run tasks of one kind until all have ended.
+static void run_tasks(STARTUP_T *su, int where, int thread)
+{
+    STARTUP_TASK_T *task ;
+    int ok ;
+
+    pthread_mutex_lock( &su->lock ) ;
+    while ( su->remaining > 0 ) {
+        if ( ( task = next_task(su, where) ) == NULL ) {
+            pthread_cond_wait( &su->wake, &su->lock ) ;
+            continue ;
+        }
+        task->state = STARTUP_RUNNING ;
+        task->thread = thread ;
+        task->start = nowms(su) ;
+        pthread_mutex_unlock( &su->lock ) ;
+
+        PROF_BEGIN(task->name) ;
+        ok = task->run(task->arg) ;
+        PROF_END(task->name) ;
+
+        pthread_mutex_lock( &su->lock ) ;
+        task->end = nowms(su) ;
+        task->state = ok ? STARTUP_DONE : STARTUP_FAILED ;
+        if ( !ok ) logError("Startup: '%s' failed.\n",task->name) ;
+        su->remaining-- ;
+        pthread_cond_broadcast( &su->wake ) ;
+    }
+    pthread_mutex_unlock( &su->lock ) ;
+
+} // run_tasks
+
+
+
+typedef struct {
+    STARTUP_T  *su ;
+    int         thread ;
+} WORKER_ARG_T ;
+
+static void *startupWorker(void *arg)
+{
+    WORKER_ARG_T *wa = arg ;
+
+    profThreadName("startup") ;
+    run_tasks(wa->su, STARTUP_CPU, wa->thread) ;
+    return NULL ;
+
+} // startupWorker
+
+
+
+/***********************************************************
+ * Name: startupRun
+ *
+ * Arguments:
+ *     su - startup graph, all tasks added.
+ *
+ * Description: Runs the CPU tasks on workers and the GL tasks
+ *              on this thread, each once its needs are done,
+ *              and waits for all to end.
+ *
+ * Returns: 1 if every task was done, 0 if any failed.
+ *
+ ***********************************************************/
+int startupRun(STARTUP_T *su)
+{
+    WORKER_ARG_T wa[STARTUP_MAX_WORKERS] ;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN) ;
+    int t, w, ncpu = 0, ok = 1 ;
+
+    for ( t = 0 ; t < su->ntasks ; ++t )
+        if ( su->task[t].where == STARTUP_CPU ) ++ncpu ;
+    if ( ncpu > cpus ) ncpu = cpus > 0 ? cpus : 1 ;
+    if ( ncpu > STARTUP_MAX_WORKERS ) ncpu = STARTUP_MAX_WORKERS ;
+
+    for ( w = 0 ; w < ncpu ; ++w ) {
+        wa[w].su = su ;
+        wa[w].thread = w + 1 ;
+        if ( pthread_create( &su->worker[w], NULL, startupWorker, &wa[w] ) != 0 ) break ;
+    }
+    su->nworkers = w ;
+
+    // No workers, this thread takes the CPU tasks too, in order.
+    if ( su->nworkers == 0 && ncpu > 0 ) {
+        logWarn("Startup: No worker threads, running the tasks in turn.\n") ;
+        for ( t = 0 ; t < su->ntasks ; ++t ) su->task[t].where = STARTUP_GL ;
+    }
+
+    run_tasks(su, STARTUP_GL, 0) ;
+    for ( w = 0 ; w < su->nworkers ; ++w ) pthread_join( su->worker[w], NULL ) ;
+
+    su->ready = nowms(su) ;
+    for ( t = 0 ; t < su->ntasks ; ++t )
+        if ( su->task[t].state != STARTUP_DONE ) ok = 0 ;
+    return ok ;
+
+} // startupRun
+
+
+
+// The need of a task that ended last, -1 if it needs none.
+static int gate(const STARTUP_T *su, int t)
+{
+    int n, last = -1 ;
+
+    for ( n = 0 ; n < t ; ++n )
+        if ( ( su->task[t].needs & STARTUP_NEEDS(n) ) && ( last < 0 || su->task[n].end > su->task[last].end ) )
+            last = n ;
+    return last ;
+
+} // gate
+
+
+
+/***********************************************************
+ * Name: startupFirstFrame
+ *
+ * Arguments:
+ *     su - startup graph, after startupRun().
+ *
+ * Description: Call once the first frame has been swapped.
+ *              Logs the tasks' times, the critical path and
+ *              the time to first frame.
+ *
+ * Returns: time to first frame, ms from startupCreate().
+ *
+ ***********************************************************/
+double startupFirstFrame(STARTUP_T *su)
+{
+    static const char *where[] = { "cpu", "gl" } ;
+    int path[STARTUP_MAX_TASKS + 1] ;
+    double sum = 0.0 ;
+    char line[1024] ;
+    STARTUP_TASK_T *task ;
+    int t, last, n = 0, len = 0 ;
+
+    if ( su == NULL ) return 0.0 ;
+    su->firstFrame = nowms(su) ;
+
+    logInfo("Startup: %-20s %-6s %9s %9s %9s\n","task","thread","start ms","end ms","took ms") ;
+    for ( t = 0 ; t < su->ntasks ; ++t ) {
+        task = &su->task[t] ;
+        logInfo("Startup: %-20s %s%-3d %9.2f %9.2f %9.2f%s\n",task->name,where[task->where],
+                task->thread,task->start,task->end,task->end - task->start,
+                task->state == STARTUP_DONE ? "" : task->state == STARTUP_FAILED ? " failed" : " skipped") ;
+        sum += task->end - task->start ;
+    }
+
+    // Back from the last task to end, through the needs waited for.
+    path[n++] = FIRST_FRAME ;
+    for ( t = 0, last = -1 ; t < su->ntasks ; ++t )
+        if ( last < 0 || su->task[t].end > su->task[last].end ) last = t ;
+    for ( t = last ; t >= 0 ; t = gate(su, t) ) path[n++] = t ;
+
+    while ( --n >= 0 && len < (int) sizeof( line ) ) {
+        if ( path[n] == FIRST_FRAME )
+            len += snprintf(line + len, sizeof( line ) - len, "first frame %.2f",su->firstFrame - su->ready) ;
+        else
+            len += snprintf(line + len, sizeof( line ) - len, "%s %.2f > ",su->task[path[n]].name,
+                            su->task[path[n]].end - su->task[path[n]].start) ;
+    }
+    logInfo("Startup: Critical path (ms) : %s\n",line) ;
+    logInfo("Startup: Tasks ended at %.2fms, %.2fms of work on %d workers and the GL thread, "
+            "%.2fms saved by overlap.\n",su->ready,sum,su->nworkers,sum > su->ready ? sum - su->ready : 0.0) ;
+    logInfo("Startup: Time to first frame %.2fms.\n",su->firstFrame) ;
+
+    return su->firstFrame ;
+
+} // startupFirstFrame
+
+
+
+void startupDestroy(STARTUP_T *su)
+{
+    if ( su == NULL ) return ;
+
+    pthread_mutex_destroy( &su->lock ) ;
+    pthread_cond_destroy( &su->wake ) ;
+    free( su ) ;
+
+} // startupDestroy
@@ -0,0 +1,88 @@
+
+/* ************************************************************************* *
+
+  Module Name : startup.h
+
+  Description : Startup task graph. Initialisation is split into tasks
+    that name the tasks they need. CPU tasks (file reads, image decode,
+    mesh generation, device discovery) run on worker threads as soon as
+    their needs are met, GL tasks run on the thread that owns, or will
+    create, the GL context, so the CPU work overlaps EGL bring-up and
+    each GL step starts the moment it can. Each task is timed, and the
+    report shows the critical path and the time to the first frame.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __STARTUP_H__
+#define __STARTUP_H__
+
+#include <pthread.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define STARTUP_MAX_TASKS     32
+#define STARTUP_MAX_WORKERS    4
+
+// Where a task runs.
+#define STARTUP_CPU            0          // any worker thread
+#define STARTUP_GL             1          // the thread calling startupRun()
+
+// A task's needs, or-ed task numbers from startupAdd().
+#define STARTUP_NEEDS(t)      ( (t) >= 0 ? 1u << (t) : 0u )
+
+// Task states.
+#define STARTUP_WAITING        0
+#define STARTUP_RUNNING        1
+#define STARTUP_DONE           2
+#define STARTUP_FAILED         3          // returned 0
+#define STARTUP_SKIPPED        4          // a need failed
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    const char *name ;
+    int       (*run)(void *arg) ;        // 0 = failed
+    void       *arg ;
+    int         where ;         // STARTUP_CPU or STARTUP_GL
+    unsigned int needs ;        // STARTUP_NEEDS() mask
+    int         state ;
+    int         thread ;        // 0 = GL thread, 1.. workers
+    double      start ;         // ms from startupCreate()
+    double      end ;
+} STARTUP_TASK_T ;
+
+typedef struct {
+    STARTUP_TASK_T task[STARTUP_MAX_TASKS] ;
+    int         ntasks ;
+    int         remaining ;     // tasks not yet ended
+    pthread_t   worker[STARTUP_MAX_WORKERS] ;
+    int         nworkers ;
+    pthread_mutex_t lock ;
+    pthread_cond_t wake ;
+    double      origin ;        // us, CLOCK_MONOTONIC
+    double      ready ;         // ms, all tasks ended
+    double      firstFrame ;    // ms, 0 until startupFirstFrame()
+} STARTUP_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+STARTUP_T *startupCreate(void) ;
+
+int startupAdd(STARTUP_T *su, const char *name, int where, int (*run)(void *arg), void *arg,
+               unsigned int needs) ;
+
+int startupRun(STARTUP_T *su) ;
+
+double startupFirstFrame(STARTUP_T *su) ;
+
+void startupDestroy(STARTUP_T *su) ;
+
+#endif // __STARTUP_H__
@@ -0,0 +1,682 @@
+
+/*
+  This module finds how many objects the current hardware and backend
+  can draw within the frame budget (esTri routine 7).
+
+  The objects are cubes, spheres and textured cubes, taken in turn,
+  scattered over a field about twice as wide as the view, each spinning
+  about its own axis while the view pans. Every path draws the same
+  objects, so the counts compare :
+    draws    - per object, a glUniformMatrix4fv() and a glDrawElements().
+    batch    - per batch of objects of a kind, the vertices transformed
+               on the CPU and streamed through a dynbuf ring, then one
+               draw. Colours, texture coordinates and indices are the
+               mesh replicated once per object in the batch, static.
+    instance - the mesh is replicated with a replica number per vertex
+               that indexes a uniform array of MVPs (there is no
+               instancing in ES 2.0), so one draw covers as many objects
+               as there are matrices in the array.
+    cull     - as draws, but objects whose bounding sphere is outside
+               the view frustum are not drawn.
+
+  The count doubles until a step's p99 frame time is over budget, then
+  is bisected between the last count within budget and the first over
+  it, until the knee is known to 1/STRESS_PRECISION. Each step is run
+  for STRESS_SETTLE_US before measuring, so buffer and driver warm-up
+  after a change is not counted.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <GLES2/gl2.h>
+
+#include "stress.h"
+#include "log.h"
+#include "utils.h"
+#include "glcount.h"
+#include "gltrace.h"
+
+
+
+#define STREAM_SIZE     (1 << 20)     // Bytes per dynbuf VBO, batch positions.
+#define MAX_INDEX         65536       // Vertices addressed by GLushort indices.
+
+// The field of objects, in front of the camera at the origin.
+#define FIELD_X          24.0f
+#define FIELD_Y           8.0f
+#define FIELD_NEAR        8.0f
+#define FIELD_DEPTH      16.0f
+#define PAN_DEGREES      20.0f        // View pans this far each way.
+
+#define BUF_OFFSET(i)   ((void *)(i))
+
+
+static const char *pathNames[STRESS_NPATHS] = { "draws", "batch", "instance", "cull" } ;
+static const char *kindNames[STRESS_NKINDS] = { "cube", "sphere", "textured cube" } ;
+
+
+
+// Repeatable pseudo random [0,1) for object i, so a count always gives
+// the same objects and rand() is left alone.
+static float hash01(unsigned int i, unsigned int salt)
+{
+    unsigned int h = i * 2654435761u ^ salt * 40503u ;
+
+    h ^= h >> 15 ; h *= 2246822519u ;
+    h ^= h >> 13 ; h *= 3266489917u ;
+    h ^= h >> 16 ;
+    return ( h & 0xffffff ) / 16777216.0f ;
+} // hash01
+
+
+
+static int init_program(STRESS_T *st)
+{
+    STRESS_PROGRAM_T *pg = &st->program ;
+    GLint maxVectors = 0 ;
+    char defines[80] = "" ;
+    char *vShaderStr ;
+    const char vShaderBody[] =
+        "#ifdef INSTANCED                             \n"
+        "uniform   mat4 MVPS[INSTANCES];              \n"
+        "attribute float a_instance;                  \n"
+        "#else                                        \n"
+        "uniform   mat4 MVP;                          \n"
+        "#endif                                       \n"
+        "attribute vec3 a_position;                   \n"
+        "attribute vec3 a_colour;                     \n"
+        "attribute vec2 a_texcoord;                   \n"
+        "varying   vec3 v_colour;                     \n"
+        "varying   vec2 v_texcoord;                   \n"
+        "void main()                                  \n"
+        "{                                            \n"
+        "   v_colour = a_colour;                      \n"
+        "   v_texcoord = a_texcoord;                  \n"
+        "#ifdef INSTANCED                             \n"
+        "   gl_Position = MVPS[int(a_instance)] * vec4(a_position,1.0); \n"
+        "#else                                        \n"
+        "   gl_Position = MVP * vec4(a_position,1.0); \n"
+        "#endif                                       \n"
+        "}                                            \n";
+    const char fShaderStr[] =
+        "precision mediump float;                     \n"
+        "varying   vec3 v_colour;                     \n"
+        "varying   vec2 v_texcoord;                   \n"
+        "uniform sampler2D s_texture;                 \n"
+        "void main()                                  \n"
+        "{                                            \n"
+        "   gl_FragColor = texture2D( s_texture, v_texcoord ) * vec4(v_colour, 1.0);\n"
+        "}                                            \n";
+
+    // As many matrices as fit, leaving a few vectors for the driver.
+    if ( st->path == STRESS_INSTANCE ) {
+        glGetIntegerv( GL_MAX_VERTEX_UNIFORM_VECTORS, &maxVectors ) ;
+        st->instances = ( maxVectors - 8 ) / 4 ;
+        if ( st->instances > STRESS_MAX_INSTANCES ) st->instances = STRESS_MAX_INSTANCES ;
+        if ( st->instances < 1 ) st->instances = 1 ;
+        snprintf(defines, sizeof( defines ), "#define INSTANCED\n#define INSTANCES %d\n", st->instances) ;
+    }
+    vShaderStr = malloc( strlen(defines) + sizeof( vShaderBody ) ) ;
+    strcpy(vShaderStr, defines) ;
+    strcat(vShaderStr, vShaderBody) ;
+    pg->id = esLoadProgram(vShaderStr, (char *) fShaderStr) ;
+    free( vShaderStr ) ;
+    if ( pg->id == 0 ) return 0 ;
+
+    pg->positionLoc = glGetAttribLocation( pg->id, "a_position" ) ;
+    pg->colourLoc = glGetAttribLocation( pg->id, "a_colour" ) ;
+    pg->texCoordLoc = glGetAttribLocation( pg->id, "a_texcoord" ) ;
+    pg->instanceLoc = glGetAttribLocation( pg->id, "a_instance" ) ;
+    pg->mvpLoc = glGetUniformLocation( pg->id, st->path == STRESS_INSTANCE ? "MVPS" : "MVP" ) ;
+    pg->samplerLoc = glGetUniformLocation( pg->id, "s_texture" ) ;
+    return 1 ;
+
+} // init_program
+
+
+
+// The mesh of a kind, and with batch or instance its replicas.
+static void init_mesh(STRESS_T *st, int kind, GLuint textureId)
+{
+    STRESS_MESH_T *m = &st->mesh[kind] ;
+    STRESS_VERTEX_T *rv ;
+    GLfloat *v = NULL, *t = NULL ;
+    GLushort *ind = NULL, *ri ;
+    GLuint i, j, nv ;
+    int r ;
+
+    if ( kind == STRESS_SPHERE ) {
+        m->ni = esGenSphere(STRESS_SLICES, 0.5f, &v, NULL, &t, &ind, &nv) ;
+        m->radius = 0.5f ;
+    } else {
+        m->ni = esGenCube(1.0f, &v, NULL, &t, &ind, &nv) ;
+        m->radius = 0.8661f ;     // sqrt(3) / 2
+    }
+    m->nv = nv ;
+    m->i = ind ;
+    m->v = malloc( nv * sizeof( STRESS_VERTEX_T ) ) ;
+    for ( i = 0 ; i < nv ; ++i ) {
+        memcpy( m->v[i].pos, &v[i * 3], 3 * sizeof( GLfloat ) ) ;
+        memcpy( m->v[i].tex, &t[i * 2], 2 * sizeof( GLfloat ) ) ;
+        for ( j = 0 ; j < 3 ; ++j )
+            m->v[i].colour[j] = ( kind == STRESS_TEXCUBE ) ? 1.0f : urandom(255) / 255.0f ;
+        m->v[i].instance = 0.0f ;
+    }
+    free( v ) ;
+    free( t ) ;
+
+    m->textureId = ( kind == STRESS_TEXCUBE ) ? textureId : st->whiteId ;
+    m->vbo = vbopoolAlloc(&st->vpool, m->v, nv * sizeof( STRESS_VERTEX_T )) ;
+    m->ibo = vbopoolAlloc(&st->ipool, m->i, m->ni * sizeof( GLushort )) ;
+
+    if ( st->path == STRESS_BATCH )
+        m->replicas = MAX_INDEX / nv < STREAM_SIZE / ( nv * 3 * sizeof( GLfloat ) ) ?
+                      MAX_INDEX / nv : STREAM_SIZE / ( nv * 3 * sizeof( GLfloat ) ) ;
+    else if ( st->path == STRESS_INSTANCE )
+        m->replicas = st->instances < MAX_INDEX / nv ? st->instances : MAX_INDEX / nv ;
+    else
+        return ;
+
+    rv = malloc( m->replicas * nv * sizeof( STRESS_VERTEX_T ) ) ;
+    ri = malloc( m->replicas * m->ni * sizeof( GLushort ) ) ;
+    for ( r = 0 ; r < m->replicas ; ++r ) {
+        for ( i = 0 ; i < nv ; ++i ) {
+            rv[r * nv + i] = m->v[i] ;
+            rv[r * nv + i].instance = (GLfloat) r ;
+        }
+        for ( i = 0 ; i < m->ni ; ++i )
+            ri[r * m->ni + i] = m->i[i] + r * nv ;
+    }
+    m->repVbo = vbopoolAlloc(&st->vpool, rv, m->replicas * nv * sizeof( STRESS_VERTEX_T )) ;
+    m->repIbo = vbopoolAlloc(&st->ipool, ri, m->replicas * m->ni * sizeof( GLushort )) ;
+    free( rv ) ;
+    free( ri ) ;
+
+    logInfo("Stress: %s %d vertices, %d triangles, %d per %s draw.\n",kindNames[kind],
+            m->nv,m->ni / 3,m->replicas,pathNames[st->path]) ;
+
+} // init_mesh
+
+
+
+// Grow or shrink to n objects. Object i is always the same object.
+static void set_objects(STRESS_T *st, int n)
+{
+    STRESS_OBJECT_T *ob ;
+    int i ;
+
+    if ( n > st->nobjects ) {
+        st->object = realloc( st->object, n * sizeof( STRESS_OBJECT_T ) ) ;
+        for ( i = st->nobjects ; i < n ; ++i ) {
+            ob = &st->object[i] ;
+            ob->pos[0] = ( hash01(i, 1) - 0.5f ) * 2.0f * FIELD_X ;
+            ob->pos[1] = ( hash01(i, 2) - 0.5f ) * 2.0f * FIELD_Y ;
+            ob->pos[2] = -FIELD_NEAR - hash01(i, 3) * FIELD_DEPTH ;
+            ob->axis[0] = hash01(i, 4) - 0.5f ;
+            ob->axis[1] = hash01(i, 5) - 0.5f ;
+            ob->axis[2] = hash01(i, 6) ;
+            ob->spin = 0.5f + 1.5f * hash01(i, 7) ;
+        }
+    }
+    st->nobjects = n ;
+
+} // set_objects
+
+
+
+/***********************************************************
+ * Name: stressCreate
+ *
+ * Arguments:
+ *     path      - STRESS_DRAWS, _BATCH, _INSTANCE or _CULL.
+ *     budget    - frame budget in us, 0 = 60Hz.
+ *     textureId - texture for the textured cubes.
+ *
+ * Description: Builds the program and meshes for the path, then
+ *              starts the first step with one object. Needs the
+ *              GL context current.
+ *
+ * Returns: capacity finder, NULL if the shaders fail.
+ *
+ ***********************************************************/
+STRESS_T *stressCreate(int path, double budget, GLuint textureId)
+{
+    STRESS_T *st = calloc( 1, sizeof( STRESS_T ) ) ;
+    GLubyte white[3] = { 255, 255, 255 } ;
+    int k, maxVertices = 0 ;
+
+    st->path = path ;
+    st->budget = ( budget > 0.0 ) ? budget : FSTATS_DEF_BUDGET ;
+    if ( !init_program(st) ) {
+        free( st ) ;
+        return NULL ;
+    }
+
+    glGenTextures( 1, &st->whiteId ) ;
+    glBindTexture( GL_TEXTURE_2D, st->whiteId ) ;
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 ) ;
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, white ) ;
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST ) ;
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST ) ;
+
+    vbopoolInit(&st->vpool, GL_ARRAY_BUFFER, 0) ;
+    vbopoolInit(&st->ipool, GL_ELEMENT_ARRAY_BUFFER, 0) ;
+    for ( k = 0 ; k < STRESS_NKINDS ; ++k ) {
+        init_mesh(st, k, textureId) ;
+        if ( st->mesh[k].replicas * st->mesh[k].nv > maxVertices )
+            maxVertices = st->mesh[k].replicas * st->mesh[k].nv ;
+    }
+
+    if ( path == STRESS_BATCH ) {
+        dynbufInit(&st->stream, GL_ARRAY_BUFFER, STREAM_SIZE, 0, DYNBUF_ORPHAN) ;
+        st->world = malloc( maxVertices * 3 * sizeof( GLfloat ) ) ;
+    } else if ( path == STRESS_INSTANCE )
+        st->mvps = malloc( st->instances * sizeof( ESMatrix ) ) ;
+
+    logInfo("Stress: %s path, budget %.2fms, p99 measured over %.1fs per step.\n",
+            pathNames[path],st->budget / 1000.0,STRESS_MEASURE_US / 1000000.0) ;
+
+    set_objects(st, 1) ;
+    hdrReset(&st->hist) ;
+    resettimer(STRESS_TIMER) ;
+    st->stepStart = st->lastFrame = uelapsedtime(STRESS_TIMER) ;
+
+    return st ;
+
+} // stressCreate
+
+
+
+// Planes of the view frustum from the view-projection matrix, for a
+// row vector times the matrix (as ESMatrix is used), normalised.
+static void frustum_planes(STRESS_T *st)
+{
+    const GLfloat (*m)[4] = st->viewProj.m ;
+    GLfloat len ;
+    int p, r, axis, sign ;
+
+    for ( p = 0 ; p < 6 ; ++p ) {
+        axis = p / 2 ;                  // x, y, z
+        sign = ( p & 1 ) ? -1 : 1 ;     // w + c, w - c
+        for ( r = 0 ; r < 4 ; ++r )
+            st->frustum[p][r] = m[r][3] + sign * m[r][axis] ;
+        len = sqrtf( st->frustum[p][0] * st->frustum[p][0] + st->frustum[p][1] * st->frustum[p][1] +
+                     st->frustum[p][2] * st->frustum[p][2] ) ;
+        for ( r = 0 ; r < 4 ; ++r )
+            st->frustum[p][r] /= len ;
+    }
+
+} // frustum_planes
+
+
+
+static int visible(const STRESS_T *st, const GLfloat *c, GLfloat radius)
+{
+    int p ;
+
+    for ( p = 0 ; p < 6 ; ++p )
+        if ( st->frustum[p][0] * c[0] + st->frustum[p][1] * c[1] +
+             st->frustum[p][2] * c[2] + st->frustum[p][3] < -radius ) return 0 ;
+    return 1 ;
+
+} // visible
+
+
+
+// The view and every object's model matrix for this frame.
+void stressUpdate(STRESS_T *st, int frame, float aspect)
+{
+    STRESS_OBJECT_T *ob ;
+    ESMatrix view, proj ;
+    int i ;
+
+    if ( st == NULL ) return ;
+
+    esMatrixLoadIdentity(&view) ;
+    esRotate(&view, PAN_DEGREES * sinf( frame * 0.01f ), 0.0f, 1.0f, 0.0f) ;
+    esMatrixLoadIdentity(&proj) ;
+    esPerspective(&proj, 45.0f, aspect, 0.1f, 100.0f) ;
+    esMatrixMultiply(&st->viewProj, &view, &proj) ;
+    frustum_planes(st) ;
+
+    for ( i = 0 ; i < st->nobjects ; ++i ) {
+        ob = &st->object[i] ;
+        esMatrixLoadIdentity(&ob->model) ;
+        esTranslate(&ob->model, ob->pos[0], ob->pos[1], ob->pos[2]) ;
+        esRotate(&ob->model, ob->spin * frame, ob->axis[0], ob->axis[1], ob->axis[2]) ;
+    }
+
+} // stressUpdate
+
+
+
+// Attributes from a buffer of STRESS_VERTEX_T at 'offset'. The positions
+// are left alone if they come from elsewhere.
+static void set_pointers(STRESS_T *st, GLintptr offset, int positions)
+{
+    STRESS_PROGRAM_T *pg = &st->program ;
+    GLsizei stride = sizeof( STRESS_VERTEX_T ) ;
+
+    if ( positions )
+        glVertexAttribPointer( pg->positionLoc, 3, GL_FLOAT, GL_FALSE, stride, BUF_OFFSET(offset) ) ;
+    glVertexAttribPointer( pg->colourLoc, 3, GL_FLOAT, GL_FALSE, stride,
+                           BUF_OFFSET(offset + 3 * sizeof( GLfloat )) ) ;
+    glVertexAttribPointer( pg->texCoordLoc, 2, GL_FLOAT, GL_FALSE, stride,
+                           BUF_OFFSET(offset + 6 * sizeof( GLfloat )) ) ;
+    if ( pg->instanceLoc >= 0 )
+        glVertexAttribPointer( pg->instanceLoc, 1, GL_FLOAT, GL_FALSE, stride,
+                               BUF_OFFSET(offset + 8 * sizeof( GLfloat )) ) ;
+
+} // set_pointers
+
+
+
+// One draw per object, with cull only those in view.
+static void draw_objects(STRESS_T *st, STRESS_MESH_T *m, int kind)
+{
+    STRESS_OBJECT_T *ob ;
+    ESMatrix mvp ;
+    GLintptr offset, ioffset ;
+    int i ;
+
+    glBindBuffer( GL_ARRAY_BUFFER, vbopoolBuffer(&st->vpool, m->vbo, &offset) ) ;
+    set_pointers(st, offset, 1) ;
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, vbopoolBuffer(&st->ipool, m->ibo, &ioffset) ) ;
+
+    for ( i = kind ; i < st->nobjects ; i += STRESS_NKINDS ) {
+        ob = &st->object[i] ;
+        if ( st->path == STRESS_CULL && !visible(st, ob->pos, m->radius) ) continue ;
+        esMatrixMultiply(&mvp, &ob->model, &st->viewProj) ;
+        glUniformMatrix4fv( st->program.mvpLoc, 1, GL_FALSE, &mvp.m[0][0] ) ;
+        glDrawElements( GL_TRIANGLES, m->ni, GL_UNSIGNED_SHORT, BUF_OFFSET(ioffset) ) ;
+        st->draws++ ;
+        st->triangles += m->ni / 3 ;
+    }
+
+} // draw_objects
+
+
+
+// Up to m->replicas objects per draw, transformed here into world space.
+static void draw_batches(STRESS_T *st, STRESS_MESH_T *m, int kind)
+{
+    const STRESS_VERTEX_T *v ;
+    const GLfloat (*model)[4] ;
+    GLfloat *w ;
+    GLintptr offset, roffset, ioffset ;
+    GLuint repVbo, repIbo ;
+    int i, k, n ;
+    GLuint j ;
+
+    glUniformMatrix4fv( st->program.mvpLoc, 1, GL_FALSE, &st->viewProj.m[0][0] ) ;
+    repVbo = vbopoolBuffer(&st->vpool, m->repVbo, &roffset) ;
+    repIbo = vbopoolBuffer(&st->ipool, m->repIbo, &ioffset) ;
+
+    for ( i = kind ; i < st->nobjects ; ) {
+        w = st->world ;
+        for ( n = 0 ; n < m->replicas && i < st->nobjects ; ++n, i += STRESS_NKINDS ) {
+            model = st->object[i].model.m ;
+            for ( j = 0, v = m->v ; j < m->nv ; ++j, ++v, w += 3 )
+                for ( k = 0 ; k < 3 ; ++k )
+                    w[k] = v->pos[0] * model[0][k] + v->pos[1] * model[1][k] +
+                           v->pos[2] * model[2][k] + model[3][k] ;
+        }
+
+        if ( !dynbufAlloc(&st->stream, st->world, n * m->nv * 3 * sizeof( GLfloat ), &offset) )
+            continue ;          // larger than the stream VBO, not drawn
+        glVertexAttribPointer( st->program.positionLoc, 3, GL_FLOAT, GL_FALSE, 0, BUF_OFFSET(offset) ) ;
+        glBindBuffer( GL_ARRAY_BUFFER, repVbo ) ;
+        set_pointers(st, roffset, 0) ;
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, repIbo ) ;
+        glDrawElements( GL_TRIANGLES, n * m->ni, GL_UNSIGNED_SHORT, BUF_OFFSET(ioffset) ) ;
+        st->draws++ ;
+        st->triangles += n * m->ni / 3 ;
+    }
+
+} // draw_batches
+
+
+
+// Up to m->replicas objects per draw, each replica picking its MVP.
+static void draw_instances(STRESS_T *st, STRESS_MESH_T *m, int kind)
+{
+    GLintptr offset, ioffset ;
+    int i, n ;
+
+    glBindBuffer( GL_ARRAY_BUFFER, vbopoolBuffer(&st->vpool, m->repVbo, &offset) ) ;
+    set_pointers(st, offset, 1) ;
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, vbopoolBuffer(&st->ipool, m->repIbo, &ioffset) ) ;
+
+    for ( i = kind ; i < st->nobjects ; ) {
+        for ( n = 0 ; n < m->replicas && i < st->nobjects ; ++n, i += STRESS_NKINDS )
+            esMatrixMultiply(&st->mvps[n], &st->object[i].model, &st->viewProj) ;
+        glUniformMatrix4fv( st->program.mvpLoc, n, GL_FALSE, &st->mvps[0].m[0][0] ) ;
+        glDrawElements( GL_TRIANGLES, n * m->ni, GL_UNSIGNED_SHORT, BUF_OFFSET(ioffset) ) ;
+        st->draws++ ;
+        st->triangles += n * m->ni / 3 ;
+    }
+
+} // draw_instances
+
+
+
+void stressDraw(STRESS_T *st)
+{
+    STRESS_PROGRAM_T *pg ;
+    int k ;
+
+    if ( st == NULL ) return ;
+    pg = &st->program ;
+
+    st->draws = st->triangles = 0 ;
+    if ( st->path == STRESS_BATCH ) dynbufNextFrame(&st->stream) ;
+
+    glUseProgram( pg->id ) ;
+    glEnableVertexAttribArray( pg->positionLoc ) ;
+    glEnableVertexAttribArray( pg->colourLoc ) ;
+    glEnableVertexAttribArray( pg->texCoordLoc ) ;
+    if ( pg->instanceLoc >= 0 ) glEnableVertexAttribArray( pg->instanceLoc ) ;
+    glActiveTexture( GL_TEXTURE0 ) ;
+    glUniform1i( pg->samplerLoc, 0 ) ;
+
+    for ( k = 0 ; k < STRESS_NKINDS ; ++k ) {
+        glBindTexture( GL_TEXTURE_2D, st->mesh[k].textureId ) ;
+        switch ( st->path ) {
+            case STRESS_BATCH :
+                draw_batches(st, &st->mesh[k], k) ;
+                break ;
+            case STRESS_INSTANCE :
+                draw_instances(st, &st->mesh[k], k) ;
+                break ;
+            default :
+                draw_objects(st, &st->mesh[k], k) ;
+                break ;
+        }
+    }
+
+    glDisableVertexAttribArray( pg->colourLoc ) ;
+    glDisableVertexAttribArray( pg->texCoordLoc ) ;
+    if ( pg->instanceLoc >= 0 ) glDisableVertexAttribArray( pg->instanceLoc ) ;
+
+} // stressDraw
+
+
+
+// The step's results, and the next count to try.
+static void end_step(STRESS_T *st, double now)
+{
+    STRESS_STEP_T step ;
+    double seconds = ( now - st->stepStart ) / 1000000.0 ;
+    int next, margin ;
+
+    step.objects = st->nobjects ;
+    step.frames = st->frames ;
+    step.p99 = hdrPercentile(&st->hist, 99.0) / 1000.0 ;
+    step.fps = st->frames / seconds ;
+    step.drawsPerSec = st->drawsSum / seconds ;
+    step.trianglesPerSec = st->trianglesSum / seconds ;
+    st->steps++ ;
+
+    logInfo("Stress: %7d objects  p99 %7.2fms  %6.1fHz  %9.0f draws/s  %8.2fM triangles/s  %s\n",
+            step.objects,step.p99 / 1000.0,step.fps,step.drawsPerSec,step.trianglesPerSec / 1e6,
+            step.p99 <= st->budget ? "ok" : "over budget") ;
+
+    if ( step.p99 <= st->budget ) {
+        st->good = step.objects ;
+        st->best = step ;
+    } else
+        st->bad = step.objects ;
+
+    // Double until over budget, then bisect.
+    if ( st->bad == 0 )
+        next = st->nobjects * 2 > STRESS_MAX_OBJECTS ? STRESS_MAX_OBJECTS : st->nobjects * 2 ;
+    else
+        next = ( st->good + st->bad ) / 2 ;
+    margin = st->good / STRESS_PRECISION > 1 ? st->good / STRESS_PRECISION : 1 ;
+    if ( next == st->nobjects || ( st->bad && st->bad - st->good <= margin ) || st->bad == 1 ) {
+        st->done = 1 ;
+        return ;
+    }
+    set_objects(st, next) ;
+
+} // end_step
+
+
+
+/***********************************************************
+ * Name: stressFrame
+ *
+ * Arguments:
+ *     st - capacity finder.
+ *
+ * Description: Call once a frame after the swap. Times the frame
+ *              and, once a step has settled and been measured,
+ *              moves on to the next object count.
+ *
+ * Returns: 1 once the knee has been found, else 0.
+ *
+ ***********************************************************/
+int stressFrame(STRESS_T *st)
+{
+    double now, us ;
+
+    if ( st == NULL || st->done ) return st != NULL ;
+    if ( st->fixed ) return 0 ;
+
+    now = uelapsedtime(STRESS_TIMER) ;
+    us = now - st->lastFrame ;
+    st->lastFrame = now ;
+
+    if ( !st->measuring ) {
+        if ( now - st->stepStart >= STRESS_SETTLE_US ) {
+            st->measuring = 1 ;
+            st->stepStart = now ;
+            st->frames = 0 ;
+            st->drawsSum = st->trianglesSum = 0.0 ;
+            hdrReset(&st->hist) ;
+        }
+        return 0 ;
+    }
+
+    hdrRecord(&st->hist, (uint64_t) ( us * 1000.0 )) ;
+    st->frames++ ;
+    st->drawsSum += st->draws ;
+    st->trianglesSum += st->triangles ;
+    if ( now - st->stepStart < STRESS_MEASURE_US || st->frames < STRESS_MIN_FRAMES ) return 0 ;
+
+    end_step(st, now) ;
+    st->measuring = 0 ;
+    st->stepStart = now ;
+    return st->done ;
+
+} // stressFrame
+
+
+
+// Hold n objects from now on, the search for the knee is given up.
+void stressSetObjects(STRESS_T *st, int n)
+{
+    if ( st == NULL ) return ;
+
+    if ( n < 1 ) n = 1 ;
+    if ( n > STRESS_MAX_OBJECTS ) n = STRESS_MAX_OBJECTS ;
+    set_objects(st, n) ;
+    st->fixed = 1 ;
+    st->measuring = 0 ;
+
+} // stressSetObjects
+
+
+
+void stressReport(STRESS_T *st)
+{
+    STRESS_STEP_T *b ;
+
+    if ( st == NULL ) return ;
+    b = &st->best ;
+
+    logInfo("Stress: %s path on '%s', %d steps.\n",pathNames[st->path],glGetString(GL_RENDERER),st->steps) ;
+    if ( st->fixed )
+        logInfo("Stress: Held at %d objects, the search was stopped.\n",st->nobjects) ;
+    if ( st->good == 0 ) {
+        logInfo("Stress: %s within the %.2fms budget.\n",
+                st->bad ? "Not even one object" : "Stopped before any step was",st->budget / 1000.0) ;
+        return ;
+    }
+    if ( !st->done )
+        logInfo("Stress: Stopped before the knee.\n") ;
+    else if ( st->bad == 0 )
+        logInfo("Stress: Reached the %d object limit within budget.\n",STRESS_MAX_OBJECTS) ;
+    else
+        logInfo("Stress: Knee between %d and %d objects.\n",st->good,st->bad) ;
+    logInfo("Stress: Max. sustainable %d objects, p99 %.2fms in %.2fms : %.1fHz, %.0f draws/s, %.2fM triangles/s.\n",
+            b->objects,b->p99 / 1000.0,st->budget / 1000.0,b->fps,b->drawsPerSec,b->trianglesPerSec / 1e6) ;
+
+} // stressReport
+
+
+
+void stressDestroy(STRESS_T *st)
+{
+    int k ;
+
+    if ( st == NULL ) return ;
+
+    for ( k = 0 ; k < STRESS_NKINDS ; ++k ) {
+        free( st->mesh[k].v ) ;
+        free( st->mesh[k].i ) ;
+    }
+    vbopoolDestroy(&st->vpool) ;
+    vbopoolDestroy(&st->ipool) ;
+    if ( st->path == STRESS_BATCH ) dynbufFree(&st->stream) ;
+    glDeleteTextures( 1, &st->whiteId ) ;
+    glDeleteProgram( st->program.id ) ;
+    free( st->world ) ;
+    free( st->mvps ) ;
+    free( st->object ) ;
+    free( st ) ;
+
+} // stressDestroy
+
+
+
+const char *stressPathName(int path)
+{
+    return ( path >= 0 && path < STRESS_NPATHS ) ? pathNames[path] : "?" ;
+} // stressPathName
+
+
+
+// Path from its name, -1 if unknown.
+int stressPathFromName(const char *name)
+{
+    int p ;
+
+    for ( p = 0 ; p < STRESS_NPATHS ; ++p )
+        if ( strcmp(name, pathNames[p]) == 0 ) return p ;
+    return -1 ;
+} // stressPathFromName
@@ -0,0 +1,169 @@
+
+/* ************************************************************************* *
+
+  Module Name : stress.h
+
+  Description : Capacity finder. A field of spinning coloured cubes,
+    coloured spheres and textured cubes is grown in steps, each step
+    settled and then measured, until the p99 frame time breaks the frame
+    budget. The object count doubles until the budget breaks, then is
+    bisected to find the knee. Reports the most objects that hold the
+    budget with the draw calls/s and triangles/s reached, for one of the
+    draw paths :
+      draws    - one draw call per object.
+      batch    - objects transformed on the CPU, streamed, one draw per batch.
+      instance - uniform array instancing, one draw per group of objects.
+      cull     - one draw call per object inside the view frustum.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __STRESS_H__
+#define __STRESS_H__
+
+#include <GLES2/gl2.h>
+
+#include "ESUtil.h"
+#include "framestats.h"
+#include "vbopool.h"
+#include "dynbuf.h"
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+// Draw paths.
+#define STRESS_DRAWS           0
+#define STRESS_BATCH           1
+#define STRESS_INSTANCE        2
+#define STRESS_CULL            3
+#define STRESS_NPATHS          4
+
+// Object kinds, added in turn.
+#define STRESS_CUBE            0
+#define STRESS_SPHERE          1
+#define STRESS_TEXCUBE         2
+#define STRESS_NKINDS          3
+
+#define STRESS_MAX_OBJECTS  (1 << 20)
+#define STRESS_SLICES         24          // Sphere slices.
+#define STRESS_MAX_INSTANCES  64          // Matrices per instanced draw.
+#define STRESS_SETTLE_US  500000.0        // Not measured after a change.
+#define STRESS_MEASURE_US 1000000.0       // Measured per step, at least.
+#define STRESS_MIN_FRAMES     30          // Frames measured per step, at least.
+#define STRESS_PRECISION      32          // Knee found to 1/32 of the count.
+#define STRESS_TIMER           2          // utils.c timer slot used.
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+// Mesh vertex, as in the VBOs. 'instance' is the replica number.
+typedef struct {
+    GLfloat     pos[3] ;
+    GLfloat     colour[3] ;
+    GLfloat     tex[2] ;
+    GLfloat     instance ;
+} STRESS_VERTEX_T ;
+
+typedef struct {
+    GLuint      nv ;            // no. of vertices
+    GLuint      ni ;            // no. of indices
+    STRESS_VERTEX_T *v ;
+    GLushort   *i ;
+    GLfloat     radius ;        // bounding sphere
+    int         vbo ;           // pool handles
+    int         ibo ;
+    int         replicas ;      // copies in repVbo/repIbo, batch and instance
+    int         repVbo ;
+    int         repIbo ;
+    GLuint      textureId ;
+} STRESS_MESH_T ;
+
+typedef struct {
+    GLfloat     pos[3] ;
+    GLfloat     axis[3] ;
+    GLfloat     spin ;          // degrees per frame
+    ESMatrix    model ;
+} STRESS_OBJECT_T ;
+
+typedef struct {
+    GLuint      id ;
+    GLint       positionLoc ;
+    GLint       colourLoc ;
+    GLint       texCoordLoc ;
+    GLint       instanceLoc ;
+    GLint       mvpLoc ;
+    GLint       samplerLoc ;
+} STRESS_PROGRAM_T ;
+
+// A measured step.
+typedef struct {
+    int         objects ;
+    unsigned long frames ;
+    double      p99 ;           // us
+    double      fps ;
+    double      drawsPerSec ;
+    double      trianglesPerSec ;
+} STRESS_STEP_T ;
+
+typedef struct {
+    int         path ;
+    double      budget ;        // us per frame
+    STRESS_PROGRAM_T program ;
+    int         instances ;     // per instanced draw
+    GLuint      whiteId ;       // 1x1 texture for the coloured kinds
+    STRESS_MESH_T mesh[STRESS_NKINDS] ;
+    VBOPOOL_T   vpool ;
+    VBOPOOL_T   ipool ;
+    DYNBUF_T    stream ;        // batch positions
+    GLfloat    *world ;         // batch positions, transformed
+    ESMatrix   *mvps ;          // instance matrices
+
+    STRESS_OBJECT_T *object ;
+    int         nobjects ;
+    ESMatrix    viewProj ;
+    GLfloat     frustum[6][4] ; // planes, normals inwards
+
+    unsigned long draws ;       // this frame
+    unsigned long triangles ;
+
+    int         measuring ;     // else settling
+    int         done ;
+    int         fixed ;         // count set by stressSetObjects(), not searched
+    double      stepStart ;     // us
+    double      lastFrame ;
+    HDRHIST_T   hist ;          // frame times, ns
+    unsigned long frames ;
+    double      drawsSum ;
+    double      trianglesSum ;
+    int         good ;          // most objects within budget, 0 = none
+    int         bad ;           // fewest over budget, 0 = none
+    STRESS_STEP_T best ;        // measured at 'good'
+    int         steps ;
+} STRESS_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+STRESS_T *stressCreate(int path, double budget, GLuint textureId) ;
+
+void stressUpdate(STRESS_T *st, int frame, float aspect) ;
+
+void stressDraw(STRESS_T *st) ;
+
+int stressFrame(STRESS_T *st) ;
+
+void stressSetObjects(STRESS_T *st, int n) ;
+
+void stressReport(STRESS_T *st) ;
+
+void stressDestroy(STRESS_T *st) ;
+
+const char *stressPathName(int path) ;
+
+int stressPathFromName(const char *name) ;
+
+#endif // __STRESS_H__
@@ -0,0 +1,267 @@
+
+/*
+  This module publishes live statistics through POSIX shared memory.
+
+  telemetryCreate() makes the segment /esTri-<pid> the size of one
+  TELEMETRY_T and maps it, telemetryDestroy() marks it exiting and
+  unlinks it, so only a killed writer leaves a segment behind, and
+  telemetryFindNewest() skips those whose pid has gone.
+
+  The writer is never held up by a reader, so the segment is guarded by
+  a sequence lock rather than a mutex : telemetryBegin() makes seq odd
+  and telemetryEnd() even again, with release ordering so the fields
+  written between are visible before seq changes. A reader copies the
+  whole struct and keeps the copy only if seq was even and unchanged
+  across it, else tries again. Writing is plain stores into a page that
+  is already mapped, no system calls.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "telemetry.h"
+#include "log.h"
+
+
+
+/***********************************************************
+ * Name: telemetryCreate
+ *
+ * Arguments:
+ *     program - name shown by monitors.
+ *
+ * Description: Creates and maps the segment /esTri-<pid>.
+ *
+ * Returns: the segment to write, NULL if it can't be made.
+ *
+ ***********************************************************/
+TELEMETRY_T *telemetryCreate(const char *program)
+{
+    TELEMETRY_T *t ;
+    struct timespec ts ;
+    char name[32] ;
+    int fd ;
+
+    snprintf(name, sizeof( name ), TELEMETRY_PREFIX "%d", (int) getpid()) ;
+    fd = shm_open( name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) ;
+    if ( fd < 0 ) {
+        logWarn("Telemetry: Unable to create '%s', %s.\n",name,strerror(errno)) ;
+        return NULL ;
+    }
+    if ( ftruncate( fd, sizeof( TELEMETRY_T ) ) != 0 ) {
+        logWarn("Telemetry: Unable to size '%s', %s.\n",name,strerror(errno)) ;
+        close( fd ) ;
+        shm_unlink( name ) ;
+        return NULL ;
+    }
+    t = mmap( NULL, sizeof( TELEMETRY_T ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) ;
+    close( fd ) ;
+    if ( t == MAP_FAILED ) {
+        logWarn("Telemetry: Unable to map '%s', %s.\n",name,strerror(errno)) ;
+        shm_unlink( name ) ;
+        return NULL ;
+    }
+
+    // ftruncate() zeroed it. The magic goes last, a reader that sees it
+    // sees the rest of the header.
+    clock_gettime(CLOCK_REALTIME, &ts) ;
+    t->version = TELEMETRY_VERSION ;
+    t->size = sizeof( TELEMETRY_T ) ;
+    t->pid = getpid() ;
+    snprintf(t->name, sizeof( t->name ), "%s", name) ;
+    snprintf(t->program, sizeof( t->program ), "%s", program) ;
+    t->startTime = ts.tv_sec + ts.tv_nsec / 1e9 ;
+    __atomic_store_n( &t->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE ) ;
+
+    logInfo("Telemetry: Publishing to '%s'.\n",name) ;
+    return t ;
+
+} // telemetryCreate
+
+
+
+// Start writing, readers retry until telemetryEnd().
+void telemetryBegin(TELEMETRY_T *t)
+{
+    if ( t == NULL ) return ;
+    __atomic_store_n( &t->seq, t->seq + 1, __ATOMIC_RELAXED ) ;
+    __atomic_thread_fence( __ATOMIC_RELEASE ) ;
+} // telemetryBegin
+
+
+
+void telemetryEnd(TELEMETRY_T *t)
+{
+    if ( t == NULL ) return ;
+    __atomic_store_n( &t->seq, t->seq + 1, __ATOMIC_RELEASE ) ;
+} // telemetryEnd
+
+
+
+// Mark the segment exiting for readers still attached and unlink it.
+void telemetryDestroy(TELEMETRY_T *t)
+{
+    char name[sizeof( t->name )] ;
+
+    if ( t == NULL ) return ;
+
+    telemetryBegin(t) ;
+    t->exiting = 1 ;
+    telemetryEnd(t) ;
+
+    memcpy( name, t->name, sizeof( name ) ) ;
+    munmap( t, sizeof( TELEMETRY_T ) ) ;
+    shm_unlink( name ) ;
+
+} // telemetryDestroy
+
+
+
+// Resident set size of this process in bytes, 0 if unknown. Reads
+// /proc, so not to be called every frame.
+uint64_t telemetryRss(void)
+{
+    FILE *f = fopen("/proc/self/statm", "r") ;
+    unsigned long size, resident = 0 ;
+
+    if ( f == NULL ) return 0 ;
+    if ( fscanf(f, "%lu %lu", &size, &resident) != 2 ) resident = 0 ;
+    fclose( f ) ;
+
+    return (uint64_t) resident * sysconf(_SC_PAGESIZE) ;
+
+} // telemetryRss
+
+
+
+/***********************************************************
+ * Name: telemetryAttach
+ *
+ * Arguments:
+ *     name - segment, /esTri-<pid>.
+ *
+ * Description: Maps a segment read only, once its magic,
+ *              version and size are known.
+ *
+ * Returns: the segment, NULL if it is missing or not one
+ *          this reader understands.
+ *
+ ***********************************************************/
+const TELEMETRY_T *telemetryAttach(const char *name)
+{
+    const TELEMETRY_T *t ;
+    struct stat st ;
+    int fd ;
+
+    fd = shm_open( name, O_RDONLY | O_CLOEXEC, 0 ) ;
+    if ( fd < 0 ) {
+        logWarn("Telemetry: Unable to open '%s', %s.\n",name,strerror(errno)) ;
+        return NULL ;
+    }
+    if ( fstat( fd, &st ) != 0 || st.st_size < (off_t) sizeof( TELEMETRY_T ) ) {
+        logWarn("Telemetry: '%s' is too small to be a segment.\n",name) ;
+        close( fd ) ;
+        return NULL ;
+    }
+    t = mmap( NULL, sizeof( TELEMETRY_T ), PROT_READ, MAP_SHARED, fd, 0 ) ;
+    close( fd ) ;
+    if ( t == MAP_FAILED ) {
+        logWarn("Telemetry: Unable to map '%s', %s.\n",name,strerror(errno)) ;
+        return NULL ;
+    }
+
+    if ( __atomic_load_n( &t->magic, __ATOMIC_ACQUIRE ) != TELEMETRY_MAGIC ||
+         t->version != TELEMETRY_VERSION || t->size < sizeof( TELEMETRY_T ) ) {
+        logWarn("Telemetry: '%s' is not a version %d segment.\n",name,TELEMETRY_VERSION) ;
+        munmap( (void *) t, sizeof( TELEMETRY_T ) ) ;
+        return NULL ;
+    }
+
+    return t ;
+
+} // telemetryAttach
+
+
+
+/***********************************************************
+ * Name: telemetryRead
+ *
+ * Arguments:
+ *     t    - attached segment.
+ *     copy - a consistent copy of it.
+ *
+ * Description: Copies the segment between frames, retrying
+ *              while the writer is part way through one.
+ *
+ * Returns: 1 if copied, 0 if the writer was always busy.
+ *
+ ***********************************************************/
+int telemetryRead(const TELEMETRY_T *t, TELEMETRY_T *copy)
+{
+    uint32_t seq ;
+    int i ;
+
+    for ( i = 0 ; i < TELEMETRY_READ_TRIES ; ++i ) {
+        seq = __atomic_load_n( &t->seq, __ATOMIC_ACQUIRE ) ;
+        if ( seq & 1 ) {
+            sched_yield() ;
+            continue ;
+        }
+        memcpy( copy, (const void *) t, sizeof( TELEMETRY_T ) ) ;
+        __atomic_thread_fence( __ATOMIC_ACQUIRE ) ;
+        if ( __atomic_load_n( &t->seq, __ATOMIC_RELAXED ) == seq ) return 1 ;
+    }
+    return 0 ;
+
+} // telemetryRead
+
+
+
+// The most recently made segment whose writer is still running, as
+// "/esTri-<pid>". Returns 0 if there is none.
+int telemetryFindNewest(char *name, int size)
+{
+    DIR *dir = opendir(TELEMETRY_SHM_DIR) ;
+    const char *prefix = TELEMETRY_PREFIX + 1 ;
+    struct dirent *de ;
+    struct stat st ;
+    char path[300] ;
+    time_t newest = 0 ;
+    int pid, found = 0 ;
+
+    if ( dir == NULL ) return 0 ;
+
+    while ( ( de = readdir(dir) ) != NULL ) {
+        if ( strncmp(de->d_name, prefix, strlen(prefix)) != 0 ) continue ;
+        pid = atoi(de->d_name + strlen(prefix)) ;
+        if ( pid <= 0 || ( kill( pid, 0 ) != 0 && errno != EPERM ) ) continue ;
+        snprintf(path, sizeof( path ), "%s/%s", TELEMETRY_SHM_DIR, de->d_name) ;
+        if ( stat( path, &st ) != 0 || ( found && st.st_mtime < newest ) ) continue ;
+        snprintf(name, size, "/%s", de->d_name) ;
+        newest = st.st_mtime ;
+        found = 1 ;
+    }
+    closedir( dir ) ;
+
+    return found ;
+
+} // telemetryFindNewest
+
+
+
+void telemetryDetach(const TELEMETRY_T *t)
+{
+    if ( t ) munmap( (void *) t, sizeof( TELEMETRY_T ) ) ;
+} // telemetryDetach
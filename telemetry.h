@@ -0,0 +1,128 @@
+
+/* ************************************************************************* *
+
+  Module Name : telemetry.h
+
+  Description : Live telemetry. A running program publishes its frame
+    statistics into a POSIX shared memory segment, /esTri-<pid>, which
+    a monitor such as esTop.bin maps read only. The segment is written
+    under a sequence lock once a frame, so the writer never waits on a
+    reader and a reader retries if it catches a frame half written.
+
+    The layout is versioned : a reader checks the magic, the version and
+    the size before it trusts the rest. Fields are only ever added, at
+    the end, with the version bumped.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stdint.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define TELEMETRY_MAGIC     0x54454c45    // "TELE"
+#define TELEMETRY_VERSION      2
+#define TELEMETRY_PREFIX    "/esTri-"     // then the writer's pid
+#define TELEMETRY_SHM_DIR   "/dev/shm"    // where Linux keeps the segments
+#define TELEMETRY_NPHASES      4          // update, draw, swap, frame as framestats.h
+#define TELEMETRY_READ_TRIES 1000         // telemetryRead() gives up after
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+// Frame time percentiles of a phase, ms.
+typedef struct {
+    double      p50 ;
+    double      p95 ;
+    double      p99 ;
+    double      max ;
+} TELEMETRY_PCT_T ;
+
+// The shared segment. Everything after seq is written between
+// telemetryBegin() and telemetryEnd().
+typedef struct {
+    uint32_t    magic ;
+    uint32_t    version ;
+    uint32_t    size ;          // sizeof( TELEMETRY_T ) of the writer
+    int32_t     pid ;
+    uint32_t    seq ;           // odd while being written
+    uint32_t    pad ;
+
+    char        name[32] ;      // segment name
+    char        program[32] ;
+    char        platform[16] ;
+    char        renderer[64] ;  // GL_RENDERER
+    int32_t     routine ;
+    int32_t     width ;
+    int32_t     height ;
+    int32_t     exiting ;       // set by telemetryDestroy()
+    double      startTime ;     // s since the epoch
+    double      uptime ;        // s
+    double      firstFrameMs ;  // from start to the first frame swapped
+
+    // Frames.
+    uint64_t    frames ;
+    double      fps ;           // over the last refresh
+    double      frameMs ;       // the last frame
+    double      budgetMs ;
+    uint64_t    over ;          // frames over budget, since start
+    TELEMETRY_PCT_T phase[TELEMETRY_NPHASES] ;  // since framestats last reported
+
+    // The last frame's GL work, 0 unless built with GLCOUNT.
+    uint64_t    draws ;
+    uint64_t    primitives ;
+    uint64_t    programBinds ;
+    uint64_t    bufferBinds ;
+    uint64_t    textureBinds ;
+    uint64_t    uniforms ;
+    uint64_t    uploadBytes ;   // client arrays, buffer and texture data
+
+    // Scene.
+    int32_t     objects ;
+    int32_t     pad2 ;
+    uint64_t    triangles ;     // a frame
+
+    // Memory, bytes.
+    uint64_t    rss ;
+    uint64_t    vboReserved ;   // VBO/IBO pools
+    uint64_t    vboUsed ;
+    uint64_t    texResident ;   // streamed tiles
+    uint64_t    texBudget ;
+
+    // Queues.
+    int32_t     assetsQueued ;  // waiting for decode
+    int32_t     assetsDecoded ; // waiting for upload
+    uint64_t    inputEvents ;
+    uint64_t    inputDropped ;
+} TELEMETRY_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+TELEMETRY_T *telemetryCreate(const char *program) ;
+
+void telemetryBegin(TELEMETRY_T *t) ;
+
+void telemetryEnd(TELEMETRY_T *t) ;
+
+void telemetryDestroy(TELEMETRY_T *t) ;
+
+uint64_t telemetryRss(void) ;
+
+const TELEMETRY_T *telemetryAttach(const char *name) ;
+
+int telemetryRead(const TELEMETRY_T *t, TELEMETRY_T *copy) ;
+
+int telemetryFindNewest(char *name, int size) ;
+
+void telemetryDetach(const TELEMETRY_T *t) ;
+
+#endif // __TELEMETRY_H__
@@ -0,0 +1,489 @@
+
+/*
+  This module streams a large image as a grid of tile textures.
+
+  Only the tiles inside the current view are requested. A background
+  thread copies them out of the mmap()ed TGA, and the render thread
+  uploads a few per frame into an LRU cache of GPU textures. When the
+  cache is over its byte budget the least recently used tiles that are
+  not needed this frame are deleted.
+
+  Tiles use the same orientation as esLoadTGA() (180 degree rotated
+  and BGR to RGB), so a streamed image matches a fully loaded one.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "texstream.h"
+#include "log.h"
+#include "profile.h"
+#include "glcount.h"
+#include "gltrace.h"
+
+
+
+#define TGA_HEADER_SIZE   18
+#define NCOMPONENTS        3       // RGB bytes per pixel.
+
+#define TILE_BYTES(t)     ((size_t) (t)->w * (t)->h * NCOMPONENTS)
+
+
+
+// Copy one tile out of the mapped image.
+static char *decodeTile(TEXSTREAM_T *ts, TEX_TILE_T *tile)
+{
+    char *pixels = malloc( TILE_BYTES(tile) ) ;
+    unsigned char *dst = (unsigned char *) pixels ;
+    const unsigned char *src ;
+    int x, y, sx, sy ;
+
+    if ( pixels == NULL ) return NULL ;
+
+    for ( y = 0 ; y < tile->h ; ++y ) {
+        sy = ts->height - 1 - ( tile->ty * ts->tileSize + y ) ;
+        for ( x = 0 ; x < tile->w ; ++x, dst += NCOMPONENTS ) {
+            sx = ts->width - 1 - ( tile->tx * ts->tileSize + x ) ;
+            src = ts->data + ( (size_t) sy * ts->width + sx ) * NCOMPONENTS ;
+            dst[0] = src[2] ;
+            dst[1] = src[1] ;
+            dst[2] = src[0] ;
+        }
+    }
+    return pixels ;
+} // decodeTile
+
+
+
+// Background decode thread.
+static void *decodeThread(void *arg)
+{
+    TEXSTREAM_T *ts = arg ;
+    TEX_TILE_T *tile ;
+    char *pixels ;
+    int t ;
+
+    profThreadName("tile decode") ;
+
+    pthread_mutex_lock( &ts->lock ) ;
+    while ( !ts->quit ) {
+        if ( ts->nrequest == 0 ) {
+            pthread_cond_wait( &ts->wake, &ts->lock ) ;
+            continue ;
+        }
+        t = ts->request[ts->requestHead] ;
+        ts->requestHead = ( ts->requestHead + 1 ) % TEXSTREAM_QUEUE_SIZE ;
+        ts->nrequest-- ;
+        pthread_mutex_unlock( &ts->lock ) ;
+
+        tile = &ts->tile[t] ;
+        PROF_BEGIN("decode tile") ;
+        pixels = decodeTile(ts,tile) ;
+        PROF_END("decode tile") ;
+
+        pthread_mutex_lock( &ts->lock ) ;
+        if ( pixels == NULL ) {         // out of memory, asked for again when in view
+            tile->state = TILE_EMPTY ;
+            ts->inflight-- ;
+            continue ;
+        }
+        tile->pixels = pixels ;
+        tile->state = TILE_DECODED ;
+        ts->done[ts->ndone++] = t ;
+    }
+    pthread_mutex_unlock( &ts->lock ) ;
+
+    return NULL ;
+} // decodeThread
+
+
+
+/***********************************************************
+ * Name: texstreamOpen
+ *
+ * Arguments:
+ *     fileName - uncompressed 24-bit TGA image.
+ *     tileSize - tile width/height in pixels, 0 for default.
+ *     budget   - GPU bytes for tile textures, 0 for default.
+ *
+ * Description: Maps the image and starts the decode thread.
+ *              No pixels are read until tiles are requested.
+ *
+ * Returns: stream, NULL on failure.
+ *
+ ***********************************************************/
+TEXSTREAM_T *texstreamOpen(const char *fileName, int tileSize, size_t budget)
+{
+    TEXSTREAM_T *ts ;
+    struct stat st ;
+    GLint maxSize ;
+    int fd, i ;
+
+    fd = open(fileName, O_RDONLY) ;
+    if ( fd < 0 ) return NULL ;
+    if ( fstat(fd, &st) < 0 || st.st_size < TGA_HEADER_SIZE ) {
+        close(fd) ;
+        return NULL ;
+    }
+
+    ts = calloc( 1, sizeof( TEXSTREAM_T ) ) ;
+    if ( ts == NULL ) {
+        close(fd) ;
+        return NULL ;
+    }
+    ts->mapSize = st.st_size ;
+    ts->map = mmap(NULL, ts->mapSize, PROT_READ, MAP_PRIVATE, fd, 0) ;
+    close(fd) ;
+    if ( ts->map == MAP_FAILED ) {
+        free( ts ) ;
+        return NULL ;
+    }
+
+    // Header : id length, colour map type, image type, ..., width, height, bpp.
+    ts->width = ts->map[12] + ts->map[13] * 256 ;
+    ts->height = ts->map[14] + ts->map[15] * 256 ;
+    ts->data = ts->map + TGA_HEADER_SIZE + ts->map[0] ;
+    if ( ts->map[2] != 2 || ts->map[16] != 24 ||
+         TGA_HEADER_SIZE + ts->map[0] + (size_t) ts->width * ts->height * NCOMPONENTS > ts->mapSize ) {
+        logError("Texstream: '%s' is not an uncompressed 24-bit TGA.\n",fileName) ;
+        munmap( ts->map, ts->mapSize ) ;
+        free( ts ) ;
+        return NULL ;
+    }
+
+    ts->tileSize = ( tileSize > 0 ) ? tileSize : TEXSTREAM_DEF_TILE ;
+    glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxSize ) ;
+    if ( maxSize > 0 && ts->tileSize > maxSize ) {
+        logWarn("Texstream: Tile size %d is over the GL maximum, using %d.\n",ts->tileSize,maxSize) ;
+        ts->tileSize = maxSize ;
+    }
+    ts->ntx = ( ts->width + ts->tileSize - 1 ) / ts->tileSize ;
+    ts->nty = ( ts->height + ts->tileSize - 1 ) / ts->tileSize ;
+    ts->tile = calloc( ts->ntx * ts->nty, sizeof( TEX_TILE_T ) ) ;
+    if ( ts->tile == NULL ) {
+        logError("Texstream: No memory for %d x %d tiles.\n",ts->ntx,ts->nty) ;
+        munmap( ts->map, ts->mapSize ) ;
+        free( ts ) ;
+        return NULL ;
+    }
+
+    for ( i = 0 ; i < ts->ntx * ts->nty ; ++i ) {
+        TEX_TILE_T *tile = &ts->tile[i] ;
+        tile->tx = i % ts->ntx ;
+        tile->ty = i / ts->ntx ;
+        tile->w = ts->width - tile->tx * ts->tileSize ;
+        tile->h = ts->height - tile->ty * ts->tileSize ;
+        if ( tile->w > ts->tileSize ) tile->w = ts->tileSize ;
+        if ( tile->h > ts->tileSize ) tile->h = ts->tileSize ;
+        tile->prev = tile->next = -1 ;
+    }
+
+    ts->lruHead = ts->lruTail = -1 ;
+    ts->stats.ntiles = ts->ntx * ts->nty ;
+    ts->stats.budget = ( budget > 0 ) ? budget : TEXSTREAM_DEF_BUDGET ;
+
+    pthread_mutex_init( &ts->lock, NULL ) ;
+    pthread_cond_init( &ts->wake, NULL ) ;
+    if ( ( errno = pthread_create( &ts->thread, NULL, decodeThread, ts ) ) != 0 ) {
+        logError("Texstream: Unable to start the decode thread, %s.\n",strerror(errno)) ;
+        pthread_mutex_destroy( &ts->lock ) ;
+        pthread_cond_destroy( &ts->wake ) ;
+        munmap( ts->map, ts->mapSize ) ;
+        free( ts->tile ) ;
+        free( ts ) ;
+        return NULL ;
+    }
+
+    logInfo("Texstream: '%s' is %d x %d, %d x %d tiles of %d, budget %zuKB.\n",
+            fileName,ts->width,ts->height,ts->ntx,ts->nty,ts->tileSize,ts->stats.budget >> 10) ;
+
+    return ts ;
+
+} // texstreamOpen
+
+
+
+void texstreamSetBudget(TEXSTREAM_T *ts, size_t budget)
+{
+    ts->stats.budget = budget ;
+} // texstreamSetBudget
+
+
+
+static void lruUnlink(TEXSTREAM_T *ts, int t)
+{
+    TEX_TILE_T *tile = &ts->tile[t] ;
+
+    if ( tile->prev >= 0 ) ts->tile[tile->prev].next = tile->next ;
+    else ts->lruHead = tile->next ;
+    if ( tile->next >= 0 ) ts->tile[tile->next].prev = tile->prev ;
+    else ts->lruTail = tile->prev ;
+    tile->prev = tile->next = -1 ;
+} // lruUnlink
+
+
+
+static void lruPushFront(TEXSTREAM_T *ts, int t)
+{
+    TEX_TILE_T *tile = &ts->tile[t] ;
+
+    tile->prev = -1 ;
+    tile->next = ts->lruHead ;
+    if ( ts->lruHead >= 0 ) ts->tile[ts->lruHead].prev = t ;
+    ts->lruHead = t ;
+    if ( ts->lruTail < 0 ) ts->lruTail = t ;
+} // lruPushFront
+
+
+
+/***********************************************************
+ * Name: texstreamRequestView
+ *
+ * Arguments:
+ *     ts     - stream.
+ *     x0, y0 - view rectangle in image pixels,
+ *     x1, y1   (x1/y1 exclusive, clipped to the image).
+ *
+ * Description: Marks the tiles under the view as needed this
+ *              frame and queues any that are not resident.
+ *              Call once per frame before texstreamUpdate().
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void texstreamRequestView(TEXSTREAM_T *ts, int x0, int y0, int x1, int y1)
+{
+    int tx, ty, t ;
+    int tx0, ty0, tx1, ty1 ;
+    TEX_TILE_T *tile ;
+
+    ts->frame++ ;
+
+    if ( x0 < 0 ) x0 = 0 ;
+    if ( y0 < 0 ) y0 = 0 ;
+    if ( x1 > ts->width ) x1 = ts->width ;
+    if ( y1 > ts->height ) y1 = ts->height ;
+    if ( x1 <= x0 || y1 <= y0 ) return ;
+
+    tx0 = x0 / ts->tileSize ;
+    ty0 = y0 / ts->tileSize ;
+    tx1 = ( x1 - 1 ) / ts->tileSize ;
+    ty1 = ( y1 - 1 ) / ts->tileSize ;
+
+    pthread_mutex_lock( &ts->lock ) ;
+    for ( ty = ty0 ; ty <= ty1 ; ++ty ) {
+        for ( tx = tx0 ; tx <= tx1 ; ++tx ) {
+            t = ty * ts->ntx + tx ;
+            tile = &ts->tile[t] ;
+            tile->lastUsed = ts->frame ;
+
+            if ( tile->state == TILE_RESIDENT ) {
+                ts->stats.hits++ ;
+                lruUnlink(ts,t) ;
+                lruPushFront(ts,t) ;
+                continue ;
+            }
+
+            ts->stats.misses++ ;
+            // Counting the tile being decoded and those done but not
+            // uploaded, so neither queue can overflow.
+            if ( tile->state == TILE_EMPTY && ts->inflight < TEXSTREAM_QUEUE_SIZE ) {
+                ts->request[( ts->requestHead + ts->nrequest ) % TEXSTREAM_QUEUE_SIZE] = t ;
+                ts->nrequest++ ;
+                ts->inflight++ ;
+                tile->state = TILE_REQUESTED ;
+            }
+        } // each tile column
+    } // each tile row
+    pthread_cond_signal( &ts->wake ) ;
+    pthread_mutex_unlock( &ts->lock ) ;
+
+} // texstreamRequestView
+
+
+
+// Delete least recently used tiles not needed this frame until 'bytes' fit.
+static int makeRoom(TEXSTREAM_T *ts, size_t bytes)
+{
+    TEX_TILE_T *tile ;
+    int t ;
+
+    while ( ts->stats.resident + bytes > ts->stats.budget ) {
+        t = ts->lruTail ;
+        if ( t < 0 ) return 0 ;
+        tile = &ts->tile[t] ;
+        if ( tile->lastUsed >= ts->frame ) return 0 ;   // all in view
+
+        lruUnlink(ts,t) ;
+        glDeleteTextures( 1, &tile->textureId ) ;
+        tile->textureId = 0 ;
+        tile->state = TILE_EMPTY ;
+        ts->stats.resident -= TILE_BYTES(tile) ;
+        ts->stats.nresident-- ;
+        ts->stats.evictions++ ;
+    }
+    return 1 ;
+} // makeRoom
+
+
+
+/***********************************************************
+ * Name: texstreamUpdate
+ *
+ * Arguments:
+ *     ts         - stream.
+ *     maxUploads - tile uploads allowed this frame.
+ *
+ * Description: Uploads decoded tiles (render thread only),
+ *              evicting old tiles to stay within budget.
+ *              Tiles no longer in view are dropped.
+ *
+ * Returns: no. of tiles uploaded.
+ *
+ ***********************************************************/
+int texstreamUpdate(TEXSTREAM_T *ts, int maxUploads)
+{
+    int done[TEXSTREAM_QUEUE_SIZE] ;
+    int i, t, ndone, nlater = 0, nup = 0, nout = 0 ;
+    TEX_TILE_T *tile ;
+    PROF_SCOPE("texstreamUpdate") ;
+
+    pthread_mutex_lock( &ts->lock ) ;
+    ndone = ts->ndone ;
+    memcpy( done, ts->done, ndone * sizeof( int ) ) ;
+    ts->ndone = 0 ;
+    pthread_mutex_unlock( &ts->lock ) ;
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 ) ;
+
+    for ( i = 0 ; i < ndone ; ++i ) {
+        t = done[i] ;
+        tile = &ts->tile[t] ;
+
+        // Over this frame's upload limit: keep it for the next frame.
+        if ( nup >= maxUploads && tile->lastUsed + 1 >= ts->frame ) {
+            done[nlater++] = t ;
+            continue ;
+        }
+
+        nout++ ;
+
+        // Out of view, or no room: drop it, it will be requested again.
+        if ( tile->lastUsed + 1 < ts->frame || !makeRoom(ts,TILE_BYTES(tile)) ) {
+            free( tile->pixels ) ;
+            tile->pixels = NULL ;
+            tile->state = TILE_EMPTY ;
+            continue ;
+        }
+
+        glGenTextures( 1, &tile->textureId ) ;
+        glBindTexture( GL_TEXTURE_2D, tile->textureId ) ;
+        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, tile->w, tile->h,
+                      0, GL_RGB, GL_UNSIGNED_BYTE, tile->pixels ) ;
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR ) ;
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR ) ;
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE ) ;
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE ) ;
+
+        free( tile->pixels ) ;
+        tile->pixels = NULL ;
+        tile->state = TILE_RESIDENT ;
+        lruPushFront(ts,t) ;
+        ts->stats.resident += TILE_BYTES(tile) ;
+        ts->stats.nresident++ ;
+        ts->stats.uploads++ ;
+        ++nup ;
+    }
+
+    // Tiles uploaded or dropped are out of flight. The decode thread may
+    // have added to done meanwhile, kept tiles that no longer fit are
+    // dropped, though the in flight bound should never let that happen.
+    pthread_mutex_lock( &ts->lock ) ;
+    if ( nlater > TEXSTREAM_QUEUE_SIZE - ts->ndone ) {
+        for ( i = TEXSTREAM_QUEUE_SIZE - ts->ndone ; i < nlater ; ++i ) {
+            tile = &ts->tile[done[i]] ;
+            free( tile->pixels ) ;
+            tile->pixels = NULL ;
+            tile->state = TILE_EMPTY ;
+            nout++ ;
+        }
+        nlater = TEXSTREAM_QUEUE_SIZE - ts->ndone ;
+    }
+    memcpy( &ts->done[ts->ndone], done, nlater * sizeof( int ) ) ;
+    ts->ndone += nlater ;
+    ts->inflight -= nout ;
+    pthread_mutex_unlock( &ts->lock ) ;
+
+    return nup ;
+
+} // texstreamUpdate
+
+
+
+// Texture for a tile, 0 if not resident (yet).
+GLuint texstreamTile(TEXSTREAM_T *ts, int tx, int ty)
+{
+    TEX_TILE_T *tile = &ts->tile[ty * ts->ntx + tx] ;
+
+    return ( tile->state == TILE_RESIDENT ) ? tile->textureId : 0 ;
+} // texstreamTile
+
+
+
+void texstreamGetStats(TEXSTREAM_T *ts, TEXSTREAM_STATS_T *stats)
+{
+    pthread_mutex_lock( &ts->lock ) ;
+    *stats = ts->stats ;
+    stats->queued = ts->inflight ;
+    pthread_mutex_unlock( &ts->lock ) ;
+} // texstreamGetStats
+
+
+
+void texstreamPrintStats(TEXSTREAM_T *ts)
+{
+    TEXSTREAM_STATS_T s ;
+    unsigned long total ;
+
+    texstreamGetStats(ts,&s) ;
+    total = s.hits + s.misses ;
+    logInfo("Texstream: %d/%d tiles resident, %zuKB of %zuKB budget, %d queued.\n",
+            s.nresident,s.ntiles,s.resident >> 10,s.budget >> 10,s.queued) ;
+    logInfo("Texstream: %lu hits, %lu misses (%.1f%% hit rate), %lu uploads, %lu evictions.\n",
+            s.hits,s.misses,total ? 100.0 * s.hits / total : 0.0,s.uploads,s.evictions) ;
+} // texstreamPrintStats
+
+
+
+void texstreamClose(TEXSTREAM_T *ts)
+{
+    int i ;
+
+    if ( ts == NULL ) return ;
+
+    pthread_mutex_lock( &ts->lock ) ;
+    ts->quit = 1 ;
+    pthread_cond_signal( &ts->wake ) ;
+    pthread_mutex_unlock( &ts->lock ) ;
+    pthread_join( ts->thread, NULL ) ;
+
+    for ( i = 0 ; i < ts->ntx * ts->nty ; ++i ) {
+        if ( ts->tile[i].pixels ) free( ts->tile[i].pixels ) ;
+        if ( ts->tile[i].textureId ) glDeleteTextures( 1, &ts->tile[i].textureId ) ;
+    }
+
+    pthread_mutex_destroy( &ts->lock ) ;
+    pthread_cond_destroy( &ts->wake ) ;
+    munmap( ts->map, ts->mapSize ) ;
+    free( ts->tile ) ;
+    free( ts ) ;
+} // texstreamClose
+
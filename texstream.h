@@ -0,0 +1,113 @@
+
+/* ************************************************************************* *
+
+  Module Name : texstream.h
+
+  Description : Tiled texture streaming for images too large to load or
+    upload whole. The source TGA is mmap()ed and split into fixed size
+    tiles. A background thread decodes the tiles the current view needs
+    and the render thread uploads them into an LRU cache of GPU tile
+    textures, kept within a memory budget.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __TEXSTREAM_H__
+#define __TEXSTREAM_H__
+
+#include <stddef.h>
+#include <pthread.h>
+#include <GLES2/gl2.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define TEXSTREAM_DEF_TILE       128          // Default tile size in pixels.
+#define TEXSTREAM_DEF_BUDGET     (4 << 20)    // Default GPU budget in bytes.
+#define TEXSTREAM_QUEUE_SIZE     256          // Max. tiles requested and not yet uploaded.
+
+// Tile states.
+#define TILE_EMPTY       0
+#define TILE_REQUESTED   1    // Queued for the decode thread.
+#define TILE_DECODED     2    // Pixels ready, waiting for upload.
+#define TILE_RESIDENT    3    // Uploaded, in the LRU cache.
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    int           tx, ty ;       // tile column/row
+    int           w, h ;         // tile size (edge tiles are smaller)
+    volatile int  state ;
+    char         *pixels ;       // decoded RGB tile, until uploaded
+    GLuint        textureId ;
+    unsigned long lastUsed ;     // frame last needed
+    int           prev, next ;   // LRU list links (-1 = none)
+} TEX_TILE_T ;
+
+// Counters that may be read at any time.
+typedef struct {
+    size_t        budget ;       // GPU bytes allowed
+    size_t        resident ;     // GPU bytes in use
+    int           nresident ;    // tiles in the cache
+    int           ntiles ;       // tiles in the whole image
+    int           queued ;       // decode requests outstanding
+    unsigned long hits ;         // needed tile was resident
+    unsigned long misses ;       // needed tile was not resident
+    unsigned long uploads ;
+    unsigned long evictions ;
+} TEXSTREAM_STATS_T ;
+
+typedef struct {
+    // Source image (mmap()ed TGA).
+    unsigned char  *map ;
+    size_t          mapSize ;
+    const unsigned char *data ;  // first pixel
+    int             width, height ;
+    int             tileSize ;
+    int             ntx, nty ;   // tiles across/down
+    TEX_TILE_T     *tile ;
+
+    // LRU list of resident tiles, head = most recently used.
+    int             lruHead, lruTail ;
+    unsigned long   frame ;
+
+    // Decode thread and its request/done queues.
+    pthread_t       thread ;
+    pthread_mutex_t lock ;
+    pthread_cond_t  wake ;
+    int             quit ;
+    int             request[TEXSTREAM_QUEUE_SIZE] ;
+    int             nrequest, requestHead ;
+    int             done[TEXSTREAM_QUEUE_SIZE] ;
+    int             ndone ;
+    int             inflight ;   // queued, decoding or done, at most TEXSTREAM_QUEUE_SIZE
+
+    TEXSTREAM_STATS_T stats ;
+} TEXSTREAM_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+TEXSTREAM_T *texstreamOpen(const char *fileName, int tileSize, size_t budget) ;
+
+void texstreamSetBudget(TEXSTREAM_T *ts, size_t budget) ;
+
+void texstreamRequestView(TEXSTREAM_T *ts, int x0, int y0, int x1, int y1) ;
+
+int texstreamUpdate(TEXSTREAM_T *ts, int maxUploads) ;
+
+GLuint texstreamTile(TEXSTREAM_T *ts, int tx, int ty) ;
+
+void texstreamGetStats(TEXSTREAM_T *ts, TEXSTREAM_STATS_T *stats) ;
+
+void texstreamPrintStats(TEXSTREAM_T *ts) ;
+
+void texstreamClose(TEXSTREAM_T *ts) ;
+
+#endif // __TEXSTREAM_H__
+
@@ -12,6 +12,9 @@
   1.0  28.04.13   Micro  Created from AIPFns.h.
   1.1  23.06.16   Micro  Add urandom,urandom1,init_keyboard,getkeycode,
                          restore_terminal,uelapsedtime.
+  1.2  18.10.26   Micro  init_keyboard,getkeycode replaced by input.c,
+                         init_terminal.
+  1.3  18.10.26   Micro  nowus,nowns.
 */
 
 
@@ -20,13 +23,8 @@
 #include <sys/time.h>  
 #include <stdio.h>  
 #include <stdlib.h>  
-#include <ctype.h>
-#include <fcntl.h>
 #include <math.h>
-#include <linux/input.h>
 #include <termios.h>
-#include <unistd.h>
-#include <string.h>
 
 
 #include "utils.h"
@@ -36,17 +34,6 @@
 // Modified so that you use & specify multiple timers.
 #define MAXNTIMERS  100
 
-// For keyboard input of the escape key.
-#define KEYBOARD     "/dev/input/event0"   // Maybe event1
-
-// Command line to get the input device event number.
-char *GET_DEVICE_COMMANDS = 
-"grep -E 'Handlers|EV=' /proc/bus/input/devices |"
-"grep -B1 'EV=120013' |"
-"grep -Eo 'event[0-9]+' |"
-"grep -Eo '[0-9]+' |"
-"tr -d '\n'" ;
-
 
 
 struct timespec timsp[MAXNTIMERS] ;  // store multiple timers start times.
@@ -122,6 +109,30 @@ double uelapsedtime(long ltim)
 
 
 
+/* Monotonic clock in microsecs, as stamped on input events, for any thread */
+double nowus(void)
+{
+  struct timespec ts ;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts) ;
+  return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0 ;
+
+} // nowus
+
+
+
+/* Monotonic clock in nanosecs */
+uint64_t nowns(void)
+{
+  struct timespec ts ;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts) ;
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec ;
+
+} // nowns
+
+
+
 // Uniform random number distribution (range 1 to limit)
 int urandom(int limit)
 {
@@ -141,49 +152,20 @@ int urandom1(void)
 
 
 
-// Try and get the keyboard device input event number.
-
-char *getDevice(const char *cmd)
-{
-#define MAXNCHARS  1000
-#define BLOCK       128
-    static char result[MAXNCHARS];
-    char buffer[MAXNCHARS];
-    FILE *pipe = popen(cmd,"r") ;
-    
-    strcpy(result,"") ;
-    while ( !feof(pipe) )
-        fgets(buffer, BLOCK, pipe) ;
-    pclose(pipe);
-
-// Restriction : Only allow a first digit number else use default. 
-    if ( isdigit( buffer[0] ) )
-        sprintf(result,"/dev/input/event%c",buffer[0]) ;
-    else
-        strcpy(result,KEYBOARD) ;
-
-    return result ;
-}
-
-
-
 /***********************************************************
- * Name: init_keyboard
+ * Name: init_terminal
  *
  * Arguments: None
  *
- * Description: Sets up the keyboard to one key input no wait.
+ * Description: Sets up the terminal to one key input, no echo.
+ *              The keyboard itself is read by input.c.
  *
- * Returns: keyboard id.
+ * Returns: void
  *
  ***********************************************************/
-int init_keyboard(void)
+void init_terminal(void)
 {
     struct termios newt;
-    int keyboard_fd ;
-    char *keyboard = KEYBOARD ;
-
-    keyboard = getDevice(GET_DEVICE_COMMANDS) ;
 
     // Disable immediate echoing.
     tcgetattr(0, &oldterminal);  /* Save terminal settings */
@@ -191,66 +173,7 @@ int init_keyboard(void)
     newt.c_lflag &= ~(ICANON | ECHO);   /* Change settings */
     tcsetattr(0, TCSANOW, &newt);       /* Apply settings */
 
-    // Open Device
-    keyboard_fd = open(keyboard, O_RDONLY|O_NONBLOCK) ;
-
-    if ( keyboard_fd >= 0 )
-        printf("Opened keyboard input(fd=%d) with '%s'\n",keyboard_fd,keyboard) ;
-    else
-        printf("Unable to open() keyboard input with '%s'\n",keyboard) ;
-
-    return keyboard_fd ;
-
-} // init_keyboard
-
-
-
-
-/***********************************************************
- * Name: getkeycode
- *
- * Arguments:
- *     keyboard_fd - keyboard id.
- *
- * Description: Check the keyboard and return is key code.
- *   Note: The keycode is NOT ASCII code. ESC = 1
- *                         
- * Returns: keycode. 
- *
- ***********************************************************/
-int getkeycode(int keyboard_fd)
-{
-#define NREADS      10
-#define NEVENTS      3
-    struct input_event ev[NEVENTS];
-    int i, j, key, size = sizeof(struct input_event);
-//    struct timeval keytime;  // Used to ignore multiple same key events.
-
-//    printf(".") ; fflush(NULL) ;
-
-    key = -1 ;
-    for ( j = 0 ; j < NREADS ; ++j ) {
-
-        read(keyboard_fd, ev, size * NEVENTS) ;
-   
-        for ( i = 0 ; i < NEVENTS ; ++i ) { 
-            if ( ev[i].value == 1 && ev[i].type == EV_KEY )
-/*
-                if (keytime.tv_sec != ev[i].time.tv_sec || keytime.tv_usec != ev[i].time.tv_usec)
-                {
-                      printf("Count %d : Event %d => Time = (%d,%d), Code[%d]\n",
-                             j,i,(int) ev[i].time.tv_sec,(int) ev[i].time.tv_usec,ev[i].code);
-                      fflush(NULL) ;
-                      keytime = ev[i].time ;  
-*/            
-                      return ev[i].code ;
-//                }
-        } // for i
-    } // several read()
-
-    return key ;
-
-} // getkeycode
+} // init_terminal
 
 
 
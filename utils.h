@@ -14,6 +14,9 @@
   1.0  28.04.13   Micro  Created from AIPFns.h.
   1.1  23.06.16   Micro  Add urandom,urandom1,init_keyboard,getkeycode,
                          restore_terminal,uelapsedtime.
+  1.2  18.10.26   Micro  init_keyboard,getkeycode replaced by input.c,
+                         init_terminal.
+  1.3  18.10.26   Micro  nowus,nowns.
 
  * ************************************************************************* */
 
@@ -22,6 +25,8 @@
 #ifndef __TIMER_H__
 #define __TIMER_H__
 
+#include <stdint.h>
+
 /* ************************************************************************* *
  * FUNCTION PROTOTYPES
  * ************************************************************************* */
@@ -34,13 +39,15 @@ long elapsedtime(long ltim) ;
 
 double uelapsedtime(long ltim) ;
 
+double nowus(void) ;
+
+uint64_t nowns(void) ;
+
 int urandom(int limit) ;
 
 int urandom1(void) ;
 
-int init_keyboard(void) ;
-
-int getkeycode(int keyboard_fd) ;
+void init_terminal(void) ;
 
 void restore_terminal(void) ;
 
@@ -0,0 +1,330 @@
+
+/*
+  This module sub-allocates meshes out of a few large buffer objects.
+
+  Each arena is one VBO (or IBO) with a list of blocks sorted by offset,
+  used or free. Allocation is best fit over all arenas, splitting the
+  block; freeing merges a block with free neighbours. When no free block
+  is big enough but the free bytes would be, the arenas are compacted
+  before another arena is created.
+
+  ES2 cannot copy between buffer objects on the GPU, so every arena keeps
+  a client copy and compaction re-uploads the moved data. Users look up
+  the buffer/offset of their handle at draw time, as it may move.
+*/
+
+
+/* Standard C library header files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vbopool.h"
+#include "log.h"
+#include "glcount.h"
+#include "gltrace.h"
+
+
+
+#define ALIGN(n)   ( ( (n) + VBOPOOL_ALIGN - 1 ) & ~( VBOPOOL_ALIGN - 1 ) )
+
+
+
+void vbopoolInit(VBOPOOL_T *pool, GLenum target, GLsizeiptr arenaSize)
+{
+    int h ;
+
+    memset( pool, 0, sizeof( VBOPOOL_T ) ) ;
+    pool->target = target ;
+    pool->arenaSize = ( arenaSize > 0 ) ? arenaSize : VBOPOOL_DEF_ARENA ;
+    for ( h = 0 ; h < VBOPOOL_MAX_HANDLES ; ++h )
+        pool->handle[h].arena = -1 ;
+} // vbopoolInit
+
+
+
+static int newArena(VBOPOOL_T *pool, GLsizeiptr size)
+{
+    VBOPOOL_ARENA_T *arena ;
+
+    if ( pool->narenas >= VBOPOOL_MAX_ARENAS ) return -1 ;
+
+    arena = &pool->arena[pool->narenas] ;
+    arena->size = ALIGN( size ) ;
+    arena->shadow = malloc( arena->size ) ;
+    if ( arena->shadow == NULL ) return -1 ;
+
+    glGenBuffers( 1, &arena->vboId ) ;
+    glBindBuffer( pool->target, arena->vboId ) ;
+    glBufferData( pool->target, arena->size, NULL, GL_STATIC_DRAW ) ;
+
+    arena->nblocks = 1 ;
+    arena->block[0].offset = 0 ;
+    arena->block[0].size = arena->size ;
+    arena->block[0].handle = -1 ;
+
+    return pool->narenas++ ;
+} // newArena
+
+
+
+// Smallest free block of at least 'size' bytes. Returns arena, -1 if none.
+static int bestFit(VBOPOOL_T *pool, GLsizeiptr size, int *blockp)
+{
+    GLsizeiptr best = 0 ;
+    int a, b, bestArena = -1 ;
+
+    for ( a = 0 ; a < pool->narenas ; ++a ) {
+        VBOPOOL_ARENA_T *arena = &pool->arena[a] ;
+        if ( arena->nblocks >= VBOPOOL_MAX_BLOCKS ) continue ;   // no room to split
+        for ( b = 0 ; b < arena->nblocks ; ++b ) {
+            VBOPOOL_BLOCK_T *block = &arena->block[b] ;
+            if ( block->handle >= 0 || block->size < size ) continue ;
+            if ( bestArena < 0 || block->size < best ) {
+                best = block->size ;
+                bestArena = a ;
+                *blockp = b ;
+            }
+        }
+    }
+    return bestArena ;
+} // bestFit
+
+
+
+/***********************************************************
+ * Name: vbopoolAlloc
+ *
+ * Arguments:
+ *     pool  - buffer pool.
+ *     data  - bytes to upload, may be NULL.
+ *     bytes - size of the allocation.
+ *
+ * Description: Finds room in an arena (compacting, or adding
+ *              an arena if needed) and uploads the data.
+ *              Leaves the arena bound to the pool target.
+ *
+ * Returns: handle, -1 on failure.
+ *
+ ***********************************************************/
+int vbopoolAlloc(VBOPOOL_T *pool, const void *data, GLsizeiptr bytes)
+{
+    GLsizeiptr size = ALIGN( bytes ) ;
+    VBOPOOL_STATS_T stats ;
+    VBOPOOL_ARENA_T *arena ;
+    VBOPOOL_BLOCK_T *block ;
+    int a, b = 0, h ;
+
+    for ( h = 0 ; h < VBOPOOL_MAX_HANDLES ; ++h )
+        if ( pool->handle[h].arena < 0 ) break ;
+    if ( h >= VBOPOOL_MAX_HANDLES || bytes <= 0 ) return -1 ;
+
+    a = bestFit(pool,size,&b) ;
+    if ( a < 0 ) {
+        vbopoolGetStats(pool,&stats) ;
+        if ( stats.reserved - stats.used >= size ) {
+            vbopoolDefrag(pool) ;
+            a = bestFit(pool,size,&b) ;
+        }
+    }
+    if ( a < 0 ) {
+        a = newArena(pool, size > pool->arenaSize ? size : pool->arenaSize) ;
+        if ( a < 0 ) {
+            logLimited(LOG_WARN, 1, "VBO pool: Unable to allocate %ld bytes!\n",(long) bytes) ;
+            return -1 ;
+        }
+        b = 0 ;
+    }
+
+    arena = &pool->arena[a] ;
+    block = &arena->block[b] ;
+
+    // Split off the unused end as a new free block.
+    if ( block->size > size ) {
+        memmove( block + 2, block + 1, ( arena->nblocks - b - 1 ) * sizeof( VBOPOOL_BLOCK_T ) ) ;
+        block[1].offset = block->offset + size ;
+        block[1].size = block->size - size ;
+        block[1].handle = -1 ;
+        block->size = size ;
+        arena->nblocks++ ;
+    }
+    block->handle = h ;
+
+    pool->handle[h].arena = a ;
+    pool->handle[h].offset = block->offset ;
+    pool->handle[h].size = bytes ;
+
+    glBindBuffer( pool->target, arena->vboId ) ;
+    if ( data ) {
+        memcpy( arena->shadow + block->offset, data, bytes ) ;
+        glBufferSubData( pool->target, block->offset, bytes, data ) ;
+    }
+
+    return h ;
+
+} // vbopoolAlloc
+
+
+
+// Release an allocation, merging it with free neighbours.
+void vbopoolFree(VBOPOOL_T *pool, int handle)
+{
+    VBOPOOL_ARENA_T *arena ;
+    VBOPOOL_BLOCK_T *block ;
+    int b ;
+
+    if ( handle < 0 || handle >= VBOPOOL_MAX_HANDLES || pool->handle[handle].arena < 0 )
+        return ;
+
+    arena = &pool->arena[pool->handle[handle].arena] ;
+    for ( b = 0 ; b < arena->nblocks ; ++b )
+        if ( arena->block[b].handle == handle ) break ;
+    pool->handle[handle].arena = -1 ;
+    if ( b >= arena->nblocks ) return ;
+
+    block = &arena->block[b] ;
+    block->handle = -1 ;
+
+    if ( b + 1 < arena->nblocks && block[1].handle < 0 ) {
+        block->size += block[1].size ;
+        memmove( block + 1, block + 2, ( arena->nblocks - b - 2 ) * sizeof( VBOPOOL_BLOCK_T ) ) ;
+        arena->nblocks-- ;
+    }
+    if ( b > 0 && block[-1].handle < 0 ) {
+        block[-1].size += block->size ;
+        memmove( block, block + 1, ( arena->nblocks - b - 1 ) * sizeof( VBOPOOL_BLOCK_T ) ) ;
+        arena->nblocks-- ;
+    }
+} // vbopoolFree
+
+
+
+// Buffer object and byte offset of an allocation (may change on compaction).
+GLuint vbopoolBuffer(const VBOPOOL_T *pool, int handle, GLintptr *offset)
+{
+    const VBOPOOL_HANDLE_T *h ;
+
+    if ( handle < 0 || handle >= VBOPOOL_MAX_HANDLES ) return 0 ;
+    h = &pool->handle[handle] ;
+    if ( h->arena < 0 ) return 0 ;
+
+    *offset = h->offset ;
+    return pool->arena[h->arena].vboId ;
+} // vbopoolBuffer
+
+
+
+/***********************************************************
+ * Name: vbopoolDefrag
+ *
+ * Arguments:
+ *     pool - buffer pool.
+ *
+ * Description: Slides every used block down to the start of
+ *              its arena, leaving one free block at the end,
+ *              and re-uploads the moved part of each arena.
+ *
+ * Returns: bytes moved.
+ *
+ ***********************************************************/
+GLsizeiptr vbopoolDefrag(VBOPOOL_T *pool)
+{
+    GLsizeiptr moved = 0, arenaMoved ;
+    GLintptr offset, lowest ;
+    int a, b, n ;
+
+    for ( a = 0 ; a < pool->narenas ; ++a ) {
+        VBOPOOL_ARENA_T *arena = &pool->arena[a] ;
+
+        offset = 0 ;
+        lowest = arena->size ;
+        arenaMoved = 0 ;
+        for ( b = 0, n = 0 ; b < arena->nblocks ; ++b ) {
+            VBOPOOL_BLOCK_T block = arena->block[b] ;
+
+            if ( block.handle < 0 ) continue ;
+            if ( block.offset != offset ) {
+                memmove( arena->shadow + offset, arena->shadow + block.offset, block.size ) ;
+                pool->handle[block.handle].offset = offset ;
+                if ( offset < lowest ) lowest = offset ;
+                arenaMoved += block.size ;
+            }
+            block.offset = offset ;
+            arena->block[n++] = block ;
+            offset += block.size ;
+        }
+        if ( offset < arena->size ) {
+            arena->block[n].offset = offset ;
+            arena->block[n].size = arena->size - offset ;
+            arena->block[n].handle = -1 ;
+            ++n ;
+        }
+        arena->nblocks = n ;
+
+        if ( arenaMoved > 0 ) {
+            glBindBuffer( pool->target, arena->vboId ) ;
+            glBufferSubData( pool->target, lowest, offset - lowest, arena->shadow + lowest ) ;
+            moved += arenaMoved ;
+        }
+    }
+
+    pool->defrags++ ;
+    pool->moved += moved ;
+
+    return moved ;
+
+} // vbopoolDefrag
+
+
+
+void vbopoolGetStats(const VBOPOOL_T *pool, VBOPOOL_STATS_T *stats)
+{
+    int a, b ;
+
+    memset( stats, 0, sizeof( VBOPOOL_STATS_T ) ) ;
+    stats->narenas = pool->narenas ;
+    stats->defrags = pool->defrags ;
+    stats->moved = pool->moved ;
+
+    for ( a = 0 ; a < pool->narenas ; ++a ) {
+        const VBOPOOL_ARENA_T *arena = &pool->arena[a] ;
+        stats->reserved += arena->size ;
+        for ( b = 0 ; b < arena->nblocks ; ++b ) {
+            const VBOPOOL_BLOCK_T *block = &arena->block[b] ;
+            if ( block->handle >= 0 ) {
+                stats->used += block->size ;
+                stats->nallocs++ ;
+            } else {
+                stats->nfree++ ;
+                if ( block->size > stats->largestFree ) stats->largestFree = block->size ;
+            }
+        }
+    }
+} // vbopoolGetStats
+
+
+
+void vbopoolPrintStats(const VBOPOOL_T *pool, const char *name)
+{
+    VBOPOOL_STATS_T s ;
+
+    vbopoolGetStats(pool,&s) ;
+    logInfo("VBO pool '%s': %d meshes, %.1fKB used of %.1fKB reserved in %d buffer(s), "
+            "%d free blocks (largest %.1fKB).\n",
+            name,s.nallocs,s.used / 1024.0,s.reserved / 1024.0,s.narenas,
+            s.nfree,s.largestFree / 1024.0) ;
+} // vbopoolPrintStats
+
+
+
+void vbopoolDestroy(VBOPOOL_T *pool)
+{
+    int a ;
+
+    for ( a = 0 ; a < pool->narenas ; ++a ) {
+        glDeleteBuffers( 1, &pool->arena[a].vboId ) ;
+        free( pool->arena[a].shadow ) ;
+    }
+    pool->narenas = 0 ;
+} // vbopoolDestroy
+
@@ -0,0 +1,97 @@
+
+/* ************************************************************************* *
+
+  Module Name : vbopool.h
+
+  Description : Sub-allocating buffer object pool. Meshes are placed in a
+    few large VBO/IBO arenas and referred to by handle, an offset and a
+    size, so meshes drawn together share one buffer binding. A free-list
+    allocator with coalescing and compaction keeps arenas tight, and the
+    pool reports GPU bytes in use against bytes reserved.
+
+ * ************************************************************************* */
+
+
+
+#ifndef __VBOPOOL_H__
+#define __VBOPOOL_H__
+
+#include <GLES2/gl2.h>
+
+/* ************************************************************************* *
+ * MACROS
+ * ************************************************************************* */
+
+#define VBOPOOL_MAX_ARENAS       8          // Max. buffer objects per pool.
+#define VBOPOOL_MAX_BLOCKS     256          // Max. used+free blocks per arena.
+#define VBOPOOL_MAX_HANDLES    256          // Max. live allocations per pool.
+#define VBOPOOL_DEF_ARENA   (2 << 20)       // Default arena size in bytes.
+#define VBOPOOL_ALIGN            4          // Allocation alignment.
+
+/* ************************************************************************* *
+ * STRUCTURES
+ * ************************************************************************* */
+
+typedef struct {
+    GLintptr    offset ;
+    GLsizeiptr  size ;
+    int         handle ;       // -1 = free
+} VBOPOOL_BLOCK_T ;
+
+typedef struct {
+    GLuint           vboId ;
+    GLsizeiptr       size ;
+    char            *shadow ;  // client copy, for compaction (no buffer copy in ES2)
+    int              nblocks ;
+    VBOPOOL_BLOCK_T  block[VBOPOOL_MAX_BLOCKS] ;   // sorted by offset
+} VBOPOOL_ARENA_T ;
+
+typedef struct {
+    int         arena ;        // -1 = handle unused
+    GLintptr    offset ;
+    GLsizeiptr  size ;         // bytes asked for
+} VBOPOOL_HANDLE_T ;
+
+typedef struct {
+    GLsizeiptr  reserved ;     // bytes of buffer objects
+    GLsizeiptr  used ;         // bytes allocated (incl. alignment)
+    GLsizeiptr  largestFree ;
+    int         narenas ;
+    int         nallocs ;
+    int         nfree ;        // free blocks (fragments)
+    unsigned long defrags ;
+    unsigned long moved ;      // bytes moved by compaction
+} VBOPOOL_STATS_T ;
+
+typedef struct {
+    GLenum            target ;
+    GLsizeiptr        arenaSize ;
+    int               narenas ;
+    VBOPOOL_ARENA_T   arena[VBOPOOL_MAX_ARENAS] ;
+    VBOPOOL_HANDLE_T  handle[VBOPOOL_MAX_HANDLES] ;
+    unsigned long     defrags ;
+    unsigned long     moved ;
+} VBOPOOL_T ;
+
+/* ************************************************************************* *
+ * FUNCTION PROTOTYPES
+ * ************************************************************************* */
+
+void vbopoolInit(VBOPOOL_T *pool, GLenum target, GLsizeiptr arenaSize) ;
+
+int vbopoolAlloc(VBOPOOL_T *pool, const void *data, GLsizeiptr bytes) ;
+
+void vbopoolFree(VBOPOOL_T *pool, int handle) ;
+
+GLuint vbopoolBuffer(const VBOPOOL_T *pool, int handle, GLintptr *offset) ;
+
+GLsizeiptr vbopoolDefrag(VBOPOOL_T *pool) ;
+
+void vbopoolGetStats(const VBOPOOL_T *pool, VBOPOOL_STATS_T *stats) ;
+
+void vbopoolPrintStats(const VBOPOOL_T *pool, const char *name) ;
+
+void vbopoolDestroy(VBOPOOL_T *pool) ;
+
+#endif // __VBOPOOL_H__
+